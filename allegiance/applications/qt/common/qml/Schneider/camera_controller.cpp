@@ -205,6 +205,42 @@ void CameraController::setShowFocusPlane(bool newShowFocusPlane)
     Q_EMIT showFocusPlaneChanged(m_showFocusPlane);
 }
 
+int CameraController::autoFocusGridSize() const
+{
+    return m_autoFocusGridSize;
+}
+
+void CameraController::setAutoFocusGridSize(int newAutoFocusGridSize)
+{
+    newAutoFocusGridSize = std::clamp(newAutoFocusGridSize, 1, int(all::FocusSampling::MaxGridSize));
+    if (m_autoFocusGridSize == newAutoFocusGridSize)
+        return;
+    m_autoFocusGridSize = newAutoFocusGridSize;
+    Q_EMIT autoFocusGridSizeChanged(m_autoFocusGridSize);
+}
+
+CameraController::AutoFocusStatistic CameraController::autoFocusStatistic() const
+{
+    return m_autoFocusStatistic;
+}
+
+void CameraController::setAutoFocusStatistic(AutoFocusStatistic newAutoFocusStatistic)
+{
+    if (m_autoFocusStatistic == newAutoFocusStatistic)
+        return;
+    m_autoFocusStatistic = newAutoFocusStatistic;
+    Q_EMIT autoFocusStatisticChanged(m_autoFocusStatistic);
+}
+
+all::FocusSampling CameraController::autoFocusSampling() const
+{
+    all::FocusSampling sampling;
+    sampling.columns = uint32_t(m_autoFocusGridSize);
+    sampling.rows = uint32_t(m_autoFocusGridSize);
+    sampling.statistic = all::FocusStatistic(m_autoFocusStatistic);
+    return sampling;
+}
+
 int CameraController::separationBasedOnFocusDistanceDivider() const
 {
     return m_separationBasedOnFocusDistanceDivider;
@@ -228,6 +264,11 @@ int CameraController::separationBasedOnFocusDistanceDividerDefaultValue() const
     return ms_separationBasedOnFocusDistanceDividerDefaultValue;
 }
 
+int CameraController::autoFocusGridSizeDefaultValue() const
+{
+    return ms_autoFocusGridSizeDefaultValue;
+}
+
 float CameraController::focusDistanceDefaultValue() const
 {
     return ms_focusDistanceDefaultValue;
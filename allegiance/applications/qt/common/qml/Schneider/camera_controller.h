@@ -4,6 +4,7 @@
 #include <QColor>
 #include <QtQml/qqmlregistration.h>
 
+#include <shared/focus_sampling.h>
 #include <shared/stereo_camera.h>
 
 class CameraController : public QObject
@@ -19,6 +20,8 @@ class CameraController : public QObject
 
     Q_PROPERTY(bool autoFocus READ autoFocus WRITE setAutoFocus NOTIFY autoFocusChanged)
     Q_PROPERTY(bool showAutoFocusArea READ showAutoFocusArea WRITE setShowAutoFocusArea NOTIFY showAutoFocusAreaChanged)
+    Q_PROPERTY(int autoFocusGridSize READ autoFocusGridSize WRITE setAutoFocusGridSize NOTIFY autoFocusGridSizeChanged)
+    Q_PROPERTY(AutoFocusStatistic autoFocusStatistic READ autoFocusStatistic WRITE setAutoFocusStatistic NOTIFY autoFocusStatisticChanged)
     Q_PROPERTY(bool showFocusPlane READ showFocusPlane WRITE setShowFocusPlane NOTIFY showFocusPlaneChanged)
     Q_PROPERTY(float focusDistance READ focusDistance WRITE setFocusDistance NOTIFY focusDistanceChanged)
     Q_PROPERTY(float popOut READ popOut WRITE setPopOut NOTIFY popOutChanged)
@@ -30,6 +33,7 @@ class CameraController : public QObject
 
     Q_PROPERTY(float eyeDistanceDefaultValue READ eyeDistanceDefaultValue CONSTANT)
     Q_PROPERTY(int separationBasedOnFocusDistanceDividerDefaultValue READ separationBasedOnFocusDistanceDividerDefaultValue CONSTANT)
+    Q_PROPERTY(int autoFocusGridSizeDefaultValue READ autoFocusGridSizeDefaultValue CONSTANT)
     Q_PROPERTY(float focusDistanceDefaultValue READ focusDistanceDefaultValue CONSTANT)
     Q_PROPERTY(float popOutDefaultValue READ popOutDefaultValue CONSTANT)
     Q_PROPERTY(float screenHeightDefaultValue READ screenHeightDefaultValue CONSTANT)
@@ -54,6 +58,13 @@ public:
     };
     Q_ENUM(StereoMode)
 
+    enum class AutoFocusStatistic {
+        Median = int(all::FocusStatistic::Median),
+        Percentile = int(all::FocusStatistic::Percentile),
+        CenterWeighted = int(all::FocusStatistic::CenterWeighted)
+    };
+    Q_ENUM(AutoFocusStatistic)
+
     CameraController(QObject* parent = nullptr);
 
     void setEyeDistance(float eyeDistance);
@@ -85,6 +96,15 @@ public:
     bool showAutoFocusArea() const;
     void setShowAutoFocusArea(bool newShowAutoFocusArea);
 
+    int autoFocusGridSize() const;
+    void setAutoFocusGridSize(int newAutoFocusGridSize);
+
+    AutoFocusStatistic autoFocusStatistic() const;
+    void setAutoFocusStatistic(AutoFocusStatistic newAutoFocusStatistic);
+
+    // How the renderers sample the auto focus area
+    all::FocusSampling autoFocusSampling() const;
+
     float screenHeight() const;
     void setScreenHeight(float newScreenHeight);
 
@@ -111,6 +131,7 @@ public:
 
     float eyeDistanceDefaultValue() const;
     int separationBasedOnFocusDistanceDividerDefaultValue() const;
+    int autoFocusGridSizeDefaultValue() const;
     float focusDistanceDefaultValue() const;
     float popOutDefaultValue() const;
     float screenHeightDefaultValue() const;
@@ -130,6 +151,8 @@ Q_SIGNALS:
     void popOutChanged(float);
     void autoFocusChanged(bool);
     void showAutoFocusAreaChanged(bool);
+    void autoFocusGridSizeChanged(int);
+    void autoFocusStatisticChanged(AutoFocusStatistic);
     void showFocusPlaneChanged(bool);
 
     void fovChanged(float);
@@ -144,6 +167,7 @@ private:
 
     static constexpr float ms_eyeDistanceDefaultValue = 0.06f;
     static constexpr int ms_separationBasedOnFocusDistanceDividerDefaultValue = 30;
+    static constexpr int ms_autoFocusGridSizeDefaultValue = 8;
     static constexpr float ms_focusDistanceDefaultValue = 10.0f;
     static constexpr float ms_popOutDefaultValue = 0.0f;
     static constexpr float ms_screenHeightDefaultValue = 0.4f;
@@ -157,6 +181,8 @@ private:
     bool m_flipped = false;
     bool m_autoFocus = true;
     bool m_showAutoFocusArea = true;
+    int m_autoFocusGridSize = ms_autoFocusGridSizeDefaultValue;
+    AutoFocusStatistic m_autoFocusStatistic = AutoFocusStatistic::Median;
     float m_focusDistance = ms_focusDistanceDefaultValue;
     float m_popOut = ms_popOutDefaultValue;
 
@@ -30,3 +30,55 @@ void MiscController::setWireframeEnabled(bool newWireframeEnabled)
     m_wireframeEnabled = newWireframeEnabled;
     Q_EMIT wireframeEnabledChanged(m_wireframeEnabled);
 }
+
+bool MiscController::compactVertexFormatsEnabled() const
+{
+    return m_compactVertexFormatsEnabled;
+}
+
+void MiscController::setCompactVertexFormatsEnabled(bool newCompactVertexFormatsEnabled)
+{
+    if (m_compactVertexFormatsEnabled == newCompactVertexFormatsEnabled)
+        return;
+    m_compactVertexFormatsEnabled = newCompactVertexFormatsEnabled;
+    Q_EMIT compactVertexFormatsEnabledChanged(m_compactVertexFormatsEnabled);
+}
+
+bool MiscController::memoryLeanEnabled() const
+{
+    return m_memoryLeanEnabled;
+}
+
+void MiscController::setMemoryLeanEnabled(bool newMemoryLeanEnabled)
+{
+    if (m_memoryLeanEnabled == newMemoryLeanEnabled)
+        return;
+    m_memoryLeanEnabled = newMemoryLeanEnabled;
+    Q_EMIT memoryLeanEnabledChanged(m_memoryLeanEnabled);
+}
+
+bool MiscController::depthReadbackEnabled() const
+{
+    return m_depthReadbackEnabled;
+}
+
+void MiscController::setDepthReadbackEnabled(bool newDepthReadbackEnabled)
+{
+    if (m_depthReadbackEnabled == newDepthReadbackEnabled)
+        return;
+    m_depthReadbackEnabled = newDepthReadbackEnabled;
+    Q_EMIT depthReadbackEnabledChanged(m_depthReadbackEnabled);
+}
+
+MiscController::ImportProfile MiscController::importProfile() const
+{
+    return ImportProfile(m_importProfile);
+}
+
+void MiscController::setImportProfile(ImportProfile importProfile)
+{
+    if (m_importProfile == all::ImportProfile(importProfile))
+        return;
+    m_importProfile = all::ImportProfile(importProfile);
+    Q_EMIT importProfileChanged(m_importProfile);
+}
@@ -4,6 +4,7 @@
 #include <QColor>
 #include <QtQml/qqmlregistration.h>
 
+#include <shared/import_profile.h>
 #include <shared/stereo_camera.h>
 
 class MiscController : public QObject
@@ -12,11 +13,22 @@ class MiscController : public QObject
 
     Q_PROPERTY(bool frustumViewEnabled READ frustumViewEnabled WRITE setFrustumViewEnabled NOTIFY frustumViewEnabledChanged)
     Q_PROPERTY(bool wireframeEnabled READ wireframeEnabled WRITE setWireframeEnabled NOTIFY wireframeEnabledChanged)
+    Q_PROPERTY(bool compactVertexFormatsEnabled READ compactVertexFormatsEnabled WRITE setCompactVertexFormatsEnabled NOTIFY compactVertexFormatsEnabledChanged)
+    Q_PROPERTY(bool memoryLeanEnabled READ memoryLeanEnabled WRITE setMemoryLeanEnabled NOTIFY memoryLeanEnabledChanged)
+    Q_PROPERTY(bool depthReadbackEnabled READ depthReadbackEnabled WRITE setDepthReadbackEnabled NOTIFY depthReadbackEnabledChanged)
+    Q_PROPERTY(ImportProfile importProfile READ importProfile WRITE setImportProfile NOTIFY importProfileChanged)
 
     QML_SINGLETON
     QML_NAMED_ELEMENT(Misc)
 
 public:
+    enum class ImportProfile {
+        FullQuality = int(all::ImportProfile::FullQuality),
+        FastPreview = int(all::ImportProfile::FastPreview),
+        PickingOnly = int(all::ImportProfile::PickingOnly)
+    };
+    Q_ENUM(ImportProfile);
+
     explicit MiscController(QObject* parent = nullptr);
 
     bool frustumViewEnabled() const;
@@ -25,11 +37,31 @@ public:
     bool wireframeEnabled() const;
     void setWireframeEnabled(bool newWireframeEnabled);
 
+    bool compactVertexFormatsEnabled() const;
+    void setCompactVertexFormatsEnabled(bool newCompactVertexFormatsEnabled);
+
+    bool memoryLeanEnabled() const;
+    void setMemoryLeanEnabled(bool newMemoryLeanEnabled);
+
+    bool depthReadbackEnabled() const;
+    void setDepthReadbackEnabled(bool newDepthReadbackEnabled);
+
+    ImportProfile importProfile() const;
+    void setImportProfile(ImportProfile importProfile);
+
 Q_SIGNALS:
     void frustumViewEnabledChanged(bool);
     void wireframeEnabledChanged(bool);
+    void compactVertexFormatsEnabledChanged(bool);
+    void memoryLeanEnabledChanged(bool);
+    void depthReadbackEnabledChanged(bool);
+    void importProfileChanged(all::ImportProfile);
 
 private:
     bool m_frustumViewEnabled{ true };
     bool m_wireframeEnabled{ false };
+    bool m_compactVertexFormatsEnabled{ false };
+    bool m_memoryLeanEnabled{ false };
+    bool m_depthReadbackEnabled{ true };
+    all::ImportProfile m_importProfile{ all::ImportProfile::FullQuality };
 };
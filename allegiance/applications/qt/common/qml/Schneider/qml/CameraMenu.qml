@@ -118,6 +118,51 @@ ColumnLayout {
                                     "Shift + F2"])
             }
 
+            SliderValue {
+                Layout.fillWidth: true
+                enabled: Camera.autoFocus
+                visible: enabled
+                from: 1
+                to: 32
+                title: "AF Grid:"
+                precision: 0
+                unit: ""
+                value: Camera.autoFocusGridSize
+                defaultValue: Camera.autoFocusGridSizeDefaultValue
+                onMoved: current => Camera.autoFocusGridSize = Math.round(current)
+                ToolTip.text: "Number of depth samples taken across each side of the auto focus area."
+            }
+
+            RowLayout {
+                Layout.fillWidth: true
+                enabled: Camera.autoFocus
+                visible: enabled
+
+                ToolTipLabel {
+                    text: "AF Depth"
+                    ToolTip.text: join(["How the focus distance is taken from the depths under the auto focus area:",
+                                        " - Median: the depth most of the area is at.",
+                                        " - Near Quartile: leans towards the nearest objects.",
+                                        " - Center Weighted: median counting the middle of the area more."])
+                }
+                ComboBox {
+                    Layout.fillWidth: true
+                    model: [
+                        { value: Camera.AutoFocusStatistic.Median, text: "Median" },
+                        { value: Camera.AutoFocusStatistic.Percentile, text: "Near Quartile" },
+                        { value: Camera.AutoFocusStatistic.CenterWeighted, text: "Center Weighted" }
+                    ]
+                    textRole: "text"
+                    valueRole: "value"
+                    currentIndex: Camera.autoFocusStatistic
+                    onCurrentIndexChanged: {
+                        if (currentIndex !== -1 && Camera.autoFocusStatistic != currentIndex) {
+                            Camera.autoFocusStatistic = currentIndex;
+                        }
+                    }
+                }
+            }
+
             CheckBoxX {
                 title: "Show Focus Plane"
                 initial: Camera.showFocusPlane
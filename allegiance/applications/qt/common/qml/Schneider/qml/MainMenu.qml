@@ -31,6 +31,43 @@ ScrollView {
             }
         }
 
+        ProgressBar {
+            Layout.fillWidth: true
+            Layout.alignment: Qt.AlignTop
+            visible: Scene.modelLoading
+            from: 0.0
+            to: 1.0
+            value: Scene.modelLoadProgress
+        }
+
+        ButtonX {
+            Layout.fillWidth: true
+            Layout.alignment: Qt.AlignTop
+            visible: Scene.modelLoading
+            text: "Cancel Loading"
+            onClicked: {
+                Scene.CancelModelLoad()
+            }
+        }
+
+        Label {
+            Layout.fillWidth: true
+            Layout.alignment: Qt.AlignTop
+            visible: !Scene.modelLoading && Scene.modelMemory !== ""
+            text: Scene.modelMemory
+            font: Style.fontDefault
+            wrapMode: Text.WordWrap
+        }
+
+        Label {
+            Layout.fillWidth: true
+            Layout.alignment: Qt.AlignTop
+            visible: !Scene.modelLoading && Scene.pickedMesh !== ""
+            text: "Cursor over: " + Scene.pickedMesh
+            font: Style.fontDefault
+            elide: Text.ElideRight
+        }
+
         // Misc
         Pane {
             Layout.fillWidth: true
@@ -29,5 +29,64 @@ ColumnLayout {
             Layout.row: 1
             ToolTip.text: "Display the Camera Frustum Overlay. \nF"
         }
+
+        CheckBoxX {
+            title: "Compact Vertex Formats"
+            initial: Misc.compactVertexFormatsEnabled
+            onChecked: checkValue => Misc.compactVertexFormatsEnabled = checkValue
+            Layout.column: 0
+            Layout.columnSpan: 3
+            Layout.row: 2
+            ToolTip.text: "Store vertices as half floats and octahedral normals.\nApplies to the next loaded model."
+        }
+
+        CheckBoxX {
+            title: "Memory Lean"
+            initial: Misc.memoryLeanEnabled
+            onChecked: checkValue => Misc.memoryLeanEnabled = checkValue
+            Layout.column: 0
+            Layout.columnSpan: 3
+            Layout.row: 3
+            ToolTip.text: "Keep as little geometry as possible in CPU memory.\nImplies compact vertex formats, applies to the next loaded model."
+        }
+
+        CheckBoxX {
+            title: "GPU Depth Picking"
+            initial: Misc.depthReadbackEnabled
+            onChecked: checkValue => Misc.depthReadbackEnabled = checkValue
+            Layout.column: 0
+            Layout.columnSpan: 3
+            Layout.row: 4
+            ToolTip.text: "Read the cursor and auto focus depth back from the GPU instead of ray casting,\nwhile the view is still or the model is not ready for picking."
+        }
+
+        Label {
+            text: "Import Profile"
+            font: Style.fontDefault
+            Layout.column: 0
+            Layout.row: 5
+        }
+
+        ComboBox {
+            Layout.fillWidth: true
+            model: [
+                {value: Misc.ImportProfile.FullQuality, text: "Full Quality"},
+                {value: Misc.ImportProfile.FastPreview, text: "Fast Preview"},
+                {value: Misc.ImportProfile.PickingOnly, text: "Picking Only"}
+            ]
+            textRole: "text"
+            valueRole: "value"
+            currentIndex: Misc.importProfile
+            onCurrentIndexChanged: {
+                if (currentIndex !== -1 && Misc.importProfile != currentIndex) {
+                    Misc.importProfile = currentIndex;
+                }
+            }
+            Layout.column: 1
+            Layout.columnSpan: 2
+            Layout.row: 5
+            ToolTip.visible: hovered
+            ToolTip.text: "Processing and vertex attributes kept when importing.\nApplies to the next loaded model."
+        }
     }
 }
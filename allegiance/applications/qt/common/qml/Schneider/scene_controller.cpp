@@ -66,3 +66,55 @@ float SceneController::defaultZoomAmount() const
 {
     return ms_defaultZoomAmount;
 }
+
+bool SceneController::modelLoading() const
+{
+    return m_modelLoading;
+}
+
+void SceneController::setModelLoading(bool newModelLoading)
+{
+    if (m_modelLoading == newModelLoading)
+        return;
+    m_modelLoading = newModelLoading;
+    Q_EMIT modelLoadingChanged();
+}
+
+float SceneController::modelLoadProgress() const
+{
+    return m_modelLoadProgress;
+}
+
+void SceneController::setModelLoadProgress(float newModelLoadProgress)
+{
+    if (qFuzzyCompare(m_modelLoadProgress, newModelLoadProgress))
+        return;
+    m_modelLoadProgress = newModelLoadProgress;
+    Q_EMIT modelLoadProgressChanged();
+}
+
+QString SceneController::modelMemory() const
+{
+    return m_modelMemory;
+}
+
+void SceneController::setModelMemory(const QString& newModelMemory)
+{
+    if (m_modelMemory == newModelMemory)
+        return;
+    m_modelMemory = newModelMemory;
+    Q_EMIT modelMemoryChanged();
+}
+
+QString SceneController::pickedMesh() const
+{
+    return m_pickedMesh;
+}
+
+void SceneController::setPickedMesh(const QString& newPickedMesh)
+{
+    if (m_pickedMesh == newPickedMesh)
+        return;
+    m_pickedMesh = newPickedMesh;
+    Q_EMIT pickedMeshChanged();
+}
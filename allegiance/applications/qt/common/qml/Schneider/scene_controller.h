@@ -12,6 +12,10 @@ class SceneController : public QObject
     Q_PROPERTY(bool lockMouseInPlace READ lockMouseInPlace WRITE setLockMouseInPlace NOTIFY lockMouseInPlaceChanged)
     Q_PROPERTY(float zoomAmount READ zoomAmount WRITE setZoomAmount NOTIFY zoomAmountChanged)
     Q_PROPERTY(float defaultZoomAmount READ defaultZoomAmount CONSTANT)
+    Q_PROPERTY(bool modelLoading READ modelLoading WRITE setModelLoading NOTIFY modelLoadingChanged)
+    Q_PROPERTY(float modelLoadProgress READ modelLoadProgress WRITE setModelLoadProgress NOTIFY modelLoadProgressChanged)
+    Q_PROPERTY(QString modelMemory READ modelMemory WRITE setModelMemory NOTIFY modelMemoryChanged)
+    Q_PROPERTY(QString pickedMesh READ pickedMesh WRITE setPickedMesh NOTIFY pickedMeshChanged)
     QML_SINGLETON
     QML_NAMED_ELEMENT(Scene)
 public:
@@ -32,8 +36,21 @@ public:
 
     float defaultZoomAmount() const;
 
+    bool modelLoading() const;
+    void setModelLoading(bool newModelLoading);
+
+    float modelLoadProgress() const;
+    void setModelLoadProgress(float newModelLoadProgress);
+
+    QString modelMemory() const;
+    void setModelMemory(const QString& newModelMemory);
+
+    QString pickedMesh() const;
+    void setPickedMesh(const QString& newPickedMesh);
+
 Q_SIGNALS:
     void OpenLoadModelDialog();
+    void CancelModelLoad();
     void mouseSensitivityChanged();
 
     void shiftPressedChanged();
@@ -42,6 +59,11 @@ Q_SIGNALS:
 
     void zoomAmountChanged();
 
+    void modelLoadingChanged();
+    void modelLoadProgressChanged();
+    void modelMemoryChanged();
+    void pickedMeshChanged();
+
 protected:
     float m_mouseSensitivity = 100;
     float m_mousePressedX = 0;
@@ -51,5 +73,9 @@ private:
     bool m_shiftPressed{ false };
     static constexpr float ms_defaultZoomAmount{ 5.0f };
     float m_zoomAmount{ ms_defaultZoomAmount };
+    bool m_modelLoading{ false };
+    float m_modelLoadProgress{ 0.0f };
+    QString m_modelMemory; // CPU memory held by the loaded model
+    QString m_pickedMesh; // Mesh under the cursor, empty if none
 };
 
@@ -16,6 +16,7 @@
 #include <QFileInfo>
 
 #include <any>
+#include <string>
 
 namespace all::qt {
 struct MouseTracker {
@@ -288,12 +289,30 @@ public:
             m_renderer->propertyChanged("auto_focus", enabled);
             m_renderer->propertyChanged("show_focus_area", m_cameraController->showAutoFocusArea() && m_cameraController->autoFocus());
         });
+        QObject::connect(m_cameraController, &CameraController::autoFocusGridSizeChanged, [this] {
+            m_renderer->propertyChanged("auto_focus_sampling", m_cameraController->autoFocusSampling());
+        });
+        QObject::connect(m_cameraController, &CameraController::autoFocusStatisticChanged, [this] {
+            m_renderer->propertyChanged("auto_focus_sampling", m_cameraController->autoFocusSampling());
+        });
         QObject::connect(m_miscController, &MiscController::frustumViewEnabledChanged, [this](bool enabled) {
             m_renderer->propertyChanged("frustum_view_enabled", enabled);
         });
         QObject::connect(m_miscController, &MiscController::wireframeEnabledChanged, [this](bool enabled) {
             m_renderer->propertyChanged("wireframe_enabled", enabled);
         });
+        QObject::connect(m_miscController, &MiscController::compactVertexFormatsEnabledChanged, [this](bool enabled) {
+            m_renderer->propertyChanged("compact_vertex_formats", enabled);
+        });
+        QObject::connect(m_miscController, &MiscController::importProfileChanged, [this](all::ImportProfile profile) {
+            m_renderer->propertyChanged("import_profile", profile);
+        });
+        QObject::connect(m_miscController, &MiscController::memoryLeanEnabledChanged, [this](bool enabled) {
+            m_renderer->propertyChanged("memory_lean", enabled);
+        });
+        QObject::connect(m_miscController, &MiscController::depthReadbackEnabledChanged, [this](bool enabled) {
+            m_renderer->propertyChanged("depth_readback", enabled);
+        });
 
         QObject::connect(m_cursorController, &CursorController::displayModeChanged, [this](CursorDisplayMode displayMode) {
             m_renderer->setCursorEnabled(
@@ -320,12 +339,15 @@ public:
             QSettings settings;
             const QString lastDir = settings.value(QStringLiteral("lastDirName")).toString();
 
-            auto fn = QFileDialog::getOpenFileName(m_mainWindow, "Open Model", lastDir, "Model Files (*.obj *.fbx *.gltf *.glb)");
+            auto fn = QFileDialog::getOpenFileName(m_mainWindow, "Open Model", lastDir, "Model Files (*.obj *.fbx *.gltf *.glb *.stl *.ply)");
             if (!fn.isEmpty()) {
                 settings.setValue(QStringLiteral("lastDirName"), QFileInfo(fn).dir().absolutePath());
                 m_renderer->loadModel(fn.toStdString());
             }
         });
+        QObject::connect(m_sceneController, &SceneController::CancelModelLoad, [this]() {
+            m_renderer->cancelModelLoad();
+        });
 
         // #if !ALLEGIANCE_SERENITY
         //         QObject::connect(&impl.value(), &Qt3DImpl::modelExtentChanged, [this](const QVector3D& min, const QVector3D& max) {
@@ -354,8 +376,13 @@ public:
         m_camera.flipped = m_cameraController->flipped();
         m_renderer->propertyChanged("frustum_view_enabled", m_miscController->frustumViewEnabled());
         m_renderer->propertyChanged("wireframe_enabled", m_miscController->wireframeEnabled());
+        m_renderer->propertyChanged("compact_vertex_formats", m_miscController->compactVertexFormatsEnabled());
+        m_renderer->propertyChanged("import_profile", all::ImportProfile(m_miscController->importProfile()));
+        m_renderer->propertyChanged("memory_lean", m_miscController->memoryLeanEnabled());
+        m_renderer->propertyChanged("depth_readback", m_miscController->depthReadbackEnabled());
         m_renderer->propertyChanged("show_focus_area", m_cameraController->showAutoFocusArea());
         m_renderer->propertyChanged("show_focus_plane", m_cameraController->showFocusPlane());
+        m_renderer->propertyChanged("auto_focus_sampling", m_cameraController->autoFocusSampling());
         m_renderer->propertyChanged("auto_focus", m_cameraController->autoFocus());
         m_renderer->propertyChanged("display_mode", all::DisplayMode(m_cameraController->displayMode()));
         m_renderer->propertyChanged("cursor_color", std::array<float, 4>{ m_cursorController->cursorTint().redF(), m_cursorController->cursorTint().greenF(), m_cursorController->cursorTint().blueF(), m_cursorController->cursorTint().alphaF() });
@@ -378,6 +405,14 @@ public:
         if (name == "auto_focus_distance") {
             const float distanceToCamera = std::any_cast<float>(value);
             setAbsolutePlaneDistance(distanceToCamera);
+        } else if (name == "model_loading") {
+            m_sceneController->setModelLoading(std::any_cast<bool>(value));
+        } else if (name == "model_load_progress") {
+            m_sceneController->setModelLoadProgress(std::any_cast<float>(value));
+        } else if (name == "model_memory") {
+            m_sceneController->setModelMemory(QString::fromStdString(std::any_cast<std::string>(value)));
+        } else if (name == "picked_mesh") {
+            m_sceneController->setPickedMesh(QString::fromStdString(std::any_cast<std::string>(value)));
         } else if (name == "scene_loaded") {
             const glm::vec3 sceneCenter = m_renderer->sceneCenter();
             const glm::vec3 sceneExtent = m_renderer->sceneExtent();
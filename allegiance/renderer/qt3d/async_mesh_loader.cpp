@@ -0,0 +1,105 @@
+#include "async_mesh_loader.h"
+
+#include <QtConcurrent/QtConcurrentRun>
+#include <QPointer>
+
+namespace all::qt3d {
+
+AsyncMeshLoader::AsyncMeshLoader(QObject* parent)
+    : QObject(parent)
+{
+    QObject::connect(&m_watcher, &QFutureWatcher<std::shared_ptr<ModelData>>::finished, this, &AsyncMeshLoader::onImportFinished);
+}
+
+AsyncMeshLoader::~AsyncMeshLoader()
+{
+    cancel();
+    m_watcher.waitForFinished();
+    for (QFuture<std::shared_ptr<ModelData>>& future : m_superseded)
+        future.waitForFinished();
+}
+
+void AsyncMeshLoader::load(const QString& path, const ImportOptions& options)
+{
+    cancel();
+
+    // The watcher lets go of a running import when given the next one
+    releaseFinishedSuperseded();
+    if (m_watcher.isRunning())
+        m_superseded.push_back(m_watcher.future());
+
+    auto request = std::make_shared<Request>();
+    request->path = path;
+    m_request = request;
+
+    QPointer<AsyncMeshLoader> self(this);
+    auto onProgress = [self, request](float progress) {
+        if (request->cancelled)
+            return false;
+
+        // Only forward whole percents to the GUI thread
+        const int percent = int(progress * 100.0f);
+        if (request->lastReportedProgress.exchange(percent) != percent) {
+            QMetaObject::invokeMethod(
+                    self, [self, request, progress] {
+                        if (self && self->m_request == request)
+                            Q_EMIT self->progressChanged(progress);
+                    },
+                    Qt::QueuedConnection);
+        }
+        return true;
+    };
+
+    Q_EMIT progressChanged(0.0f);
+    m_watcher.setFuture(QtConcurrent::run([path, options, onProgress, request] {
+        std::shared_ptr<ModelData> model = MeshLoader::import(path, options, onProgress);
+        // Built off the GUI thread too, so that the cursor can pick as soon as the model shows up
+        if (model && !request->cancelled)
+            MeshLoader::buildBvh(*model);
+        return model;
+    }));
+}
+
+void AsyncMeshLoader::cancel()
+{
+    if (m_request)
+        m_request->cancelled = true;
+}
+
+bool AsyncMeshLoader::isLoading() const
+{
+    return m_request != nullptr;
+}
+
+void AsyncMeshLoader::releaseFinishedSuperseded()
+{
+    std::erase_if(m_superseded, [](const QFuture<std::shared_ptr<ModelData>>& future) {
+        return future.isFinished();
+    });
+}
+
+void AsyncMeshLoader::onImportFinished()
+{
+    releaseFinishedSuperseded();
+
+    // A newer load might have superseded this one while it was running
+    std::shared_ptr<Request> request = std::exchange(m_request, nullptr);
+    if (!request)
+        return;
+
+    std::shared_ptr<ModelData> model = m_watcher.result();
+    // The future holds on to its result, which would keep a second reference
+    // to the buffers of the model alive next to the entities created from it
+    m_watcher.setFuture(QFuture<std::shared_ptr<ModelData>>());
+
+    if (request->cancelled) {
+        Q_EMIT cancelled(request->path);
+    } else if (model == nullptr) {
+        Q_EMIT failed(request->path);
+    } else {
+        Q_EMIT progressChanged(1.0f);
+        Q_EMIT loaded(request->path, model);
+    }
+}
+
+} // namespace all::qt3d
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "mesh_loader.h"
+
+#include <QObject>
+#include <QFutureWatcher>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace all::qt3d {
+
+// Runs MeshLoader::import on a worker thread. Only one load is in flight at
+// any time, starting a new one cancels the previous one.
+class AsyncMeshLoader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit AsyncMeshLoader(QObject* parent = nullptr);
+    ~AsyncMeshLoader();
+
+    void load(const QString& path, const ImportOptions& options = {});
+    void cancel();
+
+    bool isLoading() const;
+
+Q_SIGNALS:
+    void progressChanged(float progress);
+    void loaded(const QString& path, const std::shared_ptr<all::qt3d::ModelData>& model);
+    void failed(const QString& path);
+    void cancelled(const QString& path);
+
+private:
+    struct Request {
+        QString path;
+        std::atomic<bool> cancelled{ false };
+        std::atomic<int> lastReportedProgress{ -1 };
+    };
+
+    void onImportFinished();
+    void releaseFinishedSuperseded();
+
+    QFutureWatcher<std::shared_ptr<ModelData>> m_watcher;
+    std::shared_ptr<Request> m_request;
+    // Cancelled imports that were still running when a newer one started,
+    // waited for on destruction since they use the global thread pool
+    std::vector<QFuture<std::shared_ptr<ModelData>>> m_superseded;
+};
+
+} // namespace all::qt3d
@@ -0,0 +1,246 @@
+#include "depth_readback.h"
+#include "qt3d_shaders.h"
+#include "stereo_forward_renderer.h"
+
+#include <Qt3DCore/QEntity>
+#include <Qt3DExtras/QPlaneMesh>
+#include <Qt3DExtras/Qt3DWindow>
+#include <Qt3DLogic/QFrameAction>
+#include <Qt3DRender/QCamera>
+#include <Qt3DRender/QEffect>
+#include <Qt3DRender/QGraphicsApiFilter>
+#include <Qt3DRender/QLayer>
+#include <Qt3DRender/QMaterial>
+#include <Qt3DRender/QParameter>
+#include <Qt3DRender/QRenderCapture>
+#include <Qt3DRender/QRenderPass>
+#include <Qt3DRender/QShaderProgram>
+#include <Qt3DRender/QTechnique>
+#include <Qt3DRender/QTexture>
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <ranges>
+
+namespace {
+constexpr uint32_t BackgroundDepth = 0xffffff; // Cleared depth of 1, packed
+
+QString average(qint64 total, int count, double unit)
+{
+    return QString::number(double(total) / (unit * count), 'f', 2);
+}
+} // namespace
+
+namespace all::qt3d {
+
+Q_LOGGING_CATEGORY(pickingStatistics, "allegiance.picking.statistics", QtInfoMsg)
+
+void PickingStatistics::add(qint64 latencyNs, qint64 cpuNs, int frames)
+{
+    if (!pickingStatistics().isDebugEnabled())
+        return;
+
+    m_latencyNs += latencyNs;
+    m_cpuNs += cpuNs;
+    m_frames += std::max(frames, 0);
+    if (++m_count < Interval)
+        return;
+
+    QString frameCount;
+    if (frames >= 0)
+        frameCount = " (" + average(m_frames, m_count, 1.0) + " frames)";
+    qCDebug(pickingStatistics).noquote() << m_name << "over" << m_count << "results - latency:" << average(m_latencyNs, m_count, 1.0e6) + " ms" + frameCount
+                                         << "main thread CPU:" << average(m_cpuNs, m_count, 1.0e3) << "us";
+
+    m_count = 0;
+    m_latencyNs = 0;
+    m_cpuNs = 0;
+    m_frames = 0;
+}
+
+std::optional<QVector3D> DepthReadback::Region::worldPosition(const QPointF& windowPos) const
+{
+    return pixelPosition(int(std::floor(windowPos.x() * devicePixelRatio)), int(std::floor(windowPos.y() * devicePixelRatio)));
+}
+
+std::optional<QVector3D> DepthReadback::Region::closestWorldPosition(const QPointF& windowPos) const
+{
+    const QPointF center = windowPos * devicePixelRatio;
+    std::optional<QVector3D> closest;
+    qreal closestDistance = std::numeric_limits<qreal>::max();
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        for (int x = rect.left(); x <= rect.right(); ++x) {
+            const QPointF offset = QPointF(x + 0.5, y + 0.5) - center;
+            const qreal distance = QPointF::dotProduct(offset, offset);
+            if (distance >= closestDistance)
+                continue;
+            if (const auto position = pixelPosition(x, y)) {
+                closest = position;
+                closestDistance = distance;
+            }
+        }
+    }
+    return closest;
+}
+
+std::optional<QVector3D> DepthReadback::Region::pixelPosition(int x, int y) const
+{
+    const QPoint pixel(x - rect.x(), y - rect.y());
+    if (!packedDepths.rect().contains(pixel))
+        return std::nullopt;
+
+    const QRgb rgb = reinterpret_cast<const QRgb*>(packedDepths.constScanLine(pixel.y()))[pixel.x()];
+    const uint32_t packed = (uint32_t(qRed(rgb)) << 16) | (uint32_t(qGreen(rgb)) << 8) | uint32_t(qBlue(rgb));
+    if (packed == BackgroundDepth)
+        return std::nullopt;
+
+    // Window to normalized device coordinates, through the middle of the pixel
+    const QVector3D ndc(2.0f * (float(x) + 0.5f) / float(framebufferSize.width()) - 1.0f,
+                        1.0f - 2.0f * (float(y) + 0.5f) / float(framebufferSize.height()),
+                        2.0f * float(packed) / float(BackgroundDepth) - 1.0f);
+    return inverseViewProjection.map(ndc);
+}
+
+DepthReadback::DepthReadback(QStereoForwardRenderer* renderer, const Qt3DRender::QCamera* camera,
+                             Qt3DExtras::Qt3DWindow* view, Qt3DCore::QEntity* root)
+    : QObject(view)
+    , m_renderer(renderer)
+    , m_camera(camera)
+    , m_view(view)
+{
+    // Quad over the whole target, packing the depth texture into colors
+    auto* quad = new Qt3DCore::QEntity(root);
+    quad->setObjectName("DepthReadbackQuad");
+
+    auto* mesh = new Qt3DExtras::QPlaneMesh;
+    mesh->setWidth(2.0f);
+    mesh->setHeight(2.0f);
+
+    auto* material = new Qt3DRender::QMaterial;
+    {
+        auto* shaderProgram = new Qt3DRender::QShaderProgram;
+        shaderProgram->setVertexShaderCode(depth_pack_vs.data());
+        shaderProgram->setFragmentShaderCode(depth_pack_ps.data());
+
+        auto* renderPass = new Qt3DRender::QRenderPass;
+        renderPass->setShaderProgram(shaderProgram);
+
+        auto* technique = new Qt3DRender::QTechnique;
+        technique->addRenderPass(renderPass);
+        technique->graphicsApiFilter()->setApi(Qt3DRender::QGraphicsApiFilter::OpenGL);
+        technique->graphicsApiFilter()->setProfile(Qt3DRender::QGraphicsApiFilter::CoreProfile);
+        technique->graphicsApiFilter()->setMajorVersion(3);
+        technique->graphicsApiFilter()->setMinorVersion(2);
+
+        auto* effect = new Qt3DRender::QEffect;
+        effect->addTechnique(technique);
+
+        material->setEffect(effect);
+        material->addParameter(new Qt3DRender::QParameter(QStringLiteral("depthMap"), m_renderer->depthTexture()));
+    }
+
+    // Counts the frames a capture takes
+    auto* frameAction = new Qt3DLogic::QFrameAction;
+    QObject::connect(frameAction, &Qt3DLogic::QFrameAction::triggered, this, [this] {
+        ++m_frame;
+    });
+
+    quad->addComponent(mesh);
+    quad->addComponent(material);
+    quad->addComponent(frameAction);
+    quad->addComponent(m_renderer->depthReadbackLayer());
+
+    QObject::connect(m_view, &Qt3DExtras::Qt3DWindow::widthChanged, this, &DepthReadback::updateFramebufferSize);
+    QObject::connect(m_view, &Qt3DExtras::Qt3DWindow::heightChanged, this, &DepthReadback::updateFramebufferSize);
+    updateFramebufferSize();
+}
+
+void DepthReadback::request(Purpose purpose, const QRectF& area)
+{
+    if (std::ranges::all_of(m_ring, [](const Capture& capture) { return capture.reply != nullptr; })) {
+        m_deferred[size_t(purpose)] = area;
+        return;
+    }
+    issue(purpose, area);
+}
+
+void DepthReadback::cancel(Purpose purpose)
+{
+    m_deferred[size_t(purpose)].reset();
+    for (Capture& capture : m_ring) {
+        if (capture.reply && capture.purpose == purpose)
+            capture.cancelled = true;
+    }
+}
+
+void DepthReadback::issue(Purpose purpose, const QRectF& area)
+{
+    QElapsedTimer cpuTimer;
+    cpuTimer.start();
+
+    const qreal devicePixelRatio = m_view->devicePixelRatio();
+    const QRect rect = QRectF(area.topLeft() * devicePixelRatio, area.size() * devicePixelRatio).toAlignedRect().intersected(QRect(QPoint(0, 0), m_framebufferSize));
+    if (rect.isEmpty())
+        return;
+
+    Capture& capture = *std::ranges::find(m_ring, nullptr, &Capture::reply);
+    capture.purpose = purpose;
+    capture.cancelled = false;
+    capture.region = Region{ .rect = rect,
+                             .framebufferSize = m_framebufferSize,
+                             .devicePixelRatio = devicePixelRatio,
+                             .inverseViewProjection = (m_camera->projectionMatrix() * m_camera->viewMatrix()).inverted(),
+                             .eye = m_camera->position() };
+
+    // The capture reads from the bottom left, like OpenGL, and hands the rows back from the top
+    const QRect captureRect(rect.x(), m_framebufferSize.height() - rect.bottom() - 1, rect.width(), rect.height());
+    capture.reply = m_renderer->depthCapture()->requestCapture(captureRect);
+    capture.frame = m_frame;
+    capture.timer.start();
+    QObject::connect(capture.reply, &Qt3DRender::QRenderCaptureReply::completed, this, [this, &capture] {
+        captured(capture);
+    });
+    m_renderer->setDepthReadbackActive(true);
+
+    capture.cpuNs = cpuTimer.nsecsElapsed();
+}
+
+void DepthReadback::captured(Capture& capture)
+{
+    QElapsedTimer cpuTimer;
+    cpuTimer.start();
+
+    const qint64 latencyNs = capture.timer.nsecsElapsed();
+    const int frames = int(m_frame - capture.frame);
+    const qint64 requestCpuNs = capture.cpuNs;
+    const Purpose purpose = capture.purpose;
+    const bool cancelled = capture.cancelled;
+    Region region = std::move(capture.region);
+    // Opaque, so the conversion only drops the premultiplication flag
+    region.packedDepths = capture.reply->image().convertToFormat(QImage::Format_RGB32);
+    capture.reply->deleteLater();
+    capture.reply = nullptr;
+
+    // The freed slot goes to a request that waited for it
+    if (auto deferred = std::ranges::find_if(m_deferred, [](const auto& area) { return area.has_value(); }); deferred != m_deferred.end()) {
+        const QRectF area = **deferred;
+        deferred->reset();
+        issue(Purpose(std::distance(m_deferred.begin(), deferred)), area);
+    }
+    if (std::ranges::all_of(m_ring, [](const Capture& capture) { return capture.reply == nullptr; }))
+        m_renderer->setDepthReadbackActive(false);
+
+    if (cancelled || region.packedDepths.size() != region.rect.size())
+        return;
+    Q_EMIT regionRead(purpose, region);
+    m_statistics[size_t(purpose)].add(latencyNs, requestCpuNs + cpuTimer.nsecsElapsed(), frames);
+}
+
+void DepthReadback::updateFramebufferSize()
+{
+    m_framebufferSize = m_view->size() * m_view->devicePixelRatio();
+    m_renderer->setDepthReadbackSize(m_framebufferSize.expandedTo(QSize(1, 1)));
+}
+} // namespace all::qt3d
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QLoggingCategory>
+#include <QMatrix4x4>
+#include <QObject>
+#include <QRect>
+#include <QVector3D>
+
+#include <array>
+#include <optional>
+
+namespace Qt3DCore {
+class QEntity;
+} // namespace Qt3DCore
+
+namespace Qt3DRender {
+class QCamera;
+class QRenderCaptureReply;
+} // namespace Qt3DRender
+
+namespace Qt3DExtras {
+class Qt3DWindow;
+} // namespace Qt3DExtras
+
+namespace all::qt3d {
+class QStereoForwardRenderer;
+
+// Off by default, QT_LOGGING_RULES="allegiance.picking.statistics.debug=true" turns it on
+Q_DECLARE_LOGGING_CATEGORY(pickingStatistics)
+
+// Running latency and main thread cost of a way of picking, logged every
+// Interval results to the pickingStatistics category while it is enabled
+class PickingStatistics
+{
+public:
+    static constexpr int Interval = 100;
+
+    explicit PickingStatistics(const char* name)
+        : m_name(name)
+    {
+    }
+
+    void add(qint64 latencyNs, qint64 cpuNs, int frames = -1);
+
+private:
+    const char* m_name;
+    int m_count{ 0 };
+    qint64 m_latencyNs{ 0 };
+    qint64 m_cpuNs{ 0 };
+    qint64 m_frames{ 0 };
+};
+
+// Depth of the center eye under a few regions of the window, for the cursor
+// and auto focus when there is no need to know which triangle was hit.
+// QStereoForwardRenderer draws the depth only while captures are pending, the
+// regions arrive through QRenderCapture a frame or two after the request.
+class DepthReadback : public QObject
+{
+    Q_OBJECT
+public:
+    enum class Purpose {
+        Cursor,
+        FocusArea
+    };
+    Q_ENUM(Purpose)
+
+    // Depths read back for one request
+    struct Region {
+        QRect rect; // In framebuffer pixels, from the top left like the window
+        QImage packedDepths; // 24 bit window depth in rgb, all set over the background
+        QSize framebufferSize;
+        qreal devicePixelRatio{ 1.0 };
+        // Center camera when requested
+        QMatrix4x4 inverseViewProjection;
+        QVector3D eye;
+
+        // Under a point of the window, empty over the background or outside the region
+        std::optional<QVector3D> worldPosition(const QPointF& windowPos) const;
+        // Under the pixel of the region closest to the point that covers the scene
+        std::optional<QVector3D> closestWorldPosition(const QPointF& windowPos) const;
+
+    private:
+        std::optional<QVector3D> pixelPosition(int x, int y) const;
+    };
+
+    // Enough that requests keep flowing while a couple of frames are in flight
+    static constexpr size_t RingSize = 3;
+
+    explicit DepthReadback(QStereoForwardRenderer* renderer, const Qt3DRender::QCamera* camera,
+                           Qt3DExtras::Qt3DWindow* view, Qt3DCore::QEntity* root);
+
+    // Reads back the depth under an area of the window. When all the ring is in
+    // flight, only the latest request of each purpose waits for a free slot.
+    void request(Purpose purpose, const QRectF& area);
+    // Results of earlier requests are dropped
+    void cancel(Purpose purpose);
+
+Q_SIGNALS:
+    void regionRead(all::qt3d::DepthReadback::Purpose purpose, const all::qt3d::DepthReadback::Region& region);
+
+private:
+    struct Capture {
+        Qt3DRender::QRenderCaptureReply* reply{ nullptr };
+        Purpose purpose{ Purpose::Cursor };
+        Region region;
+        bool cancelled{ false };
+        QElapsedTimer timer;
+        qint64 cpuNs{ 0 };
+        qint64 frame{ 0 };
+    };
+
+    void issue(Purpose purpose, const QRectF& area);
+    void captured(Capture& capture);
+    void updateFramebufferSize();
+
+    QStereoForwardRenderer* m_renderer;
+    const Qt3DRender::QCamera* m_camera;
+    Qt3DExtras::Qt3DWindow* m_view;
+
+    std::array<Capture, RingSize> m_ring;
+    std::array<std::optional<QRectF>, 2> m_deferred; // By purpose
+    QSize m_framebufferSize;
+    qint64 m_frame{ 0 };
+    std::array<PickingStatistics, 2> m_statistics{ PickingStatistics("Cursor depth readback"), PickingStatistics("Auto focus depth readback") };
+};
+} // namespace all::qt3d
@@ -0,0 +1,482 @@
+#include "gltf_reader.h"
+#include "mesh_loader.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QQuaternion>
+#include <QUrl>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+constexpr quint32 GlbMagic = 0x46546C67; // "glTF"
+constexpr quint32 GlbJsonChunk = 0x4E4F534A; // "JSON"
+constexpr quint32 GlbBinChunk = 0x004E4942; // "BIN\0"
+
+constexpr int UnsignedShortComponent = 5123;
+constexpr int UnsignedIntComponent = 5125;
+constexpr int FloatComponent = 5126;
+constexpr int TrianglesMode = 4;
+
+// Where the bytes of a glTF buffer are, a file range or a decoded data URI
+struct BufferSource {
+    QString filePath;
+    qint64 fileOffset{ 0 };
+    QByteArray data;
+    qint64 byteLength{ 0 };
+};
+
+uint32_t componentCount(const QString& type)
+{
+    if (type == QLatin1String("SCALAR"))
+        return 1;
+    if (type == QLatin1String("VEC2"))
+        return 2;
+    if (type == QLatin1String("VEC3"))
+        return 3;
+    if (type == QLatin1String("VEC4"))
+        return 4;
+    return 0;
+}
+
+std::optional<BufferSource> bufferSource(const QJsonObject& buffer, const QDir& dir, const std::optional<BufferSource>& glbBinary)
+{
+    const QString uri = buffer[QLatin1String("uri")].toString();
+    if (uri.isEmpty())
+        return glbBinary;
+
+    BufferSource source;
+    source.byteLength = buffer[QLatin1String("byteLength")].toInteger(-1);
+    if (uri.startsWith(QLatin1String("data:"))) {
+        const auto dataStart = uri.indexOf(QLatin1String(";base64,"));
+        if (dataStart < 0)
+            return std::nullopt;
+        source.data = QByteArray::fromBase64(uri.mid(dataStart + 8).toLatin1());
+        source.byteLength = std::min(source.byteLength, qint64(source.data.size()));
+    } else {
+        source.filePath = dir.absoluteFilePath(QUrl::fromPercentEncoding(uri.toUtf8()));
+        source.byteLength = std::min(source.byteLength, QFileInfo(source.filePath).size());
+    }
+    if (source.byteLength < 0)
+        return std::nullopt;
+    return source;
+}
+
+class GltfDocument
+{
+public:
+    GltfDocument(const QJsonObject& json, std::vector<BufferSource> buffers, const QDir& dir, all::qt3d::ModelData& model)
+        : m_accessors(json[QLatin1String("accessors")].toArray())
+        , m_bufferViews(json[QLatin1String("bufferViews")].toArray())
+        , m_meshes(json[QLatin1String("meshes")].toArray())
+        , m_materials(json[QLatin1String("materials")].toArray())
+        , m_nodes(json[QLatin1String("nodes")].toArray())
+        , m_textures(json[QLatin1String("textures")].toArray())
+        , m_images(json[QLatin1String("images")].toArray())
+        , m_buffers(std::move(buffers))
+        , m_dir(dir)
+        , m_model(model)
+        , m_primitiveMeshes(m_meshes.size())
+    {
+        for (const QJsonValue& material : m_materials)
+            m_model.materials.push_back(modelMaterialFrom(material.toObject()));
+    }
+
+    bool addNode(int nodeIndex, const QMatrix4x4& parentTransform, int depth = 0);
+
+private:
+    all::qt3d::ModelMaterial modelMaterialFrom(const QJsonObject& material) const;
+    int32_t readView(int viewIndex);
+    std::optional<SceneMeshData::SourceView> attributeView(const QJsonValue& accessorIndex, std::initializer_list<uint32_t> sizes, uint32_t& count);
+    std::optional<SceneMeshData::SourceView> indexView(const QJsonValue& accessorIndex, SceneMesh::IndexType& indexType, uint32_t& count);
+    std::optional<all::qt3d::ModelMesh> meshFrom(const QJsonObject& primitive, const QString& name);
+    uint32_t defaultMaterialIndex();
+
+    QJsonArray m_accessors;
+    QJsonArray m_bufferViews;
+    QJsonArray m_meshes;
+    QJsonArray m_materials;
+    QJsonArray m_nodes;
+    QJsonArray m_textures;
+    QJsonArray m_images;
+    std::vector<BufferSource> m_buffers;
+    QDir m_dir;
+    all::qt3d::ModelData& m_model;
+
+    std::unordered_map<int, int32_t> m_viewBuffers; // Buffer view index to ModelData::buffers index
+    std::vector<std::optional<std::vector<std::size_t>>> m_primitiveMeshes; // glTF mesh index to model mesh indices, once read
+    std::optional<uint32_t> m_defaultMaterialIndex;
+};
+
+// Mirrors what assimp makes of the metallic roughness model
+all::qt3d::ModelMaterial GltfDocument::modelMaterialFrom(const QJsonObject& materialInfo) const
+{
+    const QJsonObject pbr = materialInfo[QLatin1String("pbrMetallicRoughness")].toObject();
+    const QJsonArray baseColor = pbr[QLatin1String("baseColorFactor")].toArray();
+    auto baseColorComponent = [&baseColor](qsizetype i) {
+        return float(baseColor.size() > i ? baseColor[i].toDouble(1.0) : 1.0);
+    };
+    const float roughness = float(pbr[QLatin1String("roughnessFactor")].toDouble(1.0));
+
+    all::qt3d::ModelMaterial material;
+    material.name = materialInfo[QLatin1String("name")].toString();
+    material.ambient = QColor::fromRgbF(0.05f * 0.05f, 0.05f * 0.05f, 0.05f * 0.05f);
+    material.diffuse = QColor::fromRgbF(baseColorComponent(0), baseColorComponent(1), baseColorComponent(2));
+    material.specular = QColor::fromRgbF(0.18f, 0.18f, 0.18f);
+    material.shininess = (1.0f - roughness) * (1.0f - roughness) * 1000.0f;
+    // glTF texture coordinates start at the top left corner of the image
+    material.mirrorDiffuseTexture = false;
+
+    const int textureIndex = pbr[QLatin1String("baseColorTexture")][QLatin1String("index")].toInt(-1);
+    const int imageIndex = m_textures.at(textureIndex)[QLatin1String("source")].toInt(-1);
+    const QString uri = m_images.at(imageIndex)[QLatin1String("uri")].toString();
+    if (!uri.isEmpty() && !uri.startsWith(QLatin1String("data:")))
+        material.diffuseTexturePath = m_dir.absoluteFilePath(QUrl::fromPercentEncoding(uri.toUtf8()));
+    else if (imageIndex >= 0)
+        qDebug() << "Ignoring embedded texture of material" << material.name;
+
+    return material;
+}
+
+uint32_t GltfDocument::defaultMaterialIndex()
+{
+    if (!m_defaultMaterialIndex) {
+        m_defaultMaterialIndex = uint32_t(m_model.materials.size());
+        all::qt3d::ModelMaterial& material = m_model.materials.emplace_back(modelMaterialFrom({}));
+        material.name = QStringLiteral("DefaultMaterial");
+    }
+    return *m_defaultMaterialIndex;
+}
+
+// Reads the bytes of a buffer view on first use, returns -1 if out of bounds
+int32_t GltfDocument::readView(int viewIndex)
+{
+    if (auto it = m_viewBuffers.find(viewIndex); it != m_viewBuffers.end())
+        return it->second;
+
+    const QJsonObject view = m_bufferViews.at(viewIndex).toObject();
+    const int bufferIndex = view[QLatin1String("buffer")].toInt(-1);
+    const qint64 byteOffset = view[QLatin1String("byteOffset")].toInteger(0);
+    const qint64 byteLength = view[QLatin1String("byteLength")].toInteger(-1);
+    if (bufferIndex < 0 || std::size_t(bufferIndex) >= m_buffers.size() || byteOffset < 0 || byteLength < 0 ||
+        byteOffset + byteLength > m_buffers[bufferIndex].byteLength)
+        return -1;
+
+    const BufferSource& source = m_buffers[bufferIndex];
+    QByteArray bytes;
+    if (source.filePath.isEmpty()) {
+        bytes = source.data.mid(byteOffset, byteLength);
+    } else {
+        QFile file(source.filePath);
+        if (!file.open(QIODevice::ReadOnly) || !file.seek(source.fileOffset + byteOffset))
+            return -1;
+        bytes = file.read(byteLength);
+        if (bytes.size() != byteLength)
+            return -1;
+    }
+
+    const auto buffer = int32_t(m_model.buffers.size());
+    m_model.buffers.push_back(std::move(bytes));
+    m_viewBuffers.emplace(viewIndex, buffer);
+    return buffer;
+}
+
+std::optional<SceneMeshData::SourceView> GltfDocument::attributeView(const QJsonValue& accessorIndex, std::initializer_list<uint32_t> sizes, uint32_t& count)
+{
+    const QJsonObject accessor = m_accessors.at(accessorIndex.toInt(-1)).toObject();
+    const uint32_t size = componentCount(accessor[QLatin1String("type")].toString());
+    if (accessor.contains(QLatin1String("sparse")) || accessor[QLatin1String("componentType")].toInt() != FloatComponent ||
+        std::find(sizes.begin(), sizes.end(), size) == sizes.end())
+        return std::nullopt;
+
+    const int viewIndex = accessor[QLatin1String("bufferView")].toInt(-1);
+    const qint64 elementSize = size * sizeof(float);
+    qint64 byteStride = m_bufferViews.at(viewIndex)[QLatin1String("byteStride")].toInteger(0);
+    if (byteStride == 0)
+        byteStride = elementSize;
+    const qint64 byteOffset = accessor[QLatin1String("byteOffset")].toInteger(0);
+    const qint64 elementCount = accessor[QLatin1String("count")].toInteger(0);
+    if (viewIndex < 0 || byteStride < elementSize || byteOffset < 0 || elementCount <= 0 || elementCount > std::numeric_limits<uint32_t>::max())
+        return std::nullopt;
+
+    const int32_t buffer = readView(viewIndex);
+    if (buffer < 0 || byteOffset + byteStride * (elementCount - 1) + elementSize > m_model.buffers[buffer].size())
+        return std::nullopt;
+
+    count = uint32_t(elementCount);
+    return SceneMeshData::SourceView{ buffer, uint32_t(byteOffset), uint32_t(byteStride), size };
+}
+
+std::optional<SceneMeshData::SourceView> GltfDocument::indexView(const QJsonValue& accessorIndex, SceneMesh::IndexType& indexType, uint32_t& count)
+{
+    const QJsonObject accessor = m_accessors.at(accessorIndex.toInt(-1)).toObject();
+    const int componentType = accessor[QLatin1String("componentType")].toInt();
+    if (accessor.contains(QLatin1String("sparse")) || (componentType != UnsignedShortComponent && componentType != UnsignedIntComponent))
+        return std::nullopt;
+
+    indexType = componentType == UnsignedShortComponent ? SceneMesh::IndexType::UInt16 : SceneMesh::IndexType::UInt32;
+    const int viewIndex = accessor[QLatin1String("bufferView")].toInt(-1);
+    const qint64 byteOffset = accessor[QLatin1String("byteOffset")].toInteger(0);
+    const qint64 elementCount = accessor[QLatin1String("count")].toInteger(0);
+    if (viewIndex < 0 || byteOffset < 0 || elementCount <= 0 || elementCount % 3 != 0 || elementCount > std::numeric_limits<uint32_t>::max())
+        return std::nullopt;
+
+    const int32_t buffer = readView(viewIndex);
+    if (buffer < 0 || byteOffset + elementCount * qint64(SceneMesh::indexByteSize(indexType)) > m_model.buffers[buffer].size())
+        return std::nullopt;
+
+    count = uint32_t(elementCount);
+    return SceneMeshData::SourceView{ buffer, uint32_t(byteOffset), 0, 1 };
+}
+
+// Returns std::nullopt for primitives that can't be drawn straight from the file
+std::optional<all::qt3d::ModelMesh> GltfDocument::meshFrom(const QJsonObject& primitive, const QString& name)
+{
+    if (primitive[QLatin1String("mode")].toInt(TrianglesMode) != TrianglesMode)
+        return std::nullopt;
+
+    const QJsonObject attributes = primitive[QLatin1String("attributes")].toObject();
+    SceneMeshData::SourceLayout layout;
+    uint32_t vertexCount = 0;
+    uint32_t normalCount = 0;
+    const auto position = attributeView(attributes[QLatin1String("POSITION")], { 3 }, vertexCount);
+    const auto normal = attributeView(attributes[QLatin1String("NORMAL")], { 3 }, normalCount);
+    if (!position || !normal || normalCount != vertexCount)
+        return std::nullopt;
+    layout.position = *position;
+    layout.normal = *normal;
+
+    SceneMesh::VertexFlags vertexFlags = SceneMesh::VertexFlag::None;
+    if (attributes.contains(QLatin1String("TEXCOORD_0"))) {
+        uint32_t count = 0;
+        const auto texCoord = attributeView(attributes[QLatin1String("TEXCOORD_0")], { 2 }, count);
+        if (!texCoord || count != vertexCount)
+            return std::nullopt;
+        layout.texCoord = *texCoord;
+        vertexFlags.setFlag(SceneMesh::VertexFlag::HasTextureCoords);
+    }
+    if (attributes.contains(QLatin1String("COLOR_0"))) {
+        uint32_t count = 0;
+        const auto color = attributeView(attributes[QLatin1String("COLOR_0")], { 3, 4 }, count);
+        if (!color || count != vertexCount)
+            return std::nullopt;
+        layout.color = *color;
+        vertexFlags.setFlag(SceneMesh::VertexFlag::HasColors);
+    }
+
+    SceneMesh::IndexType indexType = SceneMesh::IndexType::UInt32;
+    uint32_t indexCount = 0;
+    const auto indices = indexView(primitive[QLatin1String("indices")], indexType, indexCount);
+    if (!indices)
+        return std::nullopt;
+    layout.indices = *indices;
+
+    // Indices are checked once here, picking reads the positions they reference
+    const char* indexData = m_model.buffers[indices->buffer].constData() + indices->byteOffset;
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        uint32_t index = 0;
+        if (indexType == SceneMesh::IndexType::UInt16)
+            index = qFromLittleEndian<quint16>(indexData + i * sizeof(quint16));
+        else
+            index = qFromLittleEndian<quint32>(indexData + i * sizeof(quint32));
+        if (index >= vertexCount)
+            return std::nullopt;
+    }
+
+    all::qt3d::ModelMesh mesh;
+    mesh.name = name;
+    const int materialIndex = primitive[QLatin1String("material")].toInt(-1);
+    mesh.materialIndex = materialIndex >= 0 && materialIndex < m_materials.size() ? uint32_t(materialIndex) : defaultMaterialIndex();
+    mesh.isSkybox = m_model.materials[mesh.materialIndex].name.contains(QLatin1String("skybox"), Qt::CaseInsensitive);
+
+    SceneMeshData& data = mesh.data;
+    data.vertexFlags = vertexFlags;
+    data.vertexCount = vertexCount;
+    data.indexCount = indexCount;
+    data.indexType = indexType;
+    data.sourceLayout = layout;
+
+    // POSITION accessors are required to declare their bounds, scan the positions otherwise
+    const QJsonObject positionAccessor = m_accessors.at(attributes[QLatin1String("POSITION")].toInt()).toObject();
+    const QJsonArray min = positionAccessor[QLatin1String("min")].toArray();
+    const QJsonArray max = positionAccessor[QLatin1String("max")].toArray();
+    if (min.size() == 3 && max.size() == 3) {
+        data.bounds.expand(glm::vec3(min[0].toDouble(), min[1].toDouble(), min[2].toDouble()));
+        data.bounds.expand(glm::vec3(max[0].toDouble(), max[1].toDouble(), max[2].toDouble()));
+    } else {
+        const char* positions = m_model.buffers[position->buffer].constData() + position->byteOffset;
+        for (uint32_t i = 0; i < vertexCount; ++i) {
+            glm::vec3 p;
+            std::memcpy(&p, positions + i * position->byteStride, sizeof(p));
+            data.bounds.expand(p);
+        }
+    }
+
+    return mesh;
+}
+
+bool GltfDocument::addNode(int nodeIndex, const QMatrix4x4& parentTransform, int depth)
+{
+    // Deeper than the node count means the hierarchy has a cycle
+    if (nodeIndex < 0 || nodeIndex >= m_nodes.size() || depth > m_nodes.size())
+        return false;
+
+    const QJsonObject node = m_nodes.at(nodeIndex).toObject();
+    QMatrix4x4 localTransform;
+    if (const QJsonArray matrix = node[QLatin1String("matrix")].toArray(); matrix.size() == 16) {
+        float values[16];
+        for (int i = 0; i < 16; ++i)
+            values[i] = float(matrix[i].toDouble());
+        localTransform = QMatrix4x4(values).transposed(); // glTF matrices are column major
+    } else {
+        const QJsonArray t = node[QLatin1String("translation")].toArray();
+        const QJsonArray r = node[QLatin1String("rotation")].toArray();
+        const QJsonArray s = node[QLatin1String("scale")].toArray();
+        if (t.size() == 3)
+            localTransform.translate(float(t[0].toDouble()), float(t[1].toDouble()), float(t[2].toDouble()));
+        if (r.size() == 4)
+            localTransform.rotate(QQuaternion(float(r[3].toDouble()), float(r[0].toDouble()), float(r[1].toDouble()), float(r[2].toDouble())));
+        if (s.size() == 3)
+            localTransform.scale(float(s[0].toDouble()), float(s[1].toDouble()), float(s[2].toDouble()));
+    }
+    const QMatrix4x4 worldTransform = parentTransform * localTransform;
+
+    if (node.contains(QLatin1String("mesh"))) {
+        const int meshIndex = node[QLatin1String("mesh")].toInt(-1);
+        if (meshIndex < 0 || meshIndex >= m_meshes.size())
+            return false;
+
+        // Each primitive becomes a mesh, read once however many nodes reference it
+        std::optional<std::vector<std::size_t>>& primitiveMeshes = m_primitiveMeshes[meshIndex];
+        if (!primitiveMeshes) {
+            primitiveMeshes.emplace();
+            const QJsonObject meshInfo = m_meshes.at(meshIndex).toObject();
+            const QJsonArray primitives = meshInfo[QLatin1String("primitives")].toArray();
+            const QString meshName = meshInfo[QLatin1String("name")].toString();
+            for (qsizetype i = 0; i < primitives.size(); ++i) {
+                const QString name = primitives.size() > 1 ? QStringLiteral("%1-%2").arg(meshName).arg(i) : meshName;
+                std::optional<all::qt3d::ModelMesh> mesh = meshFrom(primitives[i].toObject(), name);
+                if (!mesh)
+                    return false;
+                primitiveMeshes->push_back(m_model.meshes.size());
+                m_model.meshes.push_back(std::move(*mesh));
+            }
+        }
+
+        for (const std::size_t i : *primitiveMeshes) {
+            all::qt3d::ModelMesh& mesh = m_model.meshes[i];
+            if (mesh.isSkybox) {
+                QMatrix4x4 skyboxTransform;
+                skyboxTransform.scale(0.1f);
+                mesh.instances.push_back(skyboxTransform);
+            } else {
+                mesh.instances.push_back(worldTransform);
+            }
+        }
+    }
+
+    for (const QJsonValue& child : node[QLatin1String("children")].toArray()) {
+        if (!addNode(child.toInt(-1), worldTransform, depth + 1))
+            return false;
+    }
+    return true;
+}
+} // namespace
+
+bool all::qt3d::GltfReader::canRead(const QString& path)
+{
+    const QString suffix = QFileInfo(path).suffix();
+    return suffix.compare(QLatin1String("gltf"), Qt::CaseInsensitive) == 0 || suffix.compare(QLatin1String("glb"), Qt::CaseInsensitive) == 0;
+}
+
+std::shared_ptr<all::qt3d::ModelData> all::qt3d::GltfReader::read(const QString& path)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    // Only the JSON chunk of a binary file is read here, the buffer views follow on demand
+    QByteArray jsonBytes;
+    std::optional<BufferSource> glbBinary;
+    auto readWord = [&file](quint32& word) {
+        char bytes[sizeof(quint32)];
+        if (file.read(bytes, sizeof(bytes)) != sizeof(bytes))
+            return false;
+        word = qFromLittleEndian<quint32>(bytes);
+        return true;
+    };
+    quint32 magic = 0;
+    if (readWord(magic) && magic == GlbMagic) {
+        quint32 version = 0;
+        quint32 length = 0;
+        quint32 chunkLength = 0;
+        quint32 chunkType = 0;
+        if (!readWord(version) || version != 2 || !readWord(length) || !readWord(chunkLength) || !readWord(chunkType) || chunkType != GlbJsonChunk)
+            return nullptr;
+        jsonBytes = file.read(chunkLength);
+        if (readWord(chunkLength) && readWord(chunkType) && chunkType == GlbBinChunk)
+            glbBinary = BufferSource{ path, file.pos(), {}, std::min(qint64(chunkLength), file.size() - file.pos()) };
+    } else {
+        file.seek(0);
+        jsonBytes = file.readAll();
+    }
+
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(jsonBytes, &error);
+    const QJsonObject json = document.object();
+    if (error.error != QJsonParseError::NoError || !json[QLatin1String("asset")][QLatin1String("version")].toString().startsWith(QLatin1Char('2'))) {
+        qDebug() << "Invalid glTF file" << path << error.errorString();
+        return nullptr;
+    }
+    if (!json[QLatin1String("extensionsRequired")].toArray().isEmpty()) {
+        qDebug() << "glTF extensions required by" << path << ", falling back to assimp";
+        return nullptr;
+    }
+
+    const QDir dir = QFileInfo(path).absoluteDir();
+    std::vector<BufferSource> buffers;
+    for (const QJsonValue& buffer : json[QLatin1String("buffers")].toArray()) {
+        std::optional<BufferSource> source = bufferSource(buffer.toObject(), dir, glbBinary);
+        if (!source)
+            return nullptr;
+        buffers.push_back(std::move(*source));
+    }
+
+    auto model = std::make_shared<ModelData>();
+    GltfDocument gltf(json, std::move(buffers), dir, *model);
+
+    const QJsonArray scenes = json[QLatin1String("scenes")].toArray();
+    const QJsonArray rootNodes = scenes[json[QLatin1String("scene")].toInt(0)][QLatin1String("nodes")].toArray();
+    for (const QJsonValue& node : rootNodes) {
+        if (!gltf.addNode(node.toInt(-1), {})) {
+            qDebug() << "Unsupported glTF content in" << path << ", falling back to assimp";
+            return nullptr;
+        }
+    }
+    if (model->meshes.empty())
+        return nullptr;
+
+    qsizetype bufferBytes = 0;
+    for (const QByteArray& buffer : model->buffers)
+        bufferBytes += buffer.size();
+    qDebug() << "Read" << path << "into" << model->meshes.size() << "meshes from" << model->buffers.size() << "buffer views,"
+             << bufferBytes / 1024 << "KiB, in" << timer.elapsed() << "ms";
+
+    return model;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QString>
+
+#include <memory>
+
+namespace all::qt3d {
+
+struct ModelData;
+
+// glTF 2.0 reader for .gltf and .glb files, used by MeshLoader in place of
+// assimp when the accessors can be drawn as they are: float attributes,
+// 16 or 32-bit indices and triangle lists.
+//
+// Only the buffer views referenced by the meshes are read, each straight into
+// the QByteArray later handed over to its QBuffer. Meshes keep the offsets and
+// strides of the file, see SceneMeshData::sourceLayout, and stay in their own
+// space: node transforms end up in ModelMesh::instances.
+class GltfReader
+{
+public:
+    static bool canRead(const QString& path);
+
+    // Returns nullptr if the file can't be read, or uses anything the reader
+    // doesn't support, for assimp to take over
+    static std::shared_ptr<ModelData> read(const QString& path);
+};
+
+} // namespace all::qt3d
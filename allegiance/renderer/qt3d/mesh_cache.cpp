@@ -0,0 +1,440 @@
+#include "mesh_cache.h"
+#include "mesh_loader.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QUrl>
+#include <QtEndian>
+#include <QDebug>
+
+#include <shared/bvh.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+
+namespace {
+constexpr char Magic[4] = { 'A', 'M', 'S', 'H' };
+constexpr qint64 BlobAlignment = 16;
+constexpr quint32 MaxLevelsOfDetail = 16; // Sanity limit when reading
+constexpr char BvhMagic[4] = { 'A', 'B', 'V', 'F' };
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t metadataOffset;
+    uint64_t metadataSize;
+};
+static_assert(sizeof(FileHeader) % BlobAlignment == 0);
+
+// Followed by a BlobRange per mesh, then the serialized hierarchies
+struct BvhFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t meshCount;
+};
+static_assert(sizeof(BvhFileHeader) % BlobAlignment == 0);
+
+QString bvhFilePath(const QString& cacheFilePath)
+{
+    return cacheFilePath + QStringLiteral(".bvh");
+}
+
+qint64 alignedOffset(qint64 offset)
+{
+    return (offset + BlobAlignment - 1) & ~(BlobAlignment - 1);
+}
+
+// Material libraries named by the mtllib statements of an OBJ file
+QStringList objDependencies(std::string_view content)
+{
+    QStringList dependencies;
+    constexpr std::string_view Keyword = "mtllib";
+    for (std::size_t at = content.find(Keyword); at != std::string_view::npos; at = content.find(Keyword, at + Keyword.size())) {
+        std::size_t lineStart = at;
+        while (lineStart > 0 && (content[lineStart - 1] == ' ' || content[lineStart - 1] == '\t'))
+            --lineStart;
+        const std::size_t argsStart = at + Keyword.size();
+        if ((lineStart > 0 && content[lineStart - 1] != '\n') || argsStart >= content.size() || (content[argsStart] != ' ' && content[argsStart] != '\t'))
+            continue;
+        std::string_view args = content.substr(argsStart, content.find_first_of("#\r\n", argsStart) - argsStart);
+        args.remove_prefix(std::min(args.find_first_not_of(" \t"), args.size()));
+        args.remove_suffix(args.size() - std::min(args.find_last_not_of(" \t") + 1, args.size()));
+        if (!args.empty())
+            dependencies.append(QString::fromUtf8(args.data(), qsizetype(args.size())));
+    }
+    return dependencies;
+}
+
+// External buffers of a glTF file, data URIs and the binary chunk of a .glb don't need any
+QStringList gltfDependencies(QByteArrayView content, bool binary)
+{
+    QByteArrayView json = content;
+    if (binary) {
+        // 12 byte header, then the length and type of the JSON chunk
+        if (content.size() < 20)
+            return {};
+        const quint32 jsonLength = qFromLittleEndian<quint32>(content.data() + 12);
+        if (jsonLength > quint64(content.size() - 20))
+            return {};
+        json = content.sliced(20, jsonLength);
+    }
+
+    QStringList dependencies;
+    const QJsonArray buffers = QJsonDocument::fromJson(json.toByteArray()).object()[QLatin1String("buffers")].toArray();
+    for (const QJsonValue& buffer : buffers) {
+        const QString uri = buffer[QLatin1String("uri")].toString();
+        if (!uri.isEmpty() && !uri.startsWith(QLatin1String("data:")))
+            dependencies.append(QUrl::fromPercentEncoding(uri.toUtf8()));
+    }
+    return dependencies;
+}
+
+struct BlobRange {
+    quint64 offset{ 0 };
+    quint64 size{ 0 };
+};
+static_assert(sizeof(BlobRange) == 16);
+
+QDataStream& operator<<(QDataStream& stream, const BlobRange& range)
+{
+    return stream << range.offset << range.size;
+}
+
+QDataStream& operator>>(QDataStream& stream, BlobRange& range)
+{
+    return stream >> range.offset >> range.size;
+}
+
+QDataStream& operator<<(QDataStream& stream, const all::AABB& bounds)
+{
+    return stream << bounds.min.x << bounds.min.y << bounds.min.z << bounds.max.x << bounds.max.y << bounds.max.z;
+}
+
+QDataStream& operator>>(QDataStream& stream, all::AABB& bounds)
+{
+    return stream >> bounds.min.x >> bounds.min.y >> bounds.min.z >> bounds.max.x >> bounds.max.y >> bounds.max.z;
+}
+} // namespace
+
+QString all::qt3d::MeshCache::cacheFilePath(const QString& modelPath, const ImportOptions& options)
+{
+    QFile modelFile(modelPath);
+    if (!modelFile.open(QIODevice::ReadOnly) || modelFile.size() == 0)
+        return {};
+    const uchar* mapped = modelFile.map(0, modelFile.size());
+    if (mapped == nullptr)
+        return {};
+    const QByteArrayView content(mapped, modelFile.size());
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(content);
+
+    // Files the import reads besides the model itself, changing one of them changes the key
+    const QFileInfo modelInfo(modelPath);
+    const QString suffix = modelInfo.suffix().toLower();
+    QStringList dependencies;
+    if (suffix == QLatin1String("obj"))
+        dependencies = objDependencies(std::string_view(content.data(), std::size_t(content.size())));
+    else if (suffix == QLatin1String("gltf") || suffix == QLatin1String("glb"))
+        dependencies = gltfDependencies(content, suffix == QLatin1String("glb"));
+    modelFile.unmap(const_cast<uchar*>(mapped));
+
+    // Their size and modification time stand in for the content, buffers can be big
+    const QDir modelDir = modelInfo.absoluteDir();
+    for (const QString& dependency : std::as_const(dependencies)) {
+        const QFileInfo info(modelDir.absoluteFilePath(dependency));
+        hash.addData(dependency.toUtf8());
+        hash.addData(info.exists() ? QByteArray::number(info.size()) + ':' + QByteArray::number(info.lastModified().toMSecsSinceEpoch()) : QByteArrayLiteral("missing"));
+    }
+
+    const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/meshcache");
+    // Each set of import options gets its own file
+    QString variant;
+    if (options.quantization.toInt() != 0)
+        variant += QStringLiteral(".q%1").arg(options.quantization.toInt(), 0, 16);
+    if (options.batchVertexBudget > 0)
+        variant += QStringLiteral(".b%1").arg(options.batchVertexBudget);
+    if (options.optimizeVertexCache)
+        variant += options.optimizeOverdraw ? QStringLiteral(".o2") : QStringLiteral(".o1");
+    if (options.levelsOfDetail > 0)
+        variant += QStringLiteral(".l%1").arg(options.levelsOfDetail);
+    if (options.parallelVertexProcessing)
+        variant += QStringLiteral(".n%1").arg(options.normalCreaseAngle);
+    if (!options.joinIdenticalVertices)
+        variant += QStringLiteral(".j0");
+    if (!options.shadingAttributes)
+        variant += QStringLiteral(".p");
+    return cacheDir + QLatin1Char('/') + QString::fromLatin1(hash.result().toHex()) + variant + QStringLiteral(".v%1.mesh").arg(Version);
+}
+
+std::shared_ptr<all::qt3d::ModelData> all::qt3d::MeshCache::read(const QString& cacheFilePath, const QString& modelPath)
+{
+    QFile file(cacheFilePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    const qint64 fileSize = file.size();
+    if (fileSize < qint64(sizeof(FileHeader)))
+        return nullptr;
+
+    const uchar* mapped = file.map(0, fileSize);
+    if (mapped == nullptr)
+        return nullptr;
+
+    FileHeader header;
+    std::memcpy(&header, mapped, sizeof(FileHeader));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version ||
+        header.metadataOffset + header.metadataSize > quint64(fileSize)) {
+        qDebug() << "Ignoring invalid mesh cache" << cacheFilePath;
+        return nullptr;
+    }
+
+    auto isValid = [fileSize](const BlobRange& range) {
+        return range.offset <= quint64(fileSize) && range.size <= quint64(fileSize) - range.offset;
+    };
+    // Blobs are copied once out of the mapping, QBuffer needs to own its data
+    auto blob = [mapped](const BlobRange& range) {
+        return QByteArray(reinterpret_cast<const char*>(mapped + range.offset), qsizetype(range.size));
+    };
+
+    const QByteArray metadata = QByteArray::fromRawData(reinterpret_cast<const char*>(mapped + header.metadataOffset), qsizetype(header.metadataSize));
+    QDataStream stream(metadata);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    const QDir modelDir = QFileInfo(modelPath).absoluteDir();
+    auto model = std::make_shared<ModelData>();
+
+    quint32 materialCount = 0;
+    stream >> materialCount;
+    model->materials.resize(materialCount);
+    for (ModelMaterial& material : model->materials) {
+        QString relativeTexturePath;
+        stream >> material.name >> material.ambient >> material.diffuse >> material.specular >> material.shininess >> relativeTexturePath;
+        if (!relativeTexturePath.isEmpty())
+            material.diffuseTexturePath = modelDir.absoluteFilePath(relativeTexturePath);
+    }
+
+    quint32 meshCount = 0;
+    stream >> meshCount;
+    model->meshes.resize(meshCount);
+    for (ModelMesh& mesh : model->meshes) {
+        quint32 vertexFlags = 0;
+        quint8 indexType = 0;
+        BlobRange vertexRange;
+        BlobRange indexRange;
+        BlobRange pickingRange;
+        stream >> mesh.name >> mesh.materialIndex >> mesh.isSkybox >> vertexFlags >> mesh.data.vertexCount >> mesh.data.indexCount >> indexType >> mesh.data.bounds
+                >> mesh.data.positionOffset >> mesh.data.positionScale >> vertexRange >> indexRange >> pickingRange;
+
+        quint32 lodCount = 0;
+        stream >> lodCount;
+        if (stream.status() != QDataStream::Ok || mesh.materialIndex >= materialCount || indexType > quint8(SceneMesh::IndexType::UInt32) ||
+            !isValid(vertexRange) || !isValid(indexRange) || !isValid(pickingRange) || lodCount > MaxLevelsOfDetail) {
+            qDebug() << "Ignoring invalid mesh cache" << cacheFilePath;
+            return nullptr;
+        }
+        mesh.data.lods.resize(lodCount);
+        for (SceneMeshData::LevelOfDetail& lod : mesh.data.lods)
+            stream >> lod.indexCount >> lod.error;
+
+        mesh.data.vertexFlags = SceneMesh::VertexFlags::fromInt(vertexFlags);
+        mesh.data.indexType = SceneMesh::IndexType(indexType);
+        if (stream.status() != QDataStream::Ok ||
+            vertexRange.size != quint64(mesh.data.vertexCount) * SceneMesh::vertexByteStride(mesh.data.vertexFlags) ||
+            indexRange.size != quint64(mesh.data.totalIndexCount()) * SceneMesh::indexByteSize(mesh.data.indexType) ||
+            (pickingRange.size > 0 && pickingRange.size != quint64(mesh.data.vertexCount) * 3 * sizeof(float))) {
+            qDebug() << "Ignoring invalid mesh cache" << cacheFilePath;
+            return nullptr;
+        }
+        mesh.data.vertexBytes = blob(vertexRange);
+        mesh.data.indexBytes = blob(indexRange);
+        if (pickingRange.size > 0)
+            mesh.data.pickingPositions = blob(pickingRange);
+
+        quint32 subMeshCount = 0;
+        stream >> subMeshCount;
+        if (stream.status() != QDataStream::Ok || subMeshCount > mesh.data.indexCount) {
+            qDebug() << "Ignoring invalid mesh cache" << cacheFilePath;
+            return nullptr;
+        }
+        mesh.subMeshes.resize(subMeshCount);
+        for (ModelSubMesh& subMesh : mesh.subMeshes)
+            stream >> subMesh.name >> subMesh.firstIndex >> subMesh.indexCount >> subMesh.firstVertex >> subMesh.vertexCount >> subMesh.bounds;
+
+        quint32 instanceCount = 0;
+        stream >> instanceCount;
+        if (stream.status() != QDataStream::Ok || instanceCount > header.metadataSize / sizeof(QMatrix4x4)) {
+            qDebug() << "Ignoring invalid mesh cache" << cacheFilePath;
+            return nullptr;
+        }
+        mesh.instances.resize(instanceCount);
+        for (QMatrix4x4& instance : mesh.instances)
+            stream >> instance;
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qDebug() << "Ignoring invalid mesh cache" << cacheFilePath;
+        return nullptr;
+    }
+
+    return model;
+}
+
+bool all::qt3d::MeshCache::write(const QString& cacheFilePath, const QString& modelPath, const ModelData& model)
+{
+    if (!QDir().mkpath(QFileInfo(cacheFilePath).absolutePath()))
+        return false;
+
+    // Lay out the blobs first so that the metadata can reference them
+    qint64 offset = sizeof(FileHeader);
+    auto reserve = [&offset](const QByteArray& bytes) {
+        BlobRange range{ quint64(offset), quint64(bytes.size()) };
+        offset = alignedOffset(offset + bytes.size());
+        return range;
+    };
+
+    const QDir modelDir = QFileInfo(modelPath).absoluteDir();
+
+    QByteArray metadata;
+    {
+        QDataStream stream(&metadata, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_6_0);
+
+        stream << quint32(model.materials.size());
+        for (const ModelMaterial& material : model.materials) {
+            // Texture paths are stored relative to the model, a cache file might be shared by copies of the same model
+            const QString relativeTexturePath = material.diffuseTexturePath.isEmpty() ? QString() : modelDir.relativeFilePath(material.diffuseTexturePath);
+            stream << material.name << material.ambient << material.diffuse << material.specular << material.shininess << relativeTexturePath;
+        }
+
+        stream << quint32(model.meshes.size());
+        for (const ModelMesh& mesh : model.meshes) {
+            const BlobRange vertexRange = reserve(mesh.data.vertexBytes);
+            const BlobRange indexRange = reserve(mesh.data.indexBytes);
+            const BlobRange pickingRange = reserve(mesh.data.pickingPositions);
+            stream << mesh.name << mesh.materialIndex << mesh.isSkybox << quint32(mesh.data.vertexFlags.toInt()) << mesh.data.vertexCount << mesh.data.indexCount << quint8(mesh.data.indexType) << mesh.data.bounds
+                   << mesh.data.positionOffset << mesh.data.positionScale << vertexRange << indexRange << pickingRange;
+
+            stream << quint32(mesh.data.lods.size());
+            for (const SceneMeshData::LevelOfDetail& lod : mesh.data.lods)
+                stream << lod.indexCount << lod.error;
+
+            stream << quint32(mesh.subMeshes.size());
+            for (const ModelSubMesh& subMesh : mesh.subMeshes)
+                stream << subMesh.name << subMesh.firstIndex << subMesh.indexCount << subMesh.firstVertex << subMesh.vertexCount << subMesh.bounds;
+
+            stream << quint32(mesh.instances.size());
+            for (const QMatrix4x4& instance : mesh.instances)
+                stream << instance;
+        }
+    }
+
+    FileHeader header;
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.metadataOffset = offset;
+    header.metadataSize = metadata.size();
+
+    QSaveFile file(cacheFilePath);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    auto writePadded = [&file](const QByteArray& bytes) {
+        file.write(bytes);
+        const qint64 padding = alignedOffset(file.pos()) - file.pos();
+        if (padding > 0)
+            file.write(QByteArray(padding, '\0'));
+    };
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+    for (const ModelMesh& mesh : model.meshes) {
+        writePadded(mesh.data.vertexBytes);
+        writePadded(mesh.data.indexBytes);
+        writePadded(mesh.data.pickingPositions);
+    }
+    Q_ASSERT(file.pos() == offset);
+    file.write(metadata);
+
+    return file.commit();
+}
+
+std::vector<std::shared_ptr<const all::Bvh>> all::qt3d::MeshCache::readBvh(const QString& cacheFilePath, std::size_t meshCount)
+{
+    QFile file(bvhFilePath(cacheFilePath));
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+
+    const qint64 fileSize = file.size();
+    if (fileSize < qint64(sizeof(BvhFileHeader)))
+        return {};
+    const uchar* mapped = file.map(0, fileSize);
+    if (mapped == nullptr)
+        return {};
+
+    BvhFileHeader header;
+    std::memcpy(&header, mapped, sizeof(BvhFileHeader));
+    if (std::memcmp(header.magic, BvhMagic, sizeof(BvhMagic)) != 0 || header.version != Version || header.meshCount != meshCount ||
+        sizeof(BvhFileHeader) + meshCount * sizeof(BlobRange) > quint64(fileSize)) {
+        qDebug() << "Ignoring invalid BVH cache" << file.fileName();
+        return {};
+    }
+
+    std::vector<std::shared_ptr<const all::Bvh>> meshBvhs(meshCount);
+    for (std::size_t i = 0; i < meshCount; ++i) {
+        BlobRange range;
+        std::memcpy(&range, mapped + sizeof(BvhFileHeader) + i * sizeof(BlobRange), sizeof(BlobRange));
+        if (range.size == 0)
+            continue;
+        auto bvh = std::make_shared<all::Bvh>();
+        if (range.offset > quint64(fileSize) || range.size > quint64(fileSize) - range.offset || !bvh->deserialize(mapped + range.offset, range.size)) {
+            qDebug() << "Ignoring invalid BVH cache" << file.fileName();
+            return {};
+        }
+        meshBvhs[i] = std::move(bvh);
+    }
+    return meshBvhs;
+}
+
+bool all::qt3d::MeshCache::writeBvh(const QString& cacheFilePath, const std::vector<std::shared_ptr<const all::Bvh>>& meshBvhs)
+{
+    // Imports that aren't cached themselves, like glTF drawn in place, might not have created the directory
+    if (!QDir().mkpath(QFileInfo(cacheFilePath).absolutePath()))
+        return false;
+
+    QSaveFile file(bvhFilePath(cacheFilePath));
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    BvhFileHeader header;
+    std::memcpy(header.magic, BvhMagic, sizeof(BvhMagic));
+    header.version = Version;
+    header.meshCount = meshBvhs.size();
+    file.write(reinterpret_cast<const char*>(&header), sizeof(BvhFileHeader));
+
+    // Hierarchies get serialized one at a time, the ranges are filled in once they are all written
+    std::vector<BlobRange> ranges(meshBvhs.size());
+    file.write(reinterpret_cast<const char*>(ranges.data()), qint64(ranges.size() * sizeof(BlobRange)));
+    for (std::size_t i = 0; i < meshBvhs.size(); ++i) {
+        if (!meshBvhs[i])
+            continue;
+        file.write(QByteArray(alignedOffset(file.pos()) - file.pos(), '\0'));
+        const std::vector<uint8_t> bytes = meshBvhs[i]->serialize();
+        ranges[i] = { quint64(file.pos()), quint64(bytes.size()) };
+        file.write(reinterpret_cast<const char*>(bytes.data()), qint64(bytes.size()));
+    }
+    if (!file.seek(sizeof(BvhFileHeader)))
+        return false;
+    file.write(reinterpret_cast<const char*>(ranges.data()), qint64(ranges.size() * sizeof(BlobRange)));
+
+    return file.commit();
+}
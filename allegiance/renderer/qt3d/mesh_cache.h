@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+namespace all {
+class Bvh;
+} // namespace all
+
+namespace all::qt3d {
+
+struct ModelData;
+struct ImportOptions;
+
+// On-disk cache of imported models, keyed on the content of the model file
+// and on the size and modification time of the material libraries and
+// buffers it references.
+// A cache file holds the baked vertex and index blobs of every mesh followed
+// by the material and mesh descriptions, so that a cache hit doesn't need to
+// go through assimp at all.
+class MeshCache
+{
+public:
+    // Bump whenever the baked vertex layout or the file layout changes
+    static constexpr uint32_t Version = 10;
+
+    // Returns the cache file matching the current content of modelPath, the
+    // files it references and options, or an empty string if modelPath can't
+    // be read
+    static QString cacheFilePath(const QString& modelPath, const ImportOptions& options);
+
+    // Returns nullptr if the cache file doesn't exist or is invalid
+    static std::shared_ptr<ModelData> read(const QString& cacheFilePath, const QString& modelPath);
+    static bool write(const QString& cacheFilePath, const QString& modelPath, const ModelData& model);
+
+    // Picking hierarchies of the meshes of a cached model, one per mesh and
+    // null for those that aren't picked, in a file next to its cache file.
+    // Reading returns an empty vector unless the file holds meshCount valid ones.
+    static std::vector<std::shared_ptr<const all::Bvh>> readBvh(const QString& cacheFilePath, std::size_t meshCount);
+    static bool writeBvh(const QString& cacheFilePath, const std::vector<std::shared_ptr<const all::Bvh>>& meshBvhs);
+};
+
+} // namespace all::qt3d
@@ -1,10 +1,21 @@
 #include "mesh_loader.h"
+#include "gltf_reader.h"
+#include "mesh_cache.h"
+#include "obj_reader.h"
+#include "ply_reader.h"
 #include "scene_mesh.h"
+#include "stl_reader.h"
 #include "qt3d_materials.h"
 #include "qt3d_shaders.h"
+#include "util_qt.h"
 
+#include <Qt3DCore/QBuffer>
 #include <Qt3DCore/QGeometry>
 #include <Qt3DCore/QEntity>
+#include <Qt3DCore/QTransform>
+#include <Qt3DRender/QLevelOfDetail>
+#include <Qt3DRender/QLevelOfDetailBoundingSphere>
+#include <Qt3DRender/QPickingProxy>
 #include <Qt3DRender/QMaterial>
 #include <QColor>
 #include <QUrl>
@@ -16,12 +27,27 @@
 #include <Qt3DExtras/QPhongMaterial>
 #include <Qt3DExtras/QDiffuseSpecularMaterial>
 #include <Qt3DRender/QTexture>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPointer>
+#include <QtConcurrent/QtConcurrentMap>
 
 #include <assimp/Importer.hpp>
+#include <assimp/config.h>
+#include <assimp/ProgressHandler.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 
+#include <shared/bvh.h>
+#include <shared/import_arena.h>
+#include <shared/mesh_processing.h>
+
 #include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <unordered_map>
 
 namespace {
 QColor toQColor(const aiColor3D& color)
@@ -38,7 +64,29 @@ QMatrix4x4 toQMatrix4x4(const aiMatrix4x4& matrix)
             matrix.d1, matrix.d2, matrix.d3, matrix.d4);
 }
 
-Qt3DRender::QMaterial* materialFrom(const aiMaterial* materialInfo, const QString& modelPath)
+constexpr float ImportProgressShare = 0.7f; // Share of the progress spent inside assimp, the rest goes to vertex baking
+
+class ImportProgressHandler : public Assimp::ProgressHandler
+{
+public:
+    explicit ImportProgressHandler(const all::qt3d::MeshLoader::ProgressCallback& callback)
+        : m_callback(callback)
+    {
+    }
+
+    bool Update(float percentage) override
+    {
+        if (!m_callback)
+            return true;
+        // Note: assimp passes -1 when it can't estimate its progress
+        return m_callback(std::clamp(percentage, 0.0f, 1.0f) * ImportProgressShare);
+    }
+
+private:
+    all::qt3d::MeshLoader::ProgressCallback m_callback;
+};
+
+all::qt3d::ModelMaterial modelMaterialFrom(const aiMaterial* materialInfo, const QString& modelPath)
 {
     aiColor3D ambient = { 0.05f, 0.05f, 0.05f };
     materialInfo->Get(AI_MATKEY_COLOR_AMBIENT, ambient);
@@ -53,11 +101,12 @@ Qt3DRender::QMaterial* materialFrom(const aiMaterial* materialInfo, const QStrin
     float shininess = 0.2f;
     materialInfo->Get(AI_MATKEY_SHININESS, shininess);
 
-    auto *material = new Qt3DExtras::QDiffuseSpecularMaterial;
-    material->setAmbient(toQColor(ambient));
-    material->setDiffuse(toQColor(diffuse));
-    material->setSpecular(toQColor(specular));
-    material->setShininess(shininess);
+    all::qt3d::ModelMaterial material;
+    material.name = QString::fromLocal8Bit(materialInfo->GetName().C_Str());
+    material.ambient = toQColor(ambient);
+    material.diffuse = toQColor(diffuse);
+    material.specular = toQColor(specular);
+    material.shininess = shininess;
 
     aiString texFilename;
     const bool hasDiffuseTexture = materialInfo->GetTextureCount(aiTextureType::aiTextureType_DIFFUSE) > 0;
@@ -71,27 +120,140 @@ Qt3DRender::QMaterial* materialFrom(const aiMaterial* materialInfo, const QStrin
                 filename.chop(1);
             qDebug() << filename;
         }
-        const auto texturePath = QFileInfo(modelPath).absoluteDir().absoluteFilePath(filename);
-        auto* diffuseTexture = new Qt3DRender::QTextureLoader(material);
-        diffuseTexture->setSource(QUrl::fromLocalFile(texturePath));
+        material.diffuseTexturePath = QFileInfo(modelPath).absoluteDir().absoluteFilePath(filename);
+    }
+
+    return material;
+}
+
+// Diffuse textures per absolute path and orientation. Textures are owned by the root entity of
+// the model using them, a later load takes over the ones it shares with the
+// model it replaces. Only ever accessed from the GUI thread.
+class TextureCache
+{
+public:
+    struct Statistics {
+        std::size_t created{ 0 };
+        std::size_t reused{ 0 }; // Taken over from a previous load
+    };
+
+    static Qt3DRender::QAbstractTexture* texture(const QString& path, bool mirrored, Qt3DCore::QNode* owner, Statistics& statistics)
+    {
+        QPointer<Qt3DRender::QAbstractTexture>& texture = textures()[{ path, mirrored }];
+        if (texture) {
+            if (texture->parentNode() != owner) {
+                texture->setParent(owner);
+                ++statistics.reused;
+            }
+            return texture;
+        }
+
+        auto* diffuseTexture = new Qt3DRender::QTextureLoader(owner);
+        diffuseTexture->setSource(QUrl::fromLocalFile(path));
+        diffuseTexture->setMirrored(mirrored);
+        texture = diffuseTexture;
+        ++statistics.created;
+        return texture;
+    }
 
+    // Forgets the textures destroyed along with the models owning them, called before each load
+    static void prune()
+    {
+        auto& cache = textures();
+        for (auto it = cache.begin(); it != cache.end();)
+            it = it->isNull() ? cache.erase(it) : std::next(it);
+    }
+
+private:
+    static QHash<std::pair<QString, bool>, QPointer<Qt3DRender::QAbstractTexture>>& textures()
+    {
+        static QHash<std::pair<QString, bool>, QPointer<Qt3DRender::QAbstractTexture>> textures;
+        return textures;
+    }
+};
+
+Qt3DRender::QMaterial* materialFrom(const all::qt3d::ModelMaterial& materialInfo, Qt3DCore::QNode* textureOwner, TextureCache::Statistics& textureStatistics)
+{
+    auto* material = new Qt3DExtras::QDiffuseSpecularMaterial;
+    material->setAmbient(materialInfo.ambient);
+    material->setDiffuse(materialInfo.diffuse);
+    material->setSpecular(materialInfo.specular);
+    material->setShininess(materialInfo.shininess);
+
+    if (!materialInfo.diffuseTexturePath.isEmpty()) {
+        auto* diffuseTexture = TextureCache::texture(materialInfo.diffuseTexturePath, materialInfo.mirrorDiffuseTexture, textureOwner, textureStatistics);
         material->setDiffuse(QVariant::fromValue(diffuseTexture));
     }
 
     return material;
 }
 
-void addMeshes(const aiScene* scene, const aiNode* node, const QMatrix4x4& transform, Qt3DCore::QEntity* root, const QString& path)
+// Materials replaced by a GlossyMaterial in createEntities, the only ones able to decode octahedral normals
+bool isGlossyMaterial(const QString& materialName)
+{
+    static const QStringList glossyMaterials = {
+        QStringLiteral("CarPaint"), QStringLiteral("DarkGlass"), QStringLiteral("DarkGloss"), QStringLiteral("Dark"),
+        QStringLiteral("Chrome"), QStringLiteral("Plate"), QStringLiteral("Tire"), QStringLiteral("ShadowPlane")
+    };
+    return glossyMaterials.contains(materialName);
+}
+
+// Vertex attributes the material created for materialInfo in createEntities reads
+SceneMesh::VertexFlags materialAttributes(const all::qt3d::ModelMaterial& materialInfo)
+{
+    if (isGlossyMaterial(materialInfo.name))
+        return SceneMesh::VertexFlag::HasTextureCoords | SceneMesh::VertexFlag::HasColors;
+    if (materialInfo.name == QStringLiteral("Skybox") || !materialInfo.diffuseTexturePath.isEmpty())
+        return SceneMesh::VertexFlag::HasTextureCoords;
+    return SceneMesh::VertexFlag::None;
+}
+
+struct BakeJob {
+    const aiMesh* meshInfo{ nullptr };
+    QMatrix4x4 transform;
+    bool glossyMaterial{ false };
+    SceneMesh::VertexFlags materialAttributes; // Read by the material beside positions and normals
+};
+
+// Number of nodes referencing each mesh of the scene
+void countMeshUses(const aiNode* node, std::vector<uint32_t>& meshUses)
+{
+    for (std::size_t i = 0; i < node->mNumMeshes; ++i)
+        ++meshUses[node->mMeshes[i]];
+    for (std::size_t i = 0; i < node->mNumChildren; ++i)
+        countMeshUses(node->mChildren[i], meshUses);
+}
+
+struct MeshTraversal {
+    std::vector<uint32_t> meshUses;
+    std::unordered_map<uint32_t, std::size_t> instancedMeshes; // Scene mesh index to model mesh index
+};
+
+// Reads path with Reader if it handles the format. Returns false if the import got cancelled.
+template<typename Reader>
+bool readWith(const QString& path, const all::qt3d::MeshLoader::ProgressCallback& progress, std::unique_ptr<aiScene>& scene)
+{
+    if (scene || !Reader::canRead(path))
+        return true;
+    typename Reader::Result result = Reader::read(path, [&progress](float value) {
+        return !progress || progress(value * ImportProgressShare);
+    });
+    scene = std::move(result.scene);
+    return !result.cancelled;
+}
+
+// Records the meshes in traversal order, vertex baking happens in a separate pass.
+// Meshes referenced by several nodes are recorded once, along with the transform of each node.
+void addMeshes(const aiScene* scene, const aiNode* node, const QMatrix4x4& transform, all::qt3d::ModelData& model, std::vector<BakeJob>& jobs, MeshTraversal& traversal)
 {
     const auto worldTransform = transform * toQMatrix4x4(node->mTransformation);
 
     for (std::size_t i = 0; i < node->mNumMeshes; ++i) {
-        const aiMesh* meshInfo = scene->mMeshes[node->mMeshes[i]];
-        const auto meshName = QString::fromLocal8Bit(meshInfo->mName.C_Str());
-
-        const aiMaterial* materialInfo = scene->mMaterials[meshInfo->mMaterialIndex];
-        const auto materialName = QString::fromLocal8Bit(materialInfo->GetName().C_Str());
+        const uint32_t meshIndex = node->mMeshes[i];
+        const aiMesh* meshInfo = scene->mMeshes[meshIndex];
 
+        const auto& materialInfo = model.materials[meshInfo->mMaterialIndex];
+        const auto& materialName = materialInfo.name;
         const bool isSkybox = materialName.contains("skybox", Qt::CaseInsensitive);
         const QMatrix4x4 meshTransform = [worldTransform, isSkybox] {
             if (isSkybox) {
@@ -102,89 +264,688 @@ void addMeshes(const aiScene* scene, const aiNode* node, const QMatrix4x4& trans
             return worldTransform;
         }();
 
-        auto* childEntity = new Qt3DCore::QEntity(root);
-
-        SceneMesh::VertexFlags vertexFlags;
-        if (meshInfo->HasTextureCoords(0)) {
-            vertexFlags.setFlag(SceneMesh::VertexFlag::HasTextureCoords);
-        }
-        if (meshInfo->mColors[0] != nullptr) {
-            vertexFlags.setFlag(SceneMesh::VertexFlag::HasColors);
+        const bool instanced = !isSkybox && traversal.meshUses[meshIndex] > 1;
+        if (instanced) {
+            auto [it, inserted] = traversal.instancedMeshes.try_emplace(meshIndex, model.meshes.size());
+            if (!inserted) {
+                model.meshes[it->second].instances.push_back(worldTransform);
+                continue;
+            }
         }
-        auto* meshComponent = new SceneMesh(vertexFlags);
-        meshComponent->initializeFrom(meshInfo, meshTransform);
-        meshComponent->setProperty("name", meshName);
 
-        auto* materialComponent = materialFrom(materialInfo, path);
-        materialComponent->setProperty("name", materialName);
+        all::qt3d::ModelMesh& mesh = model.meshes.emplace_back();
+        mesh.name = QString::fromLocal8Bit(meshInfo->mName.C_Str());
+        mesh.materialIndex = meshInfo->mMaterialIndex;
+        mesh.isSkybox = isSkybox;
+        if (instanced)
+            mesh.instances.push_back(worldTransform);
 
-        childEntity->addComponent(meshComponent);
-        childEntity->addComponent(materialComponent);
+        jobs.push_back({ meshInfo, instanced ? QMatrix4x4{} : meshTransform, isGlossyMaterial(materialName), materialAttributes(materialInfo) });
     }
 
     for (std::size_t i = 0; i < node->mNumChildren; ++i) {
         const aiNode* childNode = node->mChildren[i];
-        addMeshes(scene, childNode, worldTransform, root, path);
+        addMeshes(scene, childNode, worldTransform, model, jobs, traversal);
+    }
+}
+
+SceneMeshData bakeMesh(const BakeJob& job, const all::qt3d::ImportOptions& options, std::pmr::memory_resource* scratch)
+{
+    SceneMesh::VertexFlags vertexFlags = options.quantization;
+    if (!options.shadingAttributes) {
+        vertexFlags.setFlag(SceneMesh::VertexFlag::QuantizedNormals, false);
+        vertexFlags.setFlag(SceneMesh::VertexFlag::NoNormals);
+        return SceneMesh::bake(job.meshInfo, job.transform, vertexFlags, scratch);
+    }
+    // Attributes the material doesn't read aren't worth uploading
+    if (job.meshInfo->HasTextureCoords(0) && job.materialAttributes.testFlag(SceneMesh::VertexFlag::HasTextureCoords)) {
+        vertexFlags.setFlag(SceneMesh::VertexFlag::HasTextureCoords);
+    }
+    if (job.meshInfo->mColors[0] != nullptr && job.materialAttributes.testFlag(SceneMesh::VertexFlag::HasColors)) {
+        vertexFlags.setFlag(SceneMesh::VertexFlag::HasColors);
+    }
+    if (job.glossyMaterial && vertexFlags.testFlag(SceneMesh::VertexFlag::QuantizedNormals)) {
+        vertexFlags.setFlag(SceneMesh::VertexFlag::QuantizedNormals, false);
+        vertexFlags.setFlag(SceneMesh::VertexFlag::OctahedralNormals);
+    }
+    return SceneMesh::bake(job.meshInfo, job.transform, vertexFlags, scratch);
+}
+
+// Merges the non skybox, non instanced meshes sharing a material and a vertex layout, in
+// import order, into batches of at most vertexBudget vertices
+void batchStaticMeshes(all::qt3d::ModelData& model, std::size_t vertexBudget)
+{
+    using all::qt3d::ModelMesh;
+
+    std::vector<std::vector<std::size_t>> groups;
+    std::map<std::pair<uint32_t, int>, std::size_t> groupOfKey;
+    std::vector<bool> batchable(model.meshes.size(), false);
+    for (std::size_t i = 0; i < model.meshes.size(); ++i) {
+        const ModelMesh& mesh = model.meshes[i];
+        if (mesh.isSkybox || !mesh.instances.empty() || mesh.data.vertexCount >= vertexBudget)
+            continue;
+        const auto key = std::make_pair(mesh.materialIndex, mesh.data.vertexFlags.toInt());
+        auto [it, inserted] = groupOfKey.try_emplace(key, groups.size());
+        if (inserted)
+            groups.emplace_back();
+        groups[it->second].push_back(i);
+        batchable[i] = true;
+    }
+
+    std::vector<ModelMesh> meshes;
+    for (std::size_t i = 0; i < model.meshes.size(); ++i) {
+        if (!batchable[i])
+            meshes.push_back(std::move(model.meshes[i]));
+    }
+
+    for (const std::vector<std::size_t>& group : groups) {
+        auto batchBegin = group.begin();
+        while (batchBegin != group.end()) {
+            auto batchEnd = batchBegin;
+            std::size_t vertexCount = 0;
+            while (batchEnd != group.end() && vertexCount + model.meshes[*batchEnd].data.vertexCount <= vertexBudget)
+                vertexCount += model.meshes[*batchEnd++].data.vertexCount;
+
+            if (batchEnd - batchBegin == 1) {
+                meshes.push_back(std::move(model.meshes[*batchBegin]));
+                batchBegin = batchEnd;
+                continue;
+            }
+
+            std::vector<const SceneMeshData*> parts;
+            ModelMesh batch;
+            const ModelMesh& first = model.meshes[*batchBegin];
+            batch.name = model.materials[first.materialIndex].name + QStringLiteral(" batch");
+            batch.materialIndex = first.materialIndex;
+
+            uint32_t firstIndex = 0;
+            uint32_t firstVertex = 0;
+            for (auto it = batchBegin; it != batchEnd; ++it) {
+                const ModelMesh& mesh = model.meshes[*it];
+                parts.push_back(&mesh.data);
+                batch.subMeshes.push_back({ mesh.name, firstIndex, mesh.data.indexCount, firstVertex, mesh.data.vertexCount, mesh.data.bounds });
+                firstIndex += mesh.data.indexCount;
+                firstVertex += mesh.data.vertexCount;
+            }
+            batch.data = SceneMesh::merge(parts);
+            meshes.push_back(std::move(batch));
+
+            batchBegin = batchEnd;
+        }
     }
+
+    model.meshes = std::move(meshes);
+}
+
+// Switches to a coarser level once its deviation projects to less than
+// MaxPixelError pixels. The deviation is relative to the mesh extent, which
+// is about the side of the projected bounding sphere, hence the threshold on
+// the projected area: (MaxPixelError / error)^2. The levels have to be
+// selected with the center camera, for both eyes to draw the same one.
+Qt3DRender::QLevelOfDetail* createLevelOfDetail(const SceneMeshData& data)
+{
+    constexpr float MaxPixelError = 1.0f;
+    constexpr float MinError = 1e-4f;
+
+    if (data.lods.empty() || !data.bounds.isValid())
+        return nullptr;
+
+    auto* levelOfDetail = new Qt3DRender::QLevelOfDetail;
+    levelOfDetail->setThresholdType(Qt3DRender::QLevelOfDetail::ProjectedScreenPixelSizeThreshold);
+    QList<qreal> thresholds;
+    for (const SceneMeshData::LevelOfDetail& lod : data.lods) {
+        const float side = MaxPixelError / std::max(lod.error, MinError);
+        thresholds.push_back(qreal(side) * side);
+    }
+    thresholds.push_back(0.0);
+    levelOfDetail->setThresholds(thresholds);
+
+    // In the space of the vertices, normalized ones for quantized positions
+    const glm::vec3 center = data.bounds.center();
+    const float radius = 0.5f * glm::length(data.bounds.extent());
+    const QVector3D localCenter = (QVector3D(center.x, center.y, center.z) - data.positionOffset) / data.positionScale;
+    levelOfDetail->setVolumeOverride(Qt3DRender::QLevelOfDetailBoundingSphere(localCenter, radius / data.positionScale));
+    return levelOfDetail;
+}
+
+// Baked bounds are exact, instanced ones are the bounds of the transformed boxes
+all::AABB sceneBounds(const all::qt3d::ModelData& model)
+{
+    all::AABB bounds;
+    for (const all::qt3d::ModelMesh& mesh : model.meshes) {
+        if (mesh.isSkybox || !mesh.data.bounds.isValid())
+            continue;
+        if (mesh.instances.empty()) {
+            bounds.expand(mesh.data.bounds.min);
+            bounds.expand(mesh.data.bounds.max);
+            continue;
+        }
+        for (const QMatrix4x4& instance : mesh.instances) {
+            for (int corner = 0; corner < 8; ++corner) {
+                const QVector3D p(corner & 1 ? mesh.data.bounds.max.x : mesh.data.bounds.min.x,
+                                  corner & 2 ? mesh.data.bounds.max.y : mesh.data.bounds.min.y,
+                                  corner & 4 ? mesh.data.bounds.max.z : mesh.data.bounds.min.z);
+                const QVector3D world = instance.map(p);
+                bounds.expand(glm::vec3(world.x(), world.y(), world.z()));
+            }
+        }
+    }
+    return bounds;
+}
+
+double elapsedMs(const QElapsedTimer& timer)
+{
+    return double(timer.nsecsElapsed()) / 1.0e6;
+}
+
+// Skyboxes are never picked, their picking positions would only take memory
+void dropUnpickedPositions(all::qt3d::ModelData& model)
+{
+    for (all::qt3d::ModelMesh& mesh : model.meshes) {
+        if (mesh.isSkybox)
+            mesh.data.pickingPositions = QByteArray();
+    }
+}
+
+// Logs the import time and the memory taken by model, for comparing import profiles
+void reportImport(const QString& path, const all::qt3d::ModelData& model, const all::qt3d::ImportOptions& options, const QElapsedTimer& importTimer)
+{
+    constexpr SceneMesh::VertexFlags QuantizationFlags = SceneMesh::VertexFlag::QuantizedPositions | SceneMesh::VertexFlag::QuantizedNormals |
+            SceneMesh::VertexFlag::OctahedralNormals | SceneMesh::VertexFlag::QuantizedTexCoords | SceneMesh::VertexFlag::QuantizedColors;
+
+    qsizetype floatVertexBytes = 0;
+    for (const all::qt3d::ModelMesh& mesh : model.meshes)
+        floatVertexBytes += mesh.data.vertexCount * SceneMesh::vertexByteStride(mesh.data.vertexFlags & ~QuantizationFlags);
+    const all::qt3d::ModelMemory memory = model.memory();
+
+    auto kib = [](qsizetype bytes) {
+        return QString::number(double(bytes) / 1024.0, 'f', 1) + QStringLiteral(" KiB");
+    };
+    QString profile = QString::fromLatin1(all::importProfileName(options.profile));
+    if (options.memoryLean)
+        profile += QStringLiteral(", memory lean");
+    qDebug().noquote() << "Imported" << path << "with the" << profile << "profile in" << importTimer.elapsed() << "ms";
+    qDebug().noquote() << "Model memory for" << path << "(" + profile + ") - vertices:" << kib(memory.vertexBytes)
+                       << "(float layout:" << kib(floatVertexBytes) << ") indices:" << kib(memory.indexBytes)
+                       << "picking:" << kib(memory.pickingBytes) << "source buffers:" << kib(memory.sourceBytes);
+}
+
+// Hierarchy over the full resolution triangles of a mesh, in the space its instances place
+std::shared_ptr<const all::Bvh> buildMeshBvh(const all::qt3d::ModelData& model, const all::qt3d::ModelMesh& mesh)
+{
+    const SceneMeshData& data = mesh.data;
+    if (mesh.isSkybox || data.indexCount == 0)
+        return nullptr;
+
+    // Float positions, wherever the mesh keeps them
+    const char* positions = nullptr;
+    std::size_t positionStride = 3 * sizeof(float);
+    QMatrix4x4 meshTransform;
+    const void* indices = nullptr;
+    if (data.sourceLayout) {
+        const SceneMeshData::SourceView& position = data.sourceLayout->position;
+        if (position.buffer < 0)
+            return nullptr;
+        positions = model.buffers[position.buffer].constData() + position.byteOffset;
+        if (position.byteStride != 0)
+            positionStride = position.byteStride;
+        const SceneMeshData::SourceView& indexView = data.sourceLayout->indices;
+        if (indexView.buffer >= 0)
+            indices = model.buffers[indexView.buffer].constData() + indexView.byteOffset;
+    } else if (data.vertexFlags.testFlag(SceneMesh::VertexFlag::QuantizedPositions)) {
+        if (data.pickingPositions.isEmpty())
+            return nullptr;
+        positions = data.pickingPositions.constData();
+        meshTransform.translate(data.positionOffset);
+        meshTransform.scale(data.positionScale);
+        indices = data.indexBytes.constData();
+    } else {
+        positions = data.vertexBytes.constData();
+        positionStride = SceneMesh::vertexByteStride(data.vertexFlags);
+        indices = data.indexBytes.constData();
+    }
+
+    auto bvh = std::make_shared<all::Bvh>();
+    const auto* floats = reinterpret_cast<const float*>(positions);
+    if (indices == nullptr) {
+        // Unindexed source meshes draw their vertices in order
+        std::vector<uint32_t> sequentialIndices(data.indexCount);
+        std::iota(sequentialIndices.begin(), sequentialIndices.end(), 0);
+        bvh->addMesh(floats, positionStride, data.vertexCount, sequentialIndices.data(), data.indexCount, toGlmMat4x4(meshTransform));
+    } else if (data.indexType == SceneMesh::IndexType::UInt16) {
+        bvh->addMesh(floats, positionStride, data.vertexCount, static_cast<const uint16_t*>(indices), data.indexCount, toGlmMat4x4(meshTransform));
+    } else {
+        bvh->addMesh(floats, positionStride, data.vertexCount, static_cast<const uint32_t*>(indices), data.indexCount, toGlmMat4x4(meshTransform));
+    }
+    bvh->build();
+    return bvh;
 }
 } // namespace
 
-Qt3DCore::QEntity* all::qt3d::MeshLoader::load(const QString& path)
+std::shared_ptr<all::qt3d::ModelData> all::qt3d::MeshLoader::import(const QString& path, const ImportOptions& options, const ProgressCallback& progress)
 {
+    QElapsedTimer importTimer;
+    importTimer.start();
+
+    // glTF data that can be drawn as is skips assimp, baking and the cache altogether.
+    // Quantized imports need their own vertex layout and take the usual path,
+    // as do lean ones which would otherwise keep the whole file resident.
+    if (options.quantization.toInt() == 0 && !options.memoryLean && GltfReader::canRead(path)) {
+        if (auto model = GltfReader::read(path)) {
+            model->bounds = sceneBounds(*model);
+            // Nothing to cache but the picking hierarchy, which still needs the key
+            if (options.useCache)
+                model->cacheFilePath = MeshCache::cacheFilePath(path, options);
+            model->timings.parseMs = model->timings.totalMs = elapsedMs(importTimer);
+            reportImport(path, *model, options, importTimer);
+            if (progress)
+                progress(1.0f);
+            return model;
+        }
+    }
+
+    const QString cacheFilePath = options.useCache ? MeshCache::cacheFilePath(path, options) : QString();
+    if (!cacheFilePath.isEmpty()) {
+        if (auto cached = MeshCache::read(cacheFilePath, path)) {
+            cached->bounds = sceneBounds(*cached);
+            cached->cacheFilePath = cacheFilePath;
+            if (options.memoryLean)
+                dropUnpickedPositions(*cached);
+            cached->timings.parseMs = cached->timings.totalMs = elapsedMs(importTimer);
+            reportImport(path, *cached, options, importTimer);
+            if (progress)
+                progress(1.0f);
+            return cached;
+        }
+    }
+
+    ImportTimings timings;
+    QElapsedTimer stageTimer;
+    stageTimer.start();
+
+    // OBJ, STL and PLY files get read in parallel, assimp takes over for what the readers don't support
+    std::unique_ptr<aiScene> ownedScene;
+    if (!readWith<ObjReader>(path, progress, ownedScene) || !readWith<StlReader>(path, progress, ownedScene) ||
+        !readWith<PlyReader>(path, progress, ownedScene))
+        return nullptr;
+
+    // Scratch buffers of the processing and baking below, released all at once when the import ends
+    all::ImportArena arena;
+
     Assimp::Importer importer;
+    const aiScene* scene = ownedScene.get();
+    if (!scene) {
+        importer.SetProgressHandler(new ImportProgressHandler(progress)); // Importer takes ownership
+
+        QElapsedTimer readTimer;
+        readTimer.start();
+
+        // Only what the profile uses: tangents never are, and imports for picking
+        // drop every attribute but positions. Normals and vertex joining are
+        // left out when done in parallel afterwards.
+        unsigned int vertexSteps = 0;
+        if (options.shadingAttributes)
+            vertexSteps |= aiProcess_GenNormals;
+        if (options.joinIdenticalVertices)
+            vertexSteps |= aiProcess_JoinIdenticalVertices;
+        unsigned int flags = aiProcess_Triangulate;
+        if (!options.shadingAttributes) {
+            importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, aiComponent_NORMALS | aiComponent_TANGENTS_AND_BITANGENTS | aiComponent_COLORS | aiComponent_TEXCOORDS);
+            flags |= aiProcess_RemoveComponent;
+        }
+        if (!options.parallelVertexProcessing)
+            flags |= vertexSteps;
+        scene = importer.ReadFile(path.toLocal8Bit().constData(), flags);
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+            qDebug() << "Failed to load mesh:" << importer.GetErrorString();
+            return nullptr;
+        }
+        qDebug() << "Read" << path << "in" << readTimer.elapsed() << "ms";
+        timings.parseMs = elapsedMs(stageTimer);
+        stageTimer.restart();
+
+        if (options.parallelVertexProcessing && !all::mesh_processing::canProcess(*scene)) {
+            scene = importer.ApplyPostProcessing(vertexSteps);
+            if (!scene) {
+                qDebug() << "Failed to load mesh:" << importer.GetErrorString();
+                return nullptr;
+            }
+        } else if (options.parallelVertexProcessing) {
+            ownedScene.reset(importer.GetOrphanedScene());
+            scene = ownedScene.get();
+            const auto report = all::mesh_processing::processScene(*ownedScene, { options.shadingAttributes, options.normalCreaseAngle, options.joinIdenticalVertices }, &arena);
+            qDebug().nospace() << "Generated normals for " << report.normalMeshCount << " meshes in " << report.normalsMs
+                               << " ms, joined " << report.vertexCountBefore << " vertices into " << report.vertexCountAfter
+                               << " in " << report.joinMs << " ms";
+        }
+        timings.postProcessMs = elapsedMs(stageTimer);
+    } else {
+        // The parallel readers generate normals and join vertices as they read
+        timings.parseMs = elapsedMs(stageTimer);
+    }
+
+    auto model = std::make_shared<ModelData>();
+    model->materials.reserve(scene->mNumMaterials);
+    for (std::size_t i = 0; i < scene->mNumMaterials; ++i)
+        model->materials.push_back(modelMaterialFrom(scene->mMaterials[i], path));
+
+    std::vector<BakeJob> jobs;
+    MeshTraversal traversal;
+    traversal.meshUses.resize(scene->mNumMeshes, 0);
+    countMeshUses(scene->mRootNode, traversal.meshUses);
+    addMeshes(scene, scene->mRootNode, {}, *model, jobs, traversal);
+    Q_ASSERT(jobs.size() == model->meshes.size());
+
+    const std::size_t instanceCount = std::accumulate(model->meshes.begin(), model->meshes.end(), std::size_t(0), [](std::size_t count, const ModelMesh& mesh) {
+        return count + mesh.instances.size();
+    });
+    if (instanceCount > 0)
+        qDebug() << "Baking" << traversal.instancedMeshes.size() << "meshes once for" << instanceCount << "node references";
+
+    // Meshes are independent from each other, bake them across the thread pool
+    QElapsedTimer bakeTimer;
+    bakeTimer.start();
+
+    std::vector<std::size_t> jobIndices(jobs.size());
+    std::iota(jobIndices.begin(), jobIndices.end(), 0);
+
+    // Meshes too large for 16-bit indices might be split into several chunks
+    std::vector<std::vector<SceneMeshData>> bakedChunks(jobs.size());
+    std::vector<SceneMesh::OptimizationResult> optimizations(options.optimizeVertexCache ? jobs.size() : 0);
+
+    std::atomic<std::size_t> bakedCount{ 0 };
+    std::atomic<bool> cancelled{ false };
+    std::mutex progressMutex;
+    QtConcurrent::blockingMap(jobIndices, [&](std::size_t i) {
+        if (cancelled)
+            return;
+
+        all::ImportArena::Job arenaJob(&arena);
+        SceneMeshData data = bakeMesh(jobs[i], options, arenaJob.resource());
+        if (options.optimizeVertexCache)
+            optimizations[i] = SceneMesh::optimize(data, options.optimizeOverdraw, arenaJob.resource());
+        bakedChunks[i] = SceneMesh::splitForShortIndices(std::move(data), arenaJob.resource());
+
+        const std::size_t baked = ++bakedCount;
+        if (progress) {
+            std::scoped_lock lock(progressMutex);
+            if (!progress(ImportProgressShare + (1.0f - ImportProgressShare) * float(baked) / float(jobs.size())))
+                cancelled = true;
+        }
+    });
+    if (cancelled)
+        return nullptr;
+
+    // Averaged over every triangle, so that the large meshes weigh the most
+    if (options.optimizeVertexCache) {
+        double triangleCount = 0.0;
+        double missesBefore = 0.0;
+        double missesAfter = 0.0;
+        for (std::size_t i = 0; i < jobs.size(); ++i) {
+            const double triangles = std::accumulate(bakedChunks[i].begin(), bakedChunks[i].end(), 0.0, [](double count, const SceneMeshData& chunk) {
+                return count + chunk.indexCount / 3;
+            });
+            triangleCount += triangles;
+            missesBefore += optimizations[i].acmrBefore * triangles;
+            missesAfter += optimizations[i].acmrAfter * triangles;
+        }
+        if (triangleCount > 0.0)
+            qDebug().nospace() << "Optimized " << jobs.size() << " meshes for the vertex cache, ACMR " << missesBefore / triangleCount << " -> " << missesAfter / triangleCount;
+    }
+
+    std::vector<ModelMesh> meshes;
+    meshes.reserve(model->meshes.size());
+    for (std::size_t i = 0; i < model->meshes.size(); ++i) {
+        for (SceneMeshData& chunk : bakedChunks[i]) {
+            ModelMesh& mesh = meshes.emplace_back(model->meshes[i]);
+            mesh.data = std::move(chunk);
+        }
+    }
+    model->meshes = std::move(meshes);
+
+    if (options.batchVertexBudget > 0)
+        batchStaticMeshes(*model, options.batchVertexBudget);
+
+    // Simplified last, so that batches get simplified as a whole
+    if (options.levelsOfDetail > 0) {
+        QElapsedTimer lodTimer;
+        lodTimer.start();
+        QtConcurrent::blockingMap(model->meshes, [&options, &arena](ModelMesh& mesh) {
+            if (mesh.isSkybox)
+                return;
+            all::ImportArena::Job arenaJob(&arena);
+            SceneMesh::generateLevelsOfDetail(mesh.data, options.levelsOfDetail, arenaJob.resource());
+        });
+
+        // Triangles drawn at each level, full resolution first. Like
+        // SceneMesh::setLevelOfDetail, meshes with fewer levels stay at their coarsest one.
+        std::size_t levelCount = 0;
+        for (const ModelMesh& mesh : model->meshes)
+            levelCount = std::max(levelCount, mesh.data.lods.size());
+        std::vector<std::size_t> levelTriangles(levelCount > 0 ? levelCount + 1 : 0, 0);
+        for (const ModelMesh& mesh : model->meshes) {
+            for (std::size_t level = 0; level < levelTriangles.size(); ++level) {
+                const std::size_t lod = std::min(level, mesh.data.lods.size());
+                levelTriangles[level] += (lod == 0 ? mesh.data.indexCount : mesh.data.lods[lod - 1].indexCount) / 3;
+            }
+        }
+        QDebug debug = qDebug().nospace();
+        debug << "Generated levels of detail in " << lodTimer.elapsed() << " ms";
+        if (!levelTriangles.empty()) {
+            debug << ", triangles " << levelTriangles[0];
+            for (std::size_t level = 1; level < levelTriangles.size(); ++level)
+                debug << " -> " << levelTriangles[level];
+        }
+    }
+
+    model->bounds = sceneBounds(*model);
+    timings.bakeMs = elapsedMs(bakeTimer);
+
+    qDebug() << "Baked" << jobs.size() << "meshes into" << model->meshes.size() << "draws in" << bakeTimer.elapsed() << "ms";
+    const all::ImportArena::Statistics arenaStatistics = arena.statistics();
+    qDebug().noquote() << "Import scratch:" << arenaStatistics.allocationCount << "allocations served by"
+                       << arenaStatistics.heapAllocationCount << "heap blocks over" << arenaStatistics.threadCount << "threads, peak"
+                       << QString::number(double(arenaStatistics.peakBytes) / 1024.0, 'f', 1) + QStringLiteral(" KiB");
+
+    // The cache is shared by lean and regular imports
+    if (!cacheFilePath.isEmpty()) {
+        if (MeshCache::write(cacheFilePath, path, *model))
+            model->cacheFilePath = cacheFilePath;
+        else
+            qDebug() << "Failed to write mesh cache" << cacheFilePath;
+    }
+
+    if (options.memoryLean)
+        dropUnpickedPositions(*model);
+    timings.totalMs = elapsedMs(importTimer);
+    model->timings = timings;
+    reportImport(path, *model, options, importTimer);
 
-    const auto flags = aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices;
-    const aiScene* scene = importer.ReadFile(path.toLocal8Bit().constData(), flags);
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+    return model;
+}
+
+all::qt3d::ModelMemory all::qt3d::ModelData::memory() const
+{
+    ModelMemory memory;
+    for (const ModelMesh& mesh : meshes) {
+        memory.vertexBytes += mesh.data.vertexBytes.size();
+        memory.indexBytes += mesh.data.indexBytes.size();
+        memory.pickingBytes += mesh.data.pickingPositions.size();
+    }
+    // Meshes drawn from the source buffers share them
+    for (const QByteArray& buffer : buffers)
+        memory.sourceBytes += buffer.size();
+    return memory;
+}
+
+const all::qt3d::ModelSubMesh* all::qt3d::ModelMesh::subMeshAt(uint32_t primitiveIndex) const
+{
+    const uint32_t index = primitiveIndex * 3;
+    auto it = std::upper_bound(subMeshes.begin(), subMeshes.end(), index, [](uint32_t index, const ModelSubMesh& subMesh) {
+        return index < subMesh.firstIndex;
+    });
+    if (it == subMeshes.begin())
         return nullptr;
-        throw std::runtime_error(QStringLiteral("Failed to load mesh: %1").arg(importer.GetErrorString()).toLocal8Bit().constData());
+    --it;
+    return index < it->firstIndex + it->indexCount ? &*it : nullptr;
+}
+
+const all::qt3d::ModelMesh* all::qt3d::ModelData::meshAt(const all::RayHit& hit) const
+{
+    return hit.instance < bvhInstanceMeshes.size() ? &meshes[bvhInstanceMeshes[hit.instance]] : nullptr;
+}
+
+void all::qt3d::MeshLoader::buildBvh(ModelData& model)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Mesh hierarchies go by the index of their mesh, empty for the meshes that aren't picked
+    std::vector<std::shared_ptr<const all::Bvh>> meshBvhs;
+    if (!model.cacheFilePath.isEmpty())
+        meshBvhs = MeshCache::readBvh(model.cacheFilePath, model.meshes.size());
+    const bool cached = !meshBvhs.empty();
+    if (!cached) {
+        // Meshes are built concurrently, and each large one across threads too
+        meshBvhs.resize(model.meshes.size());
+        std::vector<std::size_t> meshIndices(model.meshes.size());
+        std::iota(meshIndices.begin(), meshIndices.end(), 0);
+        QtConcurrent::blockingMap(meshIndices, [&model, &meshBvhs](std::size_t i) {
+            meshBvhs[i] = buildMeshBvh(model, model.meshes[i]);
+        });
+        if (!model.cacheFilePath.isEmpty() && !MeshCache::writeBvh(model.cacheFilePath, meshBvhs))
+            qDebug() << "Failed to write BVH cache next to" << model.cacheFilePath;
+    }
+
+    auto bvh = std::make_shared<all::SceneBvh>();
+    model.bvhInstanceMeshes.clear();
+    for (std::size_t i = 0; i < model.meshes.size(); ++i) {
+        if (!meshBvhs[i])
+            continue;
+        if (model.meshes[i].instances.empty())
+            bvh->addInstance(meshBvhs[i]);
+        for (const QMatrix4x4& instance : model.meshes[i].instances)
+            bvh->addInstance(meshBvhs[i], toGlmMat4x4(instance));
+        model.bvhInstanceMeshes.resize(bvh->instanceCount(), uint32_t(i));
     }
+    bvh->build();
+
+    const all::Bvh::Statistics statistics = bvh->statistics();
+    qDebug().noquote() << (cached ? "Read picking BVH over" : "Built picking BVH over") << bvh->triangleCount() << "triangles in" << timer.elapsed() << "ms,"
+                       << bvh->instanceCount() << "instances of" << std::count_if(meshBvhs.begin(), meshBvhs.end(), [](const auto& meshBvh) { return meshBvh != nullptr; })
+                       << "meshes," << statistics.nodeCount << "nodes up to" << statistics.maxDepth << "levels deep, taking"
+                       << QString::number(double(statistics.memoryBytes) / 1024.0, 'f', 1) + QStringLiteral(" KiB");
+    model.bvh = std::move(bvh);
+}
 
+Qt3DCore::QEntity* all::qt3d::MeshLoader::createEntities(const ModelData& model)
+{
     auto* root = new Qt3DCore::QEntity;
-    addMeshes(scene, scene->mRootNode, {}, root, path);
 
-    // Handle Custom Material replacement
-    {
-        std::unordered_map<QString, Qt3DRender::QMaterial*> customMaterials;
-#define MMat(name) customMaterials[QStringLiteral(#name)] = new GlossyMaterial(name##ST, name##SU)
-        MMat(CarPaint);
-        MMat(DarkGlass);
-        MMat(DarkGloss);
-        MMat(Dark);
-        MMat(Chrome);
-        MMat(Plate);
-        MMat(Tire);
-        MMat(ShadowPlane);
+    // Octahedral normals need a dedicated shader variant, create each variant on first use
+    std::unordered_map<QString, std::function<Qt3DRender::QMaterial*(bool)>> customMaterialFactories;
+#define MMat(name) customMaterialFactories[QStringLiteral(#name)] = [](bool octahedralNormals) { return new GlossyMaterial(name##ST, name##SU, octahedralNormals); }
+    MMat(CarPaint);
+    MMat(DarkGlass);
+    MMat(DarkGloss);
+    MMat(Dark);
+    MMat(Chrome);
+    MMat(Plate);
+    MMat(Tire);
+    MMat(ShadowPlane);
 #undef MMat
-        customMaterials["Skybox"] = new SkyboxMaterial(SkyboxST, {});
-
-        const auto sceneEntities = root->findChildren<Qt3DCore::QEntity*>();
-        for (auto* e : sceneEntities) {
-            Qt3DRender::QMaterial* material = [e] {
-                auto components = e->componentsOfType<Qt3DRender::QMaterial>();
-                return !components.isEmpty() ? components.first() : nullptr;
-            }();
-            if (!material)
-                continue;
-            const auto materialName = material->property("name").toString();
-
-            if (materialName.contains("skybox", Qt::CaseInsensitive)) {
-                if (e->parent() != root)
-                    e->setParent(root);
+    customMaterialFactories["Skybox"] = [](bool) { return new SkyboxMaterial(SkyboxST, {}); };
+
+    // One material per source within a load, shared by all the entities using it
+    std::map<std::pair<QString, bool>, Qt3DRender::QMaterial*> customMaterials;
+    std::vector<Qt3DRender::QMaterial*> materials(model.materials.size(), nullptr);
+    TextureCache::prune();
+    TextureCache::Statistics textureStatistics;
+
+    auto materialFor = [&](const ModelMesh& mesh) {
+        const ModelMaterial& materialInfo = model.materials[mesh.materialIndex];
+        if (auto it = customMaterialFactories.find(materialInfo.name); it != customMaterialFactories.end()) {
+            const bool octahedralNormals = mesh.data.vertexFlags.testFlag(SceneMesh::VertexFlag::OctahedralNormals);
+            Qt3DRender::QMaterial*& customMaterial = customMaterials[{ materialInfo.name, octahedralNormals }];
+            if (customMaterial == nullptr) {
+                customMaterial = it->second(octahedralNormals);
+                customMaterial->setProperty("name", materialInfo.name);
             }
+            return customMaterial;
+        }
 
-            if (auto it = customMaterials.find(materialName); it != customMaterials.end()) {
-                e->removeComponent(material);
-                e->addComponent(it->second);
-            }
+        Qt3DRender::QMaterial*& material = materials[mesh.materialIndex];
+        if (material == nullptr) {
+            material = materialFrom(materialInfo, root, textureStatistics);
+            material->setProperty("name", materialInfo.name);
         }
+        return material;
+    };
+
+    // Uploaded once, whatever the number of meshes drawing from them
+    std::vector<Qt3DCore::QBuffer*> sourceBuffers;
+    sourceBuffers.reserve(model.buffers.size());
+    for (const QByteArray& bytes : model.buffers) {
+        auto* buffer = new Qt3DCore::QBuffer(root);
+        buffer->setData(bytes);
+        sourceBuffers.push_back(buffer);
+    }
+
+    std::size_t entityCount = 0;
+    for (const ModelMesh& mesh : model.meshes) {
+        auto* meshComponent = new SceneMesh(mesh.data.vertexFlags);
+        meshComponent->setData(mesh.data, sourceBuffers);
 
-        // Delete Unused Materials
-        for (const auto& [key, value] : customMaterials) {
-            if (value->parent() == nullptr)
-                value->deleteLater();
+        Qt3DRender::QMaterial* material = materialFor(mesh);
+        auto* pickingProxy = SceneMesh::createPickingProxy(mesh.data);
+
+        // Quantized positions are decoded by the entity transform
+        QMatrix4x4 meshTransform;
+        if (mesh.data.vertexFlags.testFlag(SceneMesh::VertexFlag::QuantizedPositions)) {
+            meshTransform.translate(mesh.data.positionOffset);
+            meshTransform.scale(mesh.data.positionScale);
         }
+
+        auto addEntity = [&](SceneMesh* sceneMesh, const QMatrix4x4& transform) {
+            auto* childEntity = new Qt3DCore::QEntity(root);
+            sceneMesh->setProperty("name", mesh.name);
+            childEntity->addComponent(sceneMesh);
+            childEntity->addComponent(material);
+            if (!transform.isIdentity()) {
+                auto* transformComponent = new Qt3DCore::QTransform;
+                transformComponent->setMatrix(transform);
+                childEntity->addComponent(transformComponent);
+            }
+            if (pickingProxy)
+                childEntity->addComponent(pickingProxy);
+            if (auto* levelOfDetail = createLevelOfDetail(mesh.data)) {
+                QObject::connect(levelOfDetail, &Qt3DRender::QLevelOfDetail::currentIndexChanged, sceneMesh, &SceneMesh::setLevelOfDetail);
+                childEntity->addComponent(levelOfDetail);
+            }
+            ++entityCount;
+        };
+
+        if (mesh.instances.empty()) {
+            addEntity(meshComponent, meshTransform);
+            continue;
+        }
+
+        // Instances share the buffers and the picking proxy, but select their level of detail on their own
+        for (std::size_t i = 0; i < mesh.instances.size(); ++i)
+            addEntity(i == 0 ? meshComponent : meshComponent->createInstance(), mesh.instances[i] * meshTransform);
     }
 
+    const auto createdMaterials = customMaterials.size() + std::ranges::count_if(materials, [](auto* material) { return material != nullptr; });
+    qDebug() << "Created" << entityCount << "entities from" << model.meshes.size() << "meshes, sharing" << createdMaterials << "materials and"
+             << textureStatistics.created << "textures," << textureStatistics.reused << "textures reused from previous loads";
+
     return root;
 }
+
+Qt3DCore::QEntity* all::qt3d::MeshLoader::load(const QString& path, const ImportOptions& options)
+{
+    const std::shared_ptr<ModelData> model = import(path, options);
+    if (!model)
+        return nullptr;
+    return createEntities(*model);
+}
@@ -1,17 +1,199 @@
 #pragma once
 
+#include "scene_mesh.h"
+
+#include <shared/import_profile.h>
+
 #include <QString>
+#include <QColor>
+#include <QMatrix4x4>
+
+#include <functional>
+#include <memory>
+#include <vector>
 
 namespace Qt3DCore {
 class QEntity;
 };
 
+namespace all {
+class SceneBvh;
+struct RayHit;
+} // namespace all
+
 namespace all::qt3d {
 
+struct ModelMaterial {
+    QString name;
+    QColor ambient;
+    QColor diffuse;
+    QColor specular;
+    float shininess{ 0.0f };
+    QString diffuseTexturePath; // Absolute path, empty if no diffuse texture
+    bool mirrorDiffuseTexture{ true }; // False for texture coordinates with a top left origin
+};
+
+// Range of an imported mesh within a batch, see ImportOptions::batchVertexBudget
+struct ModelSubMesh {
+    QString name;
+    uint32_t firstIndex{ 0 };
+    uint32_t indexCount{ 0 };
+    uint32_t firstVertex{ 0 };
+    uint32_t vertexCount{ 0 };
+    all::AABB bounds;
+};
+
+struct ModelMesh {
+    QString name;
+    uint32_t materialIndex{ 0 };
+    bool isSkybox{ false };
+    SceneMeshData data;
+    std::vector<ModelSubMesh> subMeshes; // Empty unless several meshes were batched together
+
+    // World transforms of the nodes sharing a mesh, which is then baked once
+    // in its own space. Empty for meshes baked in world space.
+    std::vector<QMatrix4x4> instances;
+
+    // Returns the batched mesh a picked triangle belongs to, nullptr if not batched
+    const ModelSubMesh* subMeshAt(uint32_t primitiveIndex) const;
+};
+
+// CPU memory held by the buffers of a model, which stays resident as long as
+// its entities exist since Qt3D keeps the data it uploads
+struct ModelMemory {
+    qsizetype vertexBytes{ 0 };
+    qsizetype indexBytes{ 0 };
+    qsizetype pickingBytes{ 0 }; // Float positions of the picking proxies
+    qsizetype sourceBytes{ 0 }; // Source file buffers, see ModelData::buffers
+
+    qsizetype totalBytes() const { return vertexBytes + indexBytes + pickingBytes + sourceBytes; }
+};
+
+// Wall time spent in each stage of an import, in milliseconds
+struct ImportTimings {
+    double parseMs{ 0.0 }; // Reading the file, or the mesh cache
+    double postProcessMs{ 0.0 }; // Normal generation and vertex joining outside of the reader
+    double bakeMs{ 0.0 }; // Vertex baking, batching and levels of detail
+    double totalMs{ 0.0 };
+};
+
+// Result of a model import, holds no QNode so that it can be produced off the GUI thread
+struct ModelData {
+    std::vector<ModelMaterial> materials;
+    std::vector<ModelMesh> meshes;
+    all::AABB bounds; // World space bounds of every drawn mesh and instance, skyboxes excluded
+
+    // Source file data shared by the meshes with a SceneMeshData::sourceLayout
+    std::vector<QByteArray> buffers;
+
+    ImportTimings timings;
+
+    // World space triangles of the drawn meshes for cursor picking, see MeshLoader::buildBvh
+    std::shared_ptr<const all::SceneBvh> bvh;
+    std::vector<uint32_t> bvhInstanceMeshes; // Index in meshes of each instance of bvh
+
+    // Mesh cache file the model was read from or written to, empty if it wasn't cached
+    QString cacheFilePath;
+
+    ModelMemory memory() const;
+
+    // Returns the mesh a hit on bvh landed on, nullptr if it isn't one of its instances
+    const ModelMesh* meshAt(const all::RayHit& hit) const;
+};
+
+struct ImportOptions {
+    // Compact layouts to bake the meshes with, see SceneMesh::VertexFlag.
+    // QuantizedNormals turns into OctahedralNormals for meshes whose material can decode them.
+    SceneMesh::VertexFlags quantization{ SceneMesh::VertexFlag::None };
+
+    // Static meshes sharing a material are merged into batches of at most
+    // that many vertices, to cut down on entities and draw calls. 0 disables batching.
+    std::size_t batchVertexBudget{ SceneMesh::MaxShortIndexedVertexCount };
+
+    // Reorder triangles and vertices for the post-transform and fetch caches,
+    // optionally also sorting triangle clusters to reduce overdraw
+    bool optimizeVertexCache{ true };
+    bool optimizeOverdraw{ false };
+
+    // Simplified versions of the meshes switched to as they get smaller on
+    // screen, see SceneMesh::generateLevelsOfDetail. 0 disables them.
+    std::size_t levelsOfDetail{ 3 };
+
+    // Generate the missing normals and join identical vertices across the
+    // thread pool instead of in assimp, see all::mesh_processing. Normals are
+    // smoothed across edges whose faces are less than normalCreaseAngle
+    // degrees apart, 0 keeps them flat like assimp does.
+    bool parallelVertexProcessing{ true };
+    float normalCreaseAngle{ 0.0f };
+
+    // Fewer vertices to draw and pick, at the cost of a longer import
+    bool joinIdenticalVertices{ true };
+
+    // Normals, and texture coordinates and colors for the meshes whose
+    // material reads them. Models that are only picked need positions alone.
+    bool shadingAttributes{ true };
+
+    // Read and write baked models from the mesh cache, see MeshCache
+    bool useCache{ true };
+
+    // Keep as little as possible on the CPU once the model is uploaded: compact
+    // vertex layouts only, no source file buffers kept whole for glTF models,
+    // and float positions for picking only on the meshes that can be picked
+    bool memoryLean{ false };
+
+    // Profile the options were derived from, reported along with the import timings
+    all::ImportProfile profile{ all::ImportProfile::FullQuality };
+
+    static ImportOptions compact()
+    {
+        return { SceneMesh::VertexFlag::QuantizedPositions | SceneMesh::VertexFlag::QuantizedNormals |
+                 SceneMesh::VertexFlag::QuantizedTexCoords | SceneMesh::VertexFlag::QuantizedColors };
+    }
+
+    static ImportOptions forProfile(all::ImportProfile profile)
+    {
+        ImportOptions options;
+        options.profile = profile;
+        switch (profile) {
+        case all::ImportProfile::FullQuality:
+            break;
+        case all::ImportProfile::FastPreview:
+            options.joinIdenticalVertices = false;
+            options.optimizeVertexCache = false;
+            options.levelsOfDetail = 0;
+            break;
+        case all::ImportProfile::PickingOnly:
+            options.shadingAttributes = false;
+            options.optimizeVertexCache = false;
+            options.levelsOfDetail = 0;
+            break;
+        }
+        return options;
+    }
+};
+
 class MeshLoader
 {
 public:
-    static Qt3DCore::QEntity* load(const QString& path);
+    // Called with the import progress in [0, 1], returning false cancels the import.
+    // Might be called from several worker threads, but never concurrently.
+    using ProgressCallback = std::function<bool(float)>;
+
+    // Runs assimp and bakes the vertex buffers, safe to call from a worker thread.
+    // Returns nullptr if the import failed or was cancelled.
+    static std::shared_ptr<ModelData> import(const QString& path, const ImportOptions& options = {}, const ProgressCallback& progress = {});
+
+    // Builds a hierarchy over the full resolution triangles of every drawn
+    // instance, skyboxes excluded: one per mesh, shared by its instances, under
+    // a top level one. The mesh hierarchies are read from and written next to
+    // the mesh cache file. Fills model.bvh and model.bvhInstanceMeshes, safe to
+    // call from a worker thread.
+    static void buildBvh(ModelData& model);
+
+    // Creates the entity tree for model, must be called from the GUI thread
+    static Qt3DCore::QEntity* createEntities(const ModelData& model);
+
+    static Qt3DCore::QEntity* load(const QString& path, const ImportOptions& options = {});
 };
 
 } // namespace all::qt3d
@@ -0,0 +1,704 @@
+#include "obj_reader.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <assimp/material.h>
+#include <assimp/scene.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+constexpr qint64 MinChunkSize = 1 << 20;
+constexpr uint32_t NoIndex = std::numeric_limits<uint32_t>::max();
+
+// Share of the progress spent parsing the chunks, the rest goes to building the meshes
+constexpr float ParseProgressShare = 0.8f;
+
+struct Chunk {
+    const char* begin{ nullptr };
+    const char* end{ nullptr };
+};
+
+// Vertex attributes declared in a chunk, counted before parsing so that
+// relative indices can be resolved while parsing
+struct AttributeCounts {
+    uint32_t positions{ 0 };
+    uint32_t texCoords{ 0 };
+    uint32_t normals{ 0 };
+};
+
+struct FaceVertex {
+    uint32_t position{ NoIndex };
+    uint32_t texCoord{ NoIndex };
+    uint32_t normal{ NoIndex };
+};
+
+// Triangles following a change of object or material
+struct FaceGroup {
+    std::optional<std::string> object;
+    std::optional<std::string> material;
+    std::vector<FaceVertex> vertices; // 3 per triangle
+};
+
+struct ParsedChunk {
+    std::vector<float> positions; // xyz
+    std::vector<float> colors; // rgb per position, empty if no vertex of the chunk has a color
+    std::vector<float> texCoords; // uv
+    std::vector<float> normals; // xyz
+    std::vector<FaceGroup> groups;
+    std::vector<std::string> materialLibraries;
+    bool failed{ false };
+};
+
+struct Line {
+    std::string_view keyword;
+    const char* args{ nullptr }; // Right after the keyword
+    const char* end{ nullptr }; // Without line ending and comment
+};
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+const char* skipSpaces(const char* p, const char* end)
+{
+    while (p < end && isSpace(*p))
+        ++p;
+    return p;
+}
+
+// Splits the line at p, returns the start of the next one
+const char* nextLine(const char* p, const char* end, Line& line)
+{
+    const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+    const char* next = lineEnd ? lineEnd + 1 : end;
+    if (!lineEnd)
+        lineEnd = end;
+
+    if (const char* comment = static_cast<const char*>(std::memchr(p, '#', size_t(lineEnd - p))))
+        lineEnd = comment;
+    while (lineEnd > p && isSpace(lineEnd[-1]))
+        --lineEnd;
+
+    p = skipSpaces(p, lineEnd);
+    const char* keywordEnd = p;
+    while (keywordEnd < lineEnd && !isSpace(*keywordEnd))
+        ++keywordEnd;
+
+    line.keyword = std::string_view(p, size_t(keywordEnd - p));
+    line.args = keywordEnd;
+    line.end = lineEnd;
+    return next;
+}
+
+bool parseFloat(const char*& p, const char* end, float& value)
+{
+    p = skipSpaces(p, end);
+    if (p < end && *p == '+')
+        ++p;
+    const auto [ptr, ec] = std::from_chars(p, end, value);
+    if (ec != std::errc())
+        return false;
+    p = ptr;
+    return true;
+}
+
+// Up to maxCount floats, returns how many were read
+std::size_t parseFloats(const char* p, const char* end, float* values, std::size_t maxCount)
+{
+    std::size_t count = 0;
+    while (count < maxCount && parseFloat(p, end, values[count]))
+        ++count;
+    return count;
+}
+
+std::string_view trimmed(const char* begin, const char* end)
+{
+    begin = skipSpaces(begin, end);
+    return std::string_view(begin, size_t(end - begin));
+}
+
+// Resolves an OBJ index, 1 based or relative to the attributes declared so far
+bool parseIndex(const char*& p, const char* end, uint32_t declaredCount, uint32_t& index)
+{
+    int64_t value = 0;
+    const auto [ptr, ec] = std::from_chars(p, end, value);
+    if (ec != std::errc() || value == 0)
+        return false;
+    p = ptr;
+    const int64_t resolved = value > 0 ? value - 1 : int64_t(declaredCount) + value;
+    if (resolved < 0 || resolved >= int64_t(NoIndex))
+        return false;
+    index = uint32_t(resolved);
+    return true;
+}
+
+AttributeCounts countAttributes(const Chunk& chunk)
+{
+    AttributeCounts counts;
+    Line line;
+    for (const char* p = chunk.begin; p < chunk.end;) {
+        p = nextLine(p, chunk.end, line);
+        if (line.keyword == "v")
+            ++counts.positions;
+        else if (line.keyword == "vt")
+            ++counts.texCoords;
+        else if (line.keyword == "vn")
+            ++counts.normals;
+    }
+    return counts;
+}
+
+ParsedChunk parseChunk(const Chunk& chunk, AttributeCounts declared)
+{
+    ParsedChunk parsed;
+    std::vector<FaceVertex> polygon;
+
+    auto currentGroup = [&parsed]() -> FaceGroup& {
+        if (parsed.groups.empty())
+            parsed.groups.emplace_back();
+        return parsed.groups.back();
+    };
+    // A group that already has triangles can't change state anymore
+    auto stateGroup = [&parsed]() -> FaceGroup& {
+        if (parsed.groups.empty() || !parsed.groups.back().vertices.empty())
+            parsed.groups.emplace_back();
+        return parsed.groups.back();
+    };
+
+    Line line;
+    for (const char* p = chunk.begin; p < chunk.end && !parsed.failed;) {
+        p = nextLine(p, chunk.end, line);
+        if (line.keyword.empty())
+            continue;
+        if (line.end > line.args && line.end[-1] == '\\') {
+            parsed.failed = true; // Line continuation
+            break;
+        }
+
+        if (line.keyword == "v") {
+            float values[6] = { 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+            const std::size_t count = parseFloats(line.args, line.end, values, 6);
+            if (count < 3) {
+                parsed.failed = true;
+                break;
+            }
+            parsed.positions.insert(parsed.positions.end(), values, values + 3);
+            // Colors follow the position, backfill the vertices of the chunk declared without any
+            if (count == 6 && parsed.colors.empty())
+                parsed.colors.resize(parsed.positions.size() - 3, 1.0f);
+            if (!parsed.colors.empty())
+                parsed.colors.insert(parsed.colors.end(), values + 3, values + 6);
+            ++declared.positions;
+        } else if (line.keyword == "vt") {
+            float values[3] = { 0.0f, 0.0f, 0.0f };
+            if (parseFloats(line.args, line.end, values, 3) < 1) {
+                parsed.failed = true;
+                break;
+            }
+            parsed.texCoords.insert(parsed.texCoords.end(), values, values + 2);
+            ++declared.texCoords;
+        } else if (line.keyword == "vn") {
+            float values[3] = { 0.0f, 0.0f, 0.0f };
+            if (parseFloats(line.args, line.end, values, 3) < 3) {
+                parsed.failed = true;
+                break;
+            }
+            parsed.normals.insert(parsed.normals.end(), values, values + 3);
+            ++declared.normals;
+        } else if (line.keyword == "f") {
+            polygon.clear();
+            const char* q = skipSpaces(line.args, line.end);
+            while (q < line.end) {
+                FaceVertex vertex;
+                if (!parseIndex(q, line.end, declared.positions, vertex.position)) {
+                    parsed.failed = true;
+                    break;
+                }
+                if (q < line.end && *q == '/') {
+                    ++q;
+                    if (q < line.end && *q != '/' && !parseIndex(q, line.end, declared.texCoords, vertex.texCoord)) {
+                        parsed.failed = true;
+                        break;
+                    }
+                    if (q < line.end && *q == '/') {
+                        ++q;
+                        if (!parseIndex(q, line.end, declared.normals, vertex.normal)) {
+                            parsed.failed = true;
+                            break;
+                        }
+                    }
+                }
+                polygon.push_back(vertex);
+                q = skipSpaces(q, line.end);
+            }
+            if (parsed.failed || polygon.size() < 3)
+                continue;
+
+            // Fan triangulation, like assimp does for convex polygons
+            std::vector<FaceVertex>& vertices = currentGroup().vertices;
+            for (std::size_t i = 1; i + 1 < polygon.size(); ++i) {
+                vertices.push_back(polygon[0]);
+                vertices.push_back(polygon[i]);
+                vertices.push_back(polygon[i + 1]);
+            }
+        } else if (line.keyword == "usemtl") {
+            stateGroup().material = std::string(trimmed(line.args, line.end));
+        } else if (line.keyword == "o" || line.keyword == "g") {
+            stateGroup().object = std::string(trimmed(line.args, line.end));
+        } else if (line.keyword == "mtllib") {
+            parsed.materialLibraries.emplace_back(trimmed(line.args, line.end));
+        } else if (line.keyword == "cstype" || line.keyword == "curv" || line.keyword == "curv2" || line.keyword == "surf") {
+            parsed.failed = true; // Free form geometry
+        }
+        // Points, lines, smoothing groups and the other statements don't end up in the scene
+    }
+    return parsed;
+}
+
+struct ObjMaterial {
+    std::string name;
+    aiColor3D ambient{ 0.0f, 0.0f, 0.0f };
+    aiColor3D diffuse{ 0.6f, 0.6f, 0.6f };
+    aiColor3D specular{ 0.0f, 0.0f, 0.0f };
+    float shininess{ 0.0f };
+    std::string diffuseTexture;
+};
+
+// Texture statements may start with options, the file name comes last
+std::string textureFileName(std::string_view args)
+{
+    if (args.empty() || args.front() != '-')
+        return std::string(args);
+    const std::size_t lastSpace = args.find_last_of(" \t");
+    return std::string(lastSpace == std::string_view::npos ? args : args.substr(lastSpace + 1));
+}
+
+void readMaterialLibrary(const QString& path, std::vector<ObjMaterial>& materials)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Failed to open material library" << path;
+        return;
+    }
+    const QByteArray content = file.readAll();
+    const char* end = content.constData() + content.size();
+
+    Line line;
+    for (const char* p = content.constData(); p < end;) {
+        p = nextLine(p, end, line);
+        if (line.keyword == "newmtl") {
+            materials.emplace_back().name = std::string(trimmed(line.args, line.end));
+            continue;
+        }
+        if (materials.empty())
+            continue;
+
+        ObjMaterial& material = materials.back();
+        auto readColor = [&line](aiColor3D& color) {
+            float values[3];
+            const std::size_t count = parseFloats(line.args, line.end, values, 3);
+            if (count == 1)
+                color = aiColor3D(values[0]);
+            else if (count == 3)
+                color = aiColor3D(values[0], values[1], values[2]);
+        };
+        if (line.keyword == "Ka")
+            readColor(material.ambient);
+        else if (line.keyword == "Kd")
+            readColor(material.diffuse);
+        else if (line.keyword == "Ks")
+            readColor(material.specular);
+        else if (line.keyword == "Ns")
+            parseFloats(line.args, line.end, &material.shininess, 1);
+        else if (line.keyword == "map_Kd")
+            material.diffuseTexture = textureFileName(trimmed(line.args, line.end));
+    }
+}
+
+aiMaterial* toAiMaterial(const ObjMaterial& material)
+{
+    auto* aiMat = new aiMaterial;
+    const aiString name(material.name);
+    aiMat->AddProperty(&name, AI_MATKEY_NAME);
+    aiMat->AddProperty(&material.ambient, 1, AI_MATKEY_COLOR_AMBIENT);
+    aiMat->AddProperty(&material.diffuse, 1, AI_MATKEY_COLOR_DIFFUSE);
+    aiMat->AddProperty(&material.specular, 1, AI_MATKEY_COLOR_SPECULAR);
+    aiMat->AddProperty(&material.shininess, 1, AI_MATKEY_SHININESS);
+    if (!material.diffuseTexture.empty()) {
+        const aiString texture(material.diffuseTexture);
+        aiMat->AddProperty(&texture, AI_MATKEY_TEXTURE_DIFFUSE(0));
+    }
+    return aiMat;
+}
+
+// Faces of one object using one material, spread over the parsed chunks
+struct MeshBuilder {
+    std::string name;
+    uint32_t materialIndex{ 0 };
+    std::vector<const std::vector<FaceVertex>*> faces;
+};
+
+struct VertexKey {
+    uint32_t position;
+    uint32_t texCoord;
+    float normal[3];
+
+    bool operator==(const VertexKey& other) const
+    {
+        return position == other.position && texCoord == other.texCoord && std::memcmp(normal, other.normal, sizeof(normal)) == 0;
+    }
+};
+
+struct VertexKeyHash {
+    std::size_t operator()(const VertexKey& key) const
+    {
+        uint32_t normalBits[3];
+        std::memcpy(normalBits, key.normal, sizeof(normalBits));
+        uint64_t h = key.position * 0x9E3779B97F4A7C15ull;
+        h ^= (uint64_t(key.texCoord) + 0x7F4A7C15ull) * 0xBF58476D1CE4E5B9ull;
+        for (const uint32_t bits : normalBits)
+            h = (h ^ bits) * 0x94D049BB133111EBull;
+        return std::size_t(h ^ (h >> 31));
+    }
+};
+
+struct Attributes {
+    std::vector<float> positions;
+    std::vector<float> colors;
+    std::vector<float> texCoords;
+    std::vector<float> normals;
+};
+
+// Joins the vertices sharing all their attributes, faces without normals get flat ones
+aiMesh* buildMesh(const MeshBuilder& builder, const Attributes& attributes)
+{
+    std::size_t indexCount = 0;
+    bool hasTexCoords = false;
+    for (const std::vector<FaceVertex>* faces : builder.faces) {
+        indexCount += faces->size();
+        hasTexCoords = hasTexCoords || std::ranges::any_of(*faces, [](const FaceVertex& v) { return v.texCoord != NoIndex; });
+    }
+    const bool hasColors = !attributes.colors.empty();
+
+    // Open addressing, there can't be more vertices than indices
+    std::size_t tableSize = 1;
+    while (tableSize < indexCount * 2)
+        tableSize *= 2;
+    std::vector<uint32_t> table(tableSize, NoIndex);
+    std::vector<VertexKey> vertices;
+    vertices.reserve(indexCount / 2);
+    std::vector<uint32_t> indices;
+    indices.reserve(indexCount);
+    auto vertexIndex = [&](const VertexKey& key) {
+        for (std::size_t slot = VertexKeyHash()(key) & (tableSize - 1);; slot = (slot + 1) & (tableSize - 1)) {
+            if (table[slot] == NoIndex) {
+                table[slot] = uint32_t(vertices.size());
+                vertices.push_back(key);
+                return table[slot];
+            }
+            if (vertices[table[slot]] == key)
+                return table[slot];
+        }
+    };
+
+    const float* positions = attributes.positions.data();
+    for (const std::vector<FaceVertex>* faces : builder.faces) {
+        for (std::size_t i = 0; i < faces->size(); i += 3) {
+            const FaceVertex* triangle = faces->data() + i;
+
+            float flatNormal[3] = { 0.0f, 0.0f, 0.0f };
+            if (triangle[0].normal == NoIndex || triangle[1].normal == NoIndex || triangle[2].normal == NoIndex) {
+                const float* p0 = positions + 3 * triangle[0].position;
+                const float* p1 = positions + 3 * triangle[1].position;
+                const float* p2 = positions + 3 * triangle[2].position;
+                const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+                const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+                flatNormal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+                flatNormal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+                flatNormal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+                const float length = std::sqrt(flatNormal[0] * flatNormal[0] + flatNormal[1] * flatNormal[1] + flatNormal[2] * flatNormal[2]);
+                if (length > 0.0f) {
+                    for (float& c : flatNormal)
+                        c /= length;
+                }
+            }
+
+            for (std::size_t j = 0; j < 3; ++j) {
+                const FaceVertex& v = triangle[j];
+                VertexKey key{ v.position, v.texCoord, {} };
+                if (v.normal != NoIndex && triangle[0].normal != NoIndex && triangle[1].normal != NoIndex && triangle[2].normal != NoIndex)
+                    std::memcpy(key.normal, attributes.normals.data() + 3 * v.normal, sizeof(key.normal));
+                else
+                    std::memcpy(key.normal, flatNormal, sizeof(key.normal));
+
+                indices.push_back(vertexIndex(key));
+            }
+        }
+    }
+
+    auto* mesh = new aiMesh;
+    mesh->mName = aiString(builder.name);
+    mesh->mMaterialIndex = builder.materialIndex;
+    mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+
+    mesh->mNumVertices = unsigned(vertices.size());
+    mesh->mVertices = new aiVector3D[vertices.size()];
+    mesh->mNormals = new aiVector3D[vertices.size()];
+    if (hasTexCoords) {
+        mesh->mTextureCoords[0] = new aiVector3D[vertices.size()];
+        mesh->mNumUVComponents[0] = 2;
+    }
+    if (hasColors)
+        mesh->mColors[0] = new aiColor4D[vertices.size()];
+
+    for (std::size_t i = 0; i < vertices.size(); ++i) {
+        const VertexKey& key = vertices[i];
+        const float* p = positions + 3 * key.position;
+        mesh->mVertices[i] = aiVector3D(p[0], p[1], p[2]);
+        mesh->mNormals[i] = aiVector3D(key.normal[0], key.normal[1], key.normal[2]);
+        if (hasTexCoords) {
+            if (key.texCoord != NoIndex) {
+                const float* t = attributes.texCoords.data() + 2 * key.texCoord;
+                mesh->mTextureCoords[0][i] = aiVector3D(t[0], t[1], 0.0f);
+            } else {
+                mesh->mTextureCoords[0][i] = aiVector3D(0.0f);
+            }
+        }
+        if (hasColors) {
+            const float* c = attributes.colors.data() + 3 * key.position;
+            mesh->mColors[0][i] = aiColor4D(c[0], c[1], c[2], 1.0f);
+        }
+    }
+
+    mesh->mNumFaces = unsigned(indices.size() / 3);
+    mesh->mFaces = new aiFace[mesh->mNumFaces];
+    for (std::size_t i = 0; i < mesh->mNumFaces; ++i) {
+        aiFace& face = mesh->mFaces[i];
+        face.mNumIndices = 3;
+        face.mIndices = new unsigned[3]{ indices[3 * i], indices[3 * i + 1], indices[3 * i + 2] };
+    }
+    return mesh;
+}
+
+template<typename T>
+void append(std::vector<T>& dst, const std::vector<T>& src)
+{
+    dst.insert(dst.end(), src.begin(), src.end());
+}
+} // namespace
+
+bool all::qt3d::ObjReader::canRead(const QString& path)
+{
+    return path.endsWith(QLatin1String(".obj"), Qt::CaseInsensitive);
+}
+
+all::qt3d::ObjReader::Result all::qt3d::ObjReader::read(const QString& path, const std::function<bool(float)>& progress)
+{
+    Result result;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return result;
+    const qint64 fileSize = file.size();
+    const char* data = fileSize > 0 ? reinterpret_cast<const char*>(file.map(0, fileSize)) : nullptr;
+    if (data == nullptr)
+        return result;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Line aligned chunks, a few per thread to balance the load
+    const qint64 maxChunkCount = std::max(1, QThread::idealThreadCount() * 4);
+    const qint64 chunkSize = std::max(MinChunkSize, (fileSize + maxChunkCount - 1) / maxChunkCount);
+    std::vector<Chunk> chunks;
+    for (const char* begin = data; begin < data + fileSize;) {
+        const char* end = begin + std::min(chunkSize, qint64(data + fileSize - begin));
+        if (end < data + fileSize) {
+            const char* newline = static_cast<const char*>(std::memchr(end, '\n', size_t(data + fileSize - end)));
+            end = newline ? newline + 1 : data + fileSize;
+        }
+        chunks.push_back({ begin, end });
+        begin = end;
+    }
+
+    std::vector<std::size_t> chunkIndices(chunks.size());
+    std::iota(chunkIndices.begin(), chunkIndices.end(), 0);
+
+    std::vector<AttributeCounts> counts(chunks.size());
+    QtConcurrent::blockingMap(chunkIndices, [&](std::size_t i) {
+        counts[i] = countAttributes(chunks[i]);
+    });
+
+    // Attributes declared before each chunk
+    std::vector<AttributeCounts> declared(chunks.size());
+    for (std::size_t i = 1; i < chunks.size(); ++i) {
+        declared[i].positions = declared[i - 1].positions + counts[i - 1].positions;
+        declared[i].texCoords = declared[i - 1].texCoords + counts[i - 1].texCoords;
+        declared[i].normals = declared[i - 1].normals + counts[i - 1].normals;
+    }
+
+    std::vector<ParsedChunk> parsedChunks(chunks.size());
+    std::atomic<std::size_t> parsedCount{ 0 };
+    std::atomic<bool> cancelled{ false };
+    std::mutex progressMutex;
+    QtConcurrent::blockingMap(chunkIndices, [&](std::size_t i) {
+        if (cancelled)
+            return;
+        parsedChunks[i] = parseChunk(chunks[i], declared[i]);
+
+        const std::size_t parsed = ++parsedCount;
+        if (progress) {
+            std::scoped_lock lock(progressMutex);
+            if (!progress(ParseProgressShare * float(parsed) / float(chunks.size())))
+                cancelled = true;
+        }
+    });
+    if (cancelled) {
+        result.cancelled = true;
+        return result;
+    }
+
+    Attributes attributes;
+    const bool hasColors = std::ranges::any_of(parsedChunks, [](const ParsedChunk& chunk) { return !chunk.colors.empty(); });
+    for (const ParsedChunk& chunk : parsedChunks) {
+        if (chunk.failed) {
+            qDebug() << "Unsupported OBJ content in" << path << ", falling back to assimp";
+            return result;
+        }
+        append(attributes.positions, chunk.positions);
+        append(attributes.texCoords, chunk.texCoords);
+        append(attributes.normals, chunk.normals);
+        if (hasColors) {
+            if (chunk.colors.empty())
+                attributes.colors.resize(attributes.colors.size() + chunk.positions.size(), 1.0f);
+            else
+                append(attributes.colors, chunk.colors);
+        }
+    }
+
+    // Materials from every library, in declaration order
+    std::vector<ObjMaterial> materials;
+    const QDir modelDir = QFileInfo(path).absoluteDir();
+    for (const ParsedChunk& chunk : parsedChunks) {
+        for (const std::string& library : chunk.materialLibraries)
+            readMaterialLibrary(modelDir.absoluteFilePath(QString::fromStdString(library)), materials);
+    }
+    std::unordered_map<std::string, uint32_t> materialIndices;
+    for (std::size_t i = 0; i < materials.size(); ++i)
+        materialIndices.try_emplace(materials[i].name, uint32_t(i));
+    std::optional<uint32_t> defaultMaterialIndex;
+
+    // Faces of each object and material, in order of appearance
+    const uint32_t positionCount = uint32_t(attributes.positions.size() / 3);
+    const uint32_t texCoordCount = uint32_t(attributes.texCoords.size() / 2);
+    const uint32_t normalCount = uint32_t(attributes.normals.size() / 3);
+    std::vector<MeshBuilder> builders;
+    std::vector<std::string> objectNames;
+    std::unordered_map<std::string, std::size_t> objectIndices;
+    std::vector<std::vector<unsigned>> objectMeshes;
+    std::map<std::pair<std::size_t, uint32_t>, std::size_t> builderOfKey;
+    std::string object = QFileInfo(path).completeBaseName().toStdString();
+    std::optional<std::string> material;
+    for (const ParsedChunk& chunk : parsedChunks) {
+        for (const FaceGroup& group : chunk.groups) {
+            if (group.object)
+                object = *group.object;
+            if (group.material)
+                material = *group.material;
+            if (group.vertices.empty())
+                continue;
+
+            for (const FaceVertex& v : group.vertices) {
+                if (v.position >= positionCount || (v.texCoord != NoIndex && v.texCoord >= texCoordCount) ||
+                    (v.normal != NoIndex && v.normal >= normalCount)) {
+                    qDebug() << "Invalid OBJ face index in" << path << ", falling back to assimp";
+                    return result;
+                }
+            }
+
+            uint32_t materialIndex = 0;
+            if (auto it = material ? materialIndices.find(*material) : materialIndices.end(); it != materialIndices.end()) {
+                materialIndex = it->second;
+            } else {
+                if (!defaultMaterialIndex) {
+                    defaultMaterialIndex = uint32_t(materials.size());
+                    materials.emplace_back().name = AI_DEFAULT_MATERIAL_NAME;
+                }
+                materialIndex = *defaultMaterialIndex;
+            }
+
+            auto [objectIt, newObject] = objectIndices.try_emplace(object, objectNames.size());
+            const std::size_t objectIndex = objectIt->second;
+            if (newObject) {
+                objectNames.push_back(object);
+                objectMeshes.emplace_back();
+            }
+
+            auto [it, inserted] = builderOfKey.try_emplace({ objectIndex, materialIndex }, builders.size());
+            if (inserted) {
+                builders.push_back({ object, materialIndex, {} });
+                objectMeshes[objectIndex].push_back(unsigned(it->second));
+            }
+            builders[it->second].faces.push_back(&group.vertices);
+        }
+    }
+
+    auto scene = std::make_unique<aiScene>();
+    scene->mNumMaterials = unsigned(materials.size());
+    scene->mMaterials = new aiMaterial*[materials.size()];
+    for (std::size_t i = 0; i < materials.size(); ++i)
+        scene->mMaterials[i] = toAiMaterial(materials[i]);
+
+    // Meshes are independent from each other, join their vertices across the thread pool
+    scene->mNumMeshes = unsigned(builders.size());
+    scene->mMeshes = new aiMesh*[builders.size()];
+    std::vector<std::size_t> builderIndices(builders.size());
+    std::iota(builderIndices.begin(), builderIndices.end(), 0);
+    std::atomic<std::size_t> builtCount{ 0 };
+    QtConcurrent::blockingMap(builderIndices, [&](std::size_t i) {
+        scene->mMeshes[i] = buildMesh(builders[i], attributes);
+
+        const std::size_t built = ++builtCount;
+        if (progress) {
+            std::scoped_lock lock(progressMutex);
+            progress(ParseProgressShare + (1.0f - ParseProgressShare) * float(built) / float(builders.size()));
+        }
+    });
+
+    scene->mRootNode = new aiNode(QFileInfo(path).fileName().toStdString());
+    scene->mRootNode->mNumChildren = unsigned(objectNames.size());
+    scene->mRootNode->mChildren = new aiNode*[objectNames.size()];
+    for (std::size_t i = 0; i < objectNames.size(); ++i) {
+        auto* node = new aiNode(objectNames[i]);
+        node->mParent = scene->mRootNode;
+        node->mNumMeshes = unsigned(objectMeshes[i].size());
+        node->mMeshes = new unsigned[objectMeshes[i].size()];
+        std::ranges::copy(objectMeshes[i], node->mMeshes);
+        scene->mRootNode->mChildren[i] = node;
+    }
+
+    qDebug() << "Read" << path << "with" << chunks.size() << "chunks into" << builders.size() << "meshes in" << timer.elapsed() << "ms";
+    result.scene = std::move(scene);
+    return result;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QString>
+
+#include <functional>
+#include <memory>
+
+struct aiScene;
+
+namespace all::qt3d {
+
+// Wavefront OBJ and MTL reader, used by MeshLoader in place of assimp's
+// single threaded one. The file is memory mapped and parsed in line aligned
+// chunks across the thread pool.
+//
+// The scene is laid out like the one assimp produces with the flags used by
+// MeshLoader: one mesh per object and material, triangulated, with identical
+// vertices joined and flat normals generated for faces without any.
+class ObjReader
+{
+public:
+    struct Result {
+        std::unique_ptr<aiScene> scene; // nullptr if the file couldn't be read
+        bool cancelled{ false };
+    };
+
+    static bool canRead(const QString& path);
+
+    // Called with the progress in [0, 1], returning false cancels the read.
+    // Might be called from several worker threads, but never concurrently.
+    // Files using features the reader doesn't support, like line
+    // continuations or free form geometry, fail so that assimp can take over.
+    static Result read(const QString& path, const std::function<bool(float)>& progress = {});
+};
+
+} // namespace all::qt3d
@@ -0,0 +1,561 @@
+#include "ply_reader.h"
+#include "reader_support.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+
+#include <assimp/scene.h>
+
+#include <atomic>
+#include <charconv>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace {
+constexpr std::size_t ChunkSize = 1 << 16;
+constexpr std::size_t MaxHeaderSize = 1 << 16;
+
+enum class ScalarType : uint8_t {
+    Invalid,
+    Int8,
+    UInt8,
+    Int16,
+    UInt16,
+    Int32,
+    UInt32,
+    Float32,
+    Float64
+};
+
+ScalarType scalarType(std::string_view name)
+{
+    if (name == "char" || name == "int8")
+        return ScalarType::Int8;
+    if (name == "uchar" || name == "uint8")
+        return ScalarType::UInt8;
+    if (name == "short" || name == "int16")
+        return ScalarType::Int16;
+    if (name == "ushort" || name == "uint16")
+        return ScalarType::UInt16;
+    if (name == "int" || name == "int32")
+        return ScalarType::Int32;
+    if (name == "uint" || name == "uint32")
+        return ScalarType::UInt32;
+    if (name == "float" || name == "float32")
+        return ScalarType::Float32;
+    if (name == "double" || name == "float64")
+        return ScalarType::Float64;
+    return ScalarType::Invalid;
+}
+
+std::size_t scalarSize(ScalarType type)
+{
+    switch (type) {
+    case ScalarType::Int8:
+    case ScalarType::UInt8:
+        return 1;
+    case ScalarType::Int16:
+    case ScalarType::UInt16:
+        return 2;
+    case ScalarType::Int32:
+    case ScalarType::UInt32:
+    case ScalarType::Float32:
+        return 4;
+    case ScalarType::Float64:
+        return 8;
+    case ScalarType::Invalid:
+        break;
+    }
+    return 0;
+}
+
+// Calls f.operator()<T, BigEndian>() with the C++ type of type, so that
+// whole columns get converted by a loop specialized for their type
+template<typename F>
+void dispatch(ScalarType type, bool bigEndian, F&& f)
+{
+    auto withEndianness = [&]<typename T>() {
+        if (bigEndian)
+            f.template operator()<T, true>();
+        else
+            f.template operator()<T, false>();
+    };
+    switch (type) {
+    case ScalarType::Int8:
+        return withEndianness.template operator()<qint8>();
+    case ScalarType::UInt8:
+        return withEndianness.template operator()<quint8>();
+    case ScalarType::Int16:
+        return withEndianness.template operator()<qint16>();
+    case ScalarType::UInt16:
+        return withEndianness.template operator()<quint16>();
+    case ScalarType::Int32:
+        return withEndianness.template operator()<qint32>();
+    case ScalarType::UInt32:
+        return withEndianness.template operator()<quint32>();
+    case ScalarType::Float32:
+        return withEndianness.template operator()<float>();
+    case ScalarType::Float64:
+        return withEndianness.template operator()<double>();
+    case ScalarType::Invalid:
+        break;
+    }
+}
+
+template<typename T, bool BigEndian>
+T load(const char* data)
+{
+    if constexpr (BigEndian)
+        return qFromBigEndian<T>(data);
+    else
+        return qFromLittleEndian<T>(data);
+}
+
+struct Property {
+    std::string name;
+    ScalarType type{ ScalarType::Invalid };
+    ScalarType countType{ ScalarType::Invalid }; // Set for lists only
+    std::size_t byteOffset{ 0 }; // From the start of the element, up to the first list
+};
+
+struct Element {
+    std::string name;
+    std::size_t count{ 0 };
+    std::vector<Property> properties;
+    bool hasLists{ false };
+    std::size_t fixedSize{ 0 }; // Byte size of each element without lists
+
+    const Property* property(std::string_view name) const
+    {
+        for (const Property& property : properties) {
+            if (property.name == name)
+                return property.countType == ScalarType::Invalid ? &property : nullptr;
+        }
+        return nullptr;
+    }
+};
+
+struct Header {
+    bool bigEndian{ false };
+    std::vector<Element> elements;
+    std::size_t size{ 0 }; // Up to the first element
+};
+
+std::vector<std::string_view> splitWords(std::string_view line)
+{
+    std::vector<std::string_view> words;
+    std::size_t begin = 0;
+    while (begin < line.size()) {
+        while (begin < line.size() && (line[begin] == ' ' || line[begin] == '\t' || line[begin] == '\r'))
+            ++begin;
+        std::size_t end = begin;
+        while (end < line.size() && line[end] != ' ' && line[end] != '\t' && line[end] != '\r')
+            ++end;
+        if (end > begin)
+            words.push_back(line.substr(begin, end - begin));
+        begin = end;
+    }
+    return words;
+}
+
+std::optional<Header> parseHeader(const char* data, std::size_t size)
+{
+    const std::string_view text(data, std::min(size, MaxHeaderSize));
+    if (!text.starts_with("ply"))
+        return std::nullopt;
+
+    Header header;
+    bool binary = false;
+    std::size_t lineBegin = 0;
+    while (lineBegin < text.size()) {
+        const std::size_t lineEnd = text.find('\n', lineBegin);
+        if (lineEnd == std::string_view::npos)
+            return std::nullopt;
+        const std::vector<std::string_view> words = splitWords(text.substr(lineBegin, lineEnd - lineBegin));
+        lineBegin = lineEnd + 1;
+        if (words.empty())
+            continue;
+
+        if (words[0] == "format" && words.size() >= 2) {
+            binary = words[1] == "binary_little_endian" || words[1] == "binary_big_endian";
+            header.bigEndian = words[1] == "binary_big_endian";
+        } else if (words[0] == "element" && words.size() == 3) {
+            Element& element = header.elements.emplace_back();
+            element.name = words[1];
+            if (std::from_chars(words[2].data(), words[2].data() + words[2].size(), element.count).ec != std::errc())
+                return std::nullopt;
+        } else if (words[0] == "property" && !header.elements.empty()) {
+            Element& element = header.elements.back();
+            Property property;
+            if (words.size() == 5 && words[1] == "list") {
+                property.countType = scalarType(words[2]);
+                property.type = scalarType(words[3]);
+                property.name = words[4];
+                if (property.countType == ScalarType::Invalid)
+                    return std::nullopt;
+            } else if (words.size() == 3) {
+                property.type = scalarType(words[1]);
+                property.name = words[2];
+            }
+            if (property.type == ScalarType::Invalid)
+                return std::nullopt;
+            property.byteOffset = element.fixedSize;
+            if (property.countType != ScalarType::Invalid)
+                element.hasLists = true;
+            else if (!element.hasLists)
+                element.fixedSize += scalarSize(property.type);
+            element.properties.push_back(std::move(property));
+        } else if (words[0] == "end_header") {
+            header.size = lineBegin;
+            if (!binary)
+                return std::nullopt;
+            return header;
+        }
+    }
+    return std::nullopt;
+}
+
+struct VertexData {
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> colors;
+    std::vector<float> texCoords;
+    std::size_t count{ 0 };
+};
+
+// Converts one scalar property of the vertices [begin, end) into dst, components floats apart
+void convertColumn(const char* vertices, const Element& element, const Property& property, bool bigEndian, bool normalized,
+                   std::size_t begin, std::size_t end, float* dst, std::size_t components)
+{
+    dispatch(property.type, bigEndian, [&]<typename T, bool BigEndian>() {
+        float scale = 1.0f;
+        if constexpr (std::is_integral_v<T>) {
+            if (normalized)
+                scale = 1.0f / float(std::numeric_limits<T>::max());
+        }
+        const char* src = vertices + property.byteOffset;
+        for (std::size_t i = begin; i < end; ++i)
+            dst[i * components] = float(load<T, BigEndian>(src + i * element.fixedSize)) * scale;
+    });
+}
+
+std::optional<VertexData> readVertices(const char* vertices, const Element& element, bool bigEndian)
+{
+    auto properties = [&element](std::initializer_list<std::string_view> names) {
+        std::vector<const Property*> found;
+        for (const std::string_view name : names) {
+            if (const Property* property = element.property(name))
+                found.push_back(property);
+        }
+        return found.size() == names.size() ? found : std::vector<const Property*>{};
+    };
+
+    const std::vector<const Property*> positions = properties({ "x", "y", "z" });
+    if (positions.empty())
+        return std::nullopt;
+    const std::vector<const Property*> normals = properties({ "nx", "ny", "nz" });
+    std::vector<const Property*> colors = properties({ "red", "green", "blue", "alpha" });
+    if (colors.empty())
+        colors = properties({ "red", "green", "blue" });
+    std::vector<const Property*> texCoords;
+    for (const auto& [u, v] : { std::pair("s", "t"), std::pair("u", "v"), std::pair("texture_u", "texture_v"), std::pair("texture_s", "texture_t") }) {
+        if (texCoords.empty())
+            texCoords = properties({ u, v });
+    }
+
+    VertexData data;
+    data.count = element.count;
+    data.positions.resize(data.count * 3);
+    if (!normals.empty())
+        data.normals.resize(data.count * 3);
+    if (!colors.empty())
+        data.colors.resize(data.count * 4, 1.0f);
+    if (!texCoords.empty())
+        data.texCoords.resize(data.count * 2);
+
+    // Integer colors are normalized, everything else is converted as is
+    struct Column {
+        const std::vector<const Property*>& properties;
+        std::vector<float>& dst;
+        std::size_t components;
+        bool normalized;
+    };
+    const Column columns[] = {
+        { positions, data.positions, 3, false },
+        { normals, data.normals, 3, false },
+        { colors, data.colors, 4, true },
+        { texCoords, data.texCoords, 2, false },
+    };
+
+    std::vector<std::size_t> chunks((data.count + ChunkSize - 1) / ChunkSize);
+    std::iota(chunks.begin(), chunks.end(), 0);
+    QtConcurrent::blockingMap(chunks, [&](std::size_t chunk) {
+        const std::size_t begin = chunk * ChunkSize;
+        const std::size_t end = std::min(data.count, begin + ChunkSize);
+        for (const Column& column : columns) {
+            for (std::size_t c = 0; c < column.properties.size(); ++c)
+                convertColumn(vertices, element, *column.properties[c], bigEndian, column.normalized, begin, end, column.dst.data() + c, column.components);
+        }
+    });
+
+    return data;
+}
+
+uint64_t loadCount(ScalarType type, bool bigEndian, const char* data)
+{
+    uint64_t count = 0;
+    dispatch(type, bigEndian, [&]<typename T, bool BigEndian>() {
+        if constexpr (std::is_integral_v<T>)
+            count = uint64_t(std::max<T>(load<T, BigEndian>(data), 0));
+    });
+    return count;
+}
+
+// Triangle list of the faces, polygons are fanned. Rows holding only
+// triangles are read in parallel, anything else in one pass.
+std::optional<std::vector<uint32_t>> readFaces(const char* faces, const char* end, const Element& element, bool bigEndian, std::size_t vertexCount)
+{
+    const Property* list = nullptr;
+    std::size_t suffixSize = 0;
+    for (const Property& property : element.properties) {
+        if (property.countType != ScalarType::Invalid) {
+            if (list != nullptr || (property.name != "vertex_indices" && property.name != "vertex_index"))
+                return std::nullopt;
+            list = &property;
+        } else if (list != nullptr) {
+            suffixSize += scalarSize(property.type);
+        }
+    }
+    if (list == nullptr || list->type == ScalarType::Float32 || list->type == ScalarType::Float64)
+        return std::nullopt;
+    // The triangle list is indexed with 32 bits, and each face is at least one triangle
+    if (element.count > std::numeric_limits<uint32_t>::max() / 3)
+        return std::nullopt;
+
+    const std::size_t prefixSize = list->byteOffset;
+    const std::size_t countSize = scalarSize(list->countType);
+    const std::size_t indexSize = scalarSize(list->type);
+    const std::size_t triangleSize = prefixSize + countSize + 3 * indexSize + suffixSize;
+
+    // A count of 3 as stored in the file
+    char three[sizeof(double)] = {};
+    dispatch(list->countType, bigEndian, [&]<typename T, bool BigEndian>() {
+        if constexpr (BigEndian)
+            qToBigEndian<T>(T(3), three);
+        else
+            qToLittleEndian<T>(T(3), three);
+    });
+
+    std::vector<uint32_t> indices;
+    std::atomic<bool> valid{ true };
+    if (element.count <= std::size_t(end - faces) / triangleSize) {
+        indices.resize(element.count * 3);
+        std::vector<std::size_t> chunks((element.count + ChunkSize - 1) / ChunkSize);
+        std::iota(chunks.begin(), chunks.end(), 0);
+        dispatch(list->type, bigEndian, [&]<typename T, bool BigEndian>() {
+            QtConcurrent::blockingMap(chunks, [&](std::size_t chunk) {
+                const std::size_t chunkEnd = std::min(element.count, (chunk + 1) * ChunkSize);
+                for (std::size_t i = chunk * ChunkSize; i < chunkEnd && valid; ++i) {
+                    const char* face = faces + i * triangleSize + prefixSize;
+                    if (std::memcmp(face, three, countSize) != 0) {
+                        valid = false;
+                        break;
+                    }
+                    for (std::size_t j = 0; j < 3; ++j) {
+                        const auto index = uint32_t(load<T, BigEndian>(face + countSize + j * indexSize));
+                        if (index >= vertexCount)
+                            valid = false;
+                        indices[3 * i + j] = index;
+                    }
+                }
+            });
+        });
+        if (valid)
+            return indices;
+    }
+
+    indices.clear();
+    valid = true;
+    dispatch(list->type, bigEndian, [&]<typename T, bool BigEndian>() {
+        const char* face = faces;
+        for (std::size_t i = 0; i < element.count && valid; ++i) {
+            if (face + prefixSize + countSize > end) {
+                valid = false;
+                break;
+            }
+            const uint64_t count = loadCount(list->countType, BigEndian, face + prefixSize);
+            const char* faceIndices = face + prefixSize + countSize;
+            if (count > uint64_t(end - faceIndices) / indexSize || uint64_t(end - faceIndices) - count * indexSize < suffixSize) {
+                valid = false;
+                break;
+            }
+            face = faceIndices + count * indexSize + suffixSize;
+            for (uint64_t j = 0; j < count; ++j) {
+                const auto index = uint32_t(load<T, BigEndian>(faceIndices + j * indexSize));
+                if (index >= vertexCount)
+                    valid = false;
+                if (j >= 2) {
+                    indices.push_back(uint32_t(load<T, BigEndian>(faceIndices)));
+                    indices.push_back(uint32_t(load<T, BigEndian>(faceIndices + (j - 1) * indexSize)));
+                    indices.push_back(index);
+                }
+            }
+        }
+    });
+    if (!valid)
+        return std::nullopt;
+    return indices;
+}
+} // namespace
+
+bool all::qt3d::PlyReader::canRead(const QString& path)
+{
+    return path.endsWith(QLatin1String(".ply"), Qt::CaseInsensitive);
+}
+
+all::qt3d::PlyReader::Result all::qt3d::PlyReader::read(const QString& path, const std::function<bool(float)>& progress)
+{
+    Result result;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return result;
+    const qint64 fileSize = file.size();
+    const char* data = fileSize > 0 ? reinterpret_cast<const char*>(file.map(0, fileSize)) : nullptr;
+    if (data == nullptr)
+        return result;
+    const char* dataEnd = data + fileSize;
+
+    const std::optional<Header> header = parseHeader(data, std::size_t(fileSize));
+    if (!header) {
+        qDebug() << "Not a binary PLY file" << path << ", falling back to assimp";
+        return result;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Elements before the faces have to be skipped, which needs them to have a fixed size
+    const Element* vertexElement = nullptr;
+    const Element* faceElement = nullptr;
+    const char* vertices = nullptr;
+    const char* faces = nullptr;
+    const char* element = data + header->size;
+    for (const Element& e : header->elements) {
+        if (e.name == "face") {
+            faceElement = &e;
+            faces = element;
+            break;
+        }
+        if (e.hasLists || (e.fixedSize > 0 && e.count > std::size_t(dataEnd - element) / e.fixedSize))
+            break;
+        if (e.name == "vertex") {
+            vertexElement = &e;
+            vertices = element;
+        }
+        element += e.count * e.fixedSize;
+    }
+    if (!vertexElement || !faceElement || vertexElement->count == 0 || vertexElement->count > std::numeric_limits<uint32_t>::max()) {
+        qDebug() << "Unsupported PLY layout in" << path << ", falling back to assimp";
+        return result;
+    }
+
+    const std::optional<VertexData> vertexData = readVertices(vertices, *vertexElement, header->bigEndian);
+    if (!vertexData) {
+        qDebug() << "PLY file without positions" << path << ", falling back to assimp";
+        return result;
+    }
+    if (progress && !progress(0.3f)) {
+        result.cancelled = true;
+        return result;
+    }
+
+    const std::optional<std::vector<uint32_t>> indices = readFaces(faces, dataEnd, *faceElement, header->bigEndian, vertexData->count);
+    if (!indices || indices->empty() || indices->size() > std::numeric_limits<uint32_t>::max()) {
+        qDebug() << "Unsupported PLY faces in" << path << ", falling back to assimp";
+        return result;
+    }
+    if (progress && !progress(0.5f)) {
+        result.cancelled = true;
+        return result;
+    }
+
+    auto* mesh = new aiMesh;
+    mesh->mName = aiString(QFileInfo(path).completeBaseName().toStdString());
+
+    // Faces without normals get flat ones, splitting the vertices they share with differently oriented faces
+    std::vector<uint32_t> sourceVertices;
+    std::vector<float> normals;
+    std::vector<uint32_t> meshIndices;
+    if (vertexData->normals.empty()) {
+        const float* positions = vertexData->positions.data();
+        auto cornerAt = [&](std::size_t corner) {
+            const uint32_t* triangle = indices->data() + corner - corner % 3;
+            reader_support::TriangleCorner triangleCorner;
+            triangleCorner.vertex = (*indices)[corner];
+            std::memcpy(triangleCorner.position, positions + 3 * triangleCorner.vertex, sizeof(triangleCorner.position));
+            reader_support::faceNormal(positions + 3 * triangle[0], positions + 3 * triangle[1], positions + 3 * triangle[2], triangleCorner.normal);
+            return triangleCorner;
+        };
+        reader_support::WeldResult weld = reader_support::weldCorners(indices->size(), cornerAt);
+        sourceVertices.resize(weld.vertexCorners.size());
+        normals.resize(weld.vertexCorners.size() * 3);
+        QtConcurrent::blockingMap(weld.vertexCorners, [&](const uint32_t& corner) {
+            const std::size_t i = &corner - weld.vertexCorners.data();
+            const reader_support::TriangleCorner vertex = cornerAt(corner);
+            sourceVertices[i] = vertex.vertex;
+            std::memcpy(normals.data() + 3 * i, vertex.normal, sizeof(vertex.normal));
+        });
+        meshIndices = std::move(weld.indices);
+    } else {
+        sourceVertices.resize(vertexData->count);
+        std::iota(sourceVertices.begin(), sourceVertices.end(), 0);
+        normals = vertexData->normals;
+        meshIndices = *indices;
+    }
+    if (progress && !progress(0.8f)) {
+        delete mesh;
+        result.cancelled = true;
+        return result;
+    }
+
+    mesh->mNumVertices = unsigned(sourceVertices.size());
+    mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+    mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+    if (!vertexData->texCoords.empty()) {
+        mesh->mTextureCoords[0] = new aiVector3D[mesh->mNumVertices];
+        mesh->mNumUVComponents[0] = 2;
+    }
+    if (!vertexData->colors.empty())
+        mesh->mColors[0] = new aiColor4D[mesh->mNumVertices];
+    QtConcurrent::blockingMap(sourceVertices, [&](const uint32_t& vertex) {
+        const std::size_t i = &vertex - sourceVertices.data();
+        const float* p = vertexData->positions.data() + 3 * vertex;
+        mesh->mVertices[i] = aiVector3D(p[0], p[1], p[2]);
+        mesh->mNormals[i] = aiVector3D(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2]);
+        if (mesh->mTextureCoords[0]) {
+            const float* t = vertexData->texCoords.data() + 2 * vertex;
+            mesh->mTextureCoords[0][i] = aiVector3D(t[0], t[1], 0.0f);
+        }
+        if (mesh->mColors[0]) {
+            const float* c = vertexData->colors.data() + 4 * vertex;
+            mesh->mColors[0][i] = aiColor4D(c[0], c[1], c[2], c[3]);
+        }
+    });
+    reader_support::setTriangles(mesh, meshIndices);
+
+    if (progress)
+        progress(1.0f);
+
+    qDebug() << "Read" << path << "with" << vertexData->count << "vertices and" << meshIndices.size() / 3 << "triangles into"
+             << mesh->mNumVertices << "vertices in" << timer.elapsed() << "ms";
+    result.scene = reader_support::singleMeshScene(mesh, path);
+    return result;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <QString>
+
+#include <functional>
+#include <memory>
+
+struct aiScene;
+
+namespace all::qt3d {
+
+// Binary PLY reader, used by MeshLoader in place of assimp's. The file is
+// memory mapped and each vertex property is converted in one typed loop over
+// all the vertices, across the thread pool.
+//
+// The scene is laid out like the one assimp produces with the flags used by
+// MeshLoader: a single triangulated mesh. Meshes without normals get flat
+// ones, with identical vertices joined.
+class PlyReader
+{
+public:
+    struct Result {
+        std::unique_ptr<aiScene> scene; // nullptr if the file couldn't be read
+        bool cancelled{ false };
+    };
+
+    static bool canRead(const QString& path);
+
+    // Called with the progress in [0, 1], returning false cancels the read.
+    // ASCII files fail so that assimp can take over.
+    static Result read(const QString& path, const std::function<bool(float)>& progress = {});
+};
+
+} // namespace all::qt3d
@@ -14,9 +14,25 @@
 
 using namespace all::qt3d;
 
-all::qt3d::GlossyMaterial::GlossyMaterial(const all::qt3d::shader_textures& textures, const all::qt3d::shader_uniforms& uniforms, Qt3DCore::QNode* parent)
+namespace {
+// Inserts a #define right after the #version line of code
+QByteArray withDefine(std::string_view code, const char* define)
+{
+    QByteArray source(code.data(), qsizetype(code.size()));
+    const qsizetype versionLine = source.indexOf("#version");
+    const qsizetype insertAt = versionLine < 0 ? 0 : source.indexOf('\n', versionLine) + 1;
+    source.insert(insertAt, QByteArray("#define ") + define + '\n');
+    return source;
+}
+} // namespace
+
+all::qt3d::GlossyMaterial::GlossyMaterial(const all::qt3d::shader_textures& textures, const all::qt3d::shader_uniforms& uniforms, bool octahedralNormals, Qt3DCore::QNode* parent)
     : Qt3DRender::QMaterial(parent)
 {
+    auto vertexShaderCode = [octahedralNormals](std::string_view code) {
+        return octahedralNormals ? withDefine(code, "OCTAHEDRAL_NORMALS") : QByteArray(code.data(), qsizetype(code.size()));
+    };
+
     auto make_uniform = [this](QString name, const QVariant& val) {
         auto p = new Qt3DRender::QParameter(name, val, this);
         addParameter(p);
@@ -42,7 +58,7 @@ all::qt3d::GlossyMaterial::GlossyMaterial(const all::qt3d::shader_textures& text
     // GL 3.2
     {
         auto* shader = new Qt3DRender::QShaderProgram();
-        shader->setVertexShaderCode(all::qt3d::fresnel_vs.data());
+        shader->setVertexShaderCode(vertexShaderCode(all::qt3d::fresnel_vs));
         shader->setFragmentShaderCode(all::qt3d::fresnel_ps.data());
 
         auto* rp = new Qt3DRender::QRenderPass();
@@ -60,7 +76,7 @@ all::qt3d::GlossyMaterial::GlossyMaterial(const all::qt3d::shader_textures& text
     // RHI
     {
         auto* shader = new Qt3DRender::QShaderProgram();
-        shader->setVertexShaderCode(all::qt3d::fresnel_vs_rhi.data());
+        shader->setVertexShaderCode(vertexShaderCode(all::qt3d::fresnel_vs_rhi));
         shader->setFragmentShaderCode(all::qt3d::fresnel_frag_rhi.data());
 
         auto* rp = new Qt3DRender::QRenderPass();
@@ -9,7 +9,8 @@ class GlossyMaterial : public Qt3DRender::QMaterial
 {
     Q_OBJECT
 public:
-    explicit GlossyMaterial(const all::qt3d::shader_textures& textures, const all::qt3d::shader_uniforms& uniforms, Qt3DCore::QNode* parent = nullptr);
+    // octahedralNormals selects the shader variant decoding SceneMesh::VertexFlag::OctahedralNormals
+    explicit GlossyMaterial(const all::qt3d::shader_textures& textures, const all::qt3d::shader_uniforms& uniforms, bool octahedralNormals = false, Qt3DCore::QNode* parent = nullptr);
 };
 
 class SkyboxMaterial : public Qt3DRender::QMaterial
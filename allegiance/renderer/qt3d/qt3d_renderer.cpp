@@ -4,6 +4,7 @@
 #include "qt3d_focusarea.h"
 #include "focus_plane_preview.h"
 #include "mesh_loader.h"
+#include "async_mesh_loader.h"
 #include "stereo_image_material.h"
 #include "stereo_image_mesh.h"
 #include "stereo_proxy_camera.h"
@@ -23,9 +24,11 @@
 #include <Qt3DRender/QRayCaster>
 #include <Qt3DRender/QCameraLens>
 #include <Qt3DRender/QCamera>
+#include <Qt3DRender/QLevelOfDetail>
 #include <Qt3DCore/QTransform>
 #include <Qt3DExtras/QDiffuseMapMaterial>
 #include <Qt3DExtras/QPhongMaterial>
+#include <shared/bvh.h>
 #include <shared/cursor.h>
 #include <QFileInfo>
 #include <QImageReader>
@@ -50,6 +53,8 @@ Qt3DRenderer::~Qt3DRenderer()
 
 void Qt3DRenderer::viewChanged()
 {
+    m_viewChangeTimer.start();
+
     const float flippedCorrection = m_stereoCamera->flipped() ? -1.0f : 1.0f;
     const float interocularDistance = flippedCorrection * m_stereoCamera->interocularDistance();
 
@@ -101,6 +106,8 @@ void Qt3DRenderer::viewChanged()
 
 void Qt3DRenderer::projectionChanged()
 {
+    m_viewChangeTimer.start();
+
     const float flippedCorrection = m_stereoCamera->flipped() ? -1.0f : 1.0f;
     const float interocularDistance = flippedCorrection * m_stereoCamera->interocularDistance();
 
@@ -199,6 +206,23 @@ void Qt3DRenderer::createScene(Qt3DCore::QEntity* root)
     m_cursor->addComponent(m_renderer->cursorLayer());
     m_cursor->setType(CursorType::Ball);
 
+    m_meshLoader = new AsyncMeshLoader(this);
+    QObject::connect(m_meshLoader, &AsyncMeshLoader::progressChanged, this, [this](float progress) {
+        m_propertyUpdateNofitier("model_load_progress", progress);
+    });
+    QObject::connect(m_meshLoader, &AsyncMeshLoader::loaded, this, [this](const QString&, const std::shared_ptr<ModelData>& model) {
+        setModel(model);
+        m_propertyUpdateNofitier("model_loading", false);
+    });
+    QObject::connect(m_meshLoader, &AsyncMeshLoader::failed, this, [this](const QString& path) {
+        qDebug() << "Failed to load model:" << path;
+        m_propertyUpdateNofitier("model_loading", false);
+    });
+    QObject::connect(m_meshLoader, &AsyncMeshLoader::cancelled, this, [this](const QString& path) {
+        qDebug() << "Cancelled loading model:" << path;
+        m_propertyUpdateNofitier("model_loading", false);
+    });
+
     m_cursorRaycaster = new Qt3DRender::QScreenRayCaster{ m_sceneEntity };
     m_cursorRaycaster->setRunMode(Qt3DRender::QAbstractRayCaster::SingleShot);
     m_cursorRaycaster->setFilterMode(Qt3DRender::QScreenRayCaster::DiscardAnyMatchingLayers);
@@ -209,9 +233,13 @@ void Qt3DRenderer::createScene(Qt3DCore::QEntity* root)
     m_cursorRaycaster->addLayer(m_renderer->cursorLayer());
     m_cursorRaycaster->addLayer(m_renderer->focusAreaLayer());
     m_cursorRaycaster->addLayer(m_renderer->focusPlaneLayer());
+    m_cursorRaycaster->addLayer(m_renderer->depthReadbackLayer());
     m_sceneEntity->addComponent(m_cursorRaycaster);
     QObject::connect(m_cursorRaycaster, &Qt3DRender::QScreenRayCaster::hitsChanged, this, &Qt3DRenderer::cursorHitResult);
 
+    m_depthReadback = new DepthReadback(m_renderer, m_camera->centerCamera(), m_view, m_rootEntity.get());
+    QObject::connect(m_depthReadback, &DepthReadback::regionRead, this, &Qt3DRenderer::depthRegionRead);
+
     // Frustums
     {
         m_frustumRect = new FrustumRect(root);
@@ -305,10 +333,19 @@ void Qt3DRenderer::onMouseEvent(::QMouseEvent* event)
         break;
     case QEvent::MouseMove: {
         m_focusArea->onMouseMoved(event);
-        // Note: ScreenRayCaster takes care of Qt -> OpenGL Y coordinate conversion
         if (!m_cursor->locked()) {
             const QPoint cursorPos = m_view->mapFromGlobal(m_view->cursor().pos());
-            m_cursorRaycaster->trigger(cursorPos);
+            // Note: ScreenRayCaster takes care of Qt -> OpenGL Y coordinate conversion
+            if (m_sceneBvh && m_renderer->mode() == QStereoForwardRenderer::Mode::Scene) {
+                pickCursorPosition(cursorPos);
+            } else if (m_depthReadbackEnabled) {
+                m_depthReadback->request(DepthReadback::Purpose::Cursor,
+                                         QRectF(cursorPos.x() - CursorReadbackRadius, cursorPos.y() - CursorReadbackRadius,
+                                                2 * CursorReadbackRadius + 1, 2 * CursorReadbackRadius + 1));
+            } else {
+                m_cursorRayCastTimer.start();
+                m_cursorRaycaster->trigger(cursorPos);
+            }
         }
         break;
     }
@@ -352,6 +389,24 @@ void Qt3DRenderer::propertyChanged(std::string_view name, std::any value)
     } else if (name == "cursor_locked") {
         m_cursor->setLocked(std::any_cast<bool>(value));
         return;
+    } else if (name == "compact_vertex_formats") {
+        // Applies to the next model load
+        m_compactVertexFormats = std::any_cast<bool>(value);
+    } else if (name == "import_profile") {
+        // Applies to the next model load
+        m_importProfile = std::any_cast<ImportProfile>(value);
+    } else if (name == "memory_lean") {
+        // Applies to the next model load
+        m_memoryLean = std::any_cast<bool>(value);
+    } else if (name == "auto_focus_sampling") {
+        m_focusSampling = std::any_cast<all::FocusSampling>(value);
+        requestFocusForFocusArea();
+    } else if (name == "depth_readback") {
+        m_depthReadbackEnabled = std::any_cast<bool>(value);
+        if (!m_depthReadbackEnabled) {
+            m_depthReadback->cancel(DepthReadback::Purpose::Cursor);
+            m_depthReadback->cancel(DepthReadback::Purpose::FocusArea);
+        }
     }
 }
 
@@ -426,31 +481,61 @@ void Qt3DRenderer::loadImage(QUrl path)
 
 void Qt3DRenderer::loadModel(std::filesystem::path path)
 {
+    // The current model remains displayed until the new one has been imported
+    m_propertyUpdateNofitier("model_loading", true);
+    ImportOptions options = ImportOptions::forProfile(m_importProfile);
+    if (m_compactVertexFormats || m_memoryLean)
+        options.quantization = ImportOptions::compact().quantization;
+    options.memoryLean = m_memoryLean;
+    m_meshLoader->load(QString::fromStdString(path.string()), options);
+}
+
+void Qt3DRenderer::cancelModelLoad()
+{
+    m_meshLoader->cancel();
+}
+
+void Qt3DRenderer::setModel(const std::shared_ptr<ModelData>& model)
+{
+    auto* sceneRoot = MeshLoader::createEntities(*model);
+
     delete m_userEntity;
     m_userEntity = new Qt3DCore::QEntity{ m_sceneEntity };
     m_userEntity->setObjectName("UserEntity");
 
-    QString filePath = QString::fromStdString(path.string());
-    bool isFbx = filePath.endsWith(".fbx");
-
-    auto* sceneRoot = MeshLoader::load(filePath);
-    if (sceneRoot == nullptr) {
-        qDebug() << "Failed to load model:" << filePath;
-        return;
-    }
     sceneRoot->setParent(m_userEntity);
 
-    // Give Qt3D Time to process mesh extents
-    auto* frameAction = new Qt3DLogic::QFrameAction;
-    QObject::connect(frameAction, &Qt3DLogic::QFrameAction::triggered, m_userEntity, [this, frameAction] {
-        setupCameraBasedOnSceneExtent();
-        frameAction->deleteLater();
-    });
-    m_userEntity->addComponent(frameAction);
+    // Levels of detail follow the center camera, so that both eyes draw the same ones
+    for (auto* levelOfDetail : sceneRoot->findChildren<Qt3DRender::QLevelOfDetail*>())
+        levelOfDetail->setCamera(m_camera->centerCamera());
+
+    // Bounds come from the import, no need to wait for Qt3D to compute them
+    m_sceneBounds = model->bounds;
+    m_sceneBvh = model->bvh;
+    m_model = model;
+    m_nav_params->hit_test = [bvh = m_sceneBvh](glm::vec3 origin, glm::vec3 direction, float spread) -> std::optional<glm::vec3> {
+        // Asked for every frame while the SpaceMouse moves, the closest hit found within the budget makes a good enough pivot
+        constexpr std::chrono::microseconds HitTestBudget{ 250 };
+        if (!bvh)
+            return std::nullopt;
+        const auto hit = bvh->closestHit(all::Beam{ { origin, direction }, 0.0f, spread }, std::numeric_limits<float>::max(), HitTestBudget);
+        return hit ? std::optional{ hit->position } : std::nullopt;
+    };
+    setupCameraBasedOnSceneExtent();
 
     // For AutoFocus Intersection Testing
     for (auto* rayCaster : m_afRayCasters)
         m_userEntity->addComponent(rayCaster);
+
+    // What stays resident once the import data is gone, the entities share the model buffers
+    const ModelMemory memory = model->memory();
+    auto mib = [](qsizetype bytes) {
+        return QString::number(double(bytes) / (1024.0 * 1024.0), 'f', 1);
+    };
+    const QString summary = QStringLiteral("CPU memory: %1 MiB\nvertices %2, indices %3, picking %4, source %5 MiB")
+                                    .arg(mib(memory.totalBytes()), mib(memory.vertexBytes), mib(memory.indexBytes),
+                                         mib(memory.pickingBytes), mib(memory.sourceBytes));
+    m_propertyUpdateNofitier("model_memory", summary.toStdString());
 }
 
 void Qt3DRenderer::viewAll()
@@ -473,97 +558,6 @@ bool Qt3DRenderer::hoversFocusArea(int x, int y) const
     return m_focusArea->containsMouse();
 }
 
-Qt3DRenderer::SceneExtent Qt3DRenderer::calculateSceneExtent(Qt3DCore::QEntity* entity) const
-{
-    SceneExtent e;
-    _calculateSceneDimensions(entity, e.min, e.max);
-    return e;
-}
-
-void Qt3DRenderer::_calculateSceneDimensions(Qt3DCore::QEntity* entity, QVector3D& minBounds, QVector3D& maxBounds) const
-{
-    if (entity == nullptr)
-        return;
-
-    for (Qt3DCore::QNode* childNode : entity->childNodes()) {
-        auto* childEntity = qobject_cast<Qt3DCore::QEntity*>(childNode);
-        if (childEntity != nullptr)
-            _calculateSceneDimensions(childEntity, minBounds, maxBounds);
-    }
-
-    // Check if the entity has a geometry renderer
-    auto geometryRenderers = entity->componentsOfType<Qt3DRender::QGeometryRenderer>();
-    auto materials = entity->componentsOfType<Qt3DRender::QMaterial>();
-    if (geometryRenderers.size() > 0) {
-        Qt3DRender::QGeometryRenderer* geometryRenderer = geometryRenderers.first();
-        Qt3DCore::QGeometry* geometry = geometryRenderer->geometry();
-
-        if (geometry == nullptr)
-            return;
-
-        // Skip the Skybox
-        if (materials.size() > 0) {
-            if (qobject_cast<SkyboxMaterial*>(materials.front()) != nullptr)
-                return;
-        }
-
-        const QVector3D& bvMin = geometry->minExtent();
-        const QVector3D& bvMax = geometry->maxExtent();
-
-        const QVector3D diagonal = bvMax - bvMin;
-
-        // Local Coordinates
-        const QVector3D sphereCenter = bvMin + diagonal * 0.5f;
-        const float radius = diagonal.length();
-
-        std::function<Qt3DCore::QTransform*(Qt3DCore::QEntity * e)> findNearestParentTransform = [&](Qt3DCore::QEntity* e) -> Qt3DCore::QTransform* {
-            if (e == nullptr)
-                return nullptr;
-            auto transforms = e->componentsOfType<Qt3DCore::QTransform>();
-            if (transforms.size() == 0)
-                return findNearestParentTransform(e->parentEntity());
-            return transforms.first();
-        };
-
-        Qt3DCore::QTransform* transform = findNearestParentTransform(entity);
-        if (transform != nullptr) {
-
-            const QMatrix4x4 worldMatrix = transform->worldMatrix();
-            // Transform extremities in x, y, and z directions to find extremities
-            // of the resulting ellipsoid
-            const QVector3D x = worldMatrix.map(sphereCenter + QVector3D(radius, 0.0f, 0.0f));
-            const QVector3D y = worldMatrix.map(sphereCenter + QVector3D(0.0f, radius, 0.0f));
-            const QVector3D z = worldMatrix.map(sphereCenter + QVector3D(0.0f, 0.0f, radius));
-
-            // Transform center and find maximum radius of ellipsoid
-            const QVector3D worldCenter = worldMatrix.map(sphereCenter);
-            const float worldRadius = sqrt(qMax(qMax((x - worldCenter).lengthSquared(),
-                                                     (y - worldCenter).lengthSquared()),
-                                                (z - worldCenter).lengthSquared()));
-
-            const QVector3D worldBVMax = worldCenter + QVector3D(worldRadius, worldRadius, worldRadius) * 1.44f;
-            const QVector3D worldBVMin = worldCenter - QVector3D(worldRadius, worldRadius, worldRadius) * 1.44f;
-
-            maxBounds = QVector3D(std::max(worldBVMax.x(), maxBounds.x()),
-                                  std::max(worldBVMax.y(), maxBounds.y()),
-                                  std::max(worldBVMax.z(), maxBounds.z()));
-
-            minBounds = QVector3D(std::min(worldBVMin.x(), minBounds.x()),
-                                  std::min(worldBVMin.y(), minBounds.y()),
-                                  std::min(worldBVMin.z(), minBounds.z()));
-        } else {
-
-            maxBounds = QVector3D(std::max(bvMax.x(), maxBounds.x()),
-                                  std::max(bvMax.y(), maxBounds.y()),
-                                  std::max(bvMax.z(), maxBounds.z()));
-
-            minBounds = QVector3D(std::min(bvMin.x(), minBounds.x()),
-                                  std::min(bvMin.y(), minBounds.y()),
-                                  std::min(bvMin.z(), minBounds.z()));
-        }
-    }
-}
-
 void Qt3DRenderer::modelExtentChanged(const QVector3D& min, const QVector3D& max)
 {
     if (!m_nav_params)
@@ -575,12 +569,13 @@ void Qt3DRenderer::modelExtentChanged(const QVector3D& min, const QVector3D& max
 
 void Qt3DRenderer::setupCameraBasedOnSceneExtent()
 {
-    const SceneExtent ext = calculateSceneExtent(m_userEntity);
-    m_nav_params->min_extent = toGlmVec3(ext.min);
-    m_nav_params->max_extent = toGlmVec3(ext.max);
+    const glm::vec3 min = m_sceneBounds.isValid() ? m_sceneBounds.min : glm::vec3(0.0f);
+    const glm::vec3 max = m_sceneBounds.isValid() ? m_sceneBounds.max : glm::vec3(0.0f);
+    m_nav_params->min_extent = min;
+    m_nav_params->max_extent = max;
 
-    m_sceneCenter = (ext.max + ext.min) * 0.5f;
-    m_sceneExtent = ext.max - ext.min;
+    m_sceneCenter = toQVector3D((max + min) * 0.5f);
+    m_sceneExtent = toQVector3D(max - min);
 
     m_propertyUpdateNofitier("scene_loaded", {});
 }
@@ -604,6 +599,31 @@ void Qt3DRenderer::handleFocusForFocusArea()
     const QVector3D center = m_focusArea->center();
     const QVector3D extent = m_focusArea->extent();
 
+    // Traced right away on the model hierarchy, in packets over the whole sampling grid,
+    // while the view moves and the depth drawn a frame or two ago would lag behind
+    if (m_sceneBvh && m_renderer->mode() == QStereoForwardRenderer::Mode::Scene && (!m_depthReadbackEnabled || viewMoving())) {
+        m_depthReadback->cancel(DepthReadback::Purpose::FocusArea);
+        const Qt3DRender::QCamera* camera = m_camera->centerCamera();
+        const QMatrix4x4 inverseViewProjection = (camera->projectionMatrix() * camera->viewMatrix()).inverted();
+        auto toNdc = [this](float x, float y) {
+            return glm::vec2(2.0f * x / float(m_view->width()) - 1.0f, 1.0f - 2.0f * y / float(m_view->height()));
+        };
+        updateAutoFocus(all::traceFocus(*m_sceneBvh, m_focusSampling, toGlmMat4x4(inverseViewProjection),
+                                        toNdc(center.x() - extent.x() * 0.5f, center.y() - extent.y() * 0.5f),
+                                        toNdc(center.x() + extent.x() * 0.5f, center.y() + extent.y() * 0.5f),
+                                        toGlmVec3(camera->position())));
+        return;
+    }
+
+    // Otherwise the GPU gives the depth under the area, the CPU only samples it
+    if (m_depthReadbackEnabled) {
+        // One more pixel, so that the samples on the right and bottom edges fall inside
+        m_depthReadback->request(DepthReadback::Purpose::FocusArea,
+                                 QRectF(center.x() - extent.x() * 0.5f, center.y() - extent.y() * 0.5f, extent.x() + 1.0f, extent.y() + 1.0f));
+        return;
+    }
+
+    m_afRayCastTimer.start();
     const float xStep = extent.x() / (AFSamplesX - 1);
     const float yStep = extent.y() / (AFSamplesY - 1);
 
@@ -644,62 +664,137 @@ void Qt3DRenderer::afRaycasterHitResult(size_t idx, const Qt3DRender::QAbstractR
     if (!m_afResultUpdateRequested) {
         m_afResultUpdateRequested = true;
 
-        // Average all hits
         QTimer::singleShot(0, [this] {
+            QElapsedTimer cpuTimer;
+            cpuTimer.start();
             m_afResultUpdateRequested = false;
-            float averagedDistanceFromCamera = 0.0f;
-            size_t validHits = 0;
-
-            for (float hitDistance : m_lastAfHitDistances) {
-                if (hitDistance > 0) {
-                    averagedDistanceFromCamera += hitDistance;
-                    ++validHits;
-                }
-            }
-
-            if (validHits > 0) {
-                averagedDistanceFromCamera /= float(validHits);
-                // Notify Controllers our AF Distance is updated
-                m_propertyUpdateNofitier("auto_focus_distance", averagedDistanceFromCamera);
+            std::vector<all::FocusSample> samples(AFSamples);
+            for (size_t i = 0; i < AFSamples; ++i) {
+                if (m_lastAfHitDistances[i] > 0)
+                    samples[i].distance = m_lastAfHitDistances[i];
             }
+            updateAutoFocus(all::estimateFocus(m_focusSampling, samples));
+            m_afRayCastStatistics.add(m_afRayCastTimer.nsecsElapsed(), cpuTimer.nsecsElapsed());
         });
     }
 }
 
+void Qt3DRenderer::updateAutoFocus(const std::optional<all::FocusEstimate>& estimate)
+{
+    // The focus stays put while the area mostly covers the background or objects far apart
+    if (!estimate || estimate->confidence < m_focusSampling.minConfidence)
+        return;
+    // Notify Controllers our AF Distance is updated
+    m_propertyUpdateNofitier("auto_focus_distance", estimate->distance);
+}
+
 void Qt3DRenderer::cursorHitResult(const Qt3DRender::QAbstractRayCaster::Hits& hits)
 {
+    QElapsedTimer cpuTimer;
+    cpuTimer.start();
+
     auto nearestHitIterator = std::ranges::min_element(hits, {}, &Qt3DRender::QRayCasterHit::distance);
 
-    if (nearestHitIterator == hits.end()) {
-        auto cursorPos = m_view->mapFromGlobal(m_view->cursor().pos());
-
-        const QVector3D viewCenter = m_camera->centerCamera()->position() + m_camera->centerCamera()->viewVector().normalized() * m_stereoCamera->convergencePlaneDistance();
-        const QVector4D viewCenterScreen = m_camera->centerCamera()->projectionMatrix() * m_camera->centerCamera()->viewMatrix() * QVector4D(viewCenter, 1.0f);
-        const float zFocus = viewCenterScreen.z() / viewCenterScreen.w();
-        const QVector3D cursorScreenPos(cursorPos.x(), m_view->height() - cursorPos.y(), zFocus);
-
-        auto unprojectZO = [](const QVector3D& p, const QMatrix4x4& viewMatrix, const QMatrix4x4& projectionMatrix, const QRect& viewport) {
-            const QMatrix4x4 inverse = QMatrix4x4(projectionMatrix * viewMatrix).inverted();
-            QVector4D tmp(p, 1.0f);
-            tmp.setX((tmp.x() - float(viewport.x())) / float(viewport.width()));
-            tmp.setY((tmp.y() - float(viewport.y())) / float(viewport.height()));
-            tmp.setX(tmp.x() * 2.0f - 1.0f);
-            tmp.setY(tmp.y() * 2.0f - 1.0f);
-            QVector4D obj = inverse * tmp;
-            if (qFuzzyIsNull(obj.w()))
-                obj.setW(1.0f);
-            obj /= obj.w();
-            return obj.toVector3D();
-        };
+    if (nearestHitIterator == hits.end())
+        placeCursorOnFocusPlane(m_view->mapFromGlobal(m_view->cursor().pos()));
+    else
+        m_cursor->setPosition(nearestHitIterator->worldIntersection());
 
-        const QVector3D unv = unprojectZO(cursorScreenPos,
-                                          m_camera->centerCamera()->viewMatrix(),
-                                          m_camera->centerCamera()->projectionMatrix(),
-                                          QRect{ 0, 0, m_view->width(), m_view->height() });
-        m_cursor->setPosition(unv);
-        return;
+    // Only the handling shows here, the casting itself runs in the Qt3D jobs
+    m_cursorRayCastStatistics.add(m_cursorRayCastTimer.nsecsElapsed(), cpuTimer.nsecsElapsed());
+}
+
+void Qt3DRenderer::depthRegionRead(DepthReadback::Purpose purpose, const DepthReadback::Region& region)
+{
+    // Sampled through the middle of the pixels of the region, in window coordinates
+    const QPointF firstPixel = (QPointF(region.rect.topLeft()) + QPointF(0.5, 0.5)) / region.devicePixelRatio;
+    const QPointF lastPixel = (QPointF(region.rect.bottomRight()) + QPointF(0.5, 0.5)) / region.devicePixelRatio;
+
+    switch (purpose) {
+    case DepthReadback::Purpose::Cursor:
+        if (const auto position = region.closestWorldPosition((firstPixel + lastPixel) * 0.5))
+            m_cursor->setPosition(*position);
+        else
+            placeCursorOnFocusPlane(m_view->mapFromGlobal(m_view->cursor().pos()));
+        break;
+    case DepthReadback::Purpose::FocusArea: {
+        std::vector<all::FocusSample> samples = all::focusSamples(m_focusSampling,
+                                                                  glm::vec2(firstPixel.x(), firstPixel.y()),
+                                                                  glm::vec2(lastPixel.x(), lastPixel.y()));
+        for (all::FocusSample& sample : samples) {
+            if (const auto position = region.worldPosition(QPointF(sample.position.x, sample.position.y)))
+                sample.distance = (*position - region.eye).length();
+        }
+        updateAutoFocus(all::estimateFocus(m_focusSampling, samples));
+        break;
+    }
     }
-    m_cursor->setPosition(nearestHitIterator->worldIntersection());
+}
+
+// Whether the view changed too recently for the depth drawn a frame or two ago to match it
+bool Qt3DRenderer::viewMoving() const
+{
+    constexpr qint64 StillViewDelay = 100; // ms
+    return m_viewChangeTimer.isValid() && m_viewChangeTimer.elapsed() < StillViewDelay;
+}
+
+// Same as the cursor ray caster, but synchronously on the CPU side hierarchy of the model
+void Qt3DRenderer::pickCursorPosition(const QPoint& cursorPos)
+{
+    m_depthReadback->cancel(DepthReadback::Purpose::Cursor);
+
+    const Qt3DRender::QCamera* camera = m_camera->centerCamera();
+    const QMatrix4x4 inverseViewProjection = (camera->projectionMatrix() * camera->viewMatrix()).inverted();
+    const float x = 2.0f * float(cursorPos.x()) / float(m_view->width()) - 1.0f;
+    const float y = 1.0f - 2.0f * float(cursorPos.y()) / float(m_view->height());
+    const QVector3D nearPoint = inverseViewProjection.map(QVector3D(x, y, -1.0f));
+    const QVector3D farPoint = inverseViewProjection.map(QVector3D(x, y, 1.0f));
+
+    const all::Ray ray{ toGlmVec3(nearPoint), toGlmVec3(farPoint - nearPoint) };
+    const auto hit = m_sceneBvh->closestHit(ray, 1.0f);
+    if (hit)
+        m_cursor->setPosition(toQVector3D(hit->position));
+    else
+        placeCursorOnFocusPlane(cursorPos);
+
+    // Batches are named after their material, the mesh they were merged from is the one picked
+    QString pickedMeshName;
+    if (const ModelMesh* mesh = hit ? m_model->meshAt(*hit) : nullptr) {
+        const ModelSubMesh* subMesh = mesh->subMeshAt(hit->triangle);
+        pickedMeshName = subMesh ? subMesh->name : mesh->name;
+    }
+    if (pickedMeshName != m_pickedMeshName) {
+        m_pickedMeshName = pickedMeshName;
+        m_propertyUpdateNofitier("picked_mesh", m_pickedMeshName.toStdString());
+    }
+}
+
+void Qt3DRenderer::placeCursorOnFocusPlane(const QPoint& cursorPos)
+{
+    const QVector3D viewCenter = m_camera->centerCamera()->position() + m_camera->centerCamera()->viewVector().normalized() * m_stereoCamera->convergencePlaneDistance();
+    const QVector4D viewCenterScreen = m_camera->centerCamera()->projectionMatrix() * m_camera->centerCamera()->viewMatrix() * QVector4D(viewCenter, 1.0f);
+    const float zFocus = viewCenterScreen.z() / viewCenterScreen.w();
+    const QVector3D cursorScreenPos(cursorPos.x(), m_view->height() - cursorPos.y(), zFocus);
+
+    auto unprojectZO = [](const QVector3D& p, const QMatrix4x4& viewMatrix, const QMatrix4x4& projectionMatrix, const QRect& viewport) {
+        const QMatrix4x4 inverse = QMatrix4x4(projectionMatrix * viewMatrix).inverted();
+        QVector4D tmp(p, 1.0f);
+        tmp.setX((tmp.x() - float(viewport.x())) / float(viewport.width()));
+        tmp.setY((tmp.y() - float(viewport.y())) / float(viewport.height()));
+        tmp.setX(tmp.x() * 2.0f - 1.0f);
+        tmp.setY(tmp.y() * 2.0f - 1.0f);
+        QVector4D obj = inverse * tmp;
+        if (qFuzzyIsNull(obj.w()))
+            obj.setW(1.0f);
+        obj /= obj.w();
+        return obj.toVector3D();
+    };
+
+    const QVector3D unv = unprojectZO(cursorScreenPos,
+                                      m_camera->centerCamera()->viewMatrix(),
+                                      m_camera->centerCamera()->projectionMatrix(),
+                                      QRect{ 0, 0, m_view->width(), m_view->height() });
+    m_cursor->setPosition(unv);
 }
 
 } // namespace all::qt3d
@@ -3,11 +3,15 @@
 #include <Qt3DRender/QScreenRayCaster>
 
 #include <glm/mat4x4.hpp>
+#include "depth_readback.h"
 #include "frustum_rect.h"
 #include "stereo_forward_renderer.h"
+#include "mesh_loader.h"
 #include <QVector3D>
 #include <QVector2D>
 #include <QUrl>
+#include <QElapsedTimer>
+#include <shared/focus_sampling.h>
 #include <shared/stereo_camera.h>
 
 #include <filesystem>
@@ -21,6 +25,7 @@ class QMaterial;
 namespace all {
 struct ModelNavParameters;
 struct StereoCamera;
+class SceneBvh;
 } // namespace all
 
 namespace all::qt3d {
@@ -29,6 +34,8 @@ class Frustum;
 class FrustumRect;
 class FocusArea;
 class FocusPlanePreview;
+class AsyncMeshLoader;
+struct ModelData;
 
 class Qt3DRenderer : public QObject
 {
@@ -45,6 +52,7 @@ public:
     void createAspects(std::shared_ptr<all::ModelNavParameters> nav_params);
 
     void loadModel(std::filesystem::path path = "assets/motorbike.obj");
+    void cancelModelLoad();
     void viewAll();
     void setCursorEnabled(bool /* enabled */);
 
@@ -73,14 +81,9 @@ private:
 
     void createScene(Qt3DCore::QEntity* root);
     void loadImage(QUrl path = QUrl::fromLocalFile(":/13_3840x2160_sbs.jpg"));
-
-    struct SceneExtent {
-        QVector3D min, max;
-    };
-    SceneExtent calculateSceneExtent(Qt3DCore::QEntity* entity) const;
+    void setModel(const std::shared_ptr<ModelData>& model);
 
 protected:
-    void _calculateSceneDimensions(Qt3DCore::QEntity* entity, QVector3D& minBounds, QVector3D& maxBounds) const;
     void modelExtentChanged(const QVector3D& min, const QVector3D& max);
     void setupCameraBasedOnSceneExtent();
     void requestFocusForFocusArea();
@@ -88,13 +91,28 @@ protected:
 
 private:
     void afRaycasterHitResult(size_t idx, const Qt3DRender::QAbstractRayCaster::Hits& hits);
+    void updateAutoFocus(const std::optional<all::FocusEstimate>& estimate);
     void cursorHitResult(const Qt3DRender::QAbstractRayCaster::Hits& hits);
+    void depthRegionRead(DepthReadback::Purpose purpose, const DepthReadback::Region& region);
+    bool viewMoving() const;
+    void pickCursorPosition(const QPoint& cursorPos);
+    void placeCursorOnFocusPlane(const QPoint& cursorPos);
 
     Qt3DExtras::Qt3DWindow* m_view{ nullptr };
     std::unique_ptr<Qt3DCore::QEntity> m_rootEntity;
     Qt3DCore::QEntity* m_sceneEntity = nullptr;
     Qt3DCore::QEntity* m_userEntity = nullptr;
     Qt3DRender::QScreenRayCaster* m_cursorRaycaster;
+    AsyncMeshLoader* m_meshLoader{ nullptr };
+    std::shared_ptr<const all::SceneBvh> m_sceneBvh; // Picked by the cursor instead of going through Qt3D
+    std::shared_ptr<const ModelData> m_model; // Maps the instances of m_sceneBvh back to their meshes
+    QString m_pickedMeshName; // Source mesh under the cursor, empty if none
+    DepthReadback* m_depthReadback{ nullptr }; // Instead of the ray casters
+    bool m_depthReadbackEnabled{ true };
+    QElapsedTimer m_viewChangeTimer;
+    all::ImportProfile m_importProfile{ all::ImportProfile::FullQuality };
+    bool m_compactVertexFormats{ false };
+    bool m_memoryLean{ false };
 
     QStereoForwardRenderer* m_renderer;
     QStereoProxyCamera* m_camera;
@@ -102,6 +120,7 @@ private:
     CursorEntity* m_cursor;
 
     float cursor_scale = 1.0f;
+    all::AABB m_sceneBounds;
     QVector3D m_sceneCenter;
     QVector3D m_sceneExtent;
     all::StereoCamera* m_stereoCamera;
@@ -116,13 +135,23 @@ private:
     FocusArea* m_focusArea{ nullptr };
     FocusPlanePreview* m_focusPlanePreview{ nullptr };
 
+    all::FocusSampling m_focusSampling;
+
+    // Only used with the depth readback off, until the model hierarchy is there
     static constexpr size_t AFSamplesY = 2;
     static constexpr size_t AFSamplesX = 2;
     static constexpr size_t AFSamples = AFSamplesY * AFSamplesX;
 
+    // Pixels around the cursor read back, for thin geometry it just misses
+    static constexpr int CursorReadbackRadius = 2;
+
     std::array<Qt3DRender::QScreenRayCaster*, AFSamples> m_afRayCasters{ nullptr };
     std::array<float, AFSamples> m_lastAfHitDistances{};
     bool m_afResultUpdateRequested{ false };
+    QElapsedTimer m_afRayCastTimer;
+    QElapsedTimer m_cursorRayCastTimer;
+    PickingStatistics m_afRayCastStatistics{ "Auto focus QScreenRayCaster" };
+    PickingStatistics m_cursorRayCastStatistics{ "Cursor QScreenRayCaster" };
     std::function<void(std::string_view, std::any)> m_propertyUpdateNofitier;
     bool m_focusUpdateRequested{ false };
 };
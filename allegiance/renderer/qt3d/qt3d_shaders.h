@@ -48,7 +48,11 @@ uniform mat4 mvp;
 
 in vec4 vertexColor;
 in vec3 vertexPosition;
+#ifdef OCTAHEDRAL_NORMALS
+in vec2 vertexNormal;
+#else
 in vec3 vertexNormal;
+#endif
 in vec2 vertexTexCoord;
 
 out vec4 postColor;
@@ -56,10 +60,26 @@ out vec4 fragVertexColor;
 smooth out vec3 normalSem;
 out vec2 texCoord;
 
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+vec3 objectNormal()
+{
+#ifdef OCTAHEDRAL_NORMALS
+    return octahedralDecode(vertexNormal);
+#else
+    return vertexNormal;
+#endif
+}
 
 vec3 semNormal()
 {
-    vec3 n = (modelView * vec4(vertexNormal, 0.0)).xyz; // ignore position
+    vec3 n = (modelView * vec4(objectNormal(), 0.0)).xyz; // ignore position
     n *= normalScaling;
     return normalize(n);
 }
@@ -164,7 +184,11 @@ layout(std140, binding = 2) uniform qt3d_custom_uniforms {
 
 layout(location = 0) in vec3 vertexPosition;
 layout(location = 1) in vec4 vertexColor;
+#ifdef OCTAHEDRAL_NORMALS
+layout(location = 2) in vec2 vertexNormal;
+#else
 layout(location = 2) in vec3 vertexNormal;
+#endif
 layout(location = 3) in vec2 vertexTexCoord;
 
 layout(location = 0) out vec4 postColor;
@@ -172,13 +196,28 @@ layout(location = 1) out vec4 fragVertexColor;
 layout(location = 2) smooth out vec3 normalSem;
 layout(location = 3) out vec2 texCoord;
 
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+vec3 objectNormal()
+{
+#ifdef OCTAHEDRAL_NORMALS
+    return octahedralDecode(vertexNormal);
+#else
+    return vertexNormal;
+#endif
+}
 
 vec3 semNormal()
 {
-    vec3 n = (modelViewMatrix * vec4(vertexNormal, 0.0)).xyz; // ignore position
+    vec3 n = (modelViewMatrix * vec4(objectNormal(), 0.0)).xyz; // ignore position
     n *= normalScaling;
-    normalize(n);
-    return n;
+    return normalize(n);
 }
 
 void main()
@@ -567,6 +606,33 @@ void main()
 }
 )";
 
+constexpr std::string_view depth_pack_vs = R"(
+#version 150 core
+
+in vec3 vertexPosition;
+
+void main(void)
+{
+    // Plane mesh lying in xz, stretched over the whole target
+    gl_Position = vec4(vertexPosition.x, vertexPosition.z, 0.0, 1.0);
+}
+)";
+
+constexpr std::string_view depth_pack_ps = R"(
+#version 150 core
+
+uniform sampler2D depthMap;
+
+out vec4 fragColor;
+
+void main()
+{
+    // 24 bits of window depth spread over rgb, the capture reads back 8 bits per channel
+    uint depth = uint(clamp(texelFetch(depthMap, ivec2(gl_FragCoord.xy), 0).r, 0.0, 1.0) * 16777215.0);
+    fragColor = vec4(float(depth >> 16u), float((depth >> 8u) & 255u), float(depth & 255u), 255.0) / 255.0;
+}
+)";
+
 constexpr std::string_view cursor_billboard_vs = R"(
 #version 150 core
 
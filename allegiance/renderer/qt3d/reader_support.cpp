@@ -0,0 +1,68 @@
+#include "reader_support.h"
+
+#include <QFileInfo>
+
+#include <assimp/material.h>
+#include <assimp/scene.h>
+
+#include <cmath>
+
+void all::qt3d::reader_support::faceNormal(const float* p0, const float* p1, const float* p2, float* normal)
+{
+    const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    for (std::size_t i = 0; i < 3; ++i)
+        normal[i] = length > 0.0f ? normal[i] / length : 0.0f;
+}
+
+aiMaterial* all::qt3d::reader_support::defaultMaterial()
+{
+    auto* material = new aiMaterial;
+    const aiString name(AI_DEFAULT_MATERIAL_NAME);
+    material->AddProperty(&name, AI_MATKEY_NAME);
+    const aiColor4D diffuse(0.6f, 0.6f, 0.6f, 1.0f);
+    material->AddProperty(&diffuse, 1, AI_MATKEY_COLOR_DIFFUSE);
+    material->AddProperty(&diffuse, 1, AI_MATKEY_COLOR_SPECULAR);
+    const aiColor4D ambient(0.05f, 0.05f, 0.05f, 1.0f);
+    material->AddProperty(&ambient, 1, AI_MATKEY_COLOR_AMBIENT);
+    return material;
+}
+
+void all::qt3d::reader_support::setTriangles(aiMesh* mesh, const std::vector<uint32_t>& indices)
+{
+    constexpr std::size_t ChunkSize = 1 << 16;
+
+    mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+    mesh->mNumFaces = unsigned(indices.size() / 3);
+    mesh->mFaces = new aiFace[mesh->mNumFaces];
+
+    // One allocation per face, spread across the thread pool
+    std::vector<std::size_t> chunks((mesh->mNumFaces + ChunkSize - 1) / ChunkSize);
+    std::iota(chunks.begin(), chunks.end(), 0);
+    QtConcurrent::blockingMap(chunks, [&](std::size_t chunk) {
+        const std::size_t end = std::min<std::size_t>(mesh->mNumFaces, (chunk + 1) * ChunkSize);
+        for (std::size_t i = chunk * ChunkSize; i < end; ++i) {
+            aiFace& face = mesh->mFaces[i];
+            face.mNumIndices = 3;
+            face.mIndices = new unsigned[3]{ indices[3 * i], indices[3 * i + 1], indices[3 * i + 2] };
+        }
+    });
+}
+
+std::unique_ptr<aiScene> all::qt3d::reader_support::singleMeshScene(aiMesh* mesh, const QString& path)
+{
+    auto scene = std::make_unique<aiScene>();
+    scene->mNumMaterials = 1;
+    scene->mMaterials = new aiMaterial*[1]{ defaultMaterial() };
+    scene->mNumMeshes = 1;
+    scene->mMeshes = new aiMesh*[1]{ mesh };
+
+    scene->mRootNode = new aiNode(QFileInfo(path).fileName().toStdString());
+    scene->mRootNode->mNumMeshes = 1;
+    scene->mRootNode->mMeshes = new unsigned[1]{ 0 };
+    return scene;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <QString>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+struct aiMaterial;
+struct aiMesh;
+struct aiScene;
+
+// Helpers shared by the readers MeshLoader uses in place of assimp's
+namespace all::qt3d::reader_support {
+
+// Triangle corner of a mesh whose vertices aren't shared yet. vertex is the
+// source vertex providing the remaining attributes, if any.
+struct TriangleCorner {
+    uint32_t vertex{ 0 };
+    float position[3]{};
+    float normal[3]{};
+
+    bool operator==(const TriangleCorner& other) const
+    {
+        return std::memcmp(this, &other, sizeof(TriangleCorner)) == 0;
+    }
+};
+static_assert(sizeof(TriangleCorner) == 7 * sizeof(uint32_t));
+
+inline uint64_t hash(const TriangleCorner& corner)
+{
+    uint32_t words[7];
+    std::memcpy(words, &corner, sizeof(words));
+    uint64_t h = 0x9E3779B97F4A7C15ull;
+    for (const uint32_t word : words)
+        h = (h ^ word) * 0xBF58476D1CE4E5B9ull;
+    return h ^ (h >> 29);
+}
+
+struct WeldResult {
+    std::vector<uint32_t> indices; // Vertex of each corner
+    std::vector<uint32_t> vertexCorners; // First corner of each vertex
+};
+
+// Joins identical corners, the way aiProcess_JoinIdenticalVertices does.
+// Corners are spread over partitions by hash, which are then welded across
+// the thread pool, each with its own open addressing table. Vertices are
+// numbered by partition, the vertex fetch optimization restores locality.
+// cornerAt(i) returns the TriangleCorner i and is called from worker threads.
+template<typename CornerFn>
+WeldResult weldCorners(std::size_t cornerCount, const CornerFn& cornerAt)
+{
+    constexpr int PartitionBits = 8;
+    constexpr std::size_t PartitionCount = std::size_t(1) << PartitionBits;
+    constexpr std::size_t ChunkSize = std::size_t(1) << 16;
+    constexpr uint32_t Empty = ~uint32_t(0);
+
+    const std::size_t chunkCount = (cornerCount + ChunkSize - 1) / ChunkSize;
+    std::vector<std::size_t> chunks(chunkCount);
+    std::iota(chunks.begin(), chunks.end(), 0);
+    auto chunkEnd = [cornerCount](std::size_t chunk) {
+        return std::min(cornerCount, (chunk + 1) * ChunkSize);
+    };
+
+    // Partition of each corner, counted per chunk
+    std::vector<uint8_t> partitionOf(cornerCount);
+    std::vector<uint32_t> counts(chunkCount * PartitionCount, 0);
+    QtConcurrent::blockingMap(chunks, [&](std::size_t chunk) {
+        uint32_t* chunkCounts = counts.data() + chunk * PartitionCount;
+        for (std::size_t i = chunk * ChunkSize; i < chunkEnd(chunk); ++i) {
+            const auto partition = uint8_t(hash(cornerAt(i)) >> (64 - PartitionBits));
+            partitionOf[i] = partition;
+            ++chunkCounts[partition];
+        }
+    });
+
+    // Corners sorted by partition, in their original order within each partition
+    std::vector<uint32_t> offsets(chunkCount * PartitionCount);
+    std::vector<uint32_t> partitionBegin(PartitionCount + 1);
+    uint32_t offset = 0;
+    for (std::size_t partition = 0; partition < PartitionCount; ++partition) {
+        partitionBegin[partition] = offset;
+        for (std::size_t chunk = 0; chunk < chunkCount; ++chunk) {
+            offsets[chunk * PartitionCount + partition] = offset;
+            offset += counts[chunk * PartitionCount + partition];
+        }
+    }
+    partitionBegin[PartitionCount] = offset;
+
+    std::vector<uint32_t> sortedCorners(cornerCount);
+    QtConcurrent::blockingMap(chunks, [&](std::size_t chunk) {
+        uint32_t* chunkOffsets = offsets.data() + chunk * PartitionCount;
+        for (std::size_t i = chunk * ChunkSize; i < chunkEnd(chunk); ++i)
+            sortedCorners[chunkOffsets[partitionOf[i]]++] = uint32_t(i);
+    });
+
+    WeldResult result;
+    result.indices.resize(cornerCount);
+    std::vector<std::vector<uint32_t>> partitionVertices(PartitionCount);
+    std::vector<std::size_t> partitions(PartitionCount);
+    std::iota(partitions.begin(), partitions.end(), 0);
+    QtConcurrent::blockingMap(partitions, [&](std::size_t partition) {
+        const uint32_t begin = partitionBegin[partition];
+        const uint32_t end = partitionBegin[partition + 1];
+        std::size_t tableSize = 1;
+        while (tableSize < std::size_t(end - begin) * 2)
+            tableSize *= 2;
+        std::vector<uint32_t> table(tableSize, Empty);
+        std::vector<uint32_t>& vertices = partitionVertices[partition];
+        for (uint32_t i = begin; i < end; ++i) {
+            const uint32_t corner = sortedCorners[i];
+            const TriangleCorner key = cornerAt(corner);
+            for (std::size_t slot = hash(key) & (tableSize - 1);; slot = (slot + 1) & (tableSize - 1)) {
+                if (table[slot] == Empty) {
+                    table[slot] = uint32_t(vertices.size());
+                    vertices.push_back(corner);
+                    result.indices[corner] = table[slot];
+                    break;
+                }
+                if (cornerAt(vertices[table[slot]]) == key) {
+                    result.indices[corner] = table[slot];
+                    break;
+                }
+            }
+        }
+    });
+
+    std::vector<uint32_t> vertexBase(PartitionCount);
+    for (std::size_t partition = 0; partition < PartitionCount; ++partition) {
+        vertexBase[partition] = uint32_t(result.vertexCorners.size());
+        result.vertexCorners.insert(result.vertexCorners.end(), partitionVertices[partition].begin(), partitionVertices[partition].end());
+    }
+    QtConcurrent::blockingMap(chunks, [&](std::size_t chunk) {
+        for (std::size_t i = chunk * ChunkSize; i < chunkEnd(chunk); ++i)
+            result.indices[i] += vertexBase[partitionOf[i]];
+    });
+
+    return result;
+}
+
+// Unit normal of the triangle p0 p1 p2, zero if degenerate
+void faceNormal(const float* p0, const float* p1, const float* p2, float* normal);
+
+// Material assimp assigns to formats without any
+aiMaterial* defaultMaterial();
+
+// Fills the faces of mesh from a triangle list
+void setTriangles(aiMesh* mesh, const std::vector<uint32_t>& indices);
+
+// Scene holding mesh under its root node, named after the file
+std::unique_ptr<aiScene> singleMeshScene(aiMesh* mesh, const QString& path);
+
+} // namespace all::qt3d::reader_support
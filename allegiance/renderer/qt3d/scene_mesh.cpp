@@ -1,14 +1,125 @@
 #include "scene_mesh.h"
 
 #include <assimp/scene.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include <QMatrix4x4>
+#include <QFloat16>
+#include <Qt3DCore/QGeometryView>
+#include <Qt3DRender/QPickingProxy>
+#include <shared/mesh_optimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <type_traits>
 
 using namespace Qt3DCore;
 
 namespace {
-QVector3D toQVector3D(const aiVector3D& vector)
+struct VertexAttributeLayout {
+    QString name;
+    QAttribute::VertexBaseType baseType{ QAttribute::Float };
+    uint size{ 0 };
+    uint byteOffset{ 0 };
+};
+
+struct VertexLayout {
+    VertexAttributeLayout position;
+    std::optional<VertexAttributeLayout> normal;
+    std::optional<VertexAttributeLayout> texCoord;
+    std::optional<VertexAttributeLayout> color;
+    uint byteStride{ 0 };
+};
+
+VertexLayout vertexLayout(SceneMesh::VertexFlags vertexFlags)
+{
+    using VertexFlag = SceneMesh::VertexFlag;
+
+    VertexLayout layout;
+    uint byteOffset = 0;
+    // Every attribute starts on a 4 bytes boundary
+    auto nextAttribute = [&byteOffset](const QString& name, QAttribute::VertexBaseType baseType, uint size, uint componentSize) {
+        VertexAttributeLayout attribute{ name, baseType, size, byteOffset };
+        byteOffset += (size * componentSize + 3) & ~3u;
+        return attribute;
+    };
+
+    if (vertexFlags.testFlag(VertexFlag::QuantizedPositions))
+        layout.position = nextAttribute(QAttribute::defaultPositionAttributeName(), QAttribute::HalfFloat, 3, sizeof(qfloat16));
+    else
+        layout.position = nextAttribute(QAttribute::defaultPositionAttributeName(), QAttribute::Float, 3, sizeof(float));
+
+    if (!vertexFlags.testFlag(VertexFlag::NoNormals)) {
+        if (vertexFlags.testFlag(VertexFlag::OctahedralNormals))
+            layout.normal = nextAttribute(QAttribute::defaultNormalAttributeName(), QAttribute::HalfFloat, 2, sizeof(qfloat16));
+        else if (vertexFlags.testFlag(VertexFlag::QuantizedNormals))
+            layout.normal = nextAttribute(QAttribute::defaultNormalAttributeName(), QAttribute::HalfFloat, 3, sizeof(qfloat16));
+        else
+            layout.normal = nextAttribute(QAttribute::defaultNormalAttributeName(), QAttribute::Float, 3, sizeof(float));
+    }
+
+    if (vertexFlags.testFlag(VertexFlag::HasTextureCoords)) {
+        if (vertexFlags.testFlag(VertexFlag::QuantizedTexCoords))
+            layout.texCoord = nextAttribute(QAttribute::defaultTextureCoordinateAttributeName(), QAttribute::HalfFloat, 2, sizeof(qfloat16));
+        else
+            layout.texCoord = nextAttribute(QAttribute::defaultTextureCoordinateAttributeName(), QAttribute::Float, 2, sizeof(float));
+    }
+
+    if (vertexFlags.testFlag(VertexFlag::HasColors)) {
+        if (vertexFlags.testFlag(VertexFlag::QuantizedColors))
+            layout.color = nextAttribute(QAttribute::defaultColorAttributeName(), QAttribute::UnsignedByte, 4, sizeof(uchar));
+        else
+            layout.color = nextAttribute(QAttribute::defaultColorAttributeName(), QAttribute::Float, 4, sizeof(float));
+    }
+
+    layout.byteStride = byteOffset;
+    return layout;
+}
+
+// Maps a unit vector onto the [-1, 1] square, decoded by octahedralDecode in qt3d_shaders.h
+void octahedralEncode(const float* n, float* encoded)
+{
+    const float l1Norm = std::abs(n[0]) + std::abs(n[1]) + std::abs(n[2]);
+    if (l1Norm == 0.0f) {
+        encoded[0] = encoded[1] = 0.0f;
+        return;
+    }
+    const float x = n[0] / l1Norm;
+    const float y = n[1] / l1Norm;
+    if (n[2] >= 0.0f) {
+        encoded[0] = x;
+        encoded[1] = y;
+    } else {
+        encoded[0] = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        encoded[1] = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    }
+}
+// Expects data.pickingPositions to hold the world space positions covered by data.bounds.
+// Normalizes them to the bounds and stores them as half floats into the vertices.
+void quantizePositions(SceneMeshData& data, const VertexLayout& layout)
 {
-    return QVector3D(vector.x, vector.y, vector.z);
+    // Uniform scale so that the normals aren't skewed when decoding
+    if (data.bounds.isValid()) {
+        const glm::vec3 extent = data.bounds.extent();
+        const float halfExtent = 0.5f * std::max(extent.x, std::max(extent.y, extent.z));
+        const glm::vec3 center = data.bounds.center();
+        data.positionOffset = QVector3D(center.x, center.y, center.z);
+        data.positionScale = halfExtent > 0.0f ? halfExtent : 1.0f;
+    }
+
+    float* pickingPositions = reinterpret_cast<float*>(data.pickingPositions.data());
+    const glm::mat4 normalizeMatrix = glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / data.positionScale)),
+                                                     -glm::vec3(data.positionOffset.x(), data.positionOffset.y(), data.positionOffset.z()));
+    all::vertex_kernels::transformPositions(normalizeMatrix, pickingPositions, 3 * sizeof(float),
+                                            pickingPositions, 3 * sizeof(float), data.vertexCount);
+
+    char* vertexData = data.vertexBytes.data() + layout.position.byteOffset;
+    for (std::size_t i = 0; i < data.vertexCount; ++i) {
+        qFloatToFloat16(reinterpret_cast<qfloat16*>(vertexData + i * layout.byteStride), pickingPositions + 3 * i, 3);
+    }
 }
 } // namespace
 
@@ -19,18 +130,13 @@ class SceneMeshGeometry : public QGeometry
 public:
     explicit SceneMeshGeometry(SceneMesh::VertexFlags vertexFlags, QNode* parent = nullptr);
 
-    void initializeFrom(const aiMesh* meshInfo, const QMatrix4x4& transform);
+    void setData(const SceneMeshData& data, const std::vector<Qt3DCore::QBuffer*>& sourceBuffers);
 
 private:
-    std::size_t vertexByteStride() const;
-    bool vertexHasTextureCoords() const { return m_vertexFlags.testFlag(SceneMesh::VertexFlag::HasTextureCoords); }
-    bool vertexHasColors() const { return m_vertexFlags.testFlag(SceneMesh::VertexFlag::HasColors); }
+    void setSourceData(const SceneMeshData& data, const std::vector<Qt3DCore::QBuffer*>& sourceBuffers);
 
     SceneMesh::VertexFlags m_vertexFlags{ SceneMesh::VertexFlag::None };
-    QAttribute* m_positionAttribute{ nullptr };
-    QAttribute* m_normalAttribute{ nullptr };
-    QAttribute* m_texCoordAttribute{ nullptr };
-    QAttribute* m_colorAttribute{ nullptr };
+    std::vector<QAttribute*> m_vertexAttributes;
     QAttribute* m_indexAttribute{ nullptr };
     Qt3DCore::QBuffer* m_vertexBuffer{ nullptr };
     Qt3DCore::QBuffer* m_indexBuffer{ nullptr };
@@ -43,39 +149,112 @@ SceneMeshGeometry::SceneMeshGeometry(SceneMesh::VertexFlags vertexFlags, QNode*
     , m_vertexBuffer(new Qt3DCore::QBuffer(this))
     , m_indexBuffer(new Qt3DCore::QBuffer(this))
 {
-    std::size_t byteOffset = 0;
-    auto addVertexAttribute = [this, &byteOffset](const QString& name, int size) {
+    const VertexLayout layout = vertexLayout(m_vertexFlags);
+    auto addVertexAttribute = [this, &layout](const VertexAttributeLayout& attributeLayout) {
         auto* attribute = new QAttribute(this);
-        attribute->setName(name);
-        attribute->setVertexBaseType(QAttribute::Float);
-        attribute->setVertexSize(size);
+        attribute->setName(attributeLayout.name);
+        attribute->setVertexBaseType(attributeLayout.baseType);
+        attribute->setVertexSize(attributeLayout.size);
         attribute->setAttributeType(QAttribute::VertexAttribute);
         attribute->setBuffer(m_vertexBuffer);
-        attribute->setByteStride(vertexByteStride());
-        attribute->setByteOffset(byteOffset);
+        attribute->setByteStride(layout.byteStride);
+        attribute->setByteOffset(attributeLayout.byteOffset);
         addAttribute(attribute);
-        byteOffset += size * sizeof(float);
-        return attribute;
+        m_vertexAttributes.push_back(attribute);
     };
-    m_positionAttribute = addVertexAttribute(QAttribute::defaultPositionAttributeName(), 3);
-    m_normalAttribute = addVertexAttribute(QAttribute::defaultNormalAttributeName(), 3);
-    if (vertexHasTextureCoords()) {
-        m_texCoordAttribute = addVertexAttribute(QAttribute::defaultTextureCoordinateAttributeName(), 2);
+    addVertexAttribute(layout.position);
+    if (layout.normal) {
+        addVertexAttribute(*layout.normal);
+    }
+    if (layout.texCoord) {
+        addVertexAttribute(*layout.texCoord);
     }
-    if (vertexHasColors()) {
-        m_colorAttribute = addVertexAttribute(QAttribute::defaultColorAttributeName(), 4);
+    if (layout.color) {
+        addVertexAttribute(*layout.color);
     }
-    Q_ASSERT(byteOffset == vertexByteStride());
 
     m_indexAttribute->setAttributeType(QAttribute::IndexAttribute);
-    m_indexAttribute->setVertexBaseType(QAttribute::UnsignedInt);
     m_indexAttribute->setBuffer(m_indexBuffer);
     addAttribute(m_indexAttribute);
 }
 
-void SceneMeshGeometry::initializeFrom(const aiMesh* meshInfo, const QMatrix4x4& transform)
+void SceneMeshGeometry::setData(const SceneMeshData& data, const std::vector<Qt3DCore::QBuffer*>& sourceBuffers)
 {
-    const auto normalMatrix = QMatrix4x4(transform.normalMatrix());
+    Q_ASSERT(data.vertexFlags == m_vertexFlags);
+    if (data.sourceLayout) {
+        setSourceData(data, sourceBuffers);
+        return;
+    }
+    Q_ASSERT(std::size_t(data.vertexBytes.size()) == data.vertexCount * SceneMesh::vertexByteStride(m_vertexFlags));
+
+    m_vertexBuffer->setData(data.vertexBytes);
+    for (QAttribute* attribute : m_vertexAttributes) {
+        attribute->setCount(data.vertexCount);
+    }
+
+    m_indexBuffer->setData(data.indexBytes);
+    m_indexAttribute->setVertexBaseType(data.indexType == SceneMesh::IndexType::UInt16 ? QAttribute::UnsignedShort : QAttribute::UnsignedInt);
+    m_indexAttribute->setCount(data.totalIndexCount());
+}
+
+// The attributes read straight from the shared buffers, with the offsets and strides of the source file
+void SceneMeshGeometry::setSourceData(const SceneMeshData& data, const std::vector<Qt3DCore::QBuffer*>& sourceBuffers)
+{
+    const SceneMeshData::SourceLayout& layout = *data.sourceLayout;
+    Q_ASSERT(!m_vertexFlags.testAnyFlags(SceneMesh::VertexFlag::QuantizedPositions | SceneMesh::VertexFlag::QuantizedNormals |
+                                         SceneMesh::VertexFlag::OctahedralNormals | SceneMesh::VertexFlag::QuantizedTexCoords |
+                                         SceneMesh::VertexFlag::QuantizedColors));
+
+    // Same order as the attributes added by the constructor
+    std::vector<const SceneMeshData::SourceView*> views = { &layout.position };
+    if (!m_vertexFlags.testFlag(SceneMesh::VertexFlag::NoNormals))
+        views.push_back(&layout.normal);
+    if (m_vertexFlags.testFlag(SceneMesh::VertexFlag::HasTextureCoords))
+        views.push_back(&layout.texCoord);
+    if (m_vertexFlags.testFlag(SceneMesh::VertexFlag::HasColors))
+        views.push_back(&layout.color);
+    Q_ASSERT(views.size() == m_vertexAttributes.size());
+
+    for (std::size_t i = 0; i < views.size(); ++i) {
+        const SceneMeshData::SourceView& view = *views[i];
+        QAttribute* attribute = m_vertexAttributes[i];
+        attribute->setBuffer(sourceBuffers[view.buffer]);
+        attribute->setVertexBaseType(QAttribute::Float);
+        attribute->setVertexSize(view.size);
+        attribute->setByteOffset(view.byteOffset);
+        attribute->setByteStride(view.byteStride);
+        attribute->setCount(data.vertexCount);
+    }
+
+    m_indexAttribute->setBuffer(sourceBuffers[layout.indices.buffer]);
+    m_indexAttribute->setByteOffset(layout.indices.byteOffset);
+    m_indexAttribute->setVertexBaseType(data.indexType == SceneMesh::IndexType::UInt16 ? QAttribute::UnsignedShort : QAttribute::UnsignedInt);
+    m_indexAttribute->setCount(data.totalIndexCount());
+}
+
+SceneMesh::SceneMesh(VertexFlags vertexFlags, QNode* parent)
+    : SceneMesh(vertexFlags, new SceneMeshGeometry(vertexFlags), parent)
+{
+}
+
+SceneMesh::SceneMesh(VertexFlags vertexFlags, QGeometry* geometry, QNode* parent)
+    : QGeometryRenderer(parent)
+    , m_vertexFlags(vertexFlags)
+{
+    setGeometry(geometry);
+    setPrimitiveType(Triangles);
+}
+
+std::size_t SceneMesh::vertexByteStride(VertexFlags vertexFlags)
+{
+    return vertexLayout(vertexFlags).byteStride;
+}
+
+SceneMeshData SceneMesh::bake(const aiMesh* meshInfo, const QMatrix4x4& transform, VertexFlags vertexFlags, std::pmr::memory_resource* scratch)
+{
+    const VertexLayout layout = vertexLayout(vertexFlags);
+    const glm::mat4 positionMatrix = glm::make_mat4(transform.constData());
+    const glm::mat3 normalMatrix = glm::make_mat3(transform.normalMatrix().constData());
 
     const auto vertexCount = meshInfo->mNumVertices;
 
@@ -84,90 +263,447 @@ void SceneMeshGeometry::initializeFrom(const aiMesh* meshInfo, const QMatrix4x4&
     const aiVector3D* texCoords = meshInfo->mTextureCoords[0];
     const aiColor4D* colors = meshInfo->mColors[0];
 
-    QByteArray vertexBytes;
-    vertexBytes.resize(vertexByteStride() * vertexCount);
-    float* vertexData = reinterpret_cast<float*>(vertexBytes.data());
-    for (size_t i = 0; i < vertexCount; ++i) {
-        const QVector3D position = transform.map(toQVector3D(positions[i]));
-        *vertexData++ = static_cast<float>(position.x());
-        *vertexData++ = static_cast<float>(position.y());
-        *vertexData++ = static_cast<float>(position.z());
-
-        const QVector3D normal = normalMatrix.map(toQVector3D(normals[i])).normalized();
-        *vertexData++ = static_cast<float>(normal.x());
-        *vertexData++ = static_cast<float>(normal.y());
-        *vertexData++ = static_cast<float>(normal.z());
-
-        if (vertexHasTextureCoords()) {
-            Q_ASSERT(texCoords);
-            const aiVector3D& texCoord = texCoords[i];
-            *vertexData++ = static_cast<float>(texCoord.x);
-            *vertexData++ = static_cast<float>(texCoord.y);
-        }
+    SceneMeshData data;
+    data.vertexFlags = vertexFlags;
+    data.vertexCount = vertexCount;
 
-        if (vertexHasColors()) {
-            Q_ASSERT(colors);
-            const aiColor4D& color = colors[i];
-            *vertexData++ = static_cast<float>(color.r);
-            *vertexData++ = static_cast<float>(color.g);
-            *vertexData++ = static_cast<float>(color.b);
-            *vertexData++ = static_cast<float>(color.a);
+    const std::size_t byteStride = layout.byteStride;
+    data.vertexBytes.resize(byteStride * vertexCount);
+    char* vertexData = data.vertexBytes.data();
+    auto attributeData = [vertexData, byteStride](const VertexAttributeLayout& attribute, std::size_t i) {
+        return vertexData + i * byteStride + attribute.byteOffset;
+    };
+
+    // Float positions and normals are transformed in batches, straight into the interleaved buffer
+    if (layout.position.baseType == QAttribute::Float) {
+        all::vertex_kernels::transformPositions(positionMatrix, &positions->x, sizeof(aiVector3D),
+                                                reinterpret_cast<float*>(attributeData(layout.position, 0)), byteStride,
+                                                vertexCount, &data.bounds);
+    } else {
+        data.pickingPositions.resize(vertexCount * 3 * sizeof(float));
+        float* pickingPositions = reinterpret_cast<float*>(data.pickingPositions.data());
+        all::vertex_kernels::transformPositions(positionMatrix, &positions->x, sizeof(aiVector3D),
+                                                pickingPositions, 3 * sizeof(float), vertexCount, &data.bounds);
+        quantizePositions(data, layout);
+    }
+
+    if (layout.normal && layout.normal->baseType == QAttribute::Float) {
+        all::vertex_kernels::transformNormals(normalMatrix, &normals->x, sizeof(aiVector3D),
+                                              reinterpret_cast<float*>(attributeData(*layout.normal, 0)), byteStride,
+                                              vertexCount);
+    } else if (layout.normal) {
+        std::pmr::vector<float> transformedNormals(vertexCount * 3, scratch);
+        all::vertex_kernels::transformNormals(normalMatrix, &normals->x, sizeof(aiVector3D),
+                                              transformedNormals.data(), 3 * sizeof(float), vertexCount);
+
+        const bool octahedral = vertexFlags.testFlag(VertexFlag::OctahedralNormals);
+        for (std::size_t i = 0; i < vertexCount; ++i) {
+            auto* normal = reinterpret_cast<qfloat16*>(attributeData(*layout.normal, i));
+            if (octahedral) {
+                float encoded[2];
+                octahedralEncode(transformedNormals.data() + 3 * i, encoded);
+                qFloatToFloat16(normal, encoded, 2);
+            } else {
+                qFloatToFloat16(normal, transformedNormals.data() + 3 * i, 3);
+            }
         }
     }
-    Q_ASSERT(reinterpret_cast<const char*>(vertexData) == vertexBytes.constData() + vertexBytes.size());
-    m_vertexBuffer->setData(vertexBytes);
 
-    m_positionAttribute->setCount(vertexCount);
-    m_normalAttribute->setCount(vertexCount);
-    if (vertexHasTextureCoords()) {
-        m_texCoordAttribute->setCount(vertexCount);
+    if (layout.texCoord) {
+        Q_ASSERT(texCoords);
+        const bool quantized = layout.texCoord->baseType == QAttribute::HalfFloat;
+        for (std::size_t i = 0; i < vertexCount; ++i) {
+            const float texCoord[2] = { texCoords[i].x, texCoords[i].y };
+            char* dst = attributeData(*layout.texCoord, i);
+            if (quantized)
+                qFloatToFloat16(reinterpret_cast<qfloat16*>(dst), texCoord, 2);
+            else
+                std::memcpy(dst, texCoord, sizeof(texCoord));
+        }
     }
-    if (vertexHasColors()) {
-        m_colorAttribute->setCount(vertexCount);
+
+    if (layout.color) {
+        Q_ASSERT(colors);
+        const bool quantized = layout.color->baseType == QAttribute::UnsignedByte;
+        for (std::size_t i = 0; i < vertexCount; ++i) {
+            const float color[4] = { colors[i].r, colors[i].g, colors[i].b, colors[i].a };
+            char* dst = attributeData(*layout.color, i);
+            if (quantized) {
+                for (std::size_t c = 0; c < 4; ++c)
+                    dst[c] = char(qRound(qBound(0.0f, color[c], 1.0f) * 255.0f));
+            } else {
+                std::memcpy(dst, color, sizeof(color));
+            }
+        }
     }
 
     const auto faceCount = meshInfo->mNumFaces;
     const aiFace* faces = meshInfo->mFaces;
 
-    QByteArray faceBytes;
-    faceBytes.resize(faceCount * 3 * sizeof(int32_t));
-    int32_t* faceData = reinterpret_cast<int32_t*>(faceBytes.data());
-    for (size_t i = 0; i < faceCount; ++i) {
-        const aiFace& face = faces[i];
-        Q_ASSERT(face.mNumIndices == 3);
-        for (size_t j = 0; j < 3; ++j) {
-            *faceData++ = face.mIndices[j];
+    data.indexCount = faceCount * 3;
+    data.indexType = indexTypeFor(vertexCount);
+    data.indexBytes.resize(faceCount * 3 * indexByteSize(data.indexType));
+    auto writeIndices = [&]<typename Index>(Index* faceData) {
+        for (size_t i = 0; i < faceCount; ++i) {
+            const aiFace& face = faces[i];
+            Q_ASSERT(face.mNumIndices == 3);
+            for (size_t j = 0; j < 3; ++j) {
+                *faceData++ = Index(face.mIndices[j]);
+            }
         }
+        Q_ASSERT(reinterpret_cast<const char*>(faceData) == data.indexBytes.constData() + data.indexBytes.size());
+    };
+    if (data.indexType == IndexType::UInt16)
+        writeIndices(reinterpret_cast<uint16_t*>(data.indexBytes.data()));
+    else
+        writeIndices(reinterpret_cast<uint32_t*>(data.indexBytes.data()));
+
+    return data;
+}
+
+SceneMesh::IndexType SceneMesh::indexTypeFor(std::size_t vertexCount)
+{
+    return vertexCount <= MaxShortIndexedVertexCount ? IndexType::UInt16 : IndexType::UInt32;
+}
+
+std::size_t SceneMesh::indexByteSize(IndexType indexType)
+{
+    return indexType == IndexType::UInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+std::vector<SceneMeshData> SceneMesh::splitForShortIndices(SceneMeshData data, std::pmr::memory_resource* scratch)
+{
+    std::vector<SceneMeshData> chunks;
+    if (data.indexType == IndexType::UInt16) {
+        chunks.push_back(std::move(data));
+        return chunks;
     }
-    Q_ASSERT(reinterpret_cast<const char*>(faceData) == faceBytes.constData() + faceBytes.size());
-    m_indexBuffer->setData(faceBytes);
 
-    m_indexAttribute->setCount(faceCount * 3);
+    // Greedily assign the triangles, in order, to chunks of at most MaxShortIndexedVertexCount vertices
+    struct Chunk {
+        explicit Chunk(std::pmr::memory_resource* scratch)
+            : vertices(scratch)
+            , indices(scratch)
+        {
+        }
+
+        std::pmr::vector<uint32_t> vertices; // Into data
+        std::pmr::vector<uint16_t> indices; // Into vertices
+    };
+    std::pmr::vector<Chunk> splitChunks(scratch);
+    splitChunks.emplace_back(scratch);
+
+    constexpr uint32_t Unassigned = std::numeric_limits<uint32_t>::max();
+    std::pmr::vector<uint32_t> chunkOfVertex(data.vertexCount, Unassigned, scratch);
+    std::pmr::vector<uint16_t> localIndexOfVertex(data.vertexCount, 0, scratch);
+
+    const auto* indices = reinterpret_cast<const uint32_t*>(data.indexBytes.constData());
+    for (std::size_t i = 0; i + 2 < data.indexCount; i += 3) {
+        const uint32_t chunkIndex = uint32_t(splitChunks.size() - 1);
+        std::size_t newVertices = 0;
+        for (std::size_t j = 0; j < 3; ++j)
+            newVertices += chunkOfVertex[indices[i + j]] != chunkIndex ? 1 : 0;
+        if (splitChunks.back().vertices.size() + newVertices > MaxShortIndexedVertexCount)
+            splitChunks.emplace_back(scratch);
+
+        Chunk& chunk = splitChunks.back();
+        const uint32_t currentChunk = uint32_t(splitChunks.size() - 1);
+        for (std::size_t j = 0; j < 3; ++j) {
+            const uint32_t vertex = indices[i + j];
+            if (chunkOfVertex[vertex] != currentChunk) {
+                chunkOfVertex[vertex] = currentChunk;
+                localIndexOfVertex[vertex] = uint16_t(chunk.vertices.size());
+                chunk.vertices.push_back(vertex);
+            }
+            chunk.indices.push_back(localIndexOfVertex[vertex]);
+        }
+    }
+
+    const std::size_t byteStride = vertexByteStride(data.vertexFlags);
+    std::size_t splitVertexCount = 0;
+    for (const Chunk& chunk : splitChunks)
+        splitVertexCount += chunk.vertices.size();
+    const std::size_t splitBytes = splitVertexCount * byteStride + data.indexCount * sizeof(uint16_t);
+    const std::size_t unsplitBytes = data.vertexCount * byteStride + data.indexCount * sizeof(uint32_t);
+    if (splitBytes >= unsplitBytes) {
+        chunks.push_back(std::move(data));
+        return chunks;
+    }
+
+    const bool hasPickingPositions = !data.pickingPositions.isEmpty();
+    const auto* pickingPositions = reinterpret_cast<const float*>(data.pickingPositions.constData());
+
+    chunks.reserve(splitChunks.size());
+    for (const Chunk& splitChunk : splitChunks) {
+        SceneMeshData& chunk = chunks.emplace_back();
+        chunk.vertexFlags = data.vertexFlags;
+        chunk.vertexCount = uint32_t(splitChunk.vertices.size());
+        chunk.indexCount = uint32_t(splitChunk.indices.size());
+        chunk.indexType = IndexType::UInt16;
+        chunk.positionOffset = data.positionOffset;
+        chunk.positionScale = data.positionScale;
+
+        chunk.vertexBytes.resize(chunk.vertexCount * byteStride);
+        if (hasPickingPositions)
+            chunk.pickingPositions.resize(chunk.vertexCount * 3 * sizeof(float));
+        for (std::size_t i = 0; i < splitChunk.vertices.size(); ++i) {
+            const uint32_t vertex = splitChunk.vertices[i];
+            std::memcpy(chunk.vertexBytes.data() + i * byteStride, data.vertexBytes.constData() + vertex * byteStride, byteStride);
+
+            // Float positions come first in the vertex, quantized ones are mirrored by the picking positions
+            glm::vec3 position;
+            if (hasPickingPositions) {
+                std::memcpy(chunk.pickingPositions.data() + i * 3 * sizeof(float), pickingPositions + 3 * vertex, 3 * sizeof(float));
+                position = glm::make_vec3(pickingPositions + 3 * vertex) * data.positionScale +
+                        glm::vec3(data.positionOffset.x(), data.positionOffset.y(), data.positionOffset.z());
+            } else {
+                std::memcpy(&position, data.vertexBytes.constData() + vertex * byteStride, sizeof(position));
+            }
+            chunk.bounds.expand(position);
+        }
+
+        chunk.indexBytes = QByteArray(reinterpret_cast<const char*>(splitChunk.indices.data()), qsizetype(splitChunk.indices.size() * sizeof(uint16_t)));
+    }
+
+    return chunks;
 }
 
-std::size_t SceneMeshGeometry::vertexByteStride() const
+SceneMesh::OptimizationResult SceneMesh::optimize(SceneMeshData& data, bool overdraw, std::pmr::memory_resource* scratch)
 {
-    auto elementSize = 3 + 3; // position, normal
-    if (vertexHasTextureCoords()) {
-        elementSize += 2; // texCoord
+    namespace mesh_optimizer = all::mesh_optimizer;
+
+    std::pmr::vector<uint32_t> indices(data.indexCount, scratch);
+    if (data.indexType == IndexType::UInt16) {
+        const auto* shortIndices = reinterpret_cast<const uint16_t*>(data.indexBytes.constData());
+        std::copy(shortIndices, shortIndices + data.indexCount, indices.begin());
+    } else {
+        std::memcpy(indices.data(), data.indexBytes.constData(), data.indexCount * sizeof(uint32_t));
     }
-    if (vertexHasColors()) {
-        elementSize += 4; // color
+
+    OptimizationResult result;
+    result.acmrBefore = mesh_optimizer::acmr(indices.data(), indices.size(), data.vertexCount, mesh_optimizer::DefaultCacheSize, scratch);
+
+    mesh_optimizer::optimizeVertexCache(indices.data(), indices.size(), data.vertexCount, scratch);
+    if (overdraw) {
+        // Float positions come first in the vertex, quantized ones are mirrored by the picking positions
+        const bool hasPickingPositions = !data.pickingPositions.isEmpty();
+        const auto* positions = reinterpret_cast<const float*>(hasPickingPositions ? data.pickingPositions.constData() : data.vertexBytes.constData());
+        const std::size_t positionStride = hasPickingPositions ? 3 * sizeof(float) : vertexByteStride(data.vertexFlags);
+        mesh_optimizer::optimizeOverdraw(indices.data(), indices.size(), positions, positionStride, data.vertexCount,
+                                         mesh_optimizer::DefaultOverdrawThreshold, scratch);
     }
-    return elementSize * sizeof(float);
+
+    const std::pmr::vector<uint32_t> remap = mesh_optimizer::optimizeVertexFetch(indices.data(), indices.size(), data.vertexCount, scratch);
+    mesh_optimizer::remapVertices(remap, data.vertexBytes.data(), vertexByteStride(data.vertexFlags), scratch);
+    if (!data.pickingPositions.isEmpty())
+        mesh_optimizer::remapVertices(remap, data.pickingPositions.data(), 3 * sizeof(float), scratch);
+
+    result.acmrAfter = mesh_optimizer::acmr(indices.data(), indices.size(), data.vertexCount, mesh_optimizer::DefaultCacheSize, scratch);
+
+    if (data.indexType == IndexType::UInt16)
+        std::copy(indices.begin(), indices.end(), reinterpret_cast<uint16_t*>(data.indexBytes.data()));
+    else
+        std::memcpy(data.indexBytes.data(), indices.data(), data.indexCount * sizeof(uint32_t));
+
+    return result;
 }
 
-SceneMesh::SceneMesh(VertexFlags vertexFlags, QNode* parent)
-    : QGeometryRenderer(parent)
+SceneMeshData SceneMesh::merge(const std::vector<const SceneMeshData*>& parts)
 {
-    auto* geometry = new SceneMeshGeometry(vertexFlags);
-    setGeometry(geometry);
-    setPrimitiveType(Triangles);
+    Q_ASSERT(!parts.empty());
+
+    SceneMeshData data;
+    data.vertexFlags = parts.front()->vertexFlags;
+    for (const SceneMeshData* part : parts) {
+        Q_ASSERT(part->vertexFlags == data.vertexFlags);
+        data.vertexCount += part->vertexCount;
+        data.indexCount += part->indexCount;
+        if (part->bounds.isValid()) {
+            data.bounds.expand(part->bounds.min);
+            data.bounds.expand(part->bounds.max);
+        }
+    }
+
+    const VertexLayout layout = vertexLayout(data.vertexFlags);
+    const bool quantizedPositions = data.vertexFlags.testFlag(VertexFlag::QuantizedPositions);
+
+    data.vertexBytes.reserve(data.vertexCount * layout.byteStride);
+    if (quantizedPositions)
+        data.pickingPositions.resize(data.vertexCount * 3 * sizeof(float));
+    float* pickingPositions = reinterpret_cast<float*>(data.pickingPositions.data());
+
+    data.indexType = indexTypeFor(data.vertexCount);
+    data.indexBytes.resize(data.indexCount * indexByteSize(data.indexType));
+
+    auto appendIndices = [](const SceneMeshData& part, uint32_t baseVertex, auto* dst) {
+        using Index = std::remove_pointer_t<decltype(dst)>;
+        auto copy = [&](const auto* src) {
+            for (std::size_t i = 0; i < part.indexCount; ++i)
+                *dst++ = Index(src[i] + baseVertex);
+        };
+        if (part.indexType == IndexType::UInt16)
+            copy(reinterpret_cast<const uint16_t*>(part.indexBytes.constData()));
+        else
+            copy(reinterpret_cast<const uint32_t*>(part.indexBytes.constData()));
+        return dst;
+    };
+
+    uint32_t baseVertex = 0;
+    uint16_t* shortIndices = reinterpret_cast<uint16_t*>(data.indexBytes.data());
+    uint32_t* indices = reinterpret_cast<uint32_t*>(data.indexBytes.data());
+    for (const SceneMeshData* part : parts) {
+        data.vertexBytes.append(part->vertexBytes);
+
+        if (data.indexType == IndexType::UInt16)
+            shortIndices = appendIndices(*part, baseVertex, shortIndices);
+        else
+            indices = appendIndices(*part, baseVertex, indices);
+
+        // Back to world space, the merged positions get normalized to the merged bounds
+        if (quantizedPositions) {
+            const glm::vec3 offset(part->positionOffset.x(), part->positionOffset.y(), part->positionOffset.z());
+            const auto* partPositions = reinterpret_cast<const float*>(part->pickingPositions.constData());
+            for (std::size_t i = 0; i < part->vertexCount * 3; i += 3) {
+                const glm::vec3 p = glm::make_vec3(partPositions + i) * part->positionScale + offset;
+                std::memcpy(pickingPositions + 3 * baseVertex + i, &p, sizeof(p));
+            }
+        }
+
+        baseVertex += part->vertexCount;
+    }
+
+    if (quantizedPositions)
+        quantizePositions(data, layout);
+
+    return data;
+}
+
+void SceneMesh::generateLevelsOfDetail(SceneMeshData& data, std::size_t maxLevels, std::pmr::memory_resource* scratch)
+{
+    namespace mesh_optimizer = all::mesh_optimizer;
+
+    // Below that, the draw call costs more than the triangles
+    constexpr std::size_t MinTriangleCount = 2048;
+    // Coarser levels are only kept if they drop at least a fifth of the triangles
+    constexpr float MinReduction = 0.8f;
+    // Per level, relative to the mesh extent
+    constexpr float MaxError = 0.02f;
+
+    data.lods.clear();
+    if (data.indexCount / 3 < MinTriangleCount || maxLevels == 0)
+        return;
+
+    std::pmr::vector<uint32_t> indices(data.indexCount, scratch);
+    if (data.indexType == IndexType::UInt16) {
+        const auto* shortIndices = reinterpret_cast<const uint16_t*>(data.indexBytes.constData());
+        std::copy(shortIndices, shortIndices + data.indexCount, indices.begin());
+    } else {
+        std::memcpy(indices.data(), data.indexBytes.constData(), data.indexCount * sizeof(uint32_t));
+    }
+
+    // Float positions come first in the vertex, quantized ones are mirrored by the picking positions
+    const bool hasPickingPositions = !data.pickingPositions.isEmpty();
+    const auto* positions = reinterpret_cast<const float*>(hasPickingPositions ? data.pickingPositions.constData() : data.vertexBytes.constData());
+    const std::size_t positionStride = hasPickingPositions ? 3 * sizeof(float) : vertexByteStride(data.vertexFlags);
+
+    std::pmr::vector<uint32_t> lodIndices(scratch);
+    for (std::size_t level = 0; level < maxLevels; ++level) {
+        // Simplifying the previous level is much cheaper than starting over from the full mesh
+        float error = 0.0f;
+        std::vector<uint32_t> simplified = mesh_optimizer::simplify(indices.data(), indices.size(), positions, positionStride,
+                                                                    data.vertexCount, indices.size() / 2, MaxError, &error, scratch);
+        if (simplified.empty() || float(simplified.size()) > float(indices.size()) * MinReduction)
+            break;
+
+        mesh_optimizer::optimizeVertexCache(simplified.data(), simplified.size(), data.vertexCount, scratch);
+        lodIndices.insert(lodIndices.end(), simplified.begin(), simplified.end());
+        // The deviations add up along the chain
+        const float previousError = data.lods.empty() ? 0.0f : data.lods.back().error;
+        data.lods.push_back({ uint32_t(simplified.size()), previousError + error });
+        indices.assign(simplified.begin(), simplified.end());
+    }
+
+    const qsizetype offset = data.indexBytes.size();
+    data.indexBytes.resize(offset + qsizetype(lodIndices.size() * indexByteSize(data.indexType)));
+    if (data.indexType == IndexType::UInt16)
+        std::copy(lodIndices.begin(), lodIndices.end(), reinterpret_cast<uint16_t*>(data.indexBytes.data() + offset));
+    else
+        std::memcpy(data.indexBytes.data() + offset, lodIndices.data(), lodIndices.size() * sizeof(uint32_t));
+}
+
+Qt3DRender::QPickingProxy* SceneMesh::createPickingProxy(const SceneMeshData& data)
+{
+    if (data.pickingPositions.isEmpty())
+        return nullptr;
+
+    auto* proxy = new Qt3DRender::QPickingProxy;
+    auto* view = new QGeometryView(proxy);
+    auto* geometry = new QGeometry(view);
+
+    auto* positionBuffer = new Qt3DCore::QBuffer(geometry);
+    positionBuffer->setData(data.pickingPositions);
+    auto* positionAttribute = new QAttribute(positionBuffer, QAttribute::defaultPositionAttributeName(), QAttribute::Float, 3, data.vertexCount, 0, 3 * sizeof(float), geometry);
+    geometry->addAttribute(positionAttribute);
+
+    auto* indexBuffer = new Qt3DCore::QBuffer(geometry);
+    indexBuffer->setData(data.indexBytes);
+    const auto indexBaseType = data.indexType == IndexType::UInt16 ? QAttribute::UnsignedShort : QAttribute::UnsignedInt;
+    auto* indexAttribute = new QAttribute(indexBuffer, indexBaseType, 1, data.indexCount, 0, 0, geometry);
+    indexAttribute->setAttributeType(QAttribute::IndexAttribute);
+    geometry->addAttribute(indexAttribute);
+
+    view->setGeometry(geometry);
+    view->setPrimitiveType(QGeometryView::Triangles);
+    proxy->setView(view);
+
+    // The bounds can't be computed from the half float render geometry either
+    const auto toLocal = [&data](const glm::vec3& p) {
+        return (QVector3D(p.x, p.y, p.z) - data.positionOffset) / data.positionScale;
+    };
+    proxy->setMinPoint(toLocal(data.bounds.min));
+    proxy->setMaxPoint(toLocal(data.bounds.max));
+
+    return proxy;
 }
 
 void SceneMesh::initializeFrom(const aiMesh* meshInfo, const QMatrix4x4& transform)
 {
-    static_cast<SceneMeshGeometry*>(geometry())->initializeFrom(meshInfo, transform);
+    setData(bake(meshInfo, transform, m_vertexFlags));
+}
+
+void SceneMesh::setData(const SceneMeshData& data, const std::vector<Qt3DCore::QBuffer*>& sourceBuffers)
+{
+    static_cast<SceneMeshGeometry*>(geometry())->setData(data, sourceBuffers);
+    m_bounds = data.bounds;
+
+    // indexOffset is the base vertex, the levels are selected by byte offset into the index buffer
+    const auto indexSize = uint32_t(indexByteSize(data.indexType));
+    m_levelsOfDetail.clear();
+    m_levelsOfDetail.push_back({ 0, data.indexCount });
+    uint32_t byteOffset = data.indexCount * indexSize;
+    for (const SceneMeshData::LevelOfDetail& lod : data.lods) {
+        m_levelsOfDetail.push_back({ byteOffset, lod.indexCount });
+        byteOffset += lod.indexCount * indexSize;
+    }
+    setLevelOfDetail(0);
+}
+
+SceneMesh* SceneMesh::createInstance() const
+{
+    auto* instance = new SceneMesh(m_vertexFlags, geometry());
+    instance->m_bounds = m_bounds;
+    instance->m_levelsOfDetail = m_levelsOfDetail;
+    instance->setLevelOfDetail(0);
+    return instance;
+}
+
+void SceneMesh::setLevelOfDetail(int level)
+{
+    if (m_levelsOfDetail.empty())
+        return;
+    const IndexRange& range = m_levelsOfDetail[std::clamp<std::size_t>(std::size_t(std::max(level, 0)), 0, m_levelsOfDetail.size() - 1)];
+    setIndexBufferByteOffset(int(range.byteOffset));
+    setVertexCount(int(range.count));
 }
 
 #include "scene_mesh.moc"
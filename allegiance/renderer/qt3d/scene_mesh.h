@@ -1,8 +1,23 @@
 #pragma once
 
 #include <Qt3DRender/QGeometryRenderer>
+#include <QVector3D>
+#include <shared/vertex_kernels.h>
+
+#include <memory_resource>
+#include <optional>
+#include <vector>
 
 struct aiMesh;
+struct SceneMeshData;
+
+namespace Qt3DCore {
+class QBuffer;
+} // namespace Qt3DCore
+
+namespace Qt3DRender {
+class QPickingProxy;
+} // namespace Qt3DRender
 
 class SceneMesh : public Qt3DRender::QGeometryRenderer
 {
@@ -11,11 +26,142 @@ public:
     enum class VertexFlag {
         None = 0,
         HasTextureCoords = 1,
-        HasColors = 2
+        HasColors = 2,
+        // Compact layouts
+        QuantizedPositions = 4, // Half floats normalized to the mesh bounds, see SceneMeshData::positionOffset
+        QuantizedNormals = 8, // Half floats
+        OctahedralNormals = 16, // Octahedral encoding in two half floats, the material has to decode them
+        QuantizedTexCoords = 32, // Half floats
+        QuantizedColors = 64, // Normalized RGBA8
+        NoNormals = 128 // Positions without normals, for meshes that are only picked
     };
     Q_DECLARE_FLAGS(VertexFlags, VertexFlag)
 
+    enum class IndexType : uint8_t {
+        UInt16,
+        UInt32
+    };
+
+    static constexpr std::size_t MaxShortIndexedVertexCount = 1 << 16;
+
     explicit SceneMesh(VertexFlags vertexFlags, Qt3DCore::QNode* parent = nullptr);
 
+    VertexFlags vertexFlags() const { return m_vertexFlags; }
+
+    static std::size_t vertexByteStride(VertexFlags vertexFlags);
+
+    // 16-bit indices whenever every vertex can be addressed with them
+    static IndexType indexTypeFor(std::size_t vertexCount);
+    static std::size_t indexByteSize(IndexType indexType);
+
+    // Converts meshInfo into interleaved vertex and index buffers. Doesn't
+    // touch any QNode and can therefore be called from a worker thread.
+    // Here and below, temporary buffers come from scratch.
+    static SceneMeshData bake(const aiMesh* meshInfo, const QMatrix4x4& transform, VertexFlags vertexFlags,
+                              std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+    // Qt3D can't pick or compute bounds on half float positions, quantized
+    // meshes need a proxy holding their float positions. Returns nullptr otherwise.
+    static Qt3DRender::QPickingProxy* createPickingProxy(const SceneMeshData& data);
+
+    // Splits a mesh too large for 16-bit indices into chunks that aren't.
+    // Returns data as is if it already uses 16-bit indices, or if the
+    // vertices shared between chunks would cost more than the saved index bytes.
+    static std::vector<SceneMeshData> splitForShortIndices(SceneMeshData data, std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+    // Reorders the triangles for vertex cache locality, and optionally
+    // overdraw, then the vertices in order of use. Returns the average cache
+    // miss ratio before and after.
+    struct OptimizationResult {
+        float acmrBefore{ 0.0f };
+        float acmrAfter{ 0.0f };
+    };
+    static OptimizationResult optimize(SceneMeshData& data, bool overdraw, std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+    // Concatenates parts sharing the same vertex flags, in order. The vertices
+    // of each part start right after the ones of the previous part.
+    static SceneMeshData merge(const std::vector<const SceneMeshData*>& parts);
+
+    // Appends up to maxLevels simplified versions of the triangles to the
+    // index buffer, each about half the size of the previous one. They keep
+    // indexing the same vertices. Meshes too small to benefit are left alone.
+    static void generateLevelsOfDetail(SceneMeshData& data, std::size_t maxLevels, std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
     void initializeFrom(const aiMesh* meshInfo, const QMatrix4x4& transform);
+    // sourceBuffers holds the buffers referenced by SceneMeshData::sourceLayout, if any
+    void setData(const SceneMeshData& data, const std::vector<Qt3DCore::QBuffer*>& sourceBuffers = {});
+
+    // Bounds of the baked positions, before the entity transform
+    const all::AABB& bounds() const { return m_bounds; }
+
+    // 0 is the full resolution mesh, out of range levels fall back to the coarsest one
+    void setLevelOfDetail(int level);
+
+    // Returns a mesh drawing the same buffers, for another entity to select
+    // its level of detail on its own
+    SceneMesh* createInstance() const;
+
+private:
+    SceneMesh(VertexFlags vertexFlags, Qt3DCore::QGeometry* geometry, Qt3DCore::QNode* parent = nullptr);
+
+    struct IndexRange {
+        uint32_t byteOffset{ 0 };
+        uint32_t count{ 0 };
+    };
+
+    VertexFlags m_vertexFlags;
+    all::AABB m_bounds;
+    std::vector<IndexRange> m_levelsOfDetail;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(SceneMesh::VertexFlags)
+
+// CPU side content of a SceneMesh, ready to be handed over to the QBuffers
+struct SceneMeshData {
+    SceneMesh::VertexFlags vertexFlags{ SceneMesh::VertexFlag::None };
+    QByteArray vertexBytes;
+    QByteArray indexBytes;
+    uint32_t vertexCount{ 0 };
+    uint32_t indexCount{ 0 };
+    SceneMesh::IndexType indexType{ SceneMesh::IndexType::UInt32 };
+    all::AABB bounds; // Of the transformed positions
+
+    // Quantized positions are stored as (position - positionOffset) / positionScale
+    QVector3D positionOffset;
+    float positionScale{ 1.0f };
+    QByteArray pickingPositions; // Float positions in the same space, only for QuantizedPositions
+
+    // Simplified versions of the mesh, finest first. Their indices follow
+    // the indexCount ones of the full resolution mesh in indexBytes.
+    struct LevelOfDetail {
+        uint32_t indexCount{ 0 };
+        float error{ 0.0f }; // Deviation from the full resolution mesh, relative to its extent
+    };
+    std::vector<LevelOfDetail> lods;
+
+    // Set for meshes drawn as laid out in the source file, whose attributes
+    // and indices then stay in buffers shared with other meshes instead of
+    // vertexBytes and indexBytes. Such meshes only use float attributes.
+    struct SourceView {
+        int32_t buffer{ -1 }; // -1 if the attribute is absent
+        uint32_t byteOffset{ 0 };
+        uint32_t byteStride{ 0 };
+        uint32_t size{ 0 }; // Components per vertex
+    };
+    struct SourceLayout {
+        SourceView position;
+        SourceView normal;
+        SourceView texCoord;
+        SourceView color;
+        SourceView indices;
+    };
+    std::optional<SourceLayout> sourceLayout;
+
+    uint32_t totalIndexCount() const
+    {
+        uint32_t count = indexCount;
+        for (const LevelOfDetail& lod : lods)
+            count += lod.indexCount;
+        return count;
+    }
 };
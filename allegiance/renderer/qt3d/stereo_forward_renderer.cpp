@@ -18,6 +18,8 @@
 #include <Qt3DRender/QCamera>
 #include <Qt3DRender/QNoPicking>
 #include <Qt3DRender/QRasterMode>
+#include <Qt3DRender/QRenderCapture>
+#include <Qt3DRender/QTexture>
 #include <QSurfaceFormat>
 
 all::qt3d::QStereoForwardRenderer::QStereoForwardRenderer(Qt3DCore::QNode* parent)
@@ -31,6 +33,7 @@ all::qt3d::QStereoForwardRenderer::QStereoForwardRenderer(Qt3DCore::QNode* paren
     , m_frustumLayer(new Qt3DRender::QLayer(this))
     , m_focusAreaLayer(new Qt3DRender::QLayer(this))
     , m_focusPlaneLayer(new Qt3DRender::QLayer(this))
+    , m_depthReadbackLayer(new Qt3DRender::QLayer(this))
 {
     m_sceneLayer->setObjectName(QStringLiteral("SceneLayer"));
     m_sceneLayer->setRecursive(true);
@@ -39,6 +42,7 @@ all::qt3d::QStereoForwardRenderer::QStereoForwardRenderer(Qt3DCore::QNode* paren
     m_frustumLayer->setObjectName(QStringLiteral("FrustumLayer"));
     m_frustumLayer->setRecursive(true);
     m_focusAreaLayer->setObjectName(QStringLiteral("FocusAreaLayer"));
+    m_depthReadbackLayer->setObjectName(QStringLiteral("DepthReadbackLayer"));
 
     const QSurfaceFormat f = QSurfaceFormat::defaultFormat();
     const bool supportsStereo = f.stereo();
@@ -67,6 +71,7 @@ all::qt3d::QStereoForwardRenderer::QStereoForwardRenderer(Qt3DCore::QNode* paren
     m_centerLayerFilter->addLayer(m_frustumLayer);
     m_centerLayerFilter->addLayer(m_cursorLayer);
     m_centerLayerFilter->addLayer(m_focusAreaLayer);
+    m_centerLayerFilter->addLayer(m_depthReadbackLayer);
 
     m_leftLayerFilter = new Qt3DRender::QLayerFilter();
     m_leftLayerFilter->setObjectName("LeftLayerFilter");
@@ -223,6 +228,56 @@ all::qt3d::QStereoForwardRenderer::QStereoForwardRenderer(Qt3DCore::QNode* paren
         m_rightFrustumCameraSelector->setCamera(m_frustumCamera);
     }
 
+    // Center eye depth for the readback, drawn to textures as large as the window
+    {
+        auto makeTextureTarget = [&](Qt3DRender::QAbstractTexture* texture, Qt3DRender::QRenderTargetOutput::AttachmentPoint attachment) {
+            auto* output = new Qt3DRender::QRenderTargetOutput;
+            output->setAttachmentPoint(attachment);
+            output->setTexture(texture);
+            auto* renderTarget = new Qt3DRender::QRenderTarget;
+            renderTarget->addOutput(output);
+            renderTarget->setParent(this);
+            return renderTarget;
+        };
+
+        m_depthTexture = new Qt3DRender::QTexture2D(this);
+        m_depthTexture->setFormat(Qt3DRender::QAbstractTexture::D24);
+        m_depthTexture->setComparisonMode(Qt3DRender::QAbstractTexture::CompareNone);
+        m_packedDepthTexture = new Qt3DRender::QTexture2D(this);
+        m_packedDepthTexture->setFormat(Qt3DRender::QAbstractTexture::RGBA8_UNorm);
+
+        m_depthReadbackBranch = new Qt3DRender::QFrameGraphNode();
+        m_depthReadbackBranch->setObjectName("DepthReadback");
+        m_depthReadbackBranch->setEnabled(false);
+
+        // Scene depth as the center camera sees it
+        auto* depthRts = new Qt3DRender::QRenderTargetSelector(m_depthReadbackBranch);
+        depthRts->setTarget(makeTextureTarget(m_depthTexture, Qt3DRender::QRenderTargetOutput::Depth));
+
+        auto* clearBuffers = new Qt3DRender::QClearBuffers(depthRts);
+        clearBuffers->setBuffers(Qt3DRender::QClearBuffers::DepthBuffer);
+        new Qt3DRender::QNoDraw(clearBuffers);
+
+        auto* sceneLayerFilter = new Qt3DRender::QLayerFilter(depthRts);
+        sceneLayerFilter->setFilterMode(Qt3DRender::QLayerFilter::AcceptAnyMatchingLayers);
+        sceneLayerFilter->addLayer(m_sceneLayer);
+
+        m_depthCameraSelector = new Qt3DRender::QCameraSelector(sceneLayerFilter);
+        auto* depthRenderState = new Qt3DRender::QRenderStateSet(m_depthCameraSelector);
+        auto* depthState = new Qt3DRender::QDepthTest;
+        depthState->setDepthFunction(Qt3DRender::QDepthTest::Less);
+        depthRenderState->addRenderState(depthState);
+
+        // Packed into colors, from which the capture reads the requested regions
+        auto* packRts = new Qt3DRender::QRenderTargetSelector(m_depthReadbackBranch);
+        packRts->setTarget(makeTextureTarget(m_packedDepthTexture, Qt3DRender::QRenderTargetOutput::Color0));
+
+        m_depthCapture = new Qt3DRender::QRenderCapture(packRts);
+        auto* packLayerFilter = new Qt3DRender::QLayerFilter(m_depthCapture);
+        packLayerFilter->setFilterMode(Qt3DRender::QLayerFilter::AcceptAnyMatchingLayers);
+        packLayerFilter->addLayer(m_depthReadbackLayer);
+    }
+
     // Hierarchy
     vp->setParent(this);
 
@@ -247,6 +302,9 @@ all::qt3d::QStereoForwardRenderer::QStereoForwardRenderer(Qt3DCore::QNode* paren
     m_leftFrustumCameraSelector->setParent(noPicking);
     m_rightFrustumCameraSelector->setParent(noPicking);
 
+    // Depth Readback
+    m_depthReadbackBranch->setParent(noPicking);
+
 #ifdef QT_DEBUG
     auto* debugOverlay = new Qt3DRender::QDebugOverlay();
     auto* noDraw = new Qt3DRender::QNoDraw();
@@ -285,6 +343,7 @@ void all::qt3d::QStereoForwardRenderer::setDisplayMode(DisplayMode displayMode)
         return;
 
     m_centerCameraSelector->setCamera(m_camera->centerCamera());
+    m_depthCameraSelector->setCamera(m_camera->centerCamera());
 
     switch (m_displayMode) {
     case all::DisplayMode::Stereo:
@@ -324,3 +383,13 @@ void all::qt3d::QStereoForwardRenderer::setWireframeEnabled(bool enabled)
     m_rightSceneRasterMode->setRasterMode(m_leftSceneRasterMode->rasterMode());
 }
 
+void all::qt3d::QStereoForwardRenderer::setDepthReadbackSize(const QSize& size)
+{
+    m_depthTexture->setSize(size.width(), size.height());
+    m_packedDepthTexture->setSize(size.width(), size.height());
+}
+
+void all::qt3d::QStereoForwardRenderer::setDepthReadbackActive(bool active)
+{
+    m_depthReadbackBranch->setEnabled(active);
+}
@@ -9,6 +9,8 @@ class QNoDraw;
 class QLayerFilter;
 class QCamera;
 class QRasterMode;
+class QRenderCapture;
+class QTexture2D;
 } // namespace Qt3DRender
 
 namespace all::qt3d {
@@ -41,6 +43,14 @@ public:
     inline Qt3DRender::QLayer* frustumLayer() const { return m_frustumLayer; }
     inline Qt3DRender::QLayer* focusAreaLayer() const { return m_focusAreaLayer; }
     inline Qt3DRender::QLayer* focusPlaneLayer() const { return m_focusPlaneLayer; }
+    inline Qt3DRender::QLayer* depthReadbackLayer() const { return m_depthReadbackLayer; }
+
+    // Center eye depth for DepthReadback, its quad packs the texture into colors the capture reads
+    inline Qt3DRender::QTexture2D* depthTexture() const { return m_depthTexture; }
+    inline Qt3DRender::QRenderCapture* depthCapture() const { return m_depthCapture; }
+    void setDepthReadbackSize(const QSize& size);
+    // The depth is only drawn while captures are pending
+    void setDepthReadbackActive(bool active);
 
     void setMode(Mode mode);
     inline Mode mode() const { return m_mode; }
@@ -60,6 +70,7 @@ private:
     Qt3DRender::QCameraSelector* m_rightCameraSelector;
     Qt3DRender::QCameraSelector* m_leftFrustumCameraSelector;
     Qt3DRender::QCameraSelector* m_rightFrustumCameraSelector;
+    Qt3DRender::QCameraSelector* m_depthCameraSelector;
 
     Qt3DRender::QLayer* m_leftLayer;
     Qt3DRender::QLayer* m_rightLayer;
@@ -69,6 +80,7 @@ private:
     Qt3DRender::QLayer* m_frustumLayer;
     Qt3DRender::QLayer* m_focusAreaLayer;
     Qt3DRender::QLayer* m_focusPlaneLayer;
+    Qt3DRender::QLayer* m_depthReadbackLayer;
 
     Qt3DRender::QNoDraw* m_sceneNoDraw;
     Qt3DRender::QNoDraw* m_stereoImageNoDraw;
@@ -82,5 +94,10 @@ private:
     Qt3DRender::QLayerFilter* m_leftLayerFilter;
     Qt3DRender::QLayerFilter* m_rightLayerFilter;
     Qt3DRender::QLayerFilter* m_frustumLayerFilter;
+
+    Qt3DRender::QFrameGraphNode* m_depthReadbackBranch;
+    Qt3DRender::QTexture2D* m_depthTexture;
+    Qt3DRender::QTexture2D* m_packedDepthTexture;
+    Qt3DRender::QRenderCapture* m_depthCapture;
 };
 } // namespace all::qt3d
@@ -0,0 +1,105 @@
+#include "stl_reader.h"
+#include "reader_support.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+
+#include <assimp/scene.h>
+
+#include <limits>
+
+namespace {
+constexpr qint64 HeaderSize = 80;
+constexpr qint64 TrianglesOffset = HeaderSize + sizeof(quint32);
+constexpr qint64 TriangleSize = 50; // Normal, 3 positions and an attribute byte count
+
+constexpr float WeldProgressShare = 0.7f; // The rest goes to building the mesh
+
+void readVector(const char* data, float* vector)
+{
+    for (std::size_t i = 0; i < 3; ++i)
+        vector[i] = qFromLittleEndian<float>(data + i * sizeof(float));
+}
+
+// Degenerate facet normals are replaced with the one of the positions
+all::qt3d::reader_support::TriangleCorner cornerAt(const char* triangles, std::size_t corner)
+{
+    const char* triangle = triangles + (corner / 3) * TriangleSize;
+    all::qt3d::reader_support::TriangleCorner result;
+    readVector(triangle, result.normal);
+    readVector(triangle + (1 + corner % 3) * 3 * sizeof(float), result.position);
+    if (result.normal[0] == 0.0f && result.normal[1] == 0.0f && result.normal[2] == 0.0f) {
+        float positions[3][3];
+        for (std::size_t i = 0; i < 3; ++i)
+            readVector(triangle + (1 + i) * 3 * sizeof(float), positions[i]);
+        all::qt3d::reader_support::faceNormal(positions[0], positions[1], positions[2], result.normal);
+    }
+    return result;
+}
+} // namespace
+
+bool all::qt3d::StlReader::canRead(const QString& path)
+{
+    return path.endsWith(QLatin1String(".stl"), Qt::CaseInsensitive);
+}
+
+all::qt3d::StlReader::Result all::qt3d::StlReader::read(const QString& path, const std::function<bool(float)>& progress)
+{
+    Result result;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return result;
+    const qint64 fileSize = file.size();
+    const char* data = fileSize >= TrianglesOffset ? reinterpret_cast<const char*>(file.map(0, fileSize)) : nullptr;
+    if (data == nullptr)
+        return result;
+
+    // ASCII files might start with anything, only the size tells binary ones apart
+    const quint32 triangleCount = qFromLittleEndian<quint32>(data + HeaderSize);
+    if (TrianglesOffset + triangleCount * TriangleSize != fileSize || triangleCount == 0 ||
+        std::size_t(triangleCount) * 3 > std::numeric_limits<uint32_t>::max()) {
+        qDebug() << "Not a binary STL file" << path << ", falling back to assimp";
+        return result;
+    }
+    if (QByteArray::fromRawData(data, HeaderSize).contains("COLOR=")) {
+        qDebug() << "Colored STL file" << path << ", falling back to assimp";
+        return result;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const char* triangles = data + TrianglesOffset;
+    const std::size_t cornerCount = std::size_t(triangleCount) * 3;
+    const reader_support::WeldResult weld = reader_support::weldCorners(cornerCount, [triangles](std::size_t corner) {
+        return cornerAt(triangles, corner);
+    });
+    if (progress && !progress(WeldProgressShare)) {
+        result.cancelled = true;
+        return result;
+    }
+
+    auto* mesh = new aiMesh;
+    mesh->mName = aiString(QFileInfo(path).completeBaseName().toStdString());
+    mesh->mNumVertices = unsigned(weld.vertexCorners.size());
+    mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+    mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+    QtConcurrent::blockingMap(mesh->mVertices, mesh->mVertices + mesh->mNumVertices, [&](aiVector3D& position) {
+        const std::size_t i = &position - mesh->mVertices;
+        const reader_support::TriangleCorner corner = cornerAt(triangles, weld.vertexCorners[i]);
+        position = aiVector3D(corner.position[0], corner.position[1], corner.position[2]);
+        mesh->mNormals[i] = aiVector3D(corner.normal[0], corner.normal[1], corner.normal[2]);
+    });
+    reader_support::setTriangles(mesh, weld.indices);
+
+    if (progress)
+        progress(1.0f);
+
+    qDebug() << "Read" << path << "with" << triangleCount << "triangles into" << mesh->mNumVertices << "vertices in" << timer.elapsed() << "ms";
+    result.scene = reader_support::singleMeshScene(mesh, path);
+    return result;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QString>
+
+#include <functional>
+#include <memory>
+
+struct aiScene;
+
+namespace all::qt3d {
+
+// Binary STL reader, used by MeshLoader in place of assimp's. The file is
+// memory mapped and its unindexed triangles are welded across the thread
+// pool, see reader_support::weldCorners.
+//
+// The scene is laid out like the one assimp produces with the flags used by
+// MeshLoader: a single mesh with the facet normals, identical vertices joined.
+class StlReader
+{
+public:
+    struct Result {
+        std::unique_ptr<aiScene> scene; // nullptr if the file couldn't be read
+        bool cancelled{ false };
+    };
+
+    static bool canRead(const QString& path);
+
+    // Called with the progress in [0, 1], returning false cancels the read.
+    // ASCII files and Materialise color extensions fail so that assimp can take over.
+    static Result read(const QString& path, const std::function<bool(float)>& progress = {});
+};
+
+} // namespace all::qt3d
@@ -1,15 +1,37 @@
 #include "mesh_loader.h"
 #include "custom_materials.h"
 #include <assimp/Importer.hpp>
+#include <assimp/config.h>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 #include <Serenity/gui/render/mesh.h>
 #include <fmt/format.h>
 #include <glm/gtc/matrix_access.hpp>
+#ifndef GLM_ENABLE_EXPERIMENTAL
+#define GLM_ENABLE_EXPERIMENTAL
+#endif
+#include <glm/gtx/matrix_decompose.hpp>
+#include <shared/import_arena.h>
+#include <shared/mesh_optimizer.h>
+#include <shared/mesh_processing.h>
+#include <shared/vertex_kernels.h>
+#include <spdlog/spdlog.h>
 #include <algorithm>
+#include <chrono>
 
 namespace {
 
+// Normals and vertex joining run across all cores in all::mesh_processing
+// rather than in assimp. Normals are smoothed across edges whose faces are
+// less than NormalCreaseAngle degrees apart, 0 keeps them flat like assimp does.
+constexpr bool ParallelVertexProcessing = true;
+constexpr float NormalCreaseAngle = 0.0f;
+
+double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
 glm::mat4 toMatrix4x4(const aiMatrix4x4& matrix)
 {
     return glm::mat4(
@@ -24,6 +46,28 @@ glm::mat4 skyboxTransform(const glm::mat4&)
     return glm::scale(glm::mat4(1.0f), glm::vec3(0.1f));
 }
 
+// Number of nodes referencing each mesh of the scene
+void countMeshUses(const aiNode* node, std::vector<uint32_t>& meshUses)
+{
+    for (size_t i = 0; i < node->mNumMeshes; ++i)
+        ++meshUses[node->mMeshes[i]];
+    for (size_t i = 0; i < node->mNumChildren; ++i)
+        countMeshUses(node->mChildren[i], meshUses);
+}
+
+// Entity transforms are made of a translation, a rotation and a scale,
+// returns false for node transforms that can't be expressed that way
+bool decomposeTransform(const glm::mat4& transform, glm::vec3& translation, glm::quat& rotation, glm::vec3& scale)
+{
+    glm::vec3 skew;
+    glm::vec4 perspective;
+    if (!glm::decompose(transform, scale, rotation, translation, skew, perspective))
+        return false;
+    constexpr float Epsilon = 1e-5f;
+    return glm::all(glm::lessThan(glm::abs(skew), glm::vec3(Epsilon))) &&
+            glm::all(glm::lessThan(glm::abs(perspective - glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)), glm::vec4(Epsilon)));
+}
+
 [[nodiscard]] std::string toLowerCase(std::string str)
 {
     std::transform(str.begin(),
@@ -34,34 +78,100 @@ glm::mat4 skyboxTransform(const glm::mat4&)
 
 } // namespace
 
-static Serenity::VertexFormat MakeVertexFormat()
+// One buffer per stream, bound in location order
+static Serenity::VertexFormat MakeVertexFormat(const all::serenity::MeshLoader::VertexStreams& streams)
 {
     Serenity::VertexFormat vertex_format;
-    vertex_format.attributes.emplace_back(KDGpu::VertexAttribute{ 0, 0, KDGpu::Format::R32G32B32_SFLOAT, 0 }); // position
-    vertex_format.buffers.emplace_back(KDGpu::VertexBufferLayout{ 0, 12 });
-    vertex_format.attributes.emplace_back(KDGpu::VertexAttribute{ 1, 1, KDGpu::Format::R32G32B32_SFLOAT, 0 }); // normal
-    vertex_format.buffers.emplace_back(KDGpu::VertexBufferLayout{ 1, 12 });
-    vertex_format.attributes.emplace_back(KDGpu::VertexAttribute{ 2, 2, KDGpu::Format::R32G32B32_SFLOAT, 0 }); // uv
-    vertex_format.buffers.emplace_back(KDGpu::VertexBufferLayout{ 2, 12 });
-    vertex_format.attributes.emplace_back(KDGpu::VertexAttribute{ 3, 3, KDGpu::Format::R32G32B32A32_SFLOAT, 0 }); // uv
-    vertex_format.buffers.emplace_back(KDGpu::VertexBufferLayout{ 3, 16 });
+    auto addStream = [&vertex_format](uint32_t location, KDGpu::Format format, uint32_t stride) {
+        const auto binding = uint32_t(vertex_format.buffers.size());
+        vertex_format.attributes.emplace_back(KDGpu::VertexAttribute{ location, binding, format, 0 });
+        vertex_format.buffers.emplace_back(KDGpu::VertexBufferLayout{ binding, stride });
+    };
+    addStream(0, KDGpu::Format::R32G32B32_SFLOAT, 12); // position
+    if (streams.normals)
+        addStream(1, KDGpu::Format::R32G32B32_SFLOAT, 12); // normal
+    if (streams.texCoords)
+        addStream(2, KDGpu::Format::R32G32B32_SFLOAT, 12); // uv
+    if (streams.colors)
+        addStream(3, KDGpu::Format::R32G32B32A32_SFLOAT, 16); // color
 
     return vertex_format;
 }
 
 namespace all::serenity {
 
-std::unique_ptr<Serenity::Entity> MeshLoader::load(std::filesystem::path path, Serenity::LayerManager* layerManager)
+std::unique_ptr<Serenity::Entity> MeshLoader::load(std::filesystem::path path, Serenity::LayerManager* layerManager, all::ImportProfile profile)
 {
+    const auto importStart = std::chrono::steady_clock::now();
+    // Scratch buffers of the processing and baking below, released all at once when the import ends
+    all::ImportArena arena;
+
+    // Only what the profile uses: tangents never are, and imports for picking
+    // drop every attribute but positions. Previews keep the vertices as read.
+    const bool pickingOnly = profile == all::ImportProfile::PickingOnly;
+    const bool joinVertices = profile != all::ImportProfile::FastPreview;
+    const bool optimizeVertexCache = profile == all::ImportProfile::FullQuality;
+    unsigned int vertexSteps = 0;
+    if (!pickingOnly)
+        vertexSteps |= aiProcess_GenNormals;
+    if (joinVertices)
+        vertexSteps |= aiProcess_JoinIdenticalVertices;
+
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path.string(),
-                                             aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices);
+    unsigned int flags = aiProcess_Triangulate | aiProcess_FlipUVs;
+    if (pickingOnly) {
+        importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, aiComponent_NORMALS | aiComponent_TANGENTS_AND_BITANGENTS | aiComponent_COLORS | aiComponent_TEXCOORDS);
+        flags |= aiProcess_RemoveComponent;
+    }
+    if (!ParallelVertexProcessing)
+        flags |= vertexSteps;
+    const auto readStart = std::chrono::steady_clock::now();
+    const aiScene* scene = importer.ReadFile(path.string(), flags);
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         throw std::runtime_error(fmt::format("Failed to load mesh: {}", importer.GetErrorString()));
     }
+    SPDLOG_INFO("Read {} in {:.1f} ms", path.string(), elapsedMs(readStart));
+
+    std::unique_ptr<aiScene> ownedScene;
+    if (ParallelVertexProcessing && !all::mesh_processing::canProcess(*scene)) {
+        scene = importer.ApplyPostProcessing(vertexSteps);
+        if (!scene)
+            throw std::runtime_error(fmt::format("Failed to load mesh: {}", importer.GetErrorString()));
+    } else if (ParallelVertexProcessing) {
+        ownedScene.reset(importer.GetOrphanedScene());
+        scene = ownedScene.get();
+        const auto report = all::mesh_processing::processScene(*ownedScene, { !pickingOnly, NormalCreaseAngle, joinVertices }, &arena);
+        SPDLOG_INFO("Generated normals for {} meshes in {:.1f} ms, joined {} vertices into {} in {:.1f} ms",
+                    report.normalMeshCount, report.normalsMs, report.vertexCountBefore, report.vertexCountAfter, report.joinMs);
+    }
 
     std::unique_ptr<Serenity::Entity> pRoot{ std::make_unique<Serenity::Entity>() };
 
+    // Meshes referenced by several nodes are baked once, each node then gets
+    // an entity applying its transform
+    std::vector<uint32_t> meshUses(scene->mNumMeshes, 0);
+    countMeshUses(scene->mRootNode, meshUses);
+    struct SharedMesh {
+        Serenity::Mesh* mesh{ nullptr };
+        Serenity::Material* material{ nullptr };
+    };
+    std::unordered_map<uint32_t, SharedMesh> sharedMeshes;
+    size_t instanceCount = 0;
+    size_t vertexBytes = 0;
+    size_t indexBytes = 0;
+    VertexCacheStatistics cacheStatistics;
+    const auto bakeStart = std::chrono::steady_clock::now();
+
+    auto makeMesh = [&](const aiMesh& mesh, const aiMaterial& material, const glm::mat4& meshTransform) {
+        const VertexStreams streams = MaterialVertexStreams(material, pickingOnly);
+        for (const auto& buffer : MakeVertexFormat(streams).buffers)
+            vertexBytes += size_t(mesh.mNumVertices) * buffer.stride;
+        for (size_t i = 0; i < mesh.mNumFaces; ++i)
+            indexBytes += mesh.mFaces[i].mNumIndices * sizeof(uint32_t);
+        all::ImportArena::Job arenaJob(&arena);
+        return static_cast<Serenity::Mesh*>(pRoot->addChild(MakeMesh(mesh, meshTransform, streams, optimizeVertexCache, arenaJob.resource(), &cacheStatistics)));
+    };
+
     std::function<void(const aiNode*, Serenity::Entity*, const glm::mat4&)> processMeshesForNode =
             [&](const aiNode* node, Serenity::Entity* root, const glm::mat4& transform) {
                 const size_t nodeMeshCount = node->mNumMeshes;
@@ -71,7 +181,8 @@ std::unique_ptr<Serenity::Entity> MeshLoader::load(std::filesystem::path path, S
                     Serenity::Entity* e = root->createChildEntity<Serenity::Entity>();
 
                     for (size_t i = 0; i < nodeMeshCount; i++) {
-                        const auto& mesh = *scene->mMeshes[node->mMeshes[i]];
+                        const uint32_t meshIndex = node->mMeshes[i];
+                        const auto& mesh = *scene->mMeshes[meshIndex];
                         const auto material = scene->mMaterials[mesh.mMaterialIndex];
 
                         const auto materialRawName = material->GetName();
@@ -81,19 +192,42 @@ std::unique_ptr<Serenity::Entity> MeshLoader::load(std::filesystem::path path, S
                         // remove translations and scales if skybox
                         const glm::mat4 meshTransform = isSkybox ? skyboxTransform(worldTransform) : worldTransform;
 
-                        auto m = MakeMaterial(*material, path);
-                        auto smesh = MakeMesh(mesh, meshTransform);
-                        auto renderer = e->createComponent<Serenity::MeshRenderer>();
-                        renderer->mesh = smesh.get();
-                        renderer->material = m.get();
+                        glm::vec3 translation;
+                        glm::quat rotation;
+                        glm::vec3 scale;
+                        const bool instanced = !isSkybox && meshUses[meshIndex] > 1 && decomposeTransform(worldTransform, translation, rotation, scale);
+
+                        Serenity::Entity* meshEntity = e;
+                        Serenity::Mesh* smeshRef = nullptr;
+                        Serenity::Material* mRef = nullptr;
+                        if (instanced) {
+                            meshEntity = e->createChildEntity<Serenity::Entity>();
+                            auto srt = meshEntity->createComponent<Serenity::SrtTransform>();
+                            srt->translation = translation;
+                            srt->rotation = rotation;
+                            srt->scale = scale;
+
+                            SharedMesh& shared = sharedMeshes[meshIndex];
+                            if (shared.mesh == nullptr) {
+                                shared.mesh = makeMesh(mesh, *material, glm::mat4(1.0f));
+                                shared.material = static_cast<Serenity::Material*>(pRoot->addChild(MakeMaterial(*material, path, pickingOnly)));
+                            }
+                            smeshRef = shared.mesh;
+                            mRef = shared.material;
+                            ++instanceCount;
+                        } else {
+                            smeshRef = makeMesh(mesh, *material, meshTransform);
+                            mRef = static_cast<Serenity::Material*>(pRoot->addChild(MakeMaterial(*material, path, pickingOnly)));
+                        }
 
-                        pRoot->addChild(std::move(smesh));
-                        pRoot->addChild(std::move(m));
+                        auto renderer = meshEntity->createComponent<Serenity::MeshRenderer>();
+                        renderer->mesh = smeshRef;
+                        renderer->material = mRef;
 
                         if (isSkybox) {
-                            e->layerMask = layerManager->layerMask({ "Skybox" });
+                            meshEntity->layerMask = layerManager->layerMask({ "Skybox" });
                         } else {
-                            auto bv = e->createComponent<Serenity::TriangleBoundingVolume>();
+                            auto bv = meshEntity->createComponent<Serenity::TriangleBoundingVolume>();
                             bv->meshRenderer = renderer;
                             bv->cacheTriangles = true;
                             bv->cullBackFaces = false;
@@ -101,9 +235,9 @@ std::unique_ptr<Serenity::Entity> MeshLoader::load(std::filesystem::path path, S
                             float opacity = 1.0f;
                             material->Get(AI_MATKEY_OPACITY, opacity);
                             if (opacity < 1.0f) {
-                                e->layerMask = layerManager->layerMask({ "Alpha" });
+                                meshEntity->layerMask = layerManager->layerMask({ "Alpha" });
                             } else {
-                                e->layerMask = layerManager->layerMask({ "Opaque" });
+                                meshEntity->layerMask = layerManager->layerMask({ "Opaque" });
                             }
                         }
                     }
@@ -116,6 +250,20 @@ std::unique_ptr<Serenity::Entity> MeshLoader::load(std::filesystem::path path, S
             };
 
     processMeshesForNode(scene->mRootNode, pRoot.get(), glm::mat4(1.0f));
+    if (instanceCount > 0)
+        SPDLOG_INFO("Baked {} meshes once for {} node references", sharedMeshes.size(), instanceCount);
+    SPDLOG_INFO("Baked meshes in {:.1f} ms", elapsedMs(bakeStart));
+    // Averaged over every triangle, so that the large meshes weigh the most
+    if (cacheStatistics.triangleCount > 0)
+        SPDLOG_INFO("Optimized {} meshes for the vertex cache, ACMR {:.3f} -> {:.3f}", cacheStatistics.meshCount,
+                    cacheStatistics.missesBefore / double(cacheStatistics.triangleCount), cacheStatistics.missesAfter / double(cacheStatistics.triangleCount));
+    const all::ImportArena::Statistics arenaStatistics = arena.statistics();
+    SPDLOG_INFO("Import scratch: {} allocations served by {} heap blocks over {} threads, peak {:.1f} KiB",
+                arenaStatistics.allocationCount, arenaStatistics.heapAllocationCount, arenaStatistics.threadCount,
+                double(arenaStatistics.peakBytes) / 1024.0);
+
+    SPDLOG_INFO("Imported {} with the {} profile in {:.1f} ms, vertices: {:.1f} KiB, indices: {:.1f} KiB", path.string(),
+                all::importProfileName(profile), elapsedMs(importStart), double(vertexBytes) / 1024.0, double(indexBytes) / 1024.0);
 
     return pRoot;
 }
@@ -133,10 +281,11 @@ std::vector<uint32_t> indices(const aiMesh& mesh)
     return indices;
 }
 
-std::unique_ptr<Serenity::Mesh> MeshLoader::MakeMesh(const aiMesh& mesh, const glm::mat4& transform)
+std::unique_ptr<Serenity::Mesh> MeshLoader::MakeMesh(const aiMesh& mesh, const glm::mat4& transform, const VertexStreams& streams, bool optimizeVertexCache,
+                                                     std::pmr::memory_resource* scratch, VertexCacheStatistics* cacheStatistics)
 {
     std::unique_ptr<Serenity::Mesh> smesh = std::make_unique<Serenity::Mesh>();
-    auto vertex_format = MakeVertexFormat();
+    auto vertex_format = MakeVertexFormat(streams);
     smesh->vertexFormat = vertex_format;
 
     std::vector<Serenity::Mesh::VertexBufferData> verts;
@@ -144,25 +293,20 @@ std::unique_ptr<Serenity::Mesh> MeshLoader::MakeMesh(const aiMesh& mesh, const g
 
     for (size_t i = 0; i < verts.size(); i++) {
         verts[i].resize(mesh.mNumVertices * vertex_format.buffers[i].stride);
-        switch (vertex_format.attributes[i].binding) {
+        switch (vertex_format.attributes[i].location) {
         case 0: // position
         {
-            glm::vec3* pos = reinterpret_cast<glm::vec3*>(verts[i].data());
-            for (size_t i = 0, mP = mesh.mNumVertices; i < mP; ++i) {
-                const aiVector3D v = mesh.mVertices[i];
-                const glm::vec3 transformed = transform * glm::vec4(v[0], v[1], v[2], 1.0f);
-                pos[i] = glm::vec3(transformed.x, transformed.y, transformed.z);
-            }
+            float* pos = reinterpret_cast<float*>(verts[i].data());
+            all::vertex_kernels::transformPositions(transform, &mesh.mVertices->x, sizeof(aiVector3D),
+                                                    pos, sizeof(glm::vec3), mesh.mNumVertices);
             break;
         }
         case 1: // normal
         {
             const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
-            glm::vec3* norms = reinterpret_cast<glm::vec3*>(verts[i].data());
-            for (size_t i = 0, mN = mesh.mNumVertices; i < mN; ++i) {
-                const aiVector3D n = mesh.mNormals[i];
-                norms[i] = normalMatrix * glm::vec3(n[0], n[1], n[2]);
-            }
+            float* norms = reinterpret_cast<float*>(verts[i].data());
+            all::vertex_kernels::transformNormals(normalMatrix, &mesh.mNormals->x, sizeof(aiVector3D),
+                                                  norms, sizeof(glm::vec3), mesh.mNumVertices);
             break;
         }
         case 2: // uv
@@ -186,8 +330,29 @@ std::unique_ptr<Serenity::Mesh> MeshLoader::MakeMesh(const aiMesh& mesh, const g
         }
     }
 
+    std::vector<uint32_t> meshIndices = indices(mesh);
+    if (optimizeVertexCache) {
+        namespace mesh_optimizer = all::mesh_optimizer;
+        const float acmrBefore = mesh_optimizer::acmr(meshIndices.data(), meshIndices.size(), mesh.mNumVertices, mesh_optimizer::DefaultCacheSize, scratch);
+        mesh_optimizer::optimizeVertexCache(meshIndices.data(), meshIndices.size(), mesh.mNumVertices, scratch);
+
+        // Each attribute lives in its own buffer, they all get the same remapping
+        const std::pmr::vector<uint32_t> remap = mesh_optimizer::optimizeVertexFetch(meshIndices.data(), meshIndices.size(), mesh.mNumVertices, scratch);
+        for (size_t i = 0; i < verts.size(); i++)
+            mesh_optimizer::remapVertices(remap, verts[i].data(), vertex_format.buffers[i].stride, scratch);
+
+        const float acmrAfter = mesh_optimizer::acmr(meshIndices.data(), meshIndices.size(), mesh.mNumVertices, mesh_optimizer::DefaultCacheSize, scratch);
+        if (cacheStatistics) {
+            const size_t triangleCount = meshIndices.size() / 3;
+            ++cacheStatistics->meshCount;
+            cacheStatistics->triangleCount += triangleCount;
+            cacheStatistics->missesBefore += double(acmrBefore) * double(triangleCount);
+            cacheStatistics->missesAfter += double(acmrAfter) * double(triangleCount);
+        }
+    }
+
     smesh->setVertices(std::move(verts));
-    smesh->setIndices(indices(mesh));
+    smesh->setIndices(std::move(meshIndices));
 
     return smesh;
 }
@@ -223,12 +388,32 @@ std::unordered_map<std::string, CustomMaterialCreator> customMaterialFactory()
     return customMaterials;
 }
 
+const std::unordered_map<std::string, CustomMaterialCreator>& customMaterials()
+{
+    static const std::unordered_map<std::string, CustomMaterialCreator> factory = customMaterialFactory();
+    return factory;
+}
+
 } // namespace
 
-std::unique_ptr<Serenity::Material> MeshLoader::MakeMaterial(const aiMaterial& material, const std::filesystem::path& model_path)
+std::unique_ptr<Serenity::Material> MeshLoader::MakeMaterial(const aiMaterial& material, const std::filesystem::path& model_path, bool unlit)
 {
+    if (unlit) {
+        aiColor3D diffuse = { 0.45f, 0.45f, 0.85f };
+        material.Get(AI_MATKEY_COLOR_DIFFUSE, diffuse);
+        const glm::vec4 color{ diffuse.r, diffuse.g, diffuse.b, 1.0f };
 
-    static const std::unordered_map<std::string, CustomMaterialCreator> factory = customMaterialFactory();
+        std::unique_ptr<Serenity::Material> m = std::make_unique<Serenity::Material>();
+        m->shaderProgram = static_cast<Serenity::SpirVShaderProgram*>(m->addChild(MakeShaderProgram("color")));
+
+        Serenity::StaticUniformBuffer* colorUbo = m->createChild<Serenity::StaticUniformBuffer>();
+        colorUbo->size = sizeof(color);
+        colorUbo->data = std::vector<uint8_t>{ (const uint8_t*)&color, (const uint8_t*)&color + sizeof(color) };
+        m->setUniformBuffer(3, 0, colorUbo);
+        return m;
+    }
+
+    const auto& factory = customMaterials();
 
     const bool hasDiffuseTexture = material.GetTextureCount(aiTextureType::aiTextureType_DIFFUSE) > 0;
     const std::string materialName = std::string(material.GetName().C_Str());
@@ -306,4 +491,21 @@ std::unique_ptr<Serenity::Material> MeshLoader::MakeMaterial(const aiMaterial& m
     }
 }
 
+MeshLoader::VertexStreams MeshLoader::MaterialVertexStreams(const aiMaterial& material, bool unlit)
+{
+    if (unlit)
+        return { .normals = false, .texCoords = false, .colors = false };
+
+    const std::string materialName = std::string(material.GetName().C_Str());
+    if (materialName == "Skybox")
+        return { .colors = false };
+    if (customMaterials().contains(materialName))
+        return {}; // GlossyMaterial
+
+    aiString tex_filename;
+    const bool hasDiffuseTexture = material.GetTextureCount(aiTextureType::aiTextureType_DIFFUSE) > 0 &&
+            material.GetTexture(aiTextureType_DIFFUSE, 0, &tex_filename) == aiReturn_SUCCESS;
+    return { .texCoords = hasDiffuseTexture, .colors = false };
+}
+
 } // namespace all::serenity
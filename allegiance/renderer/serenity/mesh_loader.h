@@ -1,7 +1,9 @@
 #pragma once
+#include <shared/import_profile.h>
 #include <unordered_map>
 #include <filesystem>
 #include <memory>
+#include <memory_resource>
 
 struct aiMesh;
 struct aiMaterial;
@@ -17,8 +19,32 @@ namespace all::serenity {
 class MeshLoader
 {
 public:
-    static std::unique_ptr<Serenity::Entity> load(std::filesystem::path path, Serenity::LayerManager* layerManager);
-    static std::unique_ptr<Serenity::Mesh> MakeMesh(const aiMesh& mesh, const glm::mat4& transform);
-    static std::unique_ptr<Serenity::Material> MakeMaterial(const aiMaterial& mesh, const std::filesystem::path& model_path);
+    // Vertex buffers baked beside positions, for shader locations 1, 2 and 3.
+    // Streams a mesh lacks but its material reads are zero-filled.
+    struct VertexStreams {
+        bool normals{ true };
+        bool texCoords{ true };
+        bool colors{ true };
+    };
+
+    // Average cache miss ratio of the meshes MakeMesh optimized, summed up to be logged once per import
+    struct VertexCacheStatistics {
+        size_t meshCount{ 0 };
+        size_t triangleCount{ 0 };
+        double missesBefore{ 0.0 };
+        double missesAfter{ 0.0 };
+    };
+
+    static std::unique_ptr<Serenity::Entity> load(std::filesystem::path path, Serenity::LayerManager* layerManager,
+                                                  all::ImportProfile profile = all::ImportProfile::FullQuality);
+    // optimizeVertexCache reorders the triangles and vertices for the post-transform and fetch caches,
+    // with temporary buffers taken from scratch, adding the result to cacheStatistics if any
+    static std::unique_ptr<Serenity::Mesh> MakeMesh(const aiMesh& mesh, const glm::mat4& transform, const VertexStreams& streams = {}, bool optimizeVertexCache = true,
+                                                    std::pmr::memory_resource* scratch = std::pmr::get_default_resource(),
+                                                    VertexCacheStatistics* cacheStatistics = nullptr);
+    // Unlit materials draw the diffuse color and only read positions, for models imported for picking
+    static std::unique_ptr<Serenity::Material> MakeMaterial(const aiMaterial& mesh, const std::filesystem::path& model_path, bool unlit = false);
+    // Streams read by the shader MakeMaterial picks for material
+    static VertexStreams MaterialVertexStreams(const aiMaterial& material, bool unlit = false);
 };
 } // namespace all::serenity
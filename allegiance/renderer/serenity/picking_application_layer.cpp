@@ -3,6 +3,8 @@
 #include "cursor.h"
 #include "focus_area.h"
 
+#include <chrono>
+
 using namespace Serenity;
 
 namespace all::serenity {
@@ -69,41 +71,30 @@ void PickingApplicationLayer::handleFocusForFocusArea()
 {
     const glm::vec3 center = focusArea()->center();
     const glm::vec3 extent = focusArea()->extent();
-
-    constexpr size_t AFSamplesY = 2;
-    constexpr size_t AFSamplesX = 2;
-    float averagedDistanceFromCamera = 0.0f;
-    size_t validHits = 0;
-
-    const float xStep = extent.x / (AFSamplesX - 1);
-    const float yStep = extent.y / (AFSamplesY - 1);
-
-    const float xStart = center.x - extent.x * 0.5;
-    const float yStart = center.y - extent.y * 0.5;
-
-    for (size_t y = 0; y < AFSamplesY; ++y) {
-        const float yPos = yStart + y * yStep;
-        for (size_t x = 0; x < AFSamplesX; ++x) {
-            const float xPos = xStart + x * xStep;
-
-            const std::vector<SpatialAspect::Hit> hits = m_spatialAspect->screenCast(glm::vec2(xPos, yPos),
-                                                                                     window()->viewportRect(),
-                                                                                     camera()->viewMatrix(),
-                                                                                     camera()->lens()->projectionMatrix());
-            if (!hits.empty()) {
-                const auto closest = std::ranges::min_element(hits, [](const SpatialAspect::Hit& a, const SpatialAspect::Hit& b) {
-                    return a.distance < b.distance;
-                });
-                averagedDistanceFromCamera += glm::length(closest->position - camera()->position());
-                ++validHits;
-            }
+    const all::FocusSampling& sampling = focusSampling();
+    const auto deadline = std::chrono::steady_clock::now() + sampling.budget;
+
+    // Samples still left when the budget runs out count as misses
+    std::vector<all::FocusSample> samples = all::focusSamples(sampling, glm::vec2(center - extent * 0.5f), glm::vec2(center + extent * 0.5f));
+    for (size_t i = 0; i < samples.size(); ++i) {
+        if (i > 0 && std::chrono::steady_clock::now() > deadline)
+            break;
+
+        const std::vector<SpatialAspect::Hit> hits = m_spatialAspect->screenCast(samples[i].position,
+                                                                                 window()->viewportRect(),
+                                                                                 camera()->viewMatrix(),
+                                                                                 camera()->lens()->projectionMatrix());
+        if (!hits.empty()) {
+            const auto closest = std::ranges::min_element(hits, [](const SpatialAspect::Hit& a, const SpatialAspect::Hit& b) {
+                return a.distance < b.distance;
+            });
+            samples[i].distance = glm::length(closest->position - camera()->position());
         }
     }
 
-    if (validHits > 0) {
-        averagedDistanceFromCamera /= float(validHits);
-        autoFocusDistanceChanged.emit(averagedDistanceFromCamera);
-    }
+    const std::optional<all::FocusEstimate> estimate = all::estimateFocus(sampling, samples);
+    if (estimate && estimate->confidence >= sampling.minConfidence)
+        autoFocusDistanceChanged.emit(estimate->distance);
 }
 
 } // namespace all::serenity
@@ -2,6 +2,7 @@
 
 #include <Serenity/core/application_layer.h>
 #include <kdbindings/property.h>
+#include <shared/focus_sampling.h>
 
 namespace Serenity {
 class StereoCamera;
@@ -19,6 +20,7 @@ public:
 
     KDBindings::Property<bool> autoFocus{ false };
     KDBindings::Property<FocusArea*> focusArea{ nullptr };
+    KDBindings::Property<all::FocusSampling> focusSampling{};
     KDBindings::Property<Cursor*> cursor{ nullptr };
     KDBindings::Property<SerenityWindow*> window{ nullptr };
     KDBindings::Property<Serenity::StereoCamera*> camera{ nullptr };
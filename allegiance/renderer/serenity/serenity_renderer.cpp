@@ -142,7 +142,7 @@ void SerenityRenderer::loadModel(std::filesystem::path file)
     m_sceneRoot->takeEntity(m_model);
 
     // Load Mesh
-    std::unique_ptr<Entity> entity = MeshLoader::load(file, m_layerManager);
+    std::unique_ptr<Entity> entity = MeshLoader::load(file, m_layerManager, m_importProfile);
     m_model = entity.get();
     if (m_model == nullptr)
         return;
@@ -152,6 +152,11 @@ void SerenityRenderer::loadModel(std::filesystem::path file)
     viewAll();
 }
 
+void SerenityRenderer::cancelModelLoad()
+{
+    // Models are loaded synchronously, nothing to cancel
+}
+
 void SerenityRenderer::viewAll()
 {
     if (m_model == nullptr)
@@ -247,6 +252,11 @@ void SerenityRenderer::propertyChanged(std::string_view name, std::any value)
         return;
     }
 
+    if (name == "auto_focus_sampling") {
+        m_pickingLayer->focusSampling = std::any_cast<all::FocusSampling>(value);
+        return;
+    }
+
     if (name == "show_focus_plane") {
         const bool focusPlanePreviewEnabled = std::any_cast<bool>(value);
         m_focusPlanePreview->enabled = focusPlanePreviewEnabled;
@@ -257,6 +267,12 @@ void SerenityRenderer::propertyChanged(std::string_view name, std::any value)
         m_wireframeEnabled = wireframeEnabled;
         updateRenderPhases();
     }
+
+    if (name == "import_profile") {
+        // Applies to the next model load
+        m_importProfile = std::any_cast<ImportProfile>(value);
+        return;
+    }
 }
 
 void SerenityRenderer::setCursorEnabled(bool enabled)
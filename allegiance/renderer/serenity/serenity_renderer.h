@@ -54,6 +54,7 @@ public:
     void createAspects(std::shared_ptr<all::ModelNavParameters> nav_params);
 
     void loadModel(std::filesystem::path file);
+    void cancelModelLoad();
     void loadImage(std::filesystem::path url);
     void viewAll();
 
@@ -144,6 +145,7 @@ protected:
     glm::vec3 m_sceneCenter;
     glm::vec3 m_sceneExtent;
     bool m_wireframeEnabled{ false };
+    ImportProfile m_importProfile{ ImportProfile::FullQuality };
 
     std::function<void(std::string_view, std::any)> m_propertyUpdateNofitier;
 };
@@ -0,0 +1,169 @@
+#pragma once
+#include <shared/vertex_kernels.h>
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace all {
+
+struct Ray {
+    glm::vec3 origin{ 0.0f };
+    glm::vec3 direction{ 0.0f, 0.0f, -1.0f }; // Distances are measured in multiples of its length
+};
+
+// Ray thickened to radius + spread * distance around its axis: a cylinder
+// when spread is 0, a cone with its apex at the origin when radius is 0.
+// The axis direction is expected to be normalized.
+struct Beam {
+    Ray axis;
+    float radius{ 0.0f };
+    float spread{ 0.0f };
+};
+
+struct RayHit {
+    float distance{ 0.0f };
+    glm::vec3 position{ 0.0f };
+    uint32_t triangle{ 0 }; // In the order the triangles were added to their Bvh
+    uint32_t instance{ 0 }; // SceneBvh instance the triangle belongs to
+    glm::vec2 barycentrics{ 0.0f }; // Weights of the second and third corners
+};
+
+struct RayPacket;
+
+// Interior nodes have a count of 0 and their children at first and first + 1,
+// which always come after them. Leaves hold the primitives [first, first + count).
+struct BvhNode {
+    glm::vec3 min;
+    uint32_t first{ 0 };
+    glm::vec3 max;
+    uint32_t count{ 0 };
+};
+
+// Bounding volume hierarchy over triangles, for ray queries on the CPU
+// without going through a renderer.
+//
+// Meshes are added first, then build() partitions their triangles with the
+// surface area heuristic, evaluated at a fixed number of bins per axis. The
+// bins of the large nodes near the root are filled across threads, and the
+// subtrees below them are built concurrently. Triangles are two sided.
+class Bvh
+{
+public:
+    // Appends the triangles of an indexed mesh. positions points to the
+    // first float3 position, transform takes them to the space of the hierarchy.
+    void addMesh(const float* positions, std::size_t positionStride, std::size_t vertexCount,
+                 const uint32_t* indices, std::size_t indexCount, const glm::mat4& transform = glm::mat4(1.0f));
+    void addMesh(const float* positions, std::size_t positionStride, std::size_t vertexCount,
+                 const uint16_t* indices, std::size_t indexCount, const glm::mat4& transform = glm::mat4(1.0f));
+
+    void build();
+
+    bool isEmpty() const { return m_nodes.empty(); }
+    std::size_t triangleCount() const { return m_triangles.size(); }
+    AABB bounds() const;
+
+    // Closest triangle the ray crosses within maxDistance, empty if none or
+    // if the hierarchy hasn't been built
+    std::optional<RayHit> closestHit(const Ray& ray, float maxDistance = std::numeric_limits<float>::max()) const;
+
+    // Closest triangle within the beam, the distance being that of the
+    // triangle point nearest to the axis, measured along it. Triangles are
+    // visited front to back, so when the budget runs out the closest one
+    // found so far is returned.
+    std::optional<RayHit> closestHit(const Beam& beam, float maxDistance = std::numeric_limits<float>::max(),
+                                     std::chrono::nanoseconds budget = std::chrono::nanoseconds::max()) const;
+
+    // closestHit() for count rays, traced four at a time with SSE2. Rays
+    // from one origin through a small screen region mostly cross the same
+    // nodes, which then get tested once for the whole packet.
+    void closestHits(const Ray* rays, std::optional<RayHit>* hits, std::size_t count, float maxDistance = std::numeric_limits<float>::max()) const;
+
+    struct Statistics {
+        std::size_t nodeCount{ 0 };
+        std::size_t leafCount{ 0 };
+        std::size_t maxDepth{ 0 };
+        std::size_t memoryBytes{ 0 };
+        double buildMs{ 0.0 };
+    };
+    const Statistics& statistics() const { return m_statistics; }
+
+    // Flat copy of the built hierarchy, to cache it on disk. deserialize()
+    // leaves the hierarchy empty and returns false if data doesn't come from
+    // serialize() of the same version or isn't consistent.
+    std::vector<uint8_t> serialize() const;
+    bool deserialize(const void* data, std::size_t size);
+
+private:
+    friend class SceneBvh;
+    using Clock = std::chrono::steady_clock;
+
+    template<typename Index>
+    void addTriangles(const float* positions, std::size_t positionStride, std::size_t vertexCount,
+                      const Index* indices, std::size_t indexCount, const glm::mat4& transform);
+
+    std::optional<RayHit> closestHitUntil(const Beam& beam, float maxDistance, Clock::time_point deadline) const;
+    void intersect(RayPacket& packet) const;
+
+    struct Triangle {
+        uint32_t vertices[3];
+        uint32_t id; // Position in the order of addition
+    };
+
+    std::vector<glm::vec3> m_vertices;
+    std::vector<Triangle> m_triangles; // In leaf order once built
+    std::vector<BvhNode> m_nodes;
+    uint32_t m_addedTriangleCount{ 0 };
+    Statistics m_statistics;
+};
+
+// Top level hierarchy over instances of per mesh hierarchies, each placed by
+// its transform. Meshes can be shared by several instances, and replacing one
+// only takes rebuilding its own Bvh and this small hierarchy over the
+// instance bounds.
+class SceneBvh
+{
+public:
+    // Returns the index of the instance, mesh must be built already
+    uint32_t addInstance(std::shared_ptr<const Bvh> mesh, const glm::mat4& transform = glm::mat4(1.0f));
+    void setInstance(uint32_t instance, std::shared_ptr<const Bvh> mesh, const glm::mat4& transform);
+
+    // Rebuilds the hierarchy over the instances, not the meshes
+    void build();
+
+    bool isEmpty() const { return m_nodes.empty(); }
+    std::size_t instanceCount() const { return m_instances.size(); }
+    std::size_t triangleCount() const; // Over every instance
+    AABB bounds() const;
+
+    // Same as the Bvh queries, with hits in world space
+    std::optional<RayHit> closestHit(const Ray& ray, float maxDistance = std::numeric_limits<float>::max()) const;
+    std::optional<RayHit> closestHit(const Beam& beam, float maxDistance = std::numeric_limits<float>::max(),
+                                     std::chrono::nanoseconds budget = std::chrono::nanoseconds::max()) const;
+    void closestHits(const Ray* rays, std::optional<RayHit>* hits, std::size_t count, float maxDistance = std::numeric_limits<float>::max()) const;
+
+    // Sums over the top level hierarchy and every distinct mesh, the build
+    // time being that of the top level alone
+    Bvh::Statistics statistics() const;
+
+private:
+    struct Instance {
+        std::shared_ptr<const Bvh> mesh;
+        glm::mat4 transform;
+        glm::mat4 inverseTransform;
+    };
+
+    std::vector<Instance> m_instances;
+    std::vector<BvhNode> m_nodes;
+    std::vector<uint32_t> m_leafInstances; // Instances in leaf order, empty meshes left out
+    std::size_t m_leafCount{ 0 };
+    std::size_t m_maxDepth{ 0 };
+    double m_buildMs{ 0.0 };
+};
+} // namespace all
@@ -1,6 +1,7 @@
 #pragma once
 #include <glm/glm.hpp>
 #include <functional>
+#include <optional>
 
 namespace all {
 enum class CursorType {
@@ -18,7 +19,10 @@ enum class CursorDisplayMode {
 
 struct ModelNavParameters {
 public:
-    std::function<glm::vec3(glm::vec3, glm::vec3)> hit_test = [](glm::vec3, glm::vec3) { return glm::vec3{ -1 }; };
+    // Closest model point within the cone starting at origin along the unit
+    // direction, its radius growing by spread per unit of distance
+    std::function<std::optional<glm::vec3>(glm::vec3 origin, glm::vec3 direction, float spread)> hit_test =
+            [](glm::vec3, glm::vec3, float) { return std::optional<glm::vec3>{}; };
 
     glm::vec3 min_extent{};
     glm::vec3 max_extent{};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace all {
+class SceneBvh;
+
+// How the focus distance is taken from the depths under the auto focus area
+enum class FocusStatistic {
+    Median,
+    Percentile, // Leans towards the near or far side of the area, see FocusSampling::percentile
+    CenterWeighted // Median with samples counting less towards the edges of the area
+};
+
+struct FocusSampling {
+    static constexpr uint32_t MaxGridSize = 32;
+
+    uint32_t columns{ 8 }; // Both clamped to [1, MaxGridSize]
+    uint32_t rows{ 8 };
+    FocusStatistic statistic{ FocusStatistic::Median };
+    float percentile{ 0.25f }; // 0 focuses on the nearest sample, 1 on the farthest
+    std::chrono::microseconds budget{ 1000 }; // Per evaluation, samples not traced in time count as misses
+    float minConfidence{ 0.2f }; // Below which the focus is better left where it is
+
+    bool operator==(const FocusSampling&) const = default;
+};
+
+struct FocusSample {
+    glm::vec2 position{ 0.0f }; // In the space the area was given in
+    float weight{ 1.0f };
+    float distance{ -1.0f }; // From the eye to what the sample hit, negative if nothing
+};
+
+struct FocusEstimate {
+    float distance{ 0.0f };
+    // Share of the sample weight within 10% of distance. Low when the area
+    // mostly covers the background or straddles objects at different depths.
+    float confidence{ 0.0f };
+    uint32_t hitCount{ 0 };
+};
+
+// Grid of samples spanning the rectangle between two corners, a single column
+// or row going through the middle. Samples come in 2x2 tiles, so that
+// consecutive ones make coherent ray packets, and the tiles go from the middle
+// outwards, so that it gets traced first when time runs short.
+std::vector<FocusSample> focusSamples(const FocusSampling& sampling, glm::vec2 corner0, glm::vec2 corner1);
+
+// Weighted percentile of the distances the samples hit, empty if none hit anything
+std::optional<FocusEstimate> estimateFocus(const FocusSampling& sampling, const std::vector<FocusSample>& samples);
+
+// Traces the samples of an area given in OpenGL normalized device coordinates
+// in packets against the hierarchy, until the budget runs out.
+std::optional<FocusEstimate> traceFocus(const SceneBvh& bvh, const FocusSampling& sampling, const glm::mat4& inverseViewProjection,
+                                        glm::vec2 corner0, glm::vec2 corner1, const glm::vec3& eye);
+} // namespace all
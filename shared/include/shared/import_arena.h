@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace all {
+
+// Scratch memory of a single model import.
+//
+// Each thread taking part in the import gets its own monotonic sub-arena, so
+// that the many short lived buffers of a job come out of one block instead of
+// the heap, without any locking. When a job ends, its sub-arena starts over
+// from a block large enough for everything the job took, so that a thread
+// ends up with one block sized for its largest job. Everything is given back
+// at once when the arena is destroyed, at the end of the import.
+class ImportArena
+{
+    class ThreadArena;
+
+public:
+    ImportArena();
+    ~ImportArena();
+
+    ImportArena(const ImportArena&) = delete;
+    ImportArena& operator=(const ImportArena&) = delete;
+
+    struct Statistics {
+        std::size_t allocationCount{ 0 }; // Served by the sub-arenas
+        std::size_t heapAllocationCount{ 0 }; // Blocks the sub-arenas took from the heap
+        std::size_t peakBytes{ 0 }; // Largest job of each thread, summed up
+        std::size_t threadCount{ 0 };
+    };
+    // Only meaningful while no job is running
+    Statistics statistics() const;
+
+    // Scope of a job on the calling thread, its allocations are valid until
+    // the scope ends. Jobs can nest, the sub-arena only starts over when the
+    // outermost one ends. Without an arena, allocations go to the default
+    // memory resource.
+    class Job
+    {
+    public:
+        explicit Job(ImportArena* arena);
+        ~Job();
+
+        Job(const Job&) = delete;
+        Job& operator=(const Job&) = delete;
+
+        std::pmr::memory_resource* resource() const;
+
+    private:
+        ThreadArena* m_threadArena{ nullptr };
+    };
+
+private:
+    ThreadArena* threadArena();
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::thread::id, std::unique_ptr<ThreadArena>> m_threadArenas;
+};
+} // namespace all
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string_view>
+
+namespace all {
+// What an imported model is going to be used for, each renderer maps it onto
+// the processing steps and vertex attributes worth paying for
+enum class ImportProfile {
+    FullQuality, // Joined vertices reordered for the GPU caches, with levels of detail
+    FastPreview, // Vertices as read from the file, missing normals are still generated
+    PickingOnly // Positions and triangles only, for hit testing
+};
+
+constexpr std::string_view importProfileName(ImportProfile profile)
+{
+    switch (profile) {
+    case ImportProfile::FullQuality:
+        return "full quality";
+    case ImportProfile::FastPreview:
+        return "fast preview";
+    case ImportProfile::PickingOnly:
+        return "picking only";
+    }
+    return {};
+}
+} // namespace all
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace all {
+
+// Triangle and vertex reordering and simplification applied to indexed
+// triangle lists at import.
+//
+// The passes are meant to be chained: optimizeVertexCache first, then
+// optionally optimizeOverdraw, and optimizeVertexFetch last since it
+// renumbers the vertices in the order the reordered triangles use them.
+// Temporary buffers of each pass come from its scratch memory resource.
+namespace mesh_optimizer {
+// FIFO cache size used to estimate the post-transform cache efficiency
+constexpr std::size_t DefaultCacheSize = 16;
+// ACMR increase optimizeOverdraw tolerates
+constexpr float DefaultOverdrawThreshold = 1.05f;
+
+// Average cache miss ratio: vertex shader invocations per triangle, between
+// 0.5 in the best case and 3 when no vertex is ever reused
+float acmr(const uint32_t* indices, std::size_t indexCount, std::size_t vertexCount,
+           std::size_t cacheSize = DefaultCacheSize, std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+// Reorders the triangles for post-transform cache locality, following Tom
+// Forsyth's "Linear-Speed Vertex Cache Optimisation"
+void optimizeVertexCache(uint32_t* indices, std::size_t indexCount, std::size_t vertexCount,
+                         std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+// Reorders clusters of triangles so that outward facing ones come first,
+// which reduces overdraw from most view points. Clusters are delimited where
+// the cache optimized order starts over, the new order is dropped if it
+// raises the ACMR by more than threshold.
+// positions holds vertexCount xyz float triplets, positionStride bytes apart.
+void optimizeOverdraw(uint32_t* indices, std::size_t indexCount,
+                      const float* positions, std::size_t positionStride, std::size_t vertexCount,
+                      float threshold = DefaultOverdrawThreshold, std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+// Renumbers the vertices in order of first use and returns the remap table,
+// remap[oldIndex] == newIndex, allocated from scratch. Unused vertices are moved to the end.
+std::pmr::vector<uint32_t> optimizeVertexFetch(uint32_t* indices, std::size_t indexCount, std::size_t vertexCount,
+                                               std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+// Applies a remap table returned by optimizeVertexFetch to vertexCount
+// vertices of vertexByteSize bytes each
+void remapVertices(const std::pmr::vector<uint32_t>& remap, void* vertices, std::size_t vertexByteSize,
+                   std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+// Simplifies the mesh down to about targetIndexCount indices using quadric
+// error metrics. Edges collapse onto one of their vertices, so that the
+// result keeps indexing the same vertices. Vertices on borders, which include
+// attribute seams, never move. Stops early once a collapse would deviate from
+// the mesh by more than targetError, relative to the mesh extent.
+// If resultError isn't null, it receives the deviation reached.
+std::vector<uint32_t> simplify(const uint32_t* indices, std::size_t indexCount,
+                               const float* positions, std::size_t positionStride, std::size_t vertexCount,
+                               std::size_t targetIndexCount, float targetError, float* resultError = nullptr,
+                               std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+} // namespace mesh_optimizer
+} // namespace all
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+struct aiMesh;
+struct aiScene;
+
+namespace all {
+class ImportArena;
+
+// Replacements for assimp's aiProcess_GenNormals and
+// aiProcess_JoinIdenticalVertices, which run on a single thread inside the
+// importer. Large meshes are processed across all cores.
+//
+// Meshes are expected to be triangulated already, polygons are supported but
+// points and lines get zero normals.
+namespace mesh_processing {
+// Whether the functions below can process every mesh of scene. Meshes with
+// bones or morph targets are left to assimp.
+bool canProcess(const aiScene& scene);
+
+// Generates normals for a mesh without any, weighting the normals of the faces
+// sharing a vertex by the angle they make at that vertex. Faces only contribute
+// if their normal is within creaseAngle degrees of the normal of the face the
+// vertex belongs to, 0 gives flat normals like aiProcess_GenNormals does.
+// Vertices end up owned by a single face, joinIdenticalVertices shares them again.
+// Returns false if the mesh already had normals. Temporary buffers come from scratch.
+bool generateNormals(aiMesh& mesh, float creaseAngle, std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+// Merges vertices with identical attributes and remaps the faces, keeping the
+// vertices in order of first occurrence. Attributes are compared with their
+// lowest 8 mantissa bits rounded off, close to the tolerance assimp uses.
+// Returns the number of vertices removed. Temporary buffers come from scratch.
+std::size_t joinIdenticalVertices(aiMesh& mesh, std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+struct SceneReport {
+    std::size_t normalMeshCount{ 0 }; // Meshes normals were generated for
+    std::size_t vertexCountBefore{ 0 };
+    std::size_t vertexCountAfter{ 0 };
+    double normalsMs{ 0.0 };
+    double joinMs{ 0.0 };
+};
+
+struct SceneOptions {
+    bool generateNormals{ true }; // For the meshes without any
+    float normalCreaseAngle{ 0.0f };
+    bool joinIdenticalVertices{ true };
+};
+
+// Runs the steps enabled in options on every mesh of scene, which canProcess
+// must accept. Each step of each mesh is a job of arena, if any.
+SceneReport processScene(aiScene& scene, const SceneOptions& options, ImportArena* arena = nullptr);
+} // namespace mesh_processing
+} // namespace all
@@ -71,6 +71,7 @@ protected:
     double hit_aperture{};
     navlib::vector_t hit_direction{};
     navlib::point_t hit_source{};
+    bool hit_selection_only{ false };
 
     std::unordered_map<std::string, std::function<void()>> m_commands;
 };
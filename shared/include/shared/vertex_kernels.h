@@ -0,0 +1,67 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <limits>
+
+namespace all {
+struct AABB {
+    glm::vec3 min{ std::numeric_limits<float>::max() };
+    glm::vec3 max{ std::numeric_limits<float>::lowest() };
+
+    bool isValid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extent() const { return max - min; }
+
+    void expand(const glm::vec3& p)
+    {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+    void expand(const AABB& other)
+    {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+};
+
+// Batched vertex transforms used when baking meshes.
+//
+// AoS arrays are described by a pointer to the first vec3 and a byte stride,
+// so that the kernels can read the tightly packed assimp arrays and write
+// straight into interleaved vertex buffers. The AVX2 path is selected at
+// runtime, SSE2 is used otherwise on x86 and a scalar fallback everywhere else.
+//
+// Transforms are assumed to be affine, the projective row is ignored.
+namespace vertex_kernels {
+// Transforms count positions by transform. If bounds isn't null, it is grown
+// to include the transformed positions.
+void transformPositions(const glm::mat4& transform,
+                        const float* src, std::size_t srcStride,
+                        float* dst, std::size_t dstStride,
+                        std::size_t count, AABB* bounds = nullptr);
+
+// Transforms count normals by normalMatrix and normalizes them.
+// Zero length normals are left at zero.
+void transformNormals(const glm::mat3& normalMatrix,
+                      const float* src, std::size_t srcStride,
+                      float* dst, std::size_t dstStride,
+                      std::size_t count);
+
+// SoA variants, each component lives in its own tightly packed array.
+// src and dst may alias.
+struct Vec3Arrays {
+    float* x{ nullptr };
+    float* y{ nullptr };
+    float* z{ nullptr };
+};
+
+void transformPositions(const glm::mat4& transform, const Vec3Arrays& src, const Vec3Arrays& dst,
+                        std::size_t count, AABB* bounds = nullptr);
+void transformNormals(const glm::mat3& normalMatrix, const Vec3Arrays& src, const Vec3Arrays& dst,
+                      std::size_t count);
+
+// Name of the instruction set the kernels dispatch to: "avx2", "sse2" or "scalar"
+const char* activeInstructionSet();
+} // namespace vertex_kernels
+} // namespace all
@@ -0,0 +1,1107 @@
+#include <shared/bvh.h>
+
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_set>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ALLEGIANCE_BVH_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(ALLEGIANCE_BVH_SSE2)
+namespace all {
+// Rays traced together, stored lane by lane. Lanes without a ray have a
+// negative distance, which nothing can be hit closer than.
+struct RayPacket {
+    static constexpr std::size_t Size = 4;
+    static constexpr uint32_t NoHit = ~0u;
+
+    alignas(16) float origin[3][Size];
+    alignas(16) float direction[3][Size];
+    alignas(16) float inverseDirection[3][Size];
+    alignas(16) float distance[Size]; // Of the closest hit so far, the maximum distance until then
+    alignas(16) float u[Size];
+    alignas(16) float v[Size];
+    uint32_t triangle[Size];
+    uint32_t instance[Size];
+};
+} // namespace all
+#endif
+
+namespace {
+using all::detail::parallelFor;
+using all::detail::workerThreadCount;
+using Clock = std::chrono::steady_clock;
+
+constexpr std::size_t BinCount = 16;
+constexpr std::size_t MinLeafSize = 2; // Never split below that
+constexpr std::size_t MaxLeafSize = 16; // Split above that even when the heuristic advises against it
+constexpr std::size_t MaxDepth = 63; // Bounds the traversal stack
+constexpr float TraversalCost = 1.0f; // Relative to intersecting a triangle
+constexpr std::size_t ParallelBinningSize = std::size_t(1) << 16; // Nodes with more primitives get binned across threads
+constexpr std::size_t BinningGrain = std::size_t(1) << 15;
+constexpr std::size_t MinSubtreeSize = std::size_t(1) << 12; // Smaller subtrees aren't worth a task of their own
+constexpr std::size_t ClockCheckInterval = 32; // Nodes visited between two looks at the clock by bounded queries
+
+float surfaceArea(const all::AABB& bounds)
+{
+    if (!bounds.isValid())
+        return 0.0f;
+    const glm::vec3 extent = bounds.extent();
+    return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+struct Bin {
+    all::AABB bounds;
+    std::size_t count{ 0 };
+};
+
+// Distance at which the ray enters the box, or infinity if it misses it before maxDistance
+float intersectBox(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance)
+{
+    const glm::vec3 t0 = (min - origin) * inverseDirection;
+    const glm::vec3 t1 = (max - origin) * inverseDirection;
+    const glm::vec3 entries = glm::min(t0, t1);
+    const glm::vec3 exits = glm::max(t0, t1);
+    const float entry = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+    const float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, maxDistance));
+    return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+}
+
+// Möller-Trumbore, two sided
+bool intersectTriangle(const all::Ray& ray, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float& distance, glm::vec2& barycentrics)
+{
+    constexpr float Epsilon = 1e-12f;
+    const glm::vec3 edge1 = b - a;
+    const glm::vec3 edge2 = c - a;
+    const glm::vec3 p = glm::cross(ray.direction, edge2);
+    const float determinant = glm::dot(edge1, p);
+    if (std::abs(determinant) < Epsilon)
+        return false;
+
+    const float inverseDeterminant = 1.0f / determinant;
+    const glm::vec3 s = ray.origin - a;
+    const float u = glm::dot(s, p) * inverseDeterminant;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+    const glm::vec3 q = glm::cross(s, edge1);
+    const float v = glm::dot(ray.direction, q) * inverseDeterminant;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+
+    distance = glm::dot(edge2, q) * inverseDeterminant;
+    barycentrics = { u, v };
+    return distance >= 0.0f;
+}
+
+// Closest points between a ray with a unit direction and the segment [p0, p1],
+// as the distance along the ray and the fraction of the segment. Returns the
+// gap between them.
+float closestPointsToSegment(const all::Ray& ray, const glm::vec3& p0, const glm::vec3& p1, float& distance, float& fraction)
+{
+    const glm::vec3 edge = p1 - p0;
+    const glm::vec3 r = ray.origin - p0;
+    const float edgeLengthSquared = glm::dot(edge, edge);
+    const float b = glm::dot(ray.direction, edge);
+    const float c = glm::dot(ray.direction, r);
+    const float f = glm::dot(edge, r);
+
+    if (edgeLengthSquared < 1e-20f) {
+        fraction = 0.0f;
+        distance = std::max(-c, 0.0f);
+    } else {
+        const float denominator = edgeLengthSquared - b * b;
+        distance = denominator > 1e-12f * edgeLengthSquared ? std::max((b * f - c * edgeLengthSquared) / denominator, 0.0f) : 0.0f;
+        fraction = (b * distance + f) / edgeLengthSquared;
+        if (fraction < 0.0f) {
+            fraction = 0.0f;
+            distance = std::max(-c, 0.0f);
+        } else if (fraction > 1.0f) {
+            fraction = 1.0f;
+            distance = std::max(b - c, 0.0f);
+        }
+    }
+    return glm::length(ray.origin + ray.direction * distance - (p0 + edge * fraction));
+}
+
+// Bins of the three axes over a range of primitives
+struct Binning {
+    std::array<std::array<Bin, BinCount>, 3> bins;
+};
+
+// Binned SAH construction over primitive bounds, shared by the triangle and
+// instance hierarchies. order ends up listing the primitives in leaf order.
+class HierarchyBuilder
+{
+public:
+    HierarchyBuilder(const std::vector<all::AABB>& primitiveBounds, std::vector<uint32_t>& order)
+        : m_bounds(primitiveBounds), m_centroids(primitiveBounds.size()), m_order(order)
+    {
+        parallelFor(m_bounds.size(), BinningGrain, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i)
+                m_centroids[i] = m_bounds[i].center();
+        });
+        m_order.resize(m_bounds.size());
+        std::iota(m_order.begin(), m_order.end(), 0);
+    }
+
+    void build(std::vector<all::BvhNode>& nodes, std::size_t& leafCount, std::size_t& maxDepth)
+    {
+        const std::size_t primitiveCount = m_bounds.size();
+        nodes.clear();
+        leafCount = 0;
+        maxDepth = 0;
+        if (primitiveCount == 0)
+            return;
+        nodes.reserve(2 * primitiveCount);
+        nodes.push_back({ {}, 0, {}, uint32_t(primitiveCount) });
+
+        // The top of the tree gets split here, each split binning across
+        // threads. What's below is left to subtree tasks, a few per thread so
+        // that uneven subtrees still keep every thread busy.
+        const std::size_t threadCount = workerThreadCount();
+        const std::size_t subtreeSize = std::max(MinSubtreeSize, primitiveCount / (4 * threadCount));
+        std::vector<Task> tasks{ { 0, 0 } };
+        std::vector<Task> subtrees;
+        while (!tasks.empty()) {
+            const Task task = tasks.back();
+            tasks.pop_back();
+            if (nodes[task.node].count < subtreeSize) {
+                subtrees.push_back(task);
+                continue;
+            }
+            splitNode(nodes, task, tasks, leafCount, maxDepth, nodes[task.node].count >= ParallelBinningSize);
+        }
+
+        struct Subtree {
+            std::vector<all::BvhNode> nodes;
+            std::size_t leafCount{ 0 };
+            std::size_t maxDepth{ 0 };
+        };
+        std::vector<Subtree> built(subtrees.size());
+        parallelFor(subtrees.size(), 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                Subtree& subtree = built[i];
+                subtree.nodes.push_back(nodes[subtrees[i].node]);
+                std::vector<Task> subtreeTasks{ { 0, subtrees[i].depth } };
+                while (!subtreeTasks.empty()) {
+                    const Task task = subtreeTasks.back();
+                    subtreeTasks.pop_back();
+                    splitNode(subtree.nodes, task, subtreeTasks, subtree.leafCount, subtree.maxDepth, false);
+                }
+            }
+        });
+
+        // The subtree root takes the place of the node it was built from, its
+        // descendants get appended with their child indices shifted
+        for (std::size_t i = 0; i < built.size(); ++i) {
+            const Subtree& subtree = built[i];
+            const uint32_t offset = uint32_t(nodes.size()) - 1;
+            auto relocated = [offset](all::BvhNode node) {
+                if (node.count == 0)
+                    node.first += offset;
+                return node;
+            };
+            nodes[subtrees[i].node] = relocated(subtree.nodes.front());
+            for (std::size_t j = 1; j < subtree.nodes.size(); ++j)
+                nodes.push_back(relocated(subtree.nodes[j]));
+            leafCount += subtree.leafCount;
+            maxDepth = std::max(maxDepth, subtree.maxDepth);
+        }
+        nodes.shrink_to_fit();
+    }
+
+private:
+    struct Task {
+        uint32_t node;
+        std::size_t depth;
+    };
+
+    // Fits the node to its primitives and splits them in two children, queued
+    // as new tasks, unless the heuristic prefers a leaf
+    void splitNode(std::vector<all::BvhNode>& nodes, const Task& task, std::vector<Task>& tasks, std::size_t& leafCount, std::size_t& maxDepth, bool parallel)
+    {
+        const uint32_t first = nodes[task.node].first;
+        const uint32_t count = nodes[task.node].count;
+
+        // Large nodes get one partial result per range of primitives, merged
+        // afterwards, so that the tree doesn't depend on the number of threads
+        auto fitRange = [&](std::size_t begin, std::size_t end, all::AABB& bounds, all::AABB& centroidBounds) {
+            for (std::size_t i = begin; i < end; ++i) {
+                bounds.expand(m_bounds[m_order[i]]);
+                centroidBounds.expand(m_centroids[m_order[i]]);
+            }
+        };
+        all::AABB bounds;
+        all::AABB centroidBounds;
+        if (parallel) {
+            std::vector<std::pair<all::AABB, all::AABB>> rangeBounds((count + BinningGrain - 1) / BinningGrain);
+            parallelFor(count, BinningGrain, [&](std::size_t begin, std::size_t end) {
+                auto& [rangeBox, rangeCentroidBox] = rangeBounds[begin / BinningGrain];
+                fitRange(first + begin, first + end, rangeBox, rangeCentroidBox);
+            });
+            for (const auto& [rangeBox, rangeCentroidBox] : rangeBounds) {
+                bounds.expand(rangeBox);
+                centroidBounds.expand(rangeCentroidBox);
+            }
+        } else {
+            fitRange(first, first + count, bounds, centroidBounds);
+        }
+        nodes[task.node].min = bounds.min;
+        nodes[task.node].max = bounds.max;
+        maxDepth = std::max(maxDepth, task.depth);
+
+        const glm::vec3 centroidExtent = centroidBounds.extent();
+        glm::vec3 binScales(0.0f);
+        for (int axis = 0; axis < 3; ++axis)
+            binScales[axis] = centroidExtent[axis] > 0.0f ? float(BinCount) / centroidExtent[axis] : 0.0f;
+        auto binOf = [&](uint32_t primitive, int axis) {
+            return std::min(BinCount - 1, std::size_t((m_centroids[primitive][axis] - centroidBounds.min[axis]) * binScales[axis]));
+        };
+
+        // Cheapest split over the bins of every axis
+        const float leafCost = float(count);
+        float bestCost = std::numeric_limits<float>::max();
+        int bestAxis = -1;
+        std::size_t bestSplit = 0;
+        if (count > MinLeafSize && task.depth < MaxDepth) {
+            auto binRange = [&](std::size_t begin, std::size_t end, Binning& binning) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    if (binScales[axis] == 0.0f)
+                        continue;
+                    for (std::size_t i = begin; i < end; ++i) {
+                        Bin& bin = binning.bins[axis][binOf(m_order[i], axis)];
+                        bin.bounds.expand(m_bounds[m_order[i]]);
+                        ++bin.count;
+                    }
+                }
+            };
+            Binning binning;
+            if (parallel) {
+                std::vector<Binning> rangeBins((count + BinningGrain - 1) / BinningGrain);
+                parallelFor(count, BinningGrain, [&](std::size_t begin, std::size_t end) {
+                    binRange(first + begin, first + end, rangeBins[begin / BinningGrain]);
+                });
+                for (const Binning& rangeBinning : rangeBins) {
+                    for (int axis = 0; axis < 3; ++axis) {
+                        for (std::size_t bin = 0; bin < BinCount; ++bin) {
+                            binning.bins[axis][bin].bounds.expand(rangeBinning.bins[axis][bin].bounds);
+                            binning.bins[axis][bin].count += rangeBinning.bins[axis][bin].count;
+                        }
+                    }
+                }
+            } else {
+                binRange(first, first + count, binning);
+            }
+
+            const float inverseArea = 1.0f / std::max(surfaceArea(bounds), std::numeric_limits<float>::min());
+            for (int axis = 0; axis < 3; ++axis) {
+                if (binScales[axis] == 0.0f)
+                    continue;
+                const std::array<Bin, BinCount>& bins = binning.bins[axis];
+
+                // Cost of the left side of each split, then added to the right side's
+                std::array<float, BinCount - 1> costs;
+                all::AABB left;
+                std::size_t leftCount = 0;
+                for (std::size_t split = 0; split + 1 < BinCount; ++split) {
+                    left.expand(bins[split].bounds);
+                    leftCount += bins[split].count;
+                    costs[split] = leftCount > 0 ? surfaceArea(left) * float(leftCount) : 0.0f;
+                }
+                all::AABB right;
+                std::size_t rightCount = 0;
+                for (std::size_t split = BinCount - 1; split > 0; --split) {
+                    right.expand(bins[split].bounds);
+                    rightCount += bins[split].count;
+                    if (rightCount == 0 || rightCount == count)
+                        continue;
+                    const float cost = TraversalCost + (costs[split - 1] + surfaceArea(right) * float(rightCount)) * inverseArea;
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = split;
+                    }
+                }
+            }
+        }
+
+        if (bestAxis < 0 || (bestCost >= leafCost && count <= MaxLeafSize)) {
+            ++leafCount;
+            return;
+        }
+
+        auto* middle = std::partition(m_order.data() + first, m_order.data() + first + count, [&](uint32_t primitive) {
+            return binOf(primitive, bestAxis) < bestSplit;
+        });
+        const uint32_t leftCount = uint32_t(middle - (m_order.data() + first));
+
+        const uint32_t leftChild = uint32_t(nodes.size());
+        nodes.push_back({ {}, first, {}, leftCount });
+        nodes.push_back({ {}, first + leftCount, {}, count - leftCount });
+        nodes[task.node].first = leftChild;
+        nodes[task.node].count = 0;
+        tasks.push_back({ leftChild + 1, task.depth + 1 });
+        tasks.push_back({ leftChild, task.depth + 1 });
+    }
+
+    const std::vector<all::AABB>& m_bounds;
+    std::vector<glm::vec3> m_centroids;
+    std::vector<uint32_t>& m_order;
+};
+
+// Visits the nodes front to back. enter(node) returns the distance the query
+// enters the node at, infinity if it misses it, and visitLeaf(node) tests
+// the primitives of a leaf, lowering closestDistance on hits. Queries with a
+// deadline stop there, leaving the closest hit found so far.
+template<typename Enter, typename VisitLeaf>
+void traverse(const std::vector<all::BvhNode>& nodes, const float& closestDistance, const Enter& enter, const VisitLeaf& visitLeaf,
+              Clock::time_point deadline = Clock::time_point::max())
+{
+    if (nodes.empty())
+        return;
+
+    // Nodes to visit along with the distance the query enters them at, which
+    // might be beyond the closest hit by the time they get popped
+    struct Entry {
+        uint32_t node;
+        float distance;
+    };
+    std::array<Entry, MaxDepth + 1> stack;
+    std::size_t stackSize = 0;
+    const float rootEntry = enter(nodes[0]);
+    if (rootEntry == std::numeric_limits<float>::infinity())
+        return;
+    stack[stackSize++] = { 0, rootEntry };
+
+    const bool bounded = deadline != Clock::time_point::max();
+    std::size_t visitedCount = 0;
+    while (stackSize > 0) {
+        if (bounded && ++visitedCount % ClockCheckInterval == 0 && Clock::now() > deadline)
+            return;
+
+        const Entry entry = stack[--stackSize];
+        if (entry.distance > closestDistance)
+            continue;
+        const all::BvhNode& node = nodes[entry.node];
+        if (node.count > 0) {
+            visitLeaf(node);
+            continue;
+        }
+
+        // Nearest child last, so that it gets visited first and shrinks the distance the other one is tested against
+        const float leftEntry = enter(nodes[node.first]);
+        const float rightEntry = enter(nodes[node.first + 1]);
+        const bool leftFirst = leftEntry <= rightEntry;
+        const float nearEntry = leftFirst ? leftEntry : rightEntry;
+        const float farEntry = leftFirst ? rightEntry : leftEntry;
+        if (farEntry != std::numeric_limits<float>::infinity())
+            stack[stackSize++] = { leftFirst ? node.first + 1 : node.first, farEntry };
+        if (nearEntry != std::numeric_limits<float>::infinity())
+            stack[stackSize++] = { leftFirst ? node.first : node.first + 1, nearEntry };
+    }
+}
+
+// Zero components would give NaNs for rays starting on a slab
+glm::vec3 inverseDirection(const glm::vec3& direction)
+{
+    auto inverse = [](float d) {
+        constexpr float Tiny = 1e-30f;
+        return 1.0f / (std::abs(d) > Tiny ? d : std::copysign(Tiny, d));
+    };
+    return { inverse(direction.x), inverse(direction.y), inverse(direction.z) };
+}
+
+// Box test for beams: the box grown by the beam radius at the farthest
+// distance any of its points projects to on the axis. Whatever lies within
+// the beam inside the box is then within the grown box around the axis, at
+// its own distance.
+float enterBeam(const all::BvhNode& node, const all::Beam& beam, const glm::vec3& inverseDirection, float closestDistance)
+{
+    const glm::vec3 center = (node.min + node.max) * 0.5f;
+    const glm::vec3 halfExtent = (node.max - node.min) * 0.5f;
+    const float farthest = glm::dot(center - beam.axis.origin, beam.axis.direction) + glm::dot(halfExtent, glm::abs(beam.axis.direction));
+    const float radius = beam.radius + beam.spread * std::max(std::min(farthest, closestDistance), 0.0f);
+    return intersectBox(node.min - radius, node.max + radius, beam.axis.origin, inverseDirection, closestDistance);
+}
+
+Clock::time_point deadlineAfter(std::chrono::nanoseconds budget)
+{
+    const Clock::time_point now = Clock::now();
+    if (budget >= Clock::time_point::max() - now)
+        return Clock::time_point::max();
+    return now + std::chrono::duration_cast<Clock::duration>(budget);
+}
+
+#if defined(ALLEGIANCE_BVH_SSE2)
+// One float per ray of a packet
+struct Lanes {
+    __m128 v;
+
+    static Lanes splat(float f) { return { _mm_set1_ps(f) }; }
+    static Lanes load(const float* p) { return { _mm_load_ps(p) }; }
+    void store(float* p) const { _mm_store_ps(p, v); }
+};
+// All bits set in the lanes a comparison holds for
+struct LaneMask {
+    __m128 v;
+};
+
+Lanes operator+(Lanes a, Lanes b) { return { _mm_add_ps(a.v, b.v) }; }
+Lanes operator-(Lanes a, Lanes b) { return { _mm_sub_ps(a.v, b.v) }; }
+Lanes operator*(Lanes a, Lanes b) { return { _mm_mul_ps(a.v, b.v) }; }
+Lanes operator/(Lanes a, Lanes b) { return { _mm_div_ps(a.v, b.v) }; }
+Lanes min(Lanes a, Lanes b) { return { _mm_min_ps(a.v, b.v) }; }
+Lanes max(Lanes a, Lanes b) { return { _mm_max_ps(a.v, b.v) }; }
+Lanes abs(Lanes a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+LaneMask operator<(Lanes a, Lanes b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+LaneMask operator<=(Lanes a, Lanes b) { return { _mm_cmple_ps(a.v, b.v) }; }
+LaneMask operator&(LaneMask a, LaneMask b) { return { _mm_and_ps(a.v, b.v) }; }
+Lanes select(LaneMask mask, Lanes a, Lanes b) { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+int laneBits(LaneMask mask) { return _mm_movemask_ps(mask.v); }
+
+float smallestLane(Lanes lanes)
+{
+    __m128 v = _mm_min_ps(lanes.v, _mm_shuffle_ps(lanes.v, lanes.v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+float largestLane(Lanes lanes)
+{
+    __m128 v = _mm_max_ps(lanes.v, _mm_shuffle_ps(lanes.v, lanes.v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+struct PacketRays {
+    Lanes origin[3];
+    Lanes direction[3];
+    Lanes inverseDirection[3];
+};
+
+PacketRays loadRays(const all::RayPacket& packet)
+{
+    PacketRays rays;
+    for (int axis = 0; axis < 3; ++axis) {
+        rays.origin[axis] = Lanes::load(packet.origin[axis]);
+        rays.direction[axis] = Lanes::load(packet.direction[axis]);
+        rays.inverseDirection[axis] = Lanes::load(packet.inverseDirection[axis]);
+    }
+    return rays;
+}
+
+void setPacketRay(all::RayPacket& packet, std::size_t lane, const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+{
+    const glm::vec3 inverse = inverseDirection(direction);
+    for (int axis = 0; axis < 3; ++axis) {
+        packet.origin[axis][lane] = origin[axis];
+        packet.direction[axis][lane] = direction[axis];
+        packet.inverseDirection[axis][lane] = inverse[axis];
+    }
+    packet.distance[lane] = maxDistance;
+}
+
+all::RayPacket createPacket(const all::Ray* rays, std::size_t count, float maxDistance)
+{
+    all::RayPacket packet{};
+    for (std::size_t lane = 0; lane < all::RayPacket::Size; ++lane) {
+        packet.triangle[lane] = all::RayPacket::NoHit;
+        if (lane < count)
+            setPacketRay(packet, lane, rays[lane].origin, rays[lane].direction, maxDistance);
+        else
+            setPacketRay(packet, lane, glm::vec3(0.0f), glm::vec3(0.0f), -1.0f);
+    }
+    return packet;
+}
+
+void readPacketHits(const all::RayPacket& packet, const all::Ray* rays, std::size_t count, std::optional<all::RayHit>* hits)
+{
+    for (std::size_t lane = 0; lane < count; ++lane) {
+        if (packet.triangle[lane] == all::RayPacket::NoHit) {
+            hits[lane].reset();
+            continue;
+        }
+        const float distance = packet.distance[lane];
+        hits[lane] = all::RayHit{ distance, rays[lane].origin + rays[lane].direction * distance, packet.triangle[lane], packet.instance[lane],
+                                  { packet.u[lane], packet.v[lane] } };
+    }
+}
+
+// Distances the rays enter the box at, infinity for those that miss it
+// before their closest hit
+Lanes enterBox(const all::BvhNode& node, const PacketRays& rays, Lanes closestDistance)
+{
+    Lanes entry = Lanes::splat(0.0f);
+    Lanes exit = closestDistance;
+    for (int axis = 0; axis < 3; ++axis) {
+        const Lanes t0 = (Lanes::splat(node.min[axis]) - rays.origin[axis]) * rays.inverseDirection[axis];
+        const Lanes t1 = (Lanes::splat(node.max[axis]) - rays.origin[axis]) * rays.inverseDirection[axis];
+        entry = max(entry, min(t0, t1));
+        exit = min(exit, max(t0, t1));
+    }
+    return select(entry <= exit, entry, Lanes::splat(std::numeric_limits<float>::infinity()));
+}
+
+// intersectTriangle() for every ray of the packet, updating the lanes that
+// hit the triangle closer than their closest hit so far
+int intersectTriangle(const PacketRays& rays, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, Lanes& distance, Lanes& u, Lanes& v)
+{
+    constexpr float Epsilon = 1e-12f;
+    const glm::vec3 edge1 = b - a;
+    const glm::vec3 edge2 = c - a;
+    const Lanes e1[3] = { Lanes::splat(edge1.x), Lanes::splat(edge1.y), Lanes::splat(edge1.z) };
+    const Lanes e2[3] = { Lanes::splat(edge2.x), Lanes::splat(edge2.y), Lanes::splat(edge2.z) };
+    const Lanes* d = rays.direction;
+
+    const Lanes p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+    const Lanes determinant = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    const Lanes inverseDeterminant = Lanes::splat(1.0f) / determinant;
+    const Lanes s[3] = { rays.origin[0] - Lanes::splat(a.x), rays.origin[1] - Lanes::splat(a.y), rays.origin[2] - Lanes::splat(a.z) };
+    const Lanes hitU = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverseDeterminant;
+    const Lanes q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+    const Lanes hitV = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inverseDeterminant;
+    const Lanes hitDistance = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inverseDeterminant;
+
+    const Lanes zero = Lanes::splat(0.0f);
+    const Lanes one = Lanes::splat(1.0f);
+    const LaneMask hit = (Lanes::splat(Epsilon) <= abs(determinant)) & (zero <= hitU) & (hitU <= one) & (zero <= hitV) & (hitU + hitV <= one) &
+            (zero <= hitDistance) & (hitDistance < distance);
+    distance = select(hit, hitDistance, distance);
+    u = select(hit, hitU, u);
+    v = select(hit, hitV, v);
+    return laneBits(hit);
+}
+
+// traverse() for packets: a node is visited when any ray of the packet
+// enters it, the nearest child for the packet first
+template<typename VisitLeaf>
+void traversePacket(const std::vector<all::BvhNode>& nodes, const PacketRays& rays, const float* closestDistance, const VisitLeaf& visitLeaf)
+{
+    if (nodes.empty())
+        return;
+
+    struct Entry {
+        uint32_t node;
+        float distance; // Nearest entry over the rays of the packet
+    };
+    std::array<Entry, MaxDepth + 1> stack;
+    std::size_t stackSize = 0;
+    const float rootEntry = smallestLane(enterBox(nodes[0], rays, Lanes::load(closestDistance)));
+    if (rootEntry == std::numeric_limits<float>::infinity())
+        return;
+    stack[stackSize++] = { 0, rootEntry };
+
+    while (stackSize > 0) {
+        const Entry entry = stack[--stackSize];
+        const Lanes distance = Lanes::load(closestDistance);
+        if (entry.distance > largestLane(distance))
+            continue;
+        const all::BvhNode& node = nodes[entry.node];
+        if (node.count > 0) {
+            visitLeaf(node);
+            continue;
+        }
+
+        const float leftEntry = smallestLane(enterBox(nodes[node.first], rays, distance));
+        const float rightEntry = smallestLane(enterBox(nodes[node.first + 1], rays, distance));
+        const bool leftFirst = leftEntry <= rightEntry;
+        const float nearEntry = leftFirst ? leftEntry : rightEntry;
+        const float farEntry = leftFirst ? rightEntry : leftEntry;
+        if (farEntry != std::numeric_limits<float>::infinity())
+            stack[stackSize++] = { leftFirst ? node.first + 1 : node.first, farEntry };
+        if (nearEntry != std::numeric_limits<float>::infinity())
+            stack[stackSize++] = { leftFirst ? node.first : node.first + 1, nearEntry };
+    }
+}
+#endif
+
+constexpr char SerializedMagic[4] = { 'A', 'B', 'V', 'H' };
+constexpr uint32_t SerializedVersion = 1; // Bump whenever the node or triangle layout changes
+
+struct SerializedHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t vertexCount;
+    uint64_t triangleCount;
+    uint64_t nodeCount;
+    uint32_t addedTriangleCount;
+    uint32_t leafCount;
+    uint32_t maxDepth;
+    uint32_t reserved;
+};
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float) && sizeof(all::BvhNode) == 32, "Serialized layout");
+} // namespace
+
+namespace all {
+
+void Bvh::addMesh(const float* positions, std::size_t positionStride, std::size_t vertexCount,
+                  const uint32_t* indices, std::size_t indexCount, const glm::mat4& transform)
+{
+    addTriangles(positions, positionStride, vertexCount, indices, indexCount, transform);
+}
+
+void Bvh::addMesh(const float* positions, std::size_t positionStride, std::size_t vertexCount,
+                  const uint16_t* indices, std::size_t indexCount, const glm::mat4& transform)
+{
+    addTriangles(positions, positionStride, vertexCount, indices, indexCount, transform);
+}
+
+template<typename Index>
+void Bvh::addTriangles(const float* positions, std::size_t positionStride, std::size_t vertexCount,
+                       const Index* indices, std::size_t indexCount, const glm::mat4& transform)
+{
+    const std::size_t firstVertex = m_vertices.size();
+    m_vertices.resize(firstVertex + vertexCount);
+    vertex_kernels::transformPositions(transform, positions, positionStride,
+                                       &m_vertices[firstVertex].x, sizeof(glm::vec3), vertexCount);
+
+    m_triangles.reserve(m_triangles.size() + indexCount / 3);
+    for (std::size_t i = 0; i + 2 < indexCount; i += 3, ++m_addedTriangleCount) {
+        if (indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount)
+            continue;
+        m_triangles.push_back({ { uint32_t(firstVertex + indices[i]), uint32_t(firstVertex + indices[i + 1]), uint32_t(firstVertex + indices[i + 2]) },
+                                m_addedTriangleCount });
+    }
+}
+
+void Bvh::build()
+{
+    const auto start = Clock::now();
+    m_statistics = {};
+
+    const std::size_t triangleCount = m_triangles.size();
+    std::vector<AABB> triangleBounds(triangleCount);
+    parallelFor(triangleCount, BinningGrain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            for (uint32_t vertex : m_triangles[i].vertices)
+                triangleBounds[i].expand(m_vertices[vertex]);
+        }
+    });
+
+    // Triangles get partitioned through their index, and only moved once at the end
+    std::vector<uint32_t> order;
+    HierarchyBuilder(triangleBounds, order).build(m_nodes, m_statistics.leafCount, m_statistics.maxDepth);
+
+    std::vector<Triangle> triangles(triangleCount);
+    parallelFor(triangleCount, BinningGrain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+            triangles[i] = m_triangles[order[i]];
+    });
+    m_triangles = std::move(triangles);
+
+    m_statistics.nodeCount = m_nodes.size();
+    m_statistics.memoryBytes = m_vertices.size() * sizeof(glm::vec3) + m_triangles.size() * sizeof(Triangle) + m_nodes.size() * sizeof(BvhNode);
+    m_statistics.buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+AABB Bvh::bounds() const
+{
+    if (m_nodes.empty())
+        return {};
+    return { m_nodes.front().min, m_nodes.front().max };
+}
+
+std::optional<RayHit> Bvh::closestHit(const Ray& ray, float maxDistance) const
+{
+    const glm::vec3 inverse = inverseDirection(ray.direction);
+    std::optional<RayHit> closest;
+    float closestDistance = maxDistance;
+
+    auto enter = [&](const BvhNode& node) {
+        return intersectBox(node.min, node.max, ray.origin, inverse, closestDistance);
+    };
+    auto visitLeaf = [&](const BvhNode& node) {
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const Triangle& triangle = m_triangles[i];
+            float distance = 0.0f;
+            glm::vec2 barycentrics;
+            if (intersectTriangle(ray, m_vertices[triangle.vertices[0]], m_vertices[triangle.vertices[1]], m_vertices[triangle.vertices[2]], distance, barycentrics) &&
+                distance < closestDistance) {
+                closestDistance = distance;
+                closest = RayHit{ distance, ray.origin + ray.direction * distance, triangle.id, 0, barycentrics };
+            }
+        }
+    };
+    traverse(m_nodes, closestDistance, enter, visitLeaf);
+    return closest;
+}
+
+void Bvh::closestHits(const Ray* rays, std::optional<RayHit>* hits, std::size_t count, float maxDistance) const
+{
+#if !defined(ALLEGIANCE_BVH_SSE2)
+    // Packets only pay off with vector instructions
+    for (std::size_t i = 0; i < count; ++i)
+        hits[i] = closestHit(rays[i], maxDistance);
+#else
+    for (std::size_t first = 0; first < count; first += RayPacket::Size) {
+        const std::size_t packetSize = std::min(RayPacket::Size, count - first);
+        RayPacket packet = createPacket(rays + first, packetSize, maxDistance);
+        intersect(packet);
+        readPacketHits(packet, rays + first, packetSize, hits + first);
+    }
+#endif
+}
+
+#if defined(ALLEGIANCE_BVH_SSE2)
+void Bvh::intersect(RayPacket& packet) const
+{
+    const PacketRays rays = loadRays(packet);
+    auto visitLeaf = [&](const BvhNode& node) {
+        Lanes distance = Lanes::load(packet.distance);
+        Lanes u = Lanes::load(packet.u);
+        Lanes v = Lanes::load(packet.v);
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const Triangle& triangle = m_triangles[i];
+            const int hitLanes = intersectTriangle(rays, m_vertices[triangle.vertices[0]], m_vertices[triangle.vertices[1]], m_vertices[triangle.vertices[2]],
+                                                   distance, u, v);
+            for (std::size_t lane = 0; lane < RayPacket::Size; ++lane) {
+                if (hitLanes & (1 << lane))
+                    packet.triangle[lane] = triangle.id;
+            }
+        }
+        distance.store(packet.distance);
+        u.store(packet.u);
+        v.store(packet.v);
+    };
+    traversePacket(m_nodes, rays, packet.distance, visitLeaf);
+}
+#endif
+
+std::optional<RayHit> Bvh::closestHit(const Beam& beam, float maxDistance, std::chrono::nanoseconds budget) const
+{
+    return closestHitUntil(beam, maxDistance, deadlineAfter(budget));
+}
+
+std::optional<RayHit> Bvh::closestHitUntil(const Beam& beam, float maxDistance, Clock::time_point deadline) const
+{
+    if (beam.radius <= 0.0f && beam.spread <= 0.0f)
+        return closestHit(beam.axis, maxDistance);
+
+    const Ray& axis = beam.axis;
+    const glm::vec3 inverse = inverseDirection(axis.direction);
+    std::optional<RayHit> closest;
+    float closestDistance = maxDistance;
+
+    auto enter = [&](const BvhNode& node) {
+        return enterBeam(node, beam, inverse, closestDistance);
+    };
+    auto visitLeaf = [&](const BvhNode& node) {
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const Triangle& triangle = m_triangles[i];
+            const glm::vec3 corners[3] = { m_vertices[triangle.vertices[0]], m_vertices[triangle.vertices[1]], m_vertices[triangle.vertices[2]] };
+
+            // Bounding sphere around the centroid, to skip the edge tests of triangles far from the axis
+            const glm::vec3 centroid = (corners[0] + corners[1] + corners[2]) * (1.0f / 3.0f);
+            const float sphereRadius = std::sqrt(std::max({ glm::dot(corners[0] - centroid, corners[0] - centroid),
+                                                            glm::dot(corners[1] - centroid, corners[1] - centroid),
+                                                            glm::dot(corners[2] - centroid, corners[2] - centroid) }));
+            const float centroidDistance = glm::dot(centroid - axis.origin, axis.direction);
+            if (centroidDistance - sphereRadius >= closestDistance)
+                continue;
+            const float centroidGap = glm::length(axis.origin + axis.direction * centroidDistance - centroid);
+            if (centroidGap > beam.radius + beam.spread * std::max(centroidDistance + sphereRadius, 0.0f) + sphereRadius)
+                continue;
+
+            float distance = 0.0f;
+            glm::vec2 barycentrics;
+            if (intersectTriangle(axis, corners[0], corners[1], corners[2], distance, barycentrics)) {
+                if (distance < closestDistance) {
+                    closestDistance = distance;
+                    closest = RayHit{ distance, axis.origin + axis.direction * distance, triangle.id, 0, barycentrics };
+                }
+                continue;
+            }
+
+            // Missed by the axis, the point nearest to it is on an edge
+            for (int edge = 0; edge < 3; ++edge) {
+                float fraction = 0.0f;
+                const float gap = closestPointsToSegment(axis, corners[edge], corners[(edge + 1) % 3], distance, fraction);
+                if (distance >= closestDistance || gap > beam.radius + beam.spread * distance)
+                    continue;
+                closestDistance = distance;
+                const glm::vec2 edgeBarycentrics[3] = { { fraction, 0.0f }, { 1.0f - fraction, fraction }, { 0.0f, 1.0f - fraction } };
+                closest = RayHit{ distance, glm::mix(corners[edge], corners[(edge + 1) % 3], fraction), triangle.id, 0, edgeBarycentrics[edge] };
+            }
+        }
+    };
+    traverse(m_nodes, closestDistance, enter, visitLeaf, deadline);
+    return closest;
+}
+
+std::vector<uint8_t> Bvh::serialize() const
+{
+    SerializedHeader header{};
+    std::memcpy(header.magic, SerializedMagic, sizeof(SerializedMagic));
+    header.version = SerializedVersion;
+    header.vertexCount = m_vertices.size();
+    header.triangleCount = m_triangles.size();
+    header.nodeCount = m_nodes.size();
+    header.addedTriangleCount = m_addedTriangleCount;
+    header.leafCount = uint32_t(m_statistics.leafCount);
+    header.maxDepth = uint32_t(m_statistics.maxDepth);
+
+    const std::size_t vertexBytes = m_vertices.size() * sizeof(glm::vec3);
+    const std::size_t triangleBytes = m_triangles.size() * sizeof(Triangle);
+    const std::size_t nodeBytes = m_nodes.size() * sizeof(BvhNode);
+    std::vector<uint8_t> data(sizeof(SerializedHeader) + vertexBytes + triangleBytes + nodeBytes);
+    uint8_t* out = data.data();
+    std::memcpy(out, &header, sizeof(SerializedHeader));
+    out += sizeof(SerializedHeader);
+    std::memcpy(out, m_vertices.data(), vertexBytes);
+    out += vertexBytes;
+    std::memcpy(out, m_triangles.data(), triangleBytes);
+    out += triangleBytes;
+    std::memcpy(out, m_nodes.data(), nodeBytes);
+    return data;
+}
+
+bool Bvh::deserialize(const void* data, std::size_t size)
+{
+    *this = {};
+    auto fail = [this] {
+        *this = {};
+        return false;
+    };
+
+    SerializedHeader header;
+    if (size < sizeof(SerializedHeader))
+        return false;
+    std::memcpy(&header, data, sizeof(SerializedHeader));
+    if (std::memcmp(header.magic, SerializedMagic, sizeof(SerializedMagic)) != 0 || header.version != SerializedVersion ||
+        header.vertexCount > size || header.triangleCount > size || header.nodeCount > size ||
+        size != sizeof(SerializedHeader) + header.vertexCount * sizeof(glm::vec3) + header.triangleCount * sizeof(Triangle) + header.nodeCount * sizeof(BvhNode) ||
+        (header.nodeCount == 0) != (header.triangleCount == 0) || header.maxDepth > MaxDepth)
+        return false;
+
+    const auto* in = static_cast<const uint8_t*>(data) + sizeof(SerializedHeader);
+    m_vertices.resize(header.vertexCount);
+    std::memcpy(m_vertices.data(), in, m_vertices.size() * sizeof(glm::vec3));
+    in += m_vertices.size() * sizeof(glm::vec3);
+    m_triangles.resize(header.triangleCount);
+    std::memcpy(m_triangles.data(), in, m_triangles.size() * sizeof(Triangle));
+    in += m_triangles.size() * sizeof(Triangle);
+    m_nodes.resize(header.nodeCount);
+    std::memcpy(m_nodes.data(), in, m_nodes.size() * sizeof(BvhNode));
+
+    // Queries trust the indices, and their stack the depth
+    for (const Triangle& triangle : m_triangles) {
+        if (triangle.vertices[0] >= header.vertexCount || triangle.vertices[1] >= header.vertexCount || triangle.vertices[2] >= header.vertexCount)
+            return fail();
+    }
+    std::vector<uint8_t> depths(m_nodes.size(), 0);
+    for (std::size_t i = 0; i < m_nodes.size(); ++i) {
+        const BvhNode& node = m_nodes[i];
+        if (node.count > 0) {
+            if (uint64_t(node.first) + node.count > header.triangleCount)
+                return fail();
+            continue;
+        }
+        if (node.first <= i || uint64_t(node.first) + 1 >= header.nodeCount || depths[i] >= MaxDepth)
+            return fail();
+        depths[node.first] = depths[node.first + 1] = uint8_t(depths[i] + 1);
+    }
+
+    m_addedTriangleCount = header.addedTriangleCount;
+    m_statistics.nodeCount = m_nodes.size();
+    m_statistics.leafCount = header.leafCount;
+    m_statistics.maxDepth = header.maxDepth;
+    m_statistics.memoryBytes = m_vertices.size() * sizeof(glm::vec3) + m_triangles.size() * sizeof(Triangle) + m_nodes.size() * sizeof(BvhNode);
+    return true;
+}
+
+uint32_t SceneBvh::addInstance(std::shared_ptr<const Bvh> mesh, const glm::mat4& transform)
+{
+    m_instances.push_back({ std::move(mesh), transform, glm::inverse(transform) });
+    return uint32_t(m_instances.size() - 1);
+}
+
+void SceneBvh::setInstance(uint32_t instance, std::shared_ptr<const Bvh> mesh, const glm::mat4& transform)
+{
+    m_instances[instance] = { std::move(mesh), transform, glm::inverse(transform) };
+}
+
+void SceneBvh::build()
+{
+    const auto start = Clock::now();
+
+    // World space bounds of the instances, from the corners of their mesh bounds
+    std::vector<AABB> instanceBounds;
+    std::vector<uint32_t> instances;
+    for (uint32_t i = 0; i < m_instances.size(); ++i) {
+        const Instance& instance = m_instances[i];
+        if (!instance.mesh || instance.mesh->isEmpty())
+            continue;
+        const AABB meshBounds = instance.mesh->bounds();
+        AABB bounds;
+        for (int corner = 0; corner < 8; ++corner) {
+            const glm::vec3 p((corner & 1) ? meshBounds.max.x : meshBounds.min.x,
+                              (corner & 2) ? meshBounds.max.y : meshBounds.min.y,
+                              (corner & 4) ? meshBounds.max.z : meshBounds.min.z);
+            bounds.expand(glm::vec3(instance.transform * glm::vec4(p, 1.0f)));
+        }
+        instanceBounds.push_back(bounds);
+        instances.push_back(i);
+    }
+
+    std::vector<uint32_t> order;
+    HierarchyBuilder(instanceBounds, order).build(m_nodes, m_leafCount, m_maxDepth);
+    m_leafInstances.resize(order.size());
+    for (std::size_t i = 0; i < order.size(); ++i)
+        m_leafInstances[i] = instances[order[i]];
+
+    m_buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+std::size_t SceneBvh::triangleCount() const
+{
+    std::size_t count = 0;
+    for (const Instance& instance : m_instances)
+        count += instance.mesh ? instance.mesh->triangleCount() : 0;
+    return count;
+}
+
+AABB SceneBvh::bounds() const
+{
+    if (m_nodes.empty())
+        return {};
+    return { m_nodes.front().min, m_nodes.front().max };
+}
+
+std::optional<RayHit> SceneBvh::closestHit(const Ray& ray, float maxDistance) const
+{
+    const glm::vec3 inverse = inverseDirection(ray.direction);
+    std::optional<RayHit> closest;
+    float closestDistance = maxDistance;
+
+    auto enter = [&](const BvhNode& node) {
+        return intersectBox(node.min, node.max, ray.origin, inverse, closestDistance);
+    };
+    // Distances along a transformed ray stay the same, as they are in multiples of its direction
+    auto visitLeaf = [&](const BvhNode& node) {
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const Instance& instance = m_instances[m_leafInstances[i]];
+            const Ray localRay{ glm::vec3(instance.inverseTransform * glm::vec4(ray.origin, 1.0f)),
+                                glm::vec3(instance.inverseTransform * glm::vec4(ray.direction, 0.0f)) };
+            if (auto hit = instance.mesh->closestHit(localRay, closestDistance)) {
+                closestDistance = hit->distance;
+                hit->position = glm::vec3(instance.transform * glm::vec4(hit->position, 1.0f));
+                hit->instance = m_leafInstances[i];
+                closest = hit;
+            }
+        }
+    };
+    traverse(m_nodes, closestDistance, enter, visitLeaf);
+    return closest;
+}
+
+void SceneBvh::closestHits(const Ray* rays, std::optional<RayHit>* hits, std::size_t count, float maxDistance) const
+{
+#if !defined(ALLEGIANCE_BVH_SSE2)
+    for (std::size_t i = 0; i < count; ++i)
+        hits[i] = closestHit(rays[i], maxDistance);
+#else
+    for (std::size_t first = 0; first < count; first += RayPacket::Size) {
+        const std::size_t packetSize = std::min(RayPacket::Size, count - first);
+        RayPacket packet = createPacket(rays + first, packetSize, maxDistance);
+        const PacketRays packetRays = loadRays(packet);
+
+        // Same as for single rays, distances stay the same in instance space
+        auto visitLeaf = [&](const BvhNode& node) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                const Instance& instance = m_instances[m_leafInstances[i]];
+                RayPacket localPacket = packet;
+                for (std::size_t lane = 0; lane < packetSize; ++lane) {
+                    const glm::vec3 origin(packet.origin[0][lane], packet.origin[1][lane], packet.origin[2][lane]);
+                    const glm::vec3 direction(packet.direction[0][lane], packet.direction[1][lane], packet.direction[2][lane]);
+                    setPacketRay(localPacket, lane, glm::vec3(instance.inverseTransform * glm::vec4(origin, 1.0f)),
+                                 glm::vec3(instance.inverseTransform * glm::vec4(direction, 0.0f)), packet.distance[lane]);
+                }
+                instance.mesh->intersect(localPacket);
+                for (std::size_t lane = 0; lane < packetSize; ++lane) {
+                    if (localPacket.distance[lane] < packet.distance[lane]) {
+                        packet.distance[lane] = localPacket.distance[lane];
+                        packet.u[lane] = localPacket.u[lane];
+                        packet.v[lane] = localPacket.v[lane];
+                        packet.triangle[lane] = localPacket.triangle[lane];
+                        packet.instance[lane] = m_leafInstances[i];
+                    }
+                }
+            }
+        };
+        traversePacket(m_nodes, packetRays, packet.distance, visitLeaf);
+        readPacketHits(packet, rays + first, packetSize, hits + first);
+    }
+#endif
+}
+
+std::optional<RayHit> SceneBvh::closestHit(const Beam& beam, float maxDistance, std::chrono::nanoseconds budget) const
+{
+    if (beam.radius <= 0.0f && beam.spread <= 0.0f)
+        return closestHit(beam.axis, maxDistance);
+
+    const Clock::time_point deadline = deadlineAfter(budget);
+    const glm::vec3 inverse = inverseDirection(beam.axis.direction);
+    std::optional<RayHit> closest;
+    float closestDistance = maxDistance;
+
+    auto enter = [&](const BvhNode& node) {
+        return enterBeam(node, beam, inverse, closestDistance);
+    };
+    // The local axis gets normalized again, which scales distances and the
+    // radius by its length. Non uniform scales are taken as that along the axis.
+    auto visitLeaf = [&](const BvhNode& node) {
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const Instance& instance = m_instances[m_leafInstances[i]];
+            const glm::vec3 localDirection(instance.inverseTransform * glm::vec4(beam.axis.direction, 0.0f));
+            const float scale = glm::length(localDirection);
+            if (scale <= 0.0f)
+                continue;
+            const Beam localBeam{ { glm::vec3(instance.inverseTransform * glm::vec4(beam.axis.origin, 1.0f)), localDirection / scale },
+                                  beam.radius * scale, beam.spread };
+            const float localMaxDistance = closestDistance < std::numeric_limits<float>::max() / scale ? closestDistance * scale : std::numeric_limits<float>::max();
+            if (auto hit = instance.mesh->closestHitUntil(localBeam, localMaxDistance, deadline)) {
+                hit->distance /= scale;
+                if (hit->distance >= closestDistance)
+                    continue;
+                closestDistance = hit->distance;
+                hit->position = glm::vec3(instance.transform * glm::vec4(hit->position, 1.0f));
+                hit->instance = m_leafInstances[i];
+                closest = hit;
+            }
+        }
+    };
+    traverse(m_nodes, closestDistance, enter, visitLeaf, deadline);
+    return closest;
+}
+
+Bvh::Statistics SceneBvh::statistics() const
+{
+    Bvh::Statistics statistics;
+    statistics.nodeCount = m_nodes.size();
+    statistics.leafCount = m_leafCount;
+    statistics.memoryBytes = m_instances.size() * sizeof(Instance) + m_nodes.size() * sizeof(BvhNode) + m_leafInstances.size() * sizeof(uint32_t);
+    statistics.buildMs = m_buildMs;
+
+    std::size_t meshDepth = 0;
+    std::unordered_set<const Bvh*> meshes;
+    for (const Instance& instance : m_instances) {
+        if (!instance.mesh || !meshes.insert(instance.mesh.get()).second)
+            continue;
+        const Bvh::Statistics& meshStatistics = instance.mesh->statistics();
+        statistics.nodeCount += meshStatistics.nodeCount;
+        statistics.leafCount += meshStatistics.leafCount;
+        statistics.memoryBytes += meshStatistics.memoryBytes;
+        meshDepth = std::max(meshDepth, meshStatistics.maxDepth);
+    }
+    statistics.maxDepth = m_maxDepth + 1 + meshDepth;
+    return statistics;
+}
+} // namespace all
@@ -0,0 +1,142 @@
+#include <shared/focus_sampling.h>
+#include <shared/bvh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+constexpr float AgreementTolerance = 0.1f; // Relative to the estimated distance
+constexpr float EdgeWeight = 0.25f; // Of the corner samples with FocusStatistic::CenterWeighted
+constexpr std::size_t RaysPerClockCheck = 16;
+
+uint32_t gridSize(uint32_t size)
+{
+    return std::clamp(size, 1u, all::FocusSampling::MaxGridSize);
+}
+
+// Offset of the i-th of count samples from the middle of the grid, in [-0.5, 0.5]
+float gridOffset(uint32_t i, uint32_t count)
+{
+    return count > 1 ? float(i) / float(count - 1) - 0.5f : 0.0f;
+}
+} // namespace
+
+namespace all {
+
+std::vector<FocusSample> focusSamples(const FocusSampling& sampling, glm::vec2 corner0, glm::vec2 corner1)
+{
+    const uint32_t columns = gridSize(sampling.columns);
+    const uint32_t rows = gridSize(sampling.rows);
+
+    struct Tile {
+        uint32_t x;
+        uint32_t y;
+        float distance; // Squared, from the middle of the grid
+    };
+    std::vector<Tile> tiles;
+    tiles.reserve(((columns + 1) / 2) * ((rows + 1) / 2));
+    for (uint32_t y = 0; y < rows; y += 2) {
+        for (uint32_t x = 0; x < columns; x += 2) {
+            const glm::vec2 offset(gridOffset(x, columns) + gridOffset(std::min(x + 1, columns - 1), columns),
+                                   gridOffset(y, rows) + gridOffset(std::min(y + 1, rows - 1), rows));
+            tiles.push_back({ x, y, glm::dot(offset, offset) });
+        }
+    }
+    std::stable_sort(tiles.begin(), tiles.end(), [](const Tile& a, const Tile& b) {
+        return a.distance < b.distance;
+    });
+
+    std::vector<FocusSample> samples;
+    samples.reserve(std::size_t(columns) * rows);
+    for (const Tile& tile : tiles) {
+        for (uint32_t y = tile.y; y < std::min(tile.y + 2, rows); ++y) {
+            for (uint32_t x = tile.x; x < std::min(tile.x + 2, columns); ++x) {
+                const glm::vec2 offset(gridOffset(x, columns), gridOffset(y, rows));
+                FocusSample sample;
+                sample.position = glm::mix(corner0, corner1, offset + 0.5f);
+                // Falls off with the square of the distance to the middle, down to EdgeWeight in the corners
+                if (sampling.statistic == FocusStatistic::CenterWeighted)
+                    sample.weight = 1.0f - (1.0f - EdgeWeight) * 2.0f * glm::dot(offset, offset);
+                samples.push_back(sample);
+            }
+        }
+    }
+    return samples;
+}
+
+std::optional<FocusEstimate> estimateFocus(const FocusSampling& sampling, const std::vector<FocusSample>& samples)
+{
+    std::vector<FocusSample> hits;
+    float totalWeight = 0.0f;
+    for (const FocusSample& sample : samples) {
+        totalWeight += sample.weight;
+        if (sample.distance >= 0.0f)
+            hits.push_back(sample);
+    }
+    if (hits.empty() || totalWeight <= 0.0f)
+        return std::nullopt;
+
+    std::sort(hits.begin(), hits.end(), [](const FocusSample& a, const FocusSample& b) {
+        return a.distance < b.distance;
+    });
+    const float hitWeight = std::accumulate(hits.begin(), hits.end(), 0.0f, [](float sum, const FocusSample& sample) {
+        return sum + sample.weight;
+    });
+
+    // Nearest sample at which the weight of those up to it reaches the percentile
+    const float percentile = sampling.statistic == FocusStatistic::Percentile ? std::clamp(sampling.percentile, 0.0f, 1.0f) : 0.5f;
+    FocusEstimate estimate;
+    estimate.distance = hits.back().distance;
+    float weight = 0.0f;
+    for (const FocusSample& hit : hits) {
+        weight += hit.weight;
+        if (weight >= percentile * hitWeight) {
+            estimate.distance = hit.distance;
+            break;
+        }
+    }
+
+    float agreeingWeight = 0.0f;
+    for (const FocusSample& hit : hits) {
+        if (std::abs(hit.distance - estimate.distance) <= AgreementTolerance * estimate.distance)
+            agreeingWeight += hit.weight;
+    }
+    estimate.confidence = std::min(agreeingWeight / totalWeight, 1.0f);
+    estimate.hitCount = uint32_t(hits.size());
+    return estimate;
+}
+
+std::optional<FocusEstimate> traceFocus(const SceneBvh& bvh, const FocusSampling& sampling, const glm::mat4& inverseViewProjection,
+                                        glm::vec2 corner0, glm::vec2 corner1, const glm::vec3& eye)
+{
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point deadline = Clock::now() + sampling.budget;
+
+    std::vector<FocusSample> samples = focusSamples(sampling, corner0, corner1);
+
+    // From the near to the far plane, which is at distance 1
+    std::vector<Ray> rays(samples.size());
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        auto unproject = [&](float depth) {
+            const glm::vec4 p = inverseViewProjection * glm::vec4(samples[i].position, depth, 1.0f);
+            return glm::vec3(p) / p.w;
+        };
+        const glm::vec3 nearPoint = unproject(-1.0f);
+        rays[i] = { nearPoint, unproject(1.0f) - nearPoint };
+    }
+
+    std::vector<std::optional<RayHit>> hits(rays.size());
+    for (std::size_t first = 0; first < rays.size(); first += RaysPerClockCheck) {
+        if (first > 0 && Clock::now() > deadline)
+            break;
+        bvh.closestHits(rays.data() + first, hits.data() + first, std::min(RaysPerClockCheck, rays.size() - first), 1.0f);
+    }
+
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        if (hits[i])
+            samples[i].distance = glm::length(hits[i]->position - eye);
+    }
+    return estimateFocus(sampling, samples);
+}
+} // namespace all
@@ -0,0 +1,156 @@
+#include <shared/import_arena.h>
+
+#include <algorithm>
+#include <optional>
+
+namespace all {
+namespace {
+// Block the sub-arenas start from, before any job told them how much they need
+constexpr std::size_t InitialBlockSize = std::size_t(64) << 10;
+
+// Counts the blocks taken from the heap
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+    std::size_t allocationCount{ 0 };
+    std::size_t allocatedBytes{ 0 }; // Since the last reset
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        ++allocationCount;
+        allocatedBytes += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+    {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+} // namespace
+
+class ImportArena::ThreadArena : public std::pmr::memory_resource
+{
+public:
+    ThreadArena()
+    {
+        m_monotonic.emplace(InitialBlockSize, &m_heap);
+    }
+
+    ~ThreadArena() override
+    {
+        m_monotonic.reset();
+        if (m_block)
+            m_heap.deallocate(m_block, m_blockSize);
+    }
+
+    void beginJob()
+    {
+        ++m_depth;
+    }
+
+    // Starts over from a single block fitting everything the job took
+    void endJob()
+    {
+        if (--m_depth > 0)
+            return;
+
+        const std::size_t jobBytes = m_blockSize + m_heap.allocatedBytes;
+        m_peakBytes = std::max(m_peakBytes, jobBytes);
+        if (m_heap.allocatedBytes == 0) {
+            m_monotonic->release();
+            return;
+        }
+
+        m_monotonic.reset();
+        if (m_block)
+            m_heap.deallocate(m_block, m_blockSize);
+        m_blockSize = std::max(m_blockSize, jobBytes);
+        m_block = m_heap.allocate(m_blockSize);
+        m_heap.allocatedBytes = 0;
+        m_monotonic.emplace(m_block, m_blockSize, &m_heap);
+    }
+
+    std::size_t allocationCount() const { return m_allocationCount; }
+    std::size_t heapAllocationCount() const { return m_heap.allocationCount; }
+    std::size_t peakBytes() const { return m_peakBytes; }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        ++m_allocationCount;
+        return m_monotonic->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void*, std::size_t, std::size_t) override
+    {
+        // Given back when the job ends
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    CountingResource m_heap;
+    void* m_block{ nullptr };
+    std::size_t m_blockSize{ 0 };
+    std::optional<std::pmr::monotonic_buffer_resource> m_monotonic;
+    int m_depth{ 0 };
+    std::size_t m_allocationCount{ 0 };
+    std::size_t m_peakBytes{ 0 };
+};
+
+ImportArena::ImportArena() = default;
+
+ImportArena::~ImportArena() = default;
+
+ImportArena::Statistics ImportArena::statistics() const
+{
+    std::scoped_lock lock(m_mutex);
+    Statistics statistics;
+    statistics.threadCount = m_threadArenas.size();
+    for (const auto& [thread, threadArena] : m_threadArenas) {
+        statistics.allocationCount += threadArena->allocationCount();
+        statistics.heapAllocationCount += threadArena->heapAllocationCount();
+        statistics.peakBytes += threadArena->peakBytes();
+    }
+    return statistics;
+}
+
+ImportArena::ThreadArena* ImportArena::threadArena()
+{
+    std::scoped_lock lock(m_mutex);
+    std::unique_ptr<ThreadArena>& threadArena = m_threadArenas[std::this_thread::get_id()];
+    if (!threadArena)
+        threadArena = std::make_unique<ThreadArena>();
+    return threadArena.get();
+}
+
+ImportArena::Job::Job(ImportArena* arena)
+{
+    if (arena) {
+        m_threadArena = arena->threadArena();
+        m_threadArena->beginJob();
+    }
+}
+
+ImportArena::Job::~Job()
+{
+    if (m_threadArena)
+        m_threadArena->endJob();
+}
+
+std::pmr::memory_resource* ImportArena::Job::resource() const
+{
+    if (m_threadArena)
+        return m_threadArena;
+    return std::pmr::get_default_resource();
+}
+} // namespace all
@@ -0,0 +1,301 @@
+#include <shared/mesh_optimizer.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+namespace {
+// Tuning values from the paper
+constexpr std::size_t ForsythCacheSize = 32;
+constexpr float CacheDecayPower = 1.5f;
+constexpr float LastTriangleScore = 0.75f;
+constexpr float ValenceBoostScale = 2.0f;
+constexpr float ValenceBoostPower = 0.5f;
+
+float vertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+    if (remainingTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        // The vertices of the last triangle get a fixed score, so that the
+        // next triangle doesn't favour reusing its edges too much
+        if (cachePosition < 3) {
+            score = LastTriangleScore;
+        } else {
+            const float scaler = 1.0f / float(ForsythCacheSize - 3);
+            score = std::pow(1.0f - float(cachePosition - 3) * scaler, CacheDecayPower);
+        }
+    }
+
+    // Favour vertices with few triangles left, to get rid of lone triangles early
+    score += ValenceBoostScale * std::pow(float(remainingTriangles), -ValenceBoostPower);
+    return score;
+}
+
+glm::vec3 position(const float* positions, std::size_t positionStride, uint32_t vertex)
+{
+    const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertex * positionStride);
+    return { p[0], p[1], p[2] };
+}
+} // namespace
+
+namespace all::mesh_optimizer {
+
+float acmr(const uint32_t* indices, std::size_t indexCount, std::size_t vertexCount, std::size_t cacheSize,
+           std::pmr::memory_resource* scratch)
+{
+    const std::size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return 0.0f;
+
+    // A vertex is in the FIFO as long as less than cacheSize misses happened since it was added
+    std::pmr::vector<std::size_t> timestamps(vertexCount, 0, scratch);
+    std::size_t time = cacheSize + 1;
+    std::size_t misses = 0;
+    for (std::size_t i = 0; i < triangleCount * 3; ++i) {
+        const uint32_t vertex = indices[i];
+        if (time - timestamps[vertex] > cacheSize) {
+            timestamps[vertex] = time++;
+            ++misses;
+        }
+    }
+    return float(misses) / float(triangleCount);
+}
+
+void optimizeVertexCache(uint32_t* indices, std::size_t indexCount, std::size_t vertexCount, std::pmr::memory_resource* scratch)
+{
+    const std::size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+        return;
+
+    // Triangles using each vertex, the ones not emitted yet are kept at the front of each range
+    std::pmr::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0, scratch);
+    for (std::size_t i = 0; i < triangleCount * 3; ++i)
+        ++adjacencyOffsets[indices[i] + 1];
+    std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+
+    std::pmr::vector<uint32_t> adjacency(triangleCount * 3, scratch);
+    {
+        std::pmr::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1, scratch);
+        for (std::size_t i = 0; i < triangleCount * 3; ++i)
+            adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+    }
+
+    std::pmr::vector<uint32_t> remainingTriangles(vertexCount, scratch);
+    std::pmr::vector<int> cachePositions(vertexCount, -1, scratch);
+    std::pmr::vector<float> vertexScores(vertexCount, scratch);
+    for (std::size_t v = 0; v < vertexCount; ++v) {
+        remainingTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+        vertexScores[v] = vertexScore(-1, remainingTriangles[v]);
+    }
+
+    auto triangleScore = [&](uint32_t triangle) {
+        return vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]] + vertexScores[indices[triangle * 3 + 2]];
+    };
+
+    std::pmr::vector<float> triangleScores(triangleCount, scratch);
+    std::pmr::vector<bool> emitted(triangleCount, false, scratch);
+    int64_t bestTriangle = 0;
+    for (std::size_t t = 0; t < triangleCount; ++t) {
+        triangleScores[t] = triangleScore(uint32_t(t));
+        if (triangleScores[t] > triangleScores[bestTriangle])
+            bestTriangle = int64_t(t);
+    }
+
+    std::pmr::vector<uint32_t> output(scratch);
+    output.reserve(triangleCount * 3);
+    std::pmr::vector<uint32_t> cache(scratch);
+    std::pmr::vector<uint32_t> newCache(scratch);
+    cache.reserve(ForsythCacheSize + 3);
+    newCache.reserve(ForsythCacheSize + 3);
+    std::size_t scanCursor = 0;
+
+    while (output.size() < triangleCount * 3) {
+        if (bestTriangle < 0) {
+            // Nothing in the cache has triangles left, carry on with the next triangle in input order
+            while (emitted[scanCursor])
+                ++scanCursor;
+            bestTriangle = int64_t(scanCursor);
+        }
+
+        const auto triangle = uint32_t(bestTriangle);
+        const uint32_t* triangleIndices = indices + triangle * 3;
+        emitted[triangle] = true;
+
+        newCache.clear();
+        for (std::size_t j = 0; j < 3; ++j) {
+            const uint32_t vertex = triangleIndices[j];
+            output.push_back(vertex);
+
+            // Move the triangle out of the pending part of the adjacency
+            uint32_t* begin = adjacency.data() + adjacencyOffsets[vertex];
+            uint32_t* end = begin + remainingTriangles[vertex];
+            uint32_t* it = std::find(begin, end, triangle);
+            std::swap(*it, *(end - 1));
+            --remainingTriangles[vertex];
+
+            if (std::find(newCache.begin(), newCache.end(), vertex) == newCache.end())
+                newCache.push_back(vertex);
+        }
+
+        // LRU update, the vertices of the emitted triangle go to the front
+        for (const uint32_t vertex : cache) {
+            if (std::find(newCache.begin(), newCache.end(), vertex) == newCache.end())
+                newCache.push_back(vertex);
+        }
+
+        for (std::size_t i = 0; i < newCache.size(); ++i) {
+            const uint32_t vertex = newCache[i];
+            cachePositions[vertex] = i < ForsythCacheSize ? int(i) : -1;
+            vertexScores[vertex] = vertexScore(cachePositions[vertex], remainingTriangles[vertex]);
+        }
+
+        // Only the triangles touching the cache changed score, the best one is among them
+        bestTriangle = -1;
+        float bestScore = -std::numeric_limits<float>::max();
+        for (std::size_t i = 0; i < newCache.size(); ++i) {
+            const uint32_t vertex = newCache[i];
+            const uint32_t* pending = adjacency.data() + adjacencyOffsets[vertex];
+            for (uint32_t k = 0; k < remainingTriangles[vertex]; ++k) {
+                const uint32_t t = pending[k];
+                triangleScores[t] = triangleScore(t);
+                if (i < ForsythCacheSize && triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        if (newCache.size() > ForsythCacheSize)
+            newCache.resize(ForsythCacheSize);
+        std::swap(cache, newCache);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeOverdraw(uint32_t* indices, std::size_t indexCount,
+                      const float* positions, std::size_t positionStride, std::size_t vertexCount,
+                      float threshold, std::pmr::memory_resource* scratch)
+{
+    const std::size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+        return;
+
+    // A triangle missing the cache on all its vertices starts a new cluster,
+    // moving clusters around doesn't break any vertex reuse
+    std::pmr::vector<std::size_t> clusterStarts(scratch);
+    {
+        std::pmr::vector<std::size_t> timestamps(vertexCount, 0, scratch);
+        std::size_t time = DefaultCacheSize + 1;
+        for (std::size_t t = 0; t < triangleCount; ++t) {
+            std::size_t misses = 0;
+            for (std::size_t j = 0; j < 3; ++j) {
+                const uint32_t vertex = indices[t * 3 + j];
+                if (time - timestamps[vertex] > DefaultCacheSize) {
+                    timestamps[vertex] = time++;
+                    ++misses;
+                }
+            }
+            if (t == 0 || misses == 3)
+                clusterStarts.push_back(t);
+        }
+    }
+    if (clusterStarts.size() < 2)
+        return;
+    clusterStarts.push_back(triangleCount);
+
+    struct Cluster {
+        std::size_t firstTriangle{ 0 };
+        std::size_t triangleCount{ 0 };
+        glm::vec3 centroid{ 0.0f };
+        glm::vec3 normal{ 0.0f };
+        float sortKey{ 0.0f };
+    };
+    std::pmr::vector<Cluster> clusters(clusterStarts.size() - 1, scratch);
+
+    // Area weighted centroids and normals
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (std::size_t c = 0; c < clusters.size(); ++c) {
+        Cluster& cluster = clusters[c];
+        cluster.firstTriangle = clusterStarts[c];
+        cluster.triangleCount = clusterStarts[c + 1] - clusterStarts[c];
+
+        float clusterArea = 0.0f;
+        for (std::size_t t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.triangleCount; ++t) {
+            const glm::vec3 p0 = position(positions, positionStride, indices[t * 3]);
+            const glm::vec3 p1 = position(positions, positionStride, indices[t * 3 + 1]);
+            const glm::vec3 p2 = position(positions, positionStride, indices[t * 3 + 2]);
+            const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            const float area = glm::length(normal);
+
+            cluster.centroid += (p0 + p1 + p2) * (area / 3.0f);
+            cluster.normal += normal;
+            clusterArea += area;
+        }
+
+        meshCentroid += cluster.centroid;
+        meshArea += clusterArea;
+        cluster.centroid = clusterArea > 0.0f ? cluster.centroid / clusterArea : position(positions, positionStride, indices[cluster.firstTriangle * 3]);
+        const float normalLength = glm::length(cluster.normal);
+        cluster.normal = normalLength > 0.0f ? cluster.normal / normalLength : glm::vec3(0.0f);
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // Clusters facing away from the mesh center are the likeliest occluders
+    for (Cluster& cluster : clusters)
+        cluster.sortKey = glm::dot(cluster.centroid - meshCentroid, cluster.normal);
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+        return a.sortKey > b.sortKey;
+    });
+
+    std::pmr::vector<uint32_t> sorted(scratch);
+    sorted.reserve(triangleCount * 3);
+    for (const Cluster& cluster : clusters)
+        sorted.insert(sorted.end(), indices + cluster.firstTriangle * 3, indices + (cluster.firstTriangle + cluster.triangleCount) * 3);
+
+    if (acmr(sorted.data(), sorted.size(), vertexCount, DefaultCacheSize, scratch) >
+        acmr(indices, triangleCount * 3, vertexCount, DefaultCacheSize, scratch) * threshold)
+        return;
+    std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+std::pmr::vector<uint32_t> optimizeVertexFetch(uint32_t* indices, std::size_t indexCount, std::size_t vertexCount,
+                                               std::pmr::memory_resource* scratch)
+{
+    constexpr uint32_t Unused = std::numeric_limits<uint32_t>::max();
+    std::pmr::vector<uint32_t> remap(vertexCount, Unused, scratch);
+
+    uint32_t nextVertex = 0;
+    for (std::size_t i = 0; i < indexCount; ++i) {
+        uint32_t& newIndex = remap[indices[i]];
+        if (newIndex == Unused)
+            newIndex = nextVertex++;
+        indices[i] = newIndex;
+    }
+    for (uint32_t& newIndex : remap) {
+        if (newIndex == Unused)
+            newIndex = nextVertex++;
+    }
+
+    return remap;
+}
+
+void remapVertices(const std::pmr::vector<uint32_t>& remap, void* vertices, std::size_t vertexByteSize,
+                   std::pmr::memory_resource* scratch)
+{
+    auto* data = static_cast<char*>(vertices);
+    const std::pmr::vector<char> source(data, data + remap.size() * vertexByteSize, scratch);
+    for (std::size_t v = 0; v < remap.size(); ++v)
+        std::memcpy(data + remap[v] * vertexByteSize, source.data() + v * vertexByteSize, vertexByteSize);
+}
+
+} // namespace all::mesh_optimizer
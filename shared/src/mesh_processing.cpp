@@ -0,0 +1,396 @@
+#include <shared/mesh_processing.h>
+
+#include <shared/import_arena.h>
+
+#include "parallel_for.h"
+
+#include <assimp/scene.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <numeric>
+#include <vector>
+
+namespace all::mesh_processing {
+namespace {
+using detail::parallelFor;
+
+// Items per task, smaller ranges stay on the calling thread
+constexpr std::size_t Grain = std::size_t(1) << 14;
+
+double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Float bits with the lowest mantissa bits rounded off, so that nearly equal
+// values compare equal. Both zeros map to 0.
+uint32_t quantize(float value)
+{
+    constexpr uint32_t DroppedBits = 8;
+    if (value == 0.0f)
+        return 0;
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits + (uint32_t(1) << (DroppedBits - 1))) & ~((uint32_t(1) << DroppedBits) - 1);
+}
+
+uint64_t hashRow(const uint32_t* row, std::size_t rowWords)
+{
+    uint64_t h = 0x9E3779B97F4A7C15ull;
+    for (std::size_t i = 0; i < rowWords; ++i)
+        h = (h ^ row[i]) * 0xBF58476D1CE4E5B9ull;
+    return h ^ (h >> 29);
+}
+
+// Returns the first row equal to each of the rowCount rows of rowWords words.
+// Rows are spread over partitions by hash, then each partition is searched
+// with its own open addressing table, keeping the rows in their original
+// order so that the first row found is the first occurrence.
+std::pmr::vector<uint32_t> firstEqualRows(const std::pmr::vector<uint32_t>& rows, std::size_t rowWords, std::size_t rowCount,
+                                          std::pmr::memory_resource* scratch)
+{
+    constexpr uint32_t Empty = ~uint32_t(0);
+    const int partitionBits = rowCount < Grain ? 0 : 8;
+    const std::size_t partitionCount = std::size_t(1) << partitionBits;
+    const std::size_t chunkCount = (rowCount + Grain - 1) / Grain;
+
+    std::pmr::vector<uint64_t> hashes(rowCount, scratch);
+    std::pmr::vector<uint32_t> counts(chunkCount * partitionCount, 0, scratch);
+    auto partitionOf = [&](std::size_t row) {
+        return partitionBits == 0 ? std::size_t(0) : std::size_t(hashes[row] >> (64 - partitionBits));
+    };
+    parallelFor(rowCount, Grain, [&](std::size_t begin, std::size_t end) {
+        uint32_t* chunkCounts = counts.data() + begin / Grain * partitionCount;
+        for (std::size_t i = begin; i < end; ++i) {
+            hashes[i] = hashRow(rows.data() + i * rowWords, rowWords);
+            ++chunkCounts[partitionOf(i)];
+        }
+    });
+
+    std::pmr::vector<uint32_t> offsets(chunkCount * partitionCount, scratch);
+    std::pmr::vector<uint32_t> partitionBegin(partitionCount + 1, scratch);
+    uint32_t offset = 0;
+    for (std::size_t partition = 0; partition < partitionCount; ++partition) {
+        partitionBegin[partition] = offset;
+        for (std::size_t chunk = 0; chunk < chunkCount; ++chunk) {
+            offsets[chunk * partitionCount + partition] = offset;
+            offset += counts[chunk * partitionCount + partition];
+        }
+    }
+    partitionBegin[partitionCount] = offset;
+
+    std::pmr::vector<uint32_t> sortedRows(rowCount, scratch);
+    parallelFor(rowCount, Grain, [&](std::size_t begin, std::size_t end) {
+        uint32_t* chunkOffsets = offsets.data() + begin / Grain * partitionCount;
+        for (std::size_t i = begin; i < end; ++i)
+            sortedRows[chunkOffsets[partitionOf(i)]++] = uint32_t(i);
+    });
+
+    std::pmr::vector<uint32_t> firstRows(rowCount, scratch);
+    parallelFor(partitionCount, 1, [&](std::size_t partitionsBegin, std::size_t partitionsEnd) {
+        std::vector<uint32_t> table;
+        for (std::size_t partition = partitionsBegin; partition < partitionsEnd; ++partition) {
+            const uint32_t begin = partitionBegin[partition];
+            const uint32_t end = partitionBegin[partition + 1];
+            std::size_t tableSize = 1;
+            while (tableSize < std::size_t(end - begin) * 2)
+                tableSize *= 2;
+            table.assign(tableSize, Empty);
+            for (uint32_t i = begin; i < end; ++i) {
+                const uint32_t row = sortedRows[i];
+                for (std::size_t slot = hashes[row] & (tableSize - 1);; slot = (slot + 1) & (tableSize - 1)) {
+                    if (table[slot] == Empty) {
+                        table[slot] = row;
+                        firstRows[row] = row;
+                        break;
+                    }
+                    const uint32_t other = table[slot];
+                    if (hashes[other] == hashes[row] &&
+                        std::equal(rows.data() + row * rowWords, rows.data() + (row + 1) * rowWords, rows.data() + other * rowWords)) {
+                        firstRows[row] = other;
+                        break;
+                    }
+                }
+            }
+        }
+    });
+    return firstRows;
+}
+
+template<typename T>
+void gather(T*& array, const std::pmr::vector<uint32_t>& source)
+{
+    if (!array)
+        return;
+    T* result = new T[source.size()];
+    parallelFor(source.size(), Grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+            result[i] = array[source[i]];
+    });
+    delete[] array;
+    array = result;
+}
+
+// Rebuilds every vertex attribute of mesh with vertex i taken from source[i].
+// Faces are left for the caller to remap.
+void gatherVertices(aiMesh& mesh, const std::pmr::vector<uint32_t>& source)
+{
+    gather(mesh.mVertices, source);
+    gather(mesh.mNormals, source);
+    gather(mesh.mTangents, source);
+    gather(mesh.mBitangents, source);
+    for (aiColor4D*& colors : mesh.mColors)
+        gather(colors, source);
+    for (aiVector3D*& texCoords : mesh.mTextureCoords)
+        gather(texCoords, source);
+    mesh.mNumVertices = uint32_t(source.size());
+}
+
+// Gives each face corner its own vertex, unless they already do
+void unshareVertices(aiMesh& mesh, std::pmr::memory_resource* scratch)
+{
+    std::pmr::vector<uint32_t> faceBegin(mesh.mNumFaces + 1, scratch);
+    for (std::size_t i = 0; i < mesh.mNumFaces; ++i)
+        faceBegin[i + 1] = faceBegin[i] + mesh.mFaces[i].mNumIndices;
+    const std::size_t cornerCount = faceBegin.back();
+
+    if (cornerCount == mesh.mNumVertices) {
+        std::pmr::vector<bool> used(mesh.mNumVertices, false, scratch);
+        bool shared = false;
+        for (std::size_t i = 0; i < mesh.mNumFaces && !shared; ++i) {
+            const aiFace& face = mesh.mFaces[i];
+            for (std::size_t j = 0; j < face.mNumIndices && !shared; ++j) {
+                shared = used[face.mIndices[j]];
+                used[face.mIndices[j]] = true;
+            }
+        }
+        if (!shared)
+            return;
+    }
+
+    std::pmr::vector<uint32_t> source(cornerCount, scratch);
+    parallelFor(mesh.mNumFaces, Grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            aiFace& face = mesh.mFaces[i];
+            for (std::size_t j = 0; j < face.mNumIndices; ++j) {
+                source[faceBegin[i] + j] = face.mIndices[j];
+                face.mIndices[j] = uint32_t(faceBegin[i] + j);
+            }
+        }
+    });
+    gatherVertices(mesh, source);
+}
+
+glm::vec3 toVec3(const aiVector3D& v)
+{
+    return { v.x, v.y, v.z };
+}
+} // namespace
+
+bool canProcess(const aiScene& scene)
+{
+    return std::none_of(scene.mMeshes, scene.mMeshes + scene.mNumMeshes, [](const aiMesh* mesh) {
+        return mesh->mNumBones > 0 || mesh->mNumAnimMeshes > 0;
+    });
+}
+
+bool generateNormals(aiMesh& mesh, float creaseAngle, std::pmr::memory_resource* scratch)
+{
+    if (mesh.mNormals || !mesh.mVertices)
+        return false;
+
+    unshareVertices(mesh, scratch);
+    const std::size_t vertexCount = mesh.mNumVertices;
+    const aiVector3D* positions = mesh.mVertices;
+
+    // Newell normal of each face and angle at each corner, which is also a
+    // vertex now
+    std::pmr::vector<glm::vec3> faceNormals(mesh.mNumFaces, scratch);
+    std::pmr::vector<uint32_t> faceOf(vertexCount, 0, scratch);
+    std::pmr::vector<float> cornerAngles(vertexCount, 0.0f, scratch);
+    parallelFor(mesh.mNumFaces, Grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            const aiFace& face = mesh.mFaces[i];
+            const std::size_t n = face.mNumIndices;
+            glm::vec3 normal(0.0f);
+            if (n >= 3) {
+                for (std::size_t j = 0; j < n; ++j) {
+                    const glm::vec3 p = toVec3(positions[face.mIndices[j]]);
+                    const glm::vec3 next = toVec3(positions[face.mIndices[(j + 1) % n]]);
+                    const glm::vec3 previous = toVec3(positions[face.mIndices[(j + n - 1) % n]]);
+                    normal += glm::vec3((p.y - next.y) * (p.z + next.z), (p.z - next.z) * (p.x + next.x), (p.x - next.x) * (p.y + next.y));
+
+                    const float lengths = glm::length(next - p) * glm::length(previous - p);
+                    const float cosine = lengths > 0.0f ? glm::dot(next - p, previous - p) / lengths : 1.0f;
+                    cornerAngles[face.mIndices[j]] = std::acos(std::clamp(cosine, -1.0f, 1.0f));
+                }
+            }
+            const float length = glm::length(normal);
+            faceNormals[i] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+            for (std::size_t j = 0; j < n; ++j)
+                faceOf[face.mIndices[j]] = uint32_t(i);
+        }
+    });
+
+    auto* normals = new aiVector3D[vertexCount];
+    mesh.mNormals = normals;
+
+    if (creaseAngle <= 0.0f) {
+        parallelFor(vertexCount, Grain, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                const glm::vec3& normal = faceNormals[faceOf[i]];
+                normals[i] = aiVector3D(normal.x, normal.y, normal.z);
+            }
+        });
+        return true;
+    }
+
+    // Vertices sharing a position, grouped under the first of them
+    std::pmr::vector<uint32_t> rows(vertexCount * 3, scratch);
+    parallelFor(vertexCount, Grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            rows[i * 3 + 0] = quantize(positions[i].x);
+            rows[i * 3 + 1] = quantize(positions[i].y);
+            rows[i * 3 + 2] = quantize(positions[i].z);
+        }
+    });
+    const std::pmr::vector<uint32_t> firstRows = firstEqualRows(rows, 3, vertexCount, scratch);
+    rows.clear();
+    rows.shrink_to_fit();
+
+    std::pmr::vector<uint32_t> groupBegin(vertexCount + 1, 0, scratch);
+    for (std::size_t i = 0; i < vertexCount; ++i)
+        ++groupBegin[firstRows[i] + 1];
+    std::partial_sum(groupBegin.begin(), groupBegin.end(), groupBegin.begin());
+    std::pmr::vector<uint32_t> groupVertices(vertexCount, scratch);
+    {
+        std::pmr::vector<uint32_t> groupEnd(groupBegin.begin(), groupBegin.end() - 1, scratch);
+        for (std::size_t i = 0; i < vertexCount; ++i)
+            groupVertices[groupEnd[firstRows[i]]++] = uint32_t(i);
+    }
+
+    const float minCosine = std::cos(glm::radians(std::min(creaseAngle, 180.0f)));
+    parallelFor(vertexCount, Grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            const glm::vec3& faceNormal = faceNormals[faceOf[i]];
+            glm::vec3 normal(0.0f);
+            const uint32_t group = firstRows[i];
+            for (uint32_t j = groupBegin[group]; j < groupBegin[group + 1]; ++j) {
+                const uint32_t other = groupVertices[j];
+                const glm::vec3& otherNormal = faceNormals[faceOf[other]];
+                if (glm::dot(faceNormal, otherNormal) >= minCosine)
+                    normal += cornerAngles[other] * otherNormal;
+            }
+            const float length = glm::length(normal);
+            normal = length > 0.0f ? normal / length : faceNormal;
+            normals[i] = aiVector3D(normal.x, normal.y, normal.z);
+        }
+    });
+    return true;
+}
+
+std::size_t joinIdenticalVertices(aiMesh& mesh, std::pmr::memory_resource* scratch)
+{
+    const std::size_t vertexCount = mesh.mNumVertices;
+    if (vertexCount == 0 || !mesh.mVertices)
+        return 0;
+
+    struct Attribute {
+        const float* data;
+        std::size_t components;
+        std::size_t stride; // In floats
+    };
+    std::pmr::vector<Attribute> attributes(scratch);
+    auto addVectors = [&](const aiVector3D* vectors, std::size_t components) {
+        if (vectors)
+            attributes.push_back({ &vectors->x, components, 3 });
+    };
+    addVectors(mesh.mVertices, 3);
+    addVectors(mesh.mNormals, 3);
+    addVectors(mesh.mTangents, 3);
+    addVectors(mesh.mBitangents, 3);
+    for (std::size_t i = 0; i < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++i)
+        addVectors(mesh.mTextureCoords[i], std::clamp<std::size_t>(mesh.mNumUVComponents[i], 1, 3));
+    for (const aiColor4D* colors : mesh.mColors) {
+        if (colors)
+            attributes.push_back({ &colors->r, 4, 4 });
+    }
+
+    std::size_t rowWords = 0;
+    for (const Attribute& attribute : attributes)
+        rowWords += attribute.components;
+
+    std::pmr::vector<uint32_t> rows(vertexCount * rowWords, scratch);
+    parallelFor(vertexCount, Grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            uint32_t* row = rows.data() + i * rowWords;
+            for (const Attribute& attribute : attributes) {
+                const float* values = attribute.data + i * attribute.stride;
+                for (std::size_t j = 0; j < attribute.components; ++j)
+                    *row++ = quantize(values[j]);
+            }
+        }
+    });
+    const std::pmr::vector<uint32_t> firstRows = firstEqualRows(rows, rowWords, vertexCount, scratch);
+    rows.clear();
+    rows.shrink_to_fit();
+
+    // First occurrences are kept in order, every other vertex maps to the
+    // new index of its first occurrence, which always comes before it
+    std::pmr::vector<uint32_t> kept(scratch);
+    std::pmr::vector<uint32_t> remap(vertexCount, scratch);
+    for (std::size_t i = 0; i < vertexCount; ++i) {
+        if (firstRows[i] == i) {
+            remap[i] = uint32_t(kept.size());
+            kept.push_back(uint32_t(i));
+        } else {
+            remap[i] = remap[firstRows[i]];
+        }
+    }
+    if (kept.size() == vertexCount)
+        return 0;
+
+    parallelFor(mesh.mNumFaces, Grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            aiFace& face = mesh.mFaces[i];
+            for (std::size_t j = 0; j < face.mNumIndices; ++j)
+                face.mIndices[j] = remap[face.mIndices[j]];
+        }
+    });
+    gatherVertices(mesh, kept);
+    return vertexCount - kept.size();
+}
+
+SceneReport processScene(aiScene& scene, const SceneOptions& options, ImportArena* arena)
+{
+    SceneReport report;
+    if (options.generateNormals) {
+        const auto normalsStart = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < scene.mNumMeshes; ++i) {
+            ImportArena::Job job(arena);
+            if (generateNormals(*scene.mMeshes[i], options.normalCreaseAngle, job.resource()))
+                ++report.normalMeshCount;
+        }
+        report.normalsMs = elapsedMs(normalsStart);
+    }
+
+    const auto joinStart = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < scene.mNumMeshes; ++i) {
+        aiMesh& mesh = *scene.mMeshes[i];
+        report.vertexCountBefore += mesh.mNumVertices;
+        if (options.joinIdenticalVertices) {
+            ImportArena::Job job(arena);
+            joinIdenticalVertices(mesh, job.resource());
+        }
+        report.vertexCountAfter += mesh.mNumVertices;
+    }
+    report.joinMs = elapsedMs(joinStart);
+    return report;
+}
+} // namespace all::mesh_processing
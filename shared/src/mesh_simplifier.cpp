@@ -0,0 +1,235 @@
+#include <shared/mesh_optimizer.h>
+#include <shared/vertex_kernels.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <memory_resource>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+// Symmetric 4x4 matrix summing the squared distances to a set of planes,
+// weighted by the area of the triangles they come from
+struct Quadric {
+    double a00{ 0 }, a01{ 0 }, a02{ 0 }, a03{ 0 };
+    double a11{ 0 }, a12{ 0 }, a13{ 0 };
+    double a22{ 0 }, a23{ 0 };
+    double a33{ 0 };
+    double weight{ 0 };
+
+    static Quadric fromPlane(const glm::vec3& n, float d, float w)
+    {
+        Quadric q;
+        q.a00 = double(n.x) * n.x * w, q.a01 = double(n.x) * n.y * w, q.a02 = double(n.x) * n.z * w, q.a03 = double(n.x) * d * w;
+        q.a11 = double(n.y) * n.y * w, q.a12 = double(n.y) * n.z * w, q.a13 = double(n.y) * d * w;
+        q.a22 = double(n.z) * n.z * w, q.a23 = double(n.z) * d * w;
+        q.a33 = double(d) * d * w;
+        q.weight = w;
+        return q;
+    }
+
+    Quadric& operator+=(const Quadric& o)
+    {
+        a00 += o.a00, a01 += o.a01, a02 += o.a02, a03 += o.a03;
+        a11 += o.a11, a12 += o.a12, a13 += o.a13;
+        a22 += o.a22, a23 += o.a23;
+        a33 += o.a33;
+        weight += o.weight;
+        return *this;
+    }
+
+    // Mean squared distance of p to the planes
+    double error(const glm::vec3& p) const
+    {
+        const double x = p.x, y = p.y, z = p.z;
+        const double r = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x +
+                a11 * y * y + 2 * a12 * y * z + 2 * a13 * y +
+                a22 * z * z + 2 * a23 * z + a33;
+        return weight > 0 ? std::max(r, 0.0) / weight : 0.0;
+    }
+};
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+};
+
+uint64_t edgeKey(uint32_t a, uint32_t b)
+{
+    return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+} // namespace
+
+namespace all::mesh_optimizer {
+
+std::vector<uint32_t> simplify(const uint32_t* indices, std::size_t indexCount,
+                               const float* positions, std::size_t positionStride, std::size_t vertexCount,
+                               std::size_t targetIndexCount, float targetError, float* resultError,
+                               std::pmr::memory_resource* scratch)
+{
+    std::vector<uint32_t> result(indices, indices + indexCount - indexCount % 3);
+    if (resultError)
+        *resultError = 0.0f;
+
+    std::pmr::vector<glm::vec3> points(vertexCount, scratch);
+    AABB bounds;
+    for (std::size_t v = 0; v < vertexCount; ++v) {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + v * positionStride);
+        points[v] = glm::vec3(p[0], p[1], p[2]);
+    }
+    for (const uint32_t v : result)
+        bounds.expand(points[v]);
+    if (!bounds.isValid())
+        return result;
+    const glm::vec3 size = bounds.extent();
+    const float extent = std::max(size.x, std::max(size.y, size.z));
+    if (extent <= 0.0f)
+        return result;
+    const double errorLimit = double(targetError) * extent * targetError * extent;
+
+    // Vertices on borders or non manifold edges stay in place, collapsing them would open holes
+    std::pmr::vector<bool> locked(vertexCount, false, scratch);
+    {
+        std::pmr::unordered_map<uint64_t, uint32_t> edgeUses(scratch);
+        edgeUses.reserve(result.size());
+        for (std::size_t i = 0; i < result.size(); i += 3) {
+            for (std::size_t j = 0; j < 3; ++j)
+                ++edgeUses[edgeKey(result[i + j], result[i + (j + 1) % 3])];
+        }
+        for (const auto& [key, uses] : edgeUses) {
+            if (uses != 2) {
+                locked[key >> 32] = true;
+                locked[key & 0xffffffff] = true;
+            }
+        }
+    }
+
+    std::pmr::vector<Quadric> quadrics(vertexCount, scratch);
+    for (std::size_t i = 0; i < result.size(); i += 3) {
+        const glm::vec3& p0 = points[result[i]];
+        const glm::vec3 normal = glm::cross(points[result[i + 1]] - p0, points[result[i + 2]] - p0);
+        const float area = glm::length(normal);
+        if (area <= 0.0f)
+            continue;
+        const glm::vec3 n = normal / area;
+        const Quadric q = Quadric::fromPlane(n, -glm::dot(n, p0), area);
+        for (std::size_t j = 0; j < 3; ++j)
+            quadrics[result[i + j]] += q;
+    }
+
+    double reachedError = 0.0;
+    std::pmr::vector<uint32_t> adjacencyOffsets(scratch);
+    std::pmr::vector<uint32_t> adjacency(scratch);
+    std::pmr::vector<uint32_t> fill(scratch);
+    std::pmr::vector<Collapse> collapses(scratch);
+    std::pmr::vector<bool> touched(vertexCount, scratch);
+    std::pmr::vector<uint32_t> remap(vertexCount, scratch);
+
+    // Each pass collapses a set of independent edges, cheapest first
+    while (result.size() > targetIndexCount) {
+        const std::size_t triangleCount = result.size() / 3;
+
+        adjacencyOffsets.assign(vertexCount + 1, 0);
+        for (const uint32_t v : result)
+            ++adjacencyOffsets[v + 1];
+        std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+        adjacency.resize(result.size());
+        fill.assign(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (std::size_t i = 0; i < result.size(); ++i)
+            adjacency[fill[result[i]]++] = uint32_t(i / 3);
+
+        // Interior edges show up once in each direction, only keep one of them
+        collapses.clear();
+        for (std::size_t i = 0; i < result.size(); i += 3) {
+            for (std::size_t j = 0; j < 3; ++j) {
+                const uint32_t a = result[i + j];
+                const uint32_t b = result[i + (j + 1) % 3];
+                if (a >= b)
+                    continue;
+
+                Quadric q = quadrics[a];
+                q += quadrics[b];
+                const double costAToB = locked[a] ? HUGE_VAL : q.error(points[b]);
+                const double costBToA = locked[b] ? HUGE_VAL : q.error(points[a]);
+                const Collapse collapse = costAToB <= costBToA ? Collapse{ a, b, costAToB } : Collapse{ b, a, costBToA };
+                if (collapse.cost <= errorLimit)
+                    collapses.push_back(collapse);
+            }
+        }
+        if (collapses.empty())
+            break;
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+            return a.cost < b.cost;
+        });
+
+        std::fill(touched.begin(), touched.end(), false);
+        std::iota(remap.begin(), remap.end(), 0);
+
+        // An interior collapse removes two triangles
+        const std::size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+        std::size_t removedTriangles = 0;
+        std::size_t collapseCount = 0;
+        for (const Collapse& collapse : collapses) {
+            if (removedTriangles >= trianglesToRemove)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // Reject collapses flipping any of the remaining triangles
+            bool flips = false;
+            for (uint32_t k = adjacencyOffsets[collapse.from]; k < adjacencyOffsets[collapse.from + 1] && !flips; ++k) {
+                const uint32_t* triangle = result.data() + adjacency[k] * 3;
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                    continue;
+
+                glm::vec3 p[3];
+                glm::vec3 moved[3];
+                for (std::size_t j = 0; j < 3; ++j) {
+                    p[j] = points[triangle[j]];
+                    moved[j] = triangle[j] == collapse.from ? points[collapse.to] : p[j];
+                }
+                const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                const glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                flips = glm::dot(before, after) <= 0.0f;
+            }
+            if (flips)
+                continue;
+
+            // The neighbourhood of the collapse has to stay as checked until the end of the pass
+            for (uint32_t k = adjacencyOffsets[collapse.from]; k < adjacencyOffsets[collapse.from + 1]; ++k) {
+                const uint32_t* triangle = result.data() + adjacency[k] * 3;
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            reachedError = std::max(reachedError, collapse.cost);
+            removedTriangles += 2;
+            ++collapseCount;
+        }
+        if (collapseCount == 0)
+            break;
+
+        std::size_t writeIndex = 0;
+        for (std::size_t t = 0; t < triangleCount; ++t) {
+            const uint32_t a = remap[result[t * 3]];
+            const uint32_t b = remap[result[t * 3 + 1]];
+            const uint32_t c = remap[result[t * 3 + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            result[writeIndex++] = a;
+            result[writeIndex++] = b;
+            result[writeIndex++] = c;
+        }
+        result.resize(writeIndex);
+    }
+
+    if (resultError)
+        *resultError = float(std::sqrt(reachedError) / extent);
+    return result;
+}
+
+} // namespace all::mesh_optimizer
@@ -264,27 +264,48 @@ long CNavigationModel::GetPivotPosition(navlib::point_t& position) const
 // Hit
 long CNavigationModel::SetHitAperture(double aperture)
 {
-    return navlib::make_result_code(navlib::navlib_errc::invalid_operation);
+    hit_aperture = aperture;
+    return 0;
 }
 
 long CNavigationModel::SetHitDirection(const navlib::vector_t& direction)
 {
-    return navlib::make_result_code(navlib::navlib_errc::invalid_operation);
+    hit_direction = direction;
+    return 0;
 }
 
 long CNavigationModel::SetHitLookFrom(const navlib::point_t& eye)
 {
-    return navlib::make_result_code(navlib::navlib_errc::invalid_operation);
+    hit_source = eye;
+    return 0;
 }
 
 long CNavigationModel::SetHitSelectionOnly(bool onlySelection)
 {
-    return navlib::make_result_code(navlib::navlib_errc::invalid_operation);
+    hit_selection_only = onlySelection;
+    return 0;
 }
 
 long CNavigationModel::GetHitLookAt(navlib::point_t& position) const
 {
-    return navlib::make_result_code(navlib::navlib_errc::invalid_operation);
+    // Nothing can be selected
+    if (hit_selection_only)
+        return navlib::make_result_code(navlib::navlib_errc::no_data_available);
+
+    const glm::vec3 direction = toGlmVec3(hit_direction);
+    if (glm::dot(direction, direction) == 0.0f)
+        return navlib::make_result_code(navlib::navlib_errc::no_data_available);
+
+    // The aperture is the diameter of the cone on the near plane, its apex
+    // being the eye. Without a near plane in front of the eye, hit test a ray.
+    const float nearPlane = m_camera->nearPlane();
+    const float spread = nearPlane > 0.0f ? float(hit_aperture) * 0.5f / nearPlane : 0.0f;
+    const auto hit = m_nav_params->hit_test(toGlmVec3(hit_source), glm::normalize(direction), spread);
+    if (!hit)
+        return navlib::make_result_code(navlib::navlib_errc::no_data_available);
+
+    position = { hit->x, hit->y, hit->z };
+    return 0;
 }
 
 long CNavigationModel::SetActiveCommand(std::string commandId)
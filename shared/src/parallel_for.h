@@ -0,0 +1,45 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace all::detail {
+// Threads to spread work over, one per core when 0. Tests set it to compare
+// results across thread counts.
+inline std::atomic<unsigned> threadCountOverride{ 0 };
+
+inline std::size_t workerThreadCount()
+{
+    const unsigned count = threadCountOverride;
+    return count > 0 ? count : std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Calls fn(begin, end) over [0, count) in ranges of grain items, spread over
+// workerThreadCount() threads. A single range stays on the calling thread.
+template<typename Fn>
+void parallelFor(std::size_t count, std::size_t grain, const Fn& fn)
+{
+    const std::size_t taskCount = (count + grain - 1) / grain;
+    const std::size_t threadCount = std::min(taskCount, workerThreadCount());
+    if (threadCount <= 1) {
+        if (count > 0)
+            fn(std::size_t(0), count);
+        return;
+    }
+
+    std::atomic<std::size_t> nextTask{ 0 };
+    auto worker = [&] {
+        for (std::size_t task = nextTask++; task < taskCount; task = nextTask++)
+            fn(task * grain, std::min(count, (task + 1) * grain));
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (std::size_t i = 1; i < threadCount; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+} // namespace all::detail
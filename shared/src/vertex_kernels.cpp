@@ -0,0 +1,155 @@
+#include <shared/vertex_kernels.h>
+#include "vertex_kernels_impl.h"
+
+#if defined(ALLEGIANCE_VERTEX_KERNELS_AVX2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ALLEGIANCE_VERTEX_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace all::vertex_kernels {
+namespace {
+using namespace detail;
+
+#if defined(ALLEGIANCE_VERTEX_KERNELS_SSE2)
+struct SseOps {
+    using V = __m128;
+    static constexpr std::size_t Width = 4;
+
+    static V set1(float v) { return _mm_set1_ps(v); }
+    static V load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, V v) { _mm_storeu_ps(p, v); }
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static V fmadd(V a, V b, V c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static V min(V a, V b) { return _mm_min_ps(a, b); }
+    static V max(V a, V b) { return _mm_max_ps(a, b); }
+    static V invLength(V lengthSquared)
+    {
+        const V mask = _mm_cmpgt_ps(lengthSquared, _mm_setzero_ps());
+        return _mm_and_ps(mask, _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lengthSquared)));
+    }
+    static float reduceMin(V v)
+    {
+        v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(v);
+    }
+    static float reduceMax(V v)
+    {
+        v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(v);
+    }
+};
+using DefaultOps = SseOps;
+#else
+using DefaultOps = ScalarOps;
+#endif
+
+#if defined(ALLEGIANCE_VERTEX_KERNELS_AVX2)
+bool cpuSupportsAvx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    const bool hasFma = (info[2] & (1 << 12)) != 0;
+    const bool hasOsxsave = (info[2] & (1 << 27)) != 0;
+    if (!hasFma || !hasOsxsave || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+struct Dispatch {
+    PositionsKernel positions;
+    NormalsKernel normals;
+    const char* name;
+};
+
+const Dispatch& dispatch()
+{
+    static const Dispatch d = []() -> Dispatch {
+#if defined(ALLEGIANCE_VERTEX_KERNELS_AVX2)
+        if (cpuSupportsAvx2())
+            return { transformPositionsAvx2, transformNormalsAvx2, "avx2" };
+#endif
+#if defined(ALLEGIANCE_VERTEX_KERNELS_SSE2)
+        return { detail::transformPositions<DefaultOps>, detail::transformNormals<DefaultOps>, "sse2" };
+#else
+        return { detail::transformPositions<DefaultOps>, detail::transformNormals<DefaultOps>, "scalar" };
+#endif
+    }();
+    return d;
+}
+
+Vec3Stream aosStream(const float* data, std::size_t stride)
+{
+    auto* p = const_cast<float*>(data);
+    return { p, p + 1, p + 2, stride };
+}
+
+Vec3Stream soaStream(const Vec3Arrays& arrays)
+{
+    return { arrays.x, arrays.y, arrays.z, sizeof(float) };
+}
+
+void transformPositions(const glm::mat4& transform, const Vec3Stream& src, const Vec3Stream& dst, std::size_t count, AABB* bounds)
+{
+    if (count == 0)
+        return;
+
+    if (!bounds) {
+        dispatch().positions(&transform[0][0], src, dst, count, nullptr);
+        return;
+    }
+
+    Bounds b{ { bounds->min.x, bounds->min.y, bounds->min.z }, { bounds->max.x, bounds->max.y, bounds->max.z } };
+    dispatch().positions(&transform[0][0], src, dst, count, &b);
+    bounds->min = glm::vec3(b.min[0], b.min[1], b.min[2]);
+    bounds->max = glm::vec3(b.max[0], b.max[1], b.max[2]);
+}
+} // namespace
+
+void transformPositions(const glm::mat4& transform,
+                        const float* src, std::size_t srcStride,
+                        float* dst, std::size_t dstStride,
+                        std::size_t count, AABB* bounds)
+{
+    transformPositions(transform, aosStream(src, srcStride), aosStream(dst, dstStride), count, bounds);
+}
+
+void transformNormals(const glm::mat3& normalMatrix,
+                      const float* src, std::size_t srcStride,
+                      float* dst, std::size_t dstStride,
+                      std::size_t count)
+{
+    if (count > 0)
+        dispatch().normals(&normalMatrix[0][0], aosStream(src, srcStride), aosStream(dst, dstStride), count);
+}
+
+void transformPositions(const glm::mat4& transform, const Vec3Arrays& src, const Vec3Arrays& dst,
+                        std::size_t count, AABB* bounds)
+{
+    transformPositions(transform, soaStream(src), soaStream(dst), count, bounds);
+}
+
+void transformNormals(const glm::mat3& normalMatrix, const Vec3Arrays& src, const Vec3Arrays& dst,
+                      std::size_t count)
+{
+    if (count > 0)
+        dispatch().normals(&normalMatrix[0][0], soaStream(src), soaStream(dst), count);
+}
+
+const char* activeInstructionSet()
+{
+    return dispatch().name;
+}
+} // namespace all::vertex_kernels
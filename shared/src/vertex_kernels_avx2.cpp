@@ -0,0 +1,51 @@
+// Built with AVX2 and FMA enabled, only called after a runtime CPU check
+#include "vertex_kernels_impl.h"
+
+#include <immintrin.h>
+
+namespace all::vertex_kernels::detail {
+namespace {
+struct Avx2Ops {
+    using V = __m256;
+    static constexpr std::size_t Width = 8;
+
+    static V set1(float v) { return _mm256_set1_ps(v); }
+    static V load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, V v) { _mm256_storeu_ps(p, v); }
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V fmadd(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+    static V min(V a, V b) { return _mm256_min_ps(a, b); }
+    static V max(V a, V b) { return _mm256_max_ps(a, b); }
+    static V invLength(V lengthSquared)
+    {
+        const V mask = _mm256_cmp_ps(lengthSquared, _mm256_setzero_ps(), _CMP_GT_OQ);
+        return _mm256_and_ps(mask, _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(lengthSquared)));
+    }
+    static float reduceMin(V v)
+    {
+        __m128 r = _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        r = _mm_min_ps(r, _mm_shuffle_ps(r, r, _MM_SHUFFLE(1, 0, 3, 2)));
+        r = _mm_min_ps(r, _mm_shuffle_ps(r, r, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(r);
+    }
+    static float reduceMax(V v)
+    {
+        __m128 r = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        r = _mm_max_ps(r, _mm_shuffle_ps(r, r, _MM_SHUFFLE(1, 0, 3, 2)));
+        r = _mm_max_ps(r, _mm_shuffle_ps(r, r, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(r);
+    }
+};
+} // namespace
+
+void transformPositionsAvx2(const float* transform, const Vec3Stream& src, const Vec3Stream& dst, std::size_t count, Bounds* bounds)
+{
+    transformPositions<Avx2Ops>(transform, src, dst, count, bounds);
+}
+
+void transformNormalsAvx2(const float* normalMatrix, const Vec3Stream& src, const Vec3Stream& dst, std::size_t count)
+{
+    transformNormals<Avx2Ops>(normalMatrix, src, dst, count);
+}
+} // namespace all::vertex_kernels::detail
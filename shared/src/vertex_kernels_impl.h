@@ -0,0 +1,187 @@
+#pragma once
+// Instruction set agnostic implementation of the vertex kernels. Included by
+// each translation unit that instantiates it for a given instruction set, so
+// it must not pull in anything with external linkage (glm in particular), or
+// the linker might pick a copy built with a wider instruction set.
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace all::vertex_kernels::detail {
+// Either AoS (x, y, z point into the same array, stride is the vertex size)
+// or SoA (x, y, z point to separate arrays, stride is sizeof(float)).
+struct Vec3Stream {
+    float* x{ nullptr };
+    float* y{ nullptr };
+    float* z{ nullptr };
+    std::size_t stride{ 0 };
+};
+
+struct Bounds {
+    float min[3];
+    float max[3];
+};
+
+// Column major matrices
+using PositionsKernel = void (*)(const float* transform, const Vec3Stream& src, const Vec3Stream& dst, std::size_t count, Bounds* bounds);
+using NormalsKernel = void (*)(const float* normalMatrix, const Vec3Stream& src, const Vec3Stream& dst, std::size_t count);
+
+void transformPositionsAvx2(const float* transform, const Vec3Stream& src, const Vec3Stream& dst, std::size_t count, Bounds* bounds);
+void transformNormalsAvx2(const float* normalMatrix, const Vec3Stream& src, const Vec3Stream& dst, std::size_t count);
+
+namespace {
+inline float* element(float* base, std::size_t stride, std::size_t i)
+{
+    return reinterpret_cast<float*>(reinterpret_cast<char*>(base) + i * stride);
+}
+
+struct ScalarOps {
+    using V = float;
+    static constexpr std::size_t Width = 1;
+
+    static V set1(float v) { return v; }
+    static V load(const float* p) { return *p; }
+    static void store(float* p, V v) { *p = v; }
+    static V add(V a, V b) { return a + b; }
+    static V mul(V a, V b) { return a * b; }
+    static V fmadd(V a, V b, V c) { return a * b + c; }
+    static V min(V a, V b) { return b < a ? b : a; }
+    static V max(V a, V b) { return a < b ? b : a; }
+    static V invLength(V lengthSquared) { return lengthSquared > 0.0f ? 1.0f / std::sqrt(lengthSquared) : 0.0f; }
+    static float reduceMin(V v) { return v; }
+    static float reduceMax(V v) { return v; }
+};
+
+template<typename Ops>
+struct Kernels {
+    using V = typename Ops::V;
+    static constexpr std::size_t Width = Ops::Width;
+
+    static void load(const Vec3Stream& s, std::size_t i, V& x, V& y, V& z)
+    {
+        if (s.stride == sizeof(float)) {
+            x = Ops::load(s.x + i);
+            y = Ops::load(s.y + i);
+            z = Ops::load(s.z + i);
+            return;
+        }
+        alignas(32) float xs[Width];
+        alignas(32) float ys[Width];
+        alignas(32) float zs[Width];
+        for (std::size_t l = 0; l < Width; ++l) {
+            xs[l] = *element(s.x, s.stride, i + l);
+            ys[l] = *element(s.y, s.stride, i + l);
+            zs[l] = *element(s.z, s.stride, i + l);
+        }
+        x = Ops::load(xs);
+        y = Ops::load(ys);
+        z = Ops::load(zs);
+    }
+
+    static void store(const Vec3Stream& s, std::size_t i, V x, V y, V z)
+    {
+        if (s.stride == sizeof(float)) {
+            Ops::store(s.x + i, x);
+            Ops::store(s.y + i, y);
+            Ops::store(s.z + i, z);
+            return;
+        }
+        alignas(32) float xs[Width];
+        alignas(32) float ys[Width];
+        alignas(32) float zs[Width];
+        Ops::store(xs, x);
+        Ops::store(ys, y);
+        Ops::store(zs, z);
+        for (std::size_t l = 0; l < Width; ++l) {
+            *element(s.x, s.stride, i + l) = xs[l];
+            *element(s.y, s.stride, i + l) = ys[l];
+            *element(s.z, s.stride, i + l) = zs[l];
+        }
+    }
+
+    // Processes as many full batches as possible, returns the number of processed vertices
+    static std::size_t transformPositions(const float* m, const Vec3Stream& src, const Vec3Stream& dst, std::size_t count, Bounds* bounds)
+    {
+        const V m00 = Ops::set1(m[0]), m01 = Ops::set1(m[4]), m02 = Ops::set1(m[8]), m03 = Ops::set1(m[12]);
+        const V m10 = Ops::set1(m[1]), m11 = Ops::set1(m[5]), m12 = Ops::set1(m[9]), m13 = Ops::set1(m[13]);
+        const V m20 = Ops::set1(m[2]), m21 = Ops::set1(m[6]), m22 = Ops::set1(m[10]), m23 = Ops::set1(m[14]);
+
+        V minX = Ops::set1(bounds ? bounds->min[0] : 0.0f), maxX = Ops::set1(bounds ? bounds->max[0] : 0.0f);
+        V minY = Ops::set1(bounds ? bounds->min[1] : 0.0f), maxY = Ops::set1(bounds ? bounds->max[1] : 0.0f);
+        V minZ = Ops::set1(bounds ? bounds->min[2] : 0.0f), maxZ = Ops::set1(bounds ? bounds->max[2] : 0.0f);
+
+        std::size_t i = 0;
+        for (; i + Width <= count; i += Width) {
+            V x, y, z;
+            load(src, i, x, y, z);
+
+            const V tx = Ops::fmadd(m00, x, Ops::fmadd(m01, y, Ops::fmadd(m02, z, m03)));
+            const V ty = Ops::fmadd(m10, x, Ops::fmadd(m11, y, Ops::fmadd(m12, z, m13)));
+            const V tz = Ops::fmadd(m20, x, Ops::fmadd(m21, y, Ops::fmadd(m22, z, m23)));
+
+            store(dst, i, tx, ty, tz);
+
+            if (bounds) {
+                minX = Ops::min(minX, tx);
+                minY = Ops::min(minY, ty);
+                minZ = Ops::min(minZ, tz);
+                maxX = Ops::max(maxX, tx);
+                maxY = Ops::max(maxY, ty);
+                maxZ = Ops::max(maxZ, tz);
+            }
+        }
+
+        if (bounds) {
+            bounds->min[0] = Ops::reduceMin(minX);
+            bounds->min[1] = Ops::reduceMin(minY);
+            bounds->min[2] = Ops::reduceMin(minZ);
+            bounds->max[0] = Ops::reduceMax(maxX);
+            bounds->max[1] = Ops::reduceMax(maxY);
+            bounds->max[2] = Ops::reduceMax(maxZ);
+        }
+        return i;
+    }
+
+    static std::size_t transformNormals(const float* m, const Vec3Stream& src, const Vec3Stream& dst, std::size_t count)
+    {
+        const V m00 = Ops::set1(m[0]), m01 = Ops::set1(m[3]), m02 = Ops::set1(m[6]);
+        const V m10 = Ops::set1(m[1]), m11 = Ops::set1(m[4]), m12 = Ops::set1(m[7]);
+        const V m20 = Ops::set1(m[2]), m21 = Ops::set1(m[5]), m22 = Ops::set1(m[8]);
+
+        std::size_t i = 0;
+        for (; i + Width <= count; i += Width) {
+            V x, y, z;
+            load(src, i, x, y, z);
+
+            const V tx = Ops::fmadd(m00, x, Ops::fmadd(m01, y, Ops::mul(m02, z)));
+            const V ty = Ops::fmadd(m10, x, Ops::fmadd(m11, y, Ops::mul(m12, z)));
+            const V tz = Ops::fmadd(m20, x, Ops::fmadd(m21, y, Ops::mul(m22, z)));
+
+            const V invLength = Ops::invLength(Ops::fmadd(tx, tx, Ops::fmadd(ty, ty, Ops::mul(tz, tz))));
+            store(dst, i, Ops::mul(tx, invLength), Ops::mul(ty, invLength), Ops::mul(tz, invLength));
+        }
+        return i;
+    }
+};
+
+inline Vec3Stream offset(const Vec3Stream& s, std::size_t i)
+{
+    return { element(s.x, s.stride, i), element(s.y, s.stride, i), element(s.z, s.stride, i), s.stride };
+}
+
+// Runs the wide kernel over full batches and the scalar one over the remainder
+template<typename Ops>
+void transformPositions(const float* m, const Vec3Stream& src, const Vec3Stream& dst, std::size_t count, Bounds* bounds)
+{
+    const std::size_t done = Kernels<Ops>::transformPositions(m, src, dst, count, bounds);
+    Kernels<ScalarOps>::transformPositions(m, offset(src, done), offset(dst, done), count - done, bounds);
+}
+
+template<typename Ops>
+void transformNormals(const float* m, const Vec3Stream& src, const Vec3Stream& dst, std::size_t count)
+{
+    const std::size_t done = Kernels<Ops>::transformNormals(m, src, dst, count);
+    Kernels<ScalarOps>::transformNormals(m, offset(src, done), offset(dst, done), count - done);
+}
+} // namespace
+} // namespace all::vertex_kernels::detail
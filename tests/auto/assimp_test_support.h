@@ -0,0 +1,30 @@
+// Helpers shared by the tests comparing meshes with the ones assimp imports
+#pragma once
+
+#include <assimp/scene.h>
+
+#include <cmath>
+#include <vector>
+
+namespace assimp_test_support {
+// Meshes in the order the nodes reference them, which is how MeshLoader walks the scene
+inline void collectMeshes(const aiScene* scene, const aiNode* node, std::vector<const aiMesh*>& meshes)
+{
+    for (unsigned i = 0; i < node->mNumMeshes; ++i)
+        meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+    for (unsigned i = 0; i < node->mNumChildren; ++i)
+        collectMeshes(scene, node->mChildren[i], meshes);
+}
+
+inline std::vector<const aiMesh*> meshesOf(const aiScene* scene)
+{
+    std::vector<const aiMesh*> meshes;
+    collectMeshes(scene, scene->mRootNode, meshes);
+    return meshes;
+}
+
+inline bool isNear(const aiVector3D& a, const aiVector3D& b, float tolerance = 1.0e-5f)
+{
+    return std::abs(a.x - b.x) <= tolerance && std::abs(a.y - b.y) <= tolerance && std::abs(a.z - b.z) <= tolerance;
+}
+} // namespace assimp_test_support
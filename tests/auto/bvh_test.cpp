@@ -0,0 +1,656 @@
+// Closest hits of all::Bvh and all::SceneBvh against intersecting every
+// triangle, one ray at a time and in packets, through transformed instances,
+// and of beams against testing every triangle for being within them. Then
+// hierarchies read back from serialize(), and built on different numbers of
+// threads.
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include <shared/bvh.h>
+
+#include <parallel_for.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <random>
+#include <vector>
+
+namespace {
+using Triangle = std::array<glm::vec3, 3>;
+
+// Small triangles scattered through [-1, 1]^3, indexed without sharing vertices
+struct Soup {
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+};
+
+Soup randomSoup(std::mt19937& rng, std::size_t triangleCount, float size)
+{
+    std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+    Soup soup;
+    for (std::size_t i = 0; i < triangleCount; ++i) {
+        const glm::vec3 center(coordinate(rng), coordinate(rng), coordinate(rng));
+        for (int corner = 0; corner < 3; ++corner) {
+            soup.positions.push_back(center.x + size * coordinate(rng));
+            soup.positions.push_back(center.y + size * coordinate(rng));
+            soup.positions.push_back(center.z + size * coordinate(rng));
+            soup.indices.push_back(uint32_t(soup.indices.size()));
+        }
+    }
+    return soup;
+}
+
+std::vector<Triangle> triangles(const Soup& soup, const glm::mat4& transform = glm::mat4(1.0f))
+{
+    std::vector<Triangle> result(soup.indices.size() / 3);
+    for (std::size_t i = 0; i < soup.indices.size(); ++i) {
+        const float* p = &soup.positions[3 * soup.indices[i]];
+        result[i / 3][i % 3] = glm::vec3(transform * glm::vec4(p[0], p[1], p[2], 1.0f));
+    }
+    return result;
+}
+
+// Rotation about z, uniform scale, then translation
+glm::mat4 transform(float angle, float scale, const glm::vec3& translation)
+{
+    const float c = std::cos(angle) * scale;
+    const float s = std::sin(angle) * scale;
+    glm::mat4 m(1.0f);
+    m[0] = glm::vec4(c, s, 0.0f, 0.0f);
+    m[1] = glm::vec4(-s, c, 0.0f, 0.0f);
+    m[2] = glm::vec4(0.0f, 0.0f, scale, 0.0f);
+    m[3] = glm::vec4(translation, 1.0f);
+    return m;
+}
+
+// Möller-Trumbore, two sided
+std::optional<float> intersect(const all::Ray& ray, const Triangle& triangle)
+{
+    const glm::vec3 e1 = triangle[1] - triangle[0];
+    const glm::vec3 e2 = triangle[2] - triangle[0];
+    const glm::vec3 p = glm::cross(ray.direction, e2);
+    const float det = glm::dot(e1, p);
+    if (std::abs(det) < 1e-12f)
+        return std::nullopt;
+    const glm::vec3 s = ray.origin - triangle[0];
+    const float u = glm::dot(s, p) / det;
+    const glm::vec3 q = glm::cross(s, e1);
+    const float v = glm::dot(ray.direction, q) / det;
+    const float distance = glm::dot(e2, q) / det;
+    if (u < 0.0f || v < 0.0f || u + v > 1.0f || distance < 0.0f)
+        return std::nullopt;
+    return distance;
+}
+
+struct Reference {
+    float distance;
+    std::size_t triangle; // Into the list intersected
+};
+
+std::optional<Reference> closestReference(const all::Ray& ray, const std::vector<Triangle>& triangles)
+{
+    std::optional<Reference> closest;
+    for (std::size_t i = 0; i < triangles.size(); ++i) {
+        const std::optional<float> distance = intersect(ray, triangles[i]);
+        if (distance && (!closest || *distance < closest->distance))
+            closest = Reference{ *distance, i };
+    }
+    return closest;
+}
+
+// Rays from above the soups, mostly towards them
+std::vector<all::Ray> randomRays(std::mt19937& rng, std::size_t count, float spread)
+{
+    std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+    std::vector<all::Ray> rays(count);
+    for (all::Ray& ray : rays) {
+        ray.origin = glm::vec3(spread * coordinate(rng), spread * coordinate(rng), 4.0f);
+        ray.direction = glm::vec3(0.3f * coordinate(rng), 0.3f * coordinate(rng), -1.0f);
+    }
+    // Axis aligned directions, with zero components, and a ray that is not normalized
+    rays[0].direction = glm::vec3(0.0f, 0.0f, -1.0f);
+    rays[1].direction = glm::vec3(0.0f, 0.0f, -2.5f);
+    rays[2].origin = glm::vec3(-4.0f, 0.1f, 0.2f);
+    rays[2].direction = glm::vec3(1.0f, 0.0f, 0.0f);
+    return rays;
+}
+
+// Distance along the axis that the point projects to, and the gap between them
+float gapToAxis(const all::Ray& axis, const glm::vec3& point, float& distance)
+{
+    distance = std::max(glm::dot(point - axis.origin, axis.direction), 0.0f);
+    return glm::length(axis.origin + axis.direction * distance - point);
+}
+
+// Distance of a triangle within the beam as Bvh defines it: where the axis
+// crosses it, else where the edge point nearest to the axis projects to.
+// That gap is convex along an edge, a ternary search finds its minimum.
+std::optional<float> beamDistance(const all::Beam& beam, const Triangle& triangle)
+{
+    if (const std::optional<float> distance = intersect(beam.axis, triangle))
+        return distance;
+
+    // Gaps change no faster than points move, none is within the beam when the
+    // sphere around the triangle is clear of it
+    const glm::vec3 centroid = (triangle[0] + triangle[1] + triangle[2]) / 3.0f;
+    float sphereRadius = 0.0f;
+    for (const glm::vec3& corner : triangle)
+        sphereRadius = std::max(sphereRadius, glm::length(corner - centroid));
+    float centroidDistance = 0.0f;
+    if (gapToAxis(beam.axis, centroid, centroidDistance) - sphereRadius > beam.radius + beam.spread * (centroidDistance + sphereRadius))
+        return std::nullopt;
+
+    std::optional<float> closest;
+    for (int edge = 0; edge < 3; ++edge) {
+        const glm::vec3& p0 = triangle[edge];
+        const glm::vec3& p1 = triangle[(edge + 1) % 3];
+        float distance = 0.0f;
+        float low = 0.0f;
+        float high = 1.0f;
+        for (int i = 0; i < 60; ++i) {
+            const float a = low + (high - low) / 3.0f;
+            const float b = high - (high - low) / 3.0f;
+            if (gapToAxis(beam.axis, glm::mix(p0, p1, a), distance) < gapToAxis(beam.axis, glm::mix(p0, p1, b), distance))
+                high = b;
+            else
+                low = a;
+        }
+        const float gap = gapToAxis(beam.axis, glm::mix(p0, p1, 0.5f * (low + high)), distance);
+        if (gap <= beam.radius + beam.spread * distance + 1e-5f && (!closest || distance < *closest))
+            closest = distance;
+    }
+    return closest;
+}
+
+std::optional<Reference> closestReference(const all::Beam& beam, const std::vector<Triangle>& triangles)
+{
+    std::optional<Reference> closest;
+    for (std::size_t i = 0; i < triangles.size(); ++i) {
+        const std::optional<float> distance = beamDistance(beam, triangles[i]);
+        if (distance && (!closest || *distance < closest->distance))
+            closest = Reference{ *distance, i };
+    }
+    return closest;
+}
+
+// Cones, cylinders and cones cut short from above the soups, axes normalized
+std::vector<all::Beam> randomBeams(std::mt19937& rng, std::size_t count, float spread)
+{
+    std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+    std::vector<all::Beam> beams(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        all::Beam& beam = beams[i];
+        beam.axis.origin = glm::vec3(spread * coordinate(rng), spread * coordinate(rng), 4.0f);
+        beam.axis.direction = glm::normalize(glm::vec3(0.3f * coordinate(rng), 0.3f * coordinate(rng), -1.0f));
+        beam.radius = i % 3 == 0 ? 0.0f : 0.02f;
+        beam.spread = i % 3 == 1 ? 0.0f : 0.01f + 0.01f * std::abs(coordinate(rng));
+    }
+    return beams;
+}
+
+bool sameHit(const std::optional<all::RayHit>& a, const std::optional<all::RayHit>& b)
+{
+    if (a.has_value() != b.has_value())
+        return false;
+    return !a
+        || (std::abs(a->distance - b->distance) <= 1e-5f * a->distance && a->triangle == b->triangle && a->instance == b->instance
+            && glm::length(a->position - b->position) <= 1e-4f);
+}
+
+// Layout written by Bvh::serialize(), to read its nodes back and corrupt them
+struct SerializedHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t vertexCount;
+    uint64_t triangleCount;
+    uint64_t nodeCount;
+    uint32_t addedTriangleCount;
+    uint32_t leafCount;
+    uint32_t maxDepth;
+    uint32_t reserved;
+};
+
+struct SerializedTriangle {
+    uint32_t vertices[3];
+    uint32_t id;
+};
+
+template<typename T>
+T readAt(const std::vector<uint8_t>& bytes, std::size_t offset)
+{
+    T value;
+    std::memcpy(&value, bytes.data() + offset, sizeof(T));
+    return value;
+}
+
+template<typename T>
+void writeAt(std::vector<uint8_t>& bytes, std::size_t offset, const T& value)
+{
+    std::memcpy(bytes.data() + offset, &value, sizeof(T));
+}
+
+std::size_t triangleOffset(const std::vector<uint8_t>& bytes, std::size_t triangle)
+{
+    const auto header = readAt<SerializedHeader>(bytes, 0);
+    return sizeof(SerializedHeader) + header.vertexCount * 3 * sizeof(float) + triangle * sizeof(SerializedTriangle);
+}
+
+std::size_t nodeOffset(const std::vector<uint8_t>& bytes, std::size_t node)
+{
+    const auto header = readAt<SerializedHeader>(bytes, 0);
+    return triangleOffset(bytes, header.triangleCount) + node * sizeof(all::BvhNode);
+}
+
+// The tree from its root down, bounds and leaf triangles, whatever the order its nodes are stored in
+void describeTree(const std::vector<uint8_t>& bytes, uint32_t index, std::vector<uint32_t>& description)
+{
+    const auto node = readAt<all::BvhNode>(bytes, nodeOffset(bytes, index));
+    for (const float bound : { node.min.x, node.min.y, node.min.z, node.max.x, node.max.y, node.max.z })
+        description.push_back(std::bit_cast<uint32_t>(bound));
+    description.push_back(node.count);
+    if (node.count == 0) {
+        describeTree(bytes, node.first, description);
+        describeTree(bytes, node.first + 1, description);
+        return;
+    }
+    for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+        const auto triangle = readAt<SerializedTriangle>(bytes, triangleOffset(bytes, i));
+        description.insert(description.end(), { triangle.id, triangle.vertices[0], triangle.vertices[1], triangle.vertices[2] });
+    }
+}
+
+// Deserialization fails, leaving the hierarchy empty
+bool rejected(const std::vector<uint8_t>& bytes, std::size_t size)
+{
+    all::Bvh bvh;
+    return !bvh.deserialize(bytes.data(), size) && bvh.isEmpty() && bvh.triangleCount() == 0;
+}
+} // namespace
+
+TEST_CASE("Closest hits match intersecting every triangle")
+{
+    std::mt19937 rng(1);
+    const Soup soup = randomSoup(rng, 3000, 0.05f);
+    const Soup other = randomSoup(rng, 500, 0.2f);
+    const glm::mat4 otherTransform = transform(0.7f, 0.5f, glm::vec3(0.3f, -0.2f, 0.5f));
+
+    all::Bvh bvh;
+    bvh.addMesh(soup.positions.data(), 3 * sizeof(float), soup.positions.size() / 3, soup.indices.data(), soup.indices.size());
+    // The second mesh with 16 bit indices, its triangles numbered after those of the first
+    const std::vector<uint16_t> otherIndices(other.indices.begin(), other.indices.end());
+    bvh.addMesh(other.positions.data(), 3 * sizeof(float), other.positions.size() / 3, otherIndices.data(), otherIndices.size(), otherTransform);
+    bvh.build();
+    REQUIRE(bvh.triangleCount() == 3500);
+
+    std::vector<Triangle> reference = triangles(soup);
+    const std::vector<Triangle> otherTriangles = triangles(other, otherTransform);
+    reference.insert(reference.end(), otherTriangles.begin(), otherTriangles.end());
+
+    int hitCount = 0;
+    for (const all::Ray& ray : randomRays(rng, 2000, 1.2f)) {
+        const std::optional<all::RayHit> hit = bvh.closestHit(ray);
+        const std::optional<Reference> expected = closestReference(ray, reference);
+        REQUIRE(hit.has_value() == expected.has_value());
+        if (!hit)
+            continue;
+        ++hitCount;
+        INFO("Ray from " << ray.origin.x << ", " << ray.origin.y << ", " << ray.origin.z);
+        CHECK(std::abs(hit->distance - expected->distance) <= 1e-5f * expected->distance);
+        REQUIRE(hit->triangle < reference.size());
+        // Another triangle at the same distance may be reported, as long as it is hit there
+        const std::optional<float> distance = intersect(ray, reference[hit->triangle]);
+        REQUIRE(distance.has_value());
+        CHECK(std::abs(*distance - hit->distance) <= 1e-5f * hit->distance);
+        CHECK(glm::length(hit->position - (ray.origin + ray.direction * hit->distance)) <= 1e-4f);
+
+        // Nothing closer than it when cut short before it
+        CHECK_FALSE(bvh.closestHit(ray, 0.999f * hit->distance).has_value());
+    }
+    // Enough of both to mean something
+    CHECK(hitCount > 500);
+    CHECK(hitCount < 1900);
+}
+
+TEST_CASE("Packets of rays hit the same as single rays")
+{
+    std::mt19937 rng(2);
+    const Soup soup = randomSoup(rng, 5000, 0.05f);
+    auto mesh = std::make_shared<all::Bvh>();
+    mesh->addMesh(soup.positions.data(), 3 * sizeof(float), soup.positions.size() / 3, soup.indices.data(), soup.indices.size());
+    mesh->build();
+
+    all::SceneBvh scene;
+    scene.addInstance(mesh);
+    scene.addInstance(mesh, transform(1.3f, 0.8f, glm::vec3(0.5f, 0.5f, -1.0f)));
+    scene.build();
+
+    // Not a multiple of the packet width, with a ragged last packet
+    const std::vector<all::Ray> rays = randomRays(rng, 1001, 1.2f);
+    std::vector<std::optional<all::RayHit>> hits(rays.size());
+    for (const float maxDistance : { std::numeric_limits<float>::max(), 3.5f }) {
+        INFO("Up to a distance of " << maxDistance);
+        mesh->closestHits(rays.data(), hits.data(), rays.size(), maxDistance);
+        int mismatches = 0;
+        for (std::size_t i = 0; i < rays.size(); ++i)
+            mismatches += !sameHit(hits[i], mesh->closestHit(rays[i], maxDistance));
+        CHECK(mismatches == 0);
+
+        scene.closestHits(rays.data(), hits.data(), rays.size(), maxDistance);
+        mismatches = 0;
+        for (std::size_t i = 0; i < rays.size(); ++i)
+            mismatches += !sameHit(hits[i], scene.closestHit(rays[i], maxDistance));
+        CHECK(mismatches == 0);
+    }
+}
+
+TEST_CASE("Hits through transformed instances match their triangles in the scene")
+{
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+
+    std::vector<Soup> soups;
+    std::vector<std::shared_ptr<const all::Bvh>> meshes;
+    for (int i = 0; i < 3; ++i) {
+        const Soup& soup = soups.emplace_back(randomSoup(rng, 1000, 0.08f));
+        auto mesh = std::make_shared<all::Bvh>();
+        mesh->addMesh(soup.positions.data(), 3 * sizeof(float), soup.positions.size() / 3, soup.indices.data(), soup.indices.size());
+        mesh->build();
+        meshes.push_back(mesh);
+    }
+
+    // Each instance rotated, scaled and moved, some of them overlapping
+    all::SceneBvh scene;
+    std::vector<std::vector<Triangle>> instanceTriangles;
+    for (uint32_t i = 0; i < 8; ++i) {
+        const glm::mat4 instanceTransform = transform(3.0f * coordinate(rng), 0.5f + std::abs(coordinate(rng)),
+                                                      glm::vec3(2.0f * coordinate(rng), 2.0f * coordinate(rng), coordinate(rng)));
+        CHECK(scene.addInstance(meshes[i % 3], instanceTransform) == i);
+        instanceTriangles.push_back(triangles(soups[i % 3], instanceTransform));
+    }
+    scene.build();
+    REQUIRE(scene.instanceCount() == 8);
+    CHECK(scene.triangleCount() == 8000);
+
+    int hitCount = 0;
+    for (const all::Ray& ray : randomRays(rng, 2000, 3.0f)) {
+        const std::optional<all::RayHit> hit = scene.closestHit(ray);
+        std::optional<float> expected;
+        for (const std::vector<Triangle>& triangles : instanceTriangles) {
+            const std::optional<Reference> closest = closestReference(ray, triangles);
+            if (closest && (!expected || closest->distance < *expected))
+                expected = closest->distance;
+        }
+        REQUIRE(hit.has_value() == expected.has_value());
+        if (!hit)
+            continue;
+        ++hitCount;
+        INFO("Ray from " << ray.origin.x << ", " << ray.origin.y << ", " << ray.origin.z);
+        CHECK(std::abs(hit->distance - *expected) <= 1e-4f * *expected);
+
+        // The instance and triangle reported are hit where the scene says
+        REQUIRE(hit->instance < instanceTriangles.size());
+        REQUIRE(hit->triangle < instanceTriangles[hit->instance].size());
+        const std::optional<float> distance = intersect(ray, instanceTriangles[hit->instance][hit->triangle]);
+        REQUIRE(distance.has_value());
+        CHECK(std::abs(*distance - hit->distance) <= 1e-4f * hit->distance);
+        CHECK(glm::length(hit->position - (ray.origin + ray.direction * hit->distance)) <= 1e-3f);
+    }
+    CHECK(hitCount > 200);
+
+    // Moving an instance away moves its hits with it
+    const glm::mat4 moved = transform(0.0f, 1.0f, glm::vec3(100.0f, 0.0f, 0.0f));
+    scene.setInstance(0, meshes[0], moved);
+    scene.build();
+    const std::vector<Triangle> movedTriangles = triangles(soups[0], moved);
+    const glm::vec3 target = (movedTriangles[0][0] + movedTriangles[0][1] + movedTriangles[0][2]) / 3.0f;
+    const all::Ray towardsMoved{ target + glm::vec3(0.0f, 0.0f, 4.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+    const std::optional<Reference> expected = closestReference(towardsMoved, movedTriangles);
+    const std::optional<all::RayHit> hit = scene.closestHit(towardsMoved);
+    REQUIRE(expected.has_value());
+    REQUIRE(hit.has_value());
+    CHECK(hit->instance == 0);
+    CHECK(std::abs(hit->distance - expected->distance) <= 1e-4f * expected->distance);
+}
+
+TEST_CASE("Beams hit the closest triangle within them")
+{
+    std::mt19937 rng(4);
+    const Soup soup = randomSoup(rng, 2000, 0.03f);
+    auto mesh = std::make_shared<all::Bvh>();
+    mesh->addMesh(soup.positions.data(), 3 * sizeof(float), soup.positions.size() / 3, soup.indices.data(), soup.indices.size());
+    mesh->build();
+    const std::vector<Triangle> reference = triangles(soup);
+
+    int hitCount = 0;
+    int rayHitCount = 0;
+    for (const all::Beam& beam : randomBeams(rng, 300, 1.2f)) {
+        INFO("Beam from " << beam.axis.origin.x << ", " << beam.axis.origin.y << " of radius " << beam.radius << " and spread " << beam.spread);
+        const std::optional<all::RayHit> hit = mesh->closestHit(beam);
+        const std::optional<Reference> expected = closestReference(beam, reference);
+        rayHitCount += mesh->closestHit(beam.axis).has_value();
+
+        // No triangle within the beam is pruned away
+        REQUIRE(hit.has_value() == expected.has_value());
+        if (!hit)
+            continue;
+        ++hitCount;
+        CHECK(std::abs(hit->distance - expected->distance) <= 1e-4f * expected->distance);
+        REQUIRE(hit->triangle < reference.size());
+        const std::optional<float> distance = beamDistance(beam, reference[hit->triangle]);
+        REQUIRE(distance.has_value());
+        CHECK(std::abs(*distance - hit->distance) <= 1e-4f * hit->distance);
+    }
+    CHECK(hitCount > rayHitCount);
+
+    // The same through rotated, scaled and moved instances
+    all::SceneBvh scene;
+    std::vector<std::vector<Triangle>> instanceTriangles;
+    for (uint32_t i = 0; i < 4; ++i) {
+        const glm::mat4 instanceTransform = transform(1.5f * float(i), 0.6f + 0.3f * float(i), glm::vec3(0.4f * float(i) - 0.6f, 0.0f, 0.0f));
+        scene.addInstance(mesh, instanceTransform);
+        instanceTriangles.push_back(triangles(soup, instanceTransform));
+    }
+    scene.build();
+
+    for (const all::Beam& beam : randomBeams(rng, 200, 1.5f)) {
+        INFO("Beam from " << beam.axis.origin.x << ", " << beam.axis.origin.y << " of radius " << beam.radius << " and spread " << beam.spread);
+        const std::optional<all::RayHit> hit = scene.closestHit(beam);
+        std::optional<float> expected;
+        for (const std::vector<Triangle>& triangles : instanceTriangles) {
+            const std::optional<Reference> closest = closestReference(beam, triangles);
+            if (closest && (!expected || closest->distance < *expected))
+                expected = closest->distance;
+        }
+        REQUIRE(hit.has_value() == expected.has_value());
+        if (!hit)
+            continue;
+        CHECK(std::abs(hit->distance - *expected) <= 1e-3f * *expected);
+        REQUIRE(hit->instance < instanceTriangles.size());
+        const std::optional<float> distance = beamDistance(beam, instanceTriangles[hit->instance][hit->triangle]);
+        REQUIRE(distance.has_value());
+        CHECK(std::abs(*distance - hit->distance) <= 1e-3f * hit->distance);
+    }
+}
+
+TEST_CASE("Beams out of time return the closest hit found so far")
+{
+    std::mt19937 rng(5);
+    const Soup soup = randomSoup(rng, 20000, 0.05f);
+    auto mesh = std::make_shared<all::Bvh>();
+    mesh->addMesh(soup.positions.data(), 3 * sizeof(float), soup.positions.size() / 3, soup.indices.data(), soup.indices.size());
+    mesh->build();
+    const std::vector<Triangle> reference = triangles(soup);
+
+    all::SceneBvh scene;
+    scene.addInstance(mesh);
+    scene.build();
+
+    // Wide enough to take many nodes, which no budget leaves time for
+    std::vector<all::Beam> beams = randomBeams(rng, 200, 1.0f);
+    for (all::Beam& beam : beams)
+        beam.spread = 0.1f;
+
+    int hitCount = 0;
+    int boundedHitCount = 0;
+    int cutShortCount = 0;
+    for (const all::Beam& beam : beams) {
+        INFO("Beam from " << beam.axis.origin.x << ", " << beam.axis.origin.y);
+        const std::optional<all::RayHit> hit = mesh->closestHit(beam);
+        hitCount += hit.has_value();
+        for (const std::optional<all::RayHit>& bounded :
+             { mesh->closestHit(beam, std::numeric_limits<float>::max(), std::chrono::nanoseconds(0)),
+               scene.closestHit(beam, std::numeric_limits<float>::max(), std::chrono::nanoseconds(0)) }) {
+            if (!bounded)
+                continue;
+            ++boundedHitCount;
+            // Within the beam where it says, and no closer than the hit found given the time
+            REQUIRE(hit.has_value());
+            CHECK(bounded->distance >= hit->distance);
+            cutShortCount += bounded->distance > hit->distance;
+            REQUIRE(bounded->triangle < reference.size());
+            const std::optional<float> distance = beamDistance(beam, reference[bounded->triangle]);
+            REQUIRE(distance.has_value());
+            CHECK(std::abs(*distance - bounded->distance) <= 1e-4f * bounded->distance);
+        }
+    }
+    // The first leaves visited already hold hits for most beams, though not the closest ones
+    CHECK(boundedHitCount > hitCount);
+    CHECK(cutShortCount > 0);
+}
+
+TEST_CASE("A serialized hierarchy reads back the same")
+{
+    std::mt19937 rng(6);
+    const Soup soup = randomSoup(rng, 5000, 0.05f);
+    all::Bvh bvh;
+    bvh.addMesh(soup.positions.data(), 3 * sizeof(float), soup.positions.size() / 3, soup.indices.data(), soup.indices.size());
+    bvh.build();
+    const std::vector<uint8_t> bytes = bvh.serialize();
+
+    all::Bvh copy;
+    REQUIRE(copy.deserialize(bytes.data(), bytes.size()));
+    CHECK(copy.triangleCount() == bvh.triangleCount());
+    CHECK(copy.bounds().min == bvh.bounds().min);
+    CHECK(copy.bounds().max == bvh.bounds().max);
+    CHECK(copy.statistics().nodeCount == bvh.statistics().nodeCount);
+    CHECK(copy.statistics().leafCount == bvh.statistics().leafCount);
+    CHECK(copy.statistics().maxDepth == bvh.statistics().maxDepth);
+    CHECK(copy.serialize() == bytes);
+
+    int mismatches = 0;
+    for (const all::Ray& ray : randomRays(rng, 500, 1.2f))
+        mismatches += !sameHit(copy.closestHit(ray), bvh.closestHit(ray));
+    CHECK(mismatches == 0);
+
+    // An empty hierarchy reads back empty
+    const std::vector<uint8_t> empty = all::Bvh().serialize();
+    CHECK(copy.deserialize(empty.data(), empty.size()));
+    CHECK(copy.isEmpty());
+}
+
+TEST_CASE("Corrupt serialized hierarchies are rejected")
+{
+    std::mt19937 rng(7);
+    const Soup soup = randomSoup(rng, 2000, 0.05f);
+    all::Bvh bvh;
+    bvh.addMesh(soup.positions.data(), 3 * sizeof(float), soup.positions.size() / 3, soup.indices.data(), soup.indices.size());
+    bvh.build();
+    const std::vector<uint8_t> bytes = bvh.serialize();
+    const auto header = readAt<SerializedHeader>(bytes, 0);
+    REQUIRE(header.nodeCount > 3);
+
+    for (const std::size_t size : { bytes.size() - 1, bytes.size() / 2, sizeof(SerializedHeader), sizeof(SerializedHeader) - 1, std::size_t(0) }) {
+        INFO("Truncated to " << size << " of " << bytes.size() << " bytes");
+        CHECK(rejected(bytes, size));
+    }
+    std::vector<uint8_t> longer = bytes;
+    longer.push_back(0);
+    CHECK(rejected(longer, longer.size()));
+
+    std::vector<uint8_t> corrupt = bytes;
+    writeAt(corrupt, offsetof(SerializedHeader, version), header.version + 1);
+    CHECK(rejected(corrupt, corrupt.size()));
+
+    corrupt = bytes;
+    corrupt[0] = 'X';
+    CHECK(rejected(corrupt, corrupt.size()));
+
+    // A triangle corner past the vertices
+    corrupt = bytes;
+    auto triangle = readAt<SerializedTriangle>(bytes, triangleOffset(bytes, 0));
+    triangle.vertices[2] = uint32_t(header.vertexCount);
+    writeAt(corrupt, triangleOffset(bytes, 0), triangle);
+    CHECK(rejected(corrupt, corrupt.size()));
+
+    // Children at or before their parent, which would loop
+    const auto root = readAt<all::BvhNode>(bytes, nodeOffset(bytes, 0));
+    REQUIRE(root.count == 0);
+    const auto child = readAt<all::BvhNode>(bytes, nodeOffset(bytes, root.first));
+    REQUIRE(child.count == 0);
+    for (const uint32_t first : { 0u, root.first - 1, root.first }) {
+        INFO("Children of node " << root.first << " moved to " << first);
+        corrupt = bytes;
+        all::BvhNode node = child;
+        node.first = first;
+        writeAt(corrupt, nodeOffset(bytes, root.first), node);
+        CHECK(rejected(corrupt, corrupt.size()));
+    }
+
+    // A leaf past the triangles
+    uint32_t leaf = 0;
+    while (readAt<all::BvhNode>(bytes, nodeOffset(bytes, leaf)).count == 0)
+        ++leaf;
+    corrupt = bytes;
+    all::BvhNode node = readAt<all::BvhNode>(bytes, nodeOffset(bytes, leaf));
+    node.first = uint32_t(header.triangleCount) - node.count + 1;
+    writeAt(corrupt, nodeOffset(bytes, leaf), node);
+    CHECK(rejected(corrupt, corrupt.size()));
+
+    // Failing leaves nothing behind of what was there before
+    all::Bvh copy;
+    REQUIRE(copy.deserialize(bytes.data(), bytes.size()));
+    CHECK_FALSE(copy.deserialize(corrupt.data(), corrupt.size()));
+    CHECK(copy.isEmpty());
+    CHECK_FALSE(copy.closestHit(all::Ray{ glm::vec3(0.0f, 0.0f, 4.0f), glm::vec3(0.0f, 0.0f, -1.0f) }).has_value());
+}
+
+TEST_CASE("The hierarchy doesn't depend on the number of threads building it")
+{
+    // Enough triangles for the nodes near the root to be binned across threads
+    std::mt19937 rng(8);
+    const Soup soup = randomSoup(rng, 150000, 0.01f);
+
+    struct ThreadCount {
+        explicit ThreadCount(unsigned count) { all::detail::threadCountOverride = count; }
+        ~ThreadCount() { all::detail::threadCountOverride = 0; }
+    };
+    auto build = [&soup](unsigned threadCount) {
+        const ThreadCount scope(threadCount);
+        all::Bvh bvh;
+        bvh.addMesh(soup.positions.data(), 3 * sizeof(float), soup.positions.size() / 3, soup.indices.data(), soup.indices.size());
+        bvh.build();
+        return bvh;
+    };
+
+    const all::Bvh single = build(1);
+    std::vector<uint32_t> singleTree;
+    describeTree(single.serialize(), 0, singleTree);
+    for (const unsigned threadCount : { 2u, 3u, 8u }) {
+        INFO("Built on " << threadCount << " threads");
+        const all::Bvh parallel = build(threadCount);
+        CHECK(parallel.statistics().nodeCount == single.statistics().nodeCount);
+        CHECK(parallel.statistics().leafCount == single.statistics().leafCount);
+        CHECK(parallel.statistics().maxDepth == single.statistics().maxDepth);
+        std::vector<uint32_t> tree;
+        describeTree(parallel.serialize(), 0, tree);
+        CHECK(tree == singleTree);
+    }
+}
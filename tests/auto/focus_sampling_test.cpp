@@ -0,0 +1,239 @@
+// Sample grids laid out by all::focusSamples(), and the focus estimateFocus()
+// takes from the distances they hit, with misses and outliers among them.
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include <shared/focus_sampling.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <vector>
+
+namespace {
+bool isNear(float a, float b, float tolerance = 1e-5f)
+{
+    return std::abs(a - b) <= tolerance;
+}
+
+float totalWeight(const std::vector<all::FocusSample>& samples)
+{
+    return std::accumulate(samples.begin(), samples.end(), 0.0f, [](float sum, const all::FocusSample& sample) {
+        return sum + sample.weight;
+    });
+}
+
+// 64 samples: most on a subject at 10 give or take 2%, some much nearer or farther, the rest missing
+std::vector<all::FocusSample> subjectWithOutliers(const all::FocusSampling& sampling, int nearCount, int farCount, int missCount)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> jitter(-0.2f, 0.2f);
+    std::vector<all::FocusSample> samples = all::focusSamples(sampling, glm::vec2(-1.0f), glm::vec2(1.0f));
+    std::shuffle(samples.begin(), samples.end(), rng);
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        const int index = int(i);
+        if (index < nearCount)
+            samples[i].distance = 0.5f;
+        else if (index < nearCount + farCount)
+            samples[i].distance = 1000.0f;
+        else if (index < nearCount + farCount + missCount)
+            samples[i].distance = -1.0f;
+        else
+            samples[i].distance = 10.0f + jitter(rng);
+    }
+    return samples;
+}
+} // namespace
+
+TEST_CASE("The grid spans the area from the middle outwards")
+{
+    all::FocusSampling sampling;
+    sampling.columns = 5;
+    sampling.rows = 4;
+    const glm::vec2 corner0(-0.5f, 0.25f);
+    const glm::vec2 corner1(0.5f, 0.75f);
+    const std::vector<all::FocusSample> samples = all::focusSamples(sampling, corner0, corner1);
+    REQUIRE(samples.size() == 20);
+
+    glm::vec2 min(1.0f);
+    glm::vec2 max(-1.0f);
+    for (const all::FocusSample& sample : samples) {
+        min = glm::min(min, sample.position);
+        max = glm::max(max, sample.position);
+        CHECK(sample.weight == 1.0f);
+        CHECK(sample.distance < 0.0f);
+    }
+    CHECK(isNear(min.x, corner0.x));
+    CHECK(isNear(min.y, corner0.y));
+    CHECK(isNear(max.x, corner1.x));
+    CHECK(isNear(max.y, corner1.y));
+
+    // Tiles of up to 2x2 samples, each no closer to the middle than the one before
+    const glm::vec2 middle = (corner0 + corner1) * 0.5f;
+    float previousDistance = 0.0f;
+    std::size_t tileCount = 0;
+    for (std::size_t first = 0; first < samples.size(); ++tileCount) {
+        // A tile ends where its samples stop being neighbours of its first one
+        std::size_t end = first + 1;
+        while (end < samples.size() && end < first + 4 && std::abs(samples[end].position.x - samples[first].position.x) < 0.3f
+               && std::abs(samples[end].position.y - samples[first].position.y) < 0.2f)
+            ++end;
+        glm::vec2 center(0.0f);
+        for (std::size_t i = first; i < end; ++i)
+            center += samples[i].position / float(end - first);
+        const glm::vec2 offset = center - middle;
+        const float distance = offset.x * offset.x + offset.y * offset.y;
+        CHECK(distance >= previousDistance - 1e-6f);
+        previousDistance = distance;
+        first = end;
+    }
+    CHECK(tileCount == 6); // 3 columns of tiles, the last one a single sample wide, by 2 rows
+
+    // Sizes are clamped, a single row going through the middle
+    sampling.columns = 100;
+    sampling.rows = 0;
+    const std::vector<all::FocusSample> row = all::focusSamples(sampling, corner0, corner1);
+    REQUIRE(row.size() == all::FocusSampling::MaxGridSize);
+    for (const all::FocusSample& sample : row)
+        CHECK(isNear(sample.position.y, middle.y));
+}
+
+TEST_CASE("Center weighted samples weigh less towards the edges")
+{
+    all::FocusSampling sampling;
+    sampling.statistic = all::FocusStatistic::CenterWeighted;
+    sampling.columns = 9;
+    sampling.rows = 9;
+    const std::vector<all::FocusSample> samples = all::focusSamples(sampling, glm::vec2(-1.0f), glm::vec2(1.0f));
+    REQUIRE(samples.size() == 81);
+    for (const all::FocusSample& sample : samples) {
+        INFO("Sample at " << sample.position.x << ", " << sample.position.y);
+        const float radius = glm::length(sample.position);
+        if (radius < 1e-6f)
+            CHECK(isNear(sample.weight, 1.0f));
+        if (isNear(std::abs(sample.position.x), 1.0f) && isNear(std::abs(sample.position.y), 1.0f))
+            CHECK(isNear(sample.weight, 0.25f));
+        CHECK(sample.weight >= 0.25f - 1e-6f);
+        CHECK(sample.weight <= 1.0f + 1e-6f);
+    }
+    // The middle tile first
+    CHECK(samples.front().weight > samples.back().weight);
+}
+
+TEST_CASE("Samples that all miss give no estimate")
+{
+    const all::FocusSampling sampling;
+    CHECK_FALSE(all::estimateFocus(sampling, {}).has_value());
+    const std::vector<all::FocusSample> samples = all::focusSamples(sampling, glm::vec2(-1.0f), glm::vec2(1.0f));
+    CHECK_FALSE(all::estimateFocus(sampling, samples).has_value());
+
+    // Nor do hits that weigh nothing
+    std::vector<all::FocusSample> weightless = samples;
+    for (all::FocusSample& sample : weightless) {
+        sample.weight = 0.0f;
+        sample.distance = 2.0f;
+    }
+    CHECK_FALSE(all::estimateFocus(sampling, weightless).has_value());
+}
+
+TEST_CASE("A single hit is the focus, as confident as its share of the weight")
+{
+    for (const all::FocusStatistic statistic : { all::FocusStatistic::Median, all::FocusStatistic::Percentile, all::FocusStatistic::CenterWeighted }) {
+        INFO("Statistic " << int(statistic));
+        all::FocusSampling sampling;
+        sampling.statistic = statistic;
+        std::vector<all::FocusSample> samples = all::focusSamples(sampling, glm::vec2(-1.0f), glm::vec2(1.0f));
+        samples[5].distance = 3.0f;
+
+        const std::optional<all::FocusEstimate> estimate = all::estimateFocus(sampling, samples);
+        REQUIRE(estimate.has_value());
+        CHECK(estimate->distance == 3.0f);
+        CHECK(estimate->hitCount == 1);
+        CHECK(isNear(estimate->confidence, samples[5].weight / totalWeight(samples)));
+        CHECK(estimate->confidence < sampling.minConfidence);
+    }
+}
+
+TEST_CASE("Outliers don't move the median off the subject")
+{
+    all::FocusSampling sampling;
+    std::vector<all::FocusSample> samples = subjectWithOutliers(sampling, 12, 12, 8);
+    std::optional<all::FocusEstimate> estimate = all::estimateFocus(sampling, samples);
+    REQUIRE(estimate.has_value());
+    CHECK(std::abs(estimate->distance - 10.0f) <= 0.2f);
+    CHECK(estimate->hitCount == 56);
+    // The 32 samples on the subject agree, misses and outliers don't
+    CHECK(isNear(estimate->confidence, 32.0f / 64.0f));
+
+    // Nor when they outnumber the subject, as long as they are split on both sides of it
+    samples = subjectWithOutliers(sampling, 20, 20, 4);
+    estimate = all::estimateFocus(sampling, samples);
+    REQUIRE(estimate.has_value());
+    CHECK(std::abs(estimate->distance - 10.0f) <= 0.2f);
+    CHECK(isNear(estimate->confidence, 20.0f / 64.0f));
+
+    // Outliers all on one side take over once they are more than half the hits
+    samples = subjectWithOutliers(sampling, 0, 34, 0);
+    estimate = all::estimateFocus(sampling, samples);
+    REQUIRE(estimate.has_value());
+    CHECK(estimate->distance == 1000.0f);
+    CHECK(isNear(estimate->confidence, 34.0f / 64.0f));
+}
+
+TEST_CASE("Percentiles lean towards the near or far outliers")
+{
+    all::FocusSampling sampling;
+    sampling.statistic = all::FocusStatistic::Percentile;
+    const std::vector<all::FocusSample> samples = subjectWithOutliers(sampling, 12, 12, 8);
+
+    sampling.percentile = 0.0f;
+    CHECK(all::estimateFocus(sampling, samples)->distance == 0.5f);
+    sampling.percentile = 1.0f;
+    CHECK(all::estimateFocus(sampling, samples)->distance == 1000.0f);
+    // Out of range percentiles are clamped
+    sampling.percentile = 2.0f;
+    CHECK(all::estimateFocus(sampling, samples)->distance == 1000.0f);
+
+    // A quarter of the 56 hits is past the 12 near ones
+    sampling.percentile = 0.25f;
+    CHECK(std::abs(all::estimateFocus(sampling, samples)->distance - 10.0f) <= 0.2f);
+    sampling.percentile = 0.2f;
+    CHECK(all::estimateFocus(sampling, samples)->distance == 0.5f);
+}
+
+TEST_CASE("Center weighting favours the middle over a busier background")
+{
+    all::FocusSampling sampling;
+    sampling.statistic = all::FocusStatistic::CenterWeighted;
+    std::vector<all::FocusSample> samples = all::focusSamples(sampling, glm::vec2(-1.0f), glm::vec2(1.0f));
+
+    // The heaviest samples on a subject at 3, just enough of them to outweigh the rest at 20
+    std::vector<std::size_t> order(samples.size());
+    std::iota(order.begin(), order.end(), std::size_t(0));
+    std::stable_sort(order.begin(), order.end(), [&samples](std::size_t a, std::size_t b) {
+        return samples[a].weight > samples[b].weight;
+    });
+    const float halfWeight = 0.5f * totalWeight(samples);
+    float subjectWeight = 0.0f;
+    std::size_t subjectCount = 0;
+    for (const std::size_t i : order) {
+        const bool onSubject = subjectWeight <= halfWeight;
+        samples[i].distance = onSubject ? 3.0f : 20.0f;
+        subjectWeight += onSubject ? samples[i].weight : 0.0f;
+        subjectCount += onSubject;
+    }
+    REQUIRE(subjectCount < samples.size() / 2);
+
+    const std::optional<all::FocusEstimate> weighted = all::estimateFocus(sampling, samples);
+    REQUIRE(weighted.has_value());
+    CHECK(weighted->distance == 3.0f);
+    CHECK(isNear(weighted->confidence, subjectWeight / totalWeight(samples)));
+
+    // Counting each sample the same, the background wins
+    for (all::FocusSample& sample : samples)
+        sample.weight = 1.0f;
+    sampling.statistic = all::FocusStatistic::Median;
+    CHECK(all::estimateFocus(sampling, samples)->distance == 20.0f);
+}
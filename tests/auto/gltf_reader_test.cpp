@@ -0,0 +1,287 @@
+// Reads glTF files with GltfReader and with assimp, and checks that the
+// buffer views drawn in place hold the same vertices, triangles and instance
+// transforms as the meshes assimp decodes.
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include "assimp_test_support.h"
+
+#include <gltf_reader.h>
+#include <mesh_loader.h>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+using assimp_test_support::isNear;
+
+constexpr float Tolerance = 1.0e-5f;
+
+const QString AssetsDir = QStringLiteral(ASSETS_DIR);
+
+void append(QByteArray& bytes, std::initializer_list<float> values)
+{
+    for (const float value : values)
+        bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template<typename Index>
+void appendIndices(QByteArray& bytes, std::initializer_list<Index> indices)
+{
+    for (const Index index : indices)
+        bytes.append(reinterpret_cast<const char*>(&index), sizeof(index));
+}
+
+QJsonObject view(int byteOffset, int byteLength, int byteStride = 0)
+{
+    QJsonObject bufferView{ { "buffer", 0 }, { "byteOffset", byteOffset }, { "byteLength", byteLength } };
+    if (byteStride != 0)
+        bufferView["byteStride"] = byteStride;
+    return bufferView;
+}
+
+QJsonObject accessor(int bufferView, int componentType, int count, const char* type, int byteOffset = 0)
+{
+    return { { "bufferView", bufferView }, { "byteOffset", byteOffset }, { "componentType", componentType }, { "count", count }, { "type", type } };
+}
+
+// A quad whose positions and normals are interleaved, with texture
+// coordinates and 16-bit indices, instanced by two nodes in a hierarchy of
+// translations, rotations, scales and matrices. A second mesh has two
+// triangle primitives with 32-bit indices and their own material.
+QJsonObject sceneJson(int& bufferLength, QByteArray& bin)
+{
+    append(bin, { 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 1, 0, 1, 0, 0, 0, 1 }); // 0: 96 bytes, stride 24
+    append(bin, { 0, 0, 1, 0, 1, 0.25f, 0, 0.25f }); // 96: 32 bytes
+    appendIndices<uint16_t>(bin, { 0, 1, 2, 0, 2, 3 }); // 128: 12 bytes
+    append(bin, { -1, 0, 0, 1, 0, 0, 0, 2, 1 }); // 140: 36 bytes
+    append(bin, { 0, -0.4472136f, 0.8944272f, 0, -0.4472136f, 0.8944272f, 0, -0.4472136f, 0.8944272f }); // 176: 36 bytes
+    appendIndices<uint32_t>(bin, { 0, 1, 2 }); // 212: 12 bytes
+    bufferLength = int(bin.size());
+
+    QJsonObject quadPosition = accessor(0, 5126, 4, "VEC3");
+    quadPosition["min"] = QJsonArray{ 0, 0, 0 };
+    quadPosition["max"] = QJsonArray{ 1, 1, 0 };
+    QJsonObject trianglePosition = accessor(3, 5126, 3, "VEC3");
+    trianglePosition["min"] = QJsonArray{ -1, 0, 0 };
+    trianglePosition["max"] = QJsonArray{ 1, 2, 1 };
+
+    const QJsonArray accessors{ quadPosition, accessor(0, 5126, 4, "VEC3", 12), accessor(1, 5126, 4, "VEC2"), accessor(2, 5123, 6, "SCALAR"),
+                                trianglePosition, accessor(4, 5126, 3, "VEC3"), accessor(5, 5125, 3, "SCALAR") };
+    const QJsonArray views{ view(0, 96, 24), view(96, 32), view(128, 12), view(140, 36), view(176, 36), view(212, 12) };
+
+    const QJsonObject quadPrimitive{ { "attributes", QJsonObject{ { "POSITION", 0 }, { "NORMAL", 1 }, { "TEXCOORD_0", 2 } } }, { "indices", 3 }, { "material", 0 } };
+    const QJsonObject triangleAttributes{ { "POSITION", 4 }, { "NORMAL", 5 } };
+    const QJsonArray meshes{
+        QJsonObject{ { "name", "Quad" }, { "primitives", QJsonArray{ quadPrimitive } } },
+        QJsonObject{ { "name", "Pair" },
+                     { "primitives", QJsonArray{ QJsonObject{ { "attributes", triangleAttributes }, { "indices", 6 }, { "material", 1 } },
+                                                 QJsonObject{ { "attributes", triangleAttributes }, { "indices", 6 }, { "material", 0 } } } } },
+    };
+    const QJsonArray materials{
+        QJsonObject{ { "name", "Paint" }, { "pbrMetallicRoughness", QJsonObject{ { "baseColorFactor", QJsonArray{ 1, 0, 0, 1 } } } } },
+        QJsonObject{ { "name", "Metal" }, { "pbrMetallicRoughness", QJsonObject{ { "roughnessFactor", 0.5 } } } },
+    };
+    const QJsonArray nodes{
+        QJsonObject{ { "name", "Single" }, { "mesh", 0 }, { "translation", QJsonArray{ 1, 2, 3 } } },
+        QJsonObject{ { "name", "Group" }, { "rotation", QJsonArray{ 0, 0.70710678, 0, 0.70710678 } }, { "scale", QJsonArray{ 2, 2, 2 } }, { "children", QJsonArray{ 2, 3 } } },
+        QJsonObject{ { "name", "Child" }, { "mesh", 0 }, { "translation", QJsonArray{ 0, 1, 0 } } },
+        QJsonObject{ { "name", "Placed" }, { "mesh", 1 }, { "matrix", QJsonArray{ 1, 0, 0, 0, 0, 0, -1, 0, 0, 1, 0, 0, 5, 0, 0, 1 } } },
+    };
+
+    return {
+        { "asset", QJsonObject{ { "version", "2.0" } } },
+        { "scene", 0 },
+        { "scenes", QJsonArray{ QJsonObject{ { "nodes", QJsonArray{ 0, 1 } } } } },
+        { "nodes", nodes },
+        { "meshes", meshes },
+        { "materials", materials },
+        { "accessors", accessors },
+        { "bufferViews", views },
+    };
+}
+
+QString writeGltf(const QTemporaryDir& dir)
+{
+    QByteArray bin;
+    int bufferLength = 0;
+    QJsonObject json = sceneJson(bufferLength, bin);
+    json["buffers"] = QJsonArray{ QJsonObject{ { "byteLength", bufferLength }, { "uri", "scene.bin" } } };
+
+    QFile binFile(dir.filePath(QStringLiteral("scene.bin")));
+    REQUIRE(binFile.open(QIODevice::WriteOnly));
+    binFile.write(bin);
+
+    const QString path = dir.filePath(QStringLiteral("scene.gltf"));
+    QFile file(path);
+    REQUIRE(file.open(QIODevice::WriteOnly));
+    file.write(QJsonDocument(json).toJson());
+    return path;
+}
+
+QString writeGlb(const QTemporaryDir& dir)
+{
+    QByteArray bin;
+    int bufferLength = 0;
+    QJsonObject json = sceneJson(bufferLength, bin);
+    json["buffers"] = QJsonArray{ QJsonObject{ { "byteLength", bufferLength } } };
+
+    // Chunks are padded to 4 bytes, JSON with spaces and the binary chunk with zeros
+    QByteArray jsonChunk = QJsonDocument(json).toJson(QJsonDocument::Compact);
+    jsonChunk.append((4 - jsonChunk.size() % 4) % 4, ' ');
+    bin.append((4 - bin.size() % 4) % 4, '\0');
+
+    auto word = [](quint32 value) {
+        char bytes[sizeof(quint32)];
+        qToLittleEndian(value, bytes);
+        return QByteArray(bytes, sizeof(bytes));
+    };
+    const quint32 length = 12 + 8 + quint32(jsonChunk.size()) + 8 + quint32(bin.size());
+    const QByteArray glb = word(0x46546C67) + word(2) + word(length) + word(quint32(jsonChunk.size())) + word(0x4E4F534A) + jsonChunk +
+            word(quint32(bin.size())) + word(0x004E4942) + bin;
+
+    const QString path = dir.filePath(QStringLiteral("scene.glb"));
+    QFile file(path);
+    REQUIRE(file.open(QIODevice::WriteOnly));
+    file.write(glb);
+    return path;
+}
+
+// Where assimp put each mesh, in the order of the nodes
+struct ImportedMesh {
+    const aiMesh* mesh{ nullptr };
+    std::vector<aiMatrix4x4> instances;
+};
+
+void collectInstances(const aiScene* scene, const aiNode* node, const aiMatrix4x4& parentTransform, std::map<std::string, ImportedMesh>& meshes)
+{
+    const aiMatrix4x4 transform = parentTransform * node->mTransformation;
+    for (unsigned i = 0; i < node->mNumMeshes; ++i) {
+        const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+        ImportedMesh& imported = meshes[mesh->mName.C_Str()];
+        imported.mesh = mesh;
+        imported.instances.push_back(transform);
+    }
+    for (unsigned i = 0; i < node->mNumChildren; ++i)
+        collectInstances(scene, node->mChildren[i], transform, meshes);
+}
+
+aiVector3D sourceVector(const all::qt3d::ModelData& model, const SceneMeshData::SourceView& view, uint32_t vertex)
+{
+    float values[3] = {};
+    std::memcpy(values, model.buffers[view.buffer].constData() + view.byteOffset + std::size_t(vertex) * view.byteStride, view.size * sizeof(float));
+    return { values[0], values[1], values[2] };
+}
+
+uint32_t sourceIndex(const all::qt3d::ModelData& model, const SceneMeshData& data, uint32_t i)
+{
+    const char* indices = model.buffers[data.sourceLayout->indices.buffer].constData() + data.sourceLayout->indices.byteOffset;
+    if (data.indexType == SceneMesh::IndexType::UInt16)
+        return qFromLittleEndian<quint16>(indices + i * sizeof(quint16));
+    return qFromLittleEndian<quint32>(indices + i * sizeof(quint32));
+}
+
+void compareWithAssimp(const QString& path)
+{
+    const std::shared_ptr<all::qt3d::ModelData> model = all::qt3d::GltfReader::read(path);
+    REQUIRE(model != nullptr);
+
+    // No post-processing, which would renumber the vertices the reader leaves in place
+    Assimp::Importer importer;
+    const aiScene* imported = importer.ReadFile(path.toLocal8Bit().constData(), 0);
+    REQUIRE(imported != nullptr);
+    std::map<std::string, ImportedMesh> importedMeshes;
+    collectInstances(imported, imported->mRootNode, aiMatrix4x4(), importedMeshes);
+    CHECK(model->meshes.size() == importedMeshes.size());
+
+    for (const all::qt3d::ModelMesh& mesh : model->meshes) {
+        INFO("Mesh " << mesh.name.toStdString());
+        const auto it = importedMeshes.find(mesh.name.toStdString());
+        REQUIRE(it != importedMeshes.end());
+        const aiMesh* importedMesh = it->second.mesh;
+        const SceneMeshData& data = mesh.data;
+        REQUIRE(data.sourceLayout.has_value());
+        const SceneMeshData::SourceLayout& layout = *data.sourceLayout;
+
+        CHECK(mesh.data.vertexCount == importedMesh->mNumVertices);
+        REQUIRE(mesh.data.indexCount == 3 * importedMesh->mNumFaces);
+        CHECK(model->materials[mesh.materialIndex].name.toStdString() == std::string(imported->mMaterials[importedMesh->mMaterialIndex]->GetName().C_Str()));
+        REQUIRE((layout.texCoord.buffer >= 0) == importedMesh->HasTextureCoords(0));
+        REQUIRE(importedMesh->HasNormals());
+
+        std::size_t mismatches = 0;
+        for (uint32_t vertex = 0; vertex < data.vertexCount && vertex < importedMesh->mNumVertices; ++vertex) {
+            bool matches = isNear(sourceVector(*model, layout.position, vertex), importedMesh->mVertices[vertex], Tolerance) &&
+                    isNear(sourceVector(*model, layout.normal, vertex), importedMesh->mNormals[vertex], Tolerance);
+            if (layout.texCoord.buffer >= 0) {
+                // assimp moves the origin of texture coordinates to the bottom left, the reader leaves it to the material
+                const aiVector3D texCoord = sourceVector(*model, layout.texCoord, vertex);
+                const aiVector3D& importedTexCoord = importedMesh->mTextureCoords[0][vertex];
+                matches = matches && std::abs(texCoord.x - importedTexCoord.x) <= Tolerance && std::abs(texCoord.y - (1.0f - importedTexCoord.y)) <= Tolerance;
+            }
+            mismatches += matches ? 0 : 1;
+        }
+        CHECK(mismatches == 0);
+        CHECK_FALSE(model->materials[mesh.materialIndex].mirrorDiffuseTexture);
+
+        std::size_t indexMismatches = 0;
+        for (uint32_t face = 0; face < importedMesh->mNumFaces; ++face) {
+            REQUIRE(importedMesh->mFaces[face].mNumIndices == 3);
+            for (uint32_t corner = 0; corner < 3; ++corner)
+                indexMismatches += sourceIndex(*model, data, 3 * face + corner) == importedMesh->mFaces[face].mIndices[corner] ? 0 : 1;
+        }
+        CHECK(indexMismatches == 0);
+
+        // Node transforms end up in the instances, in the order of the nodes
+        const std::vector<aiMatrix4x4>& importedInstances = it->second.instances;
+        REQUIRE(mesh.instances.size() == importedInstances.size());
+        for (std::size_t i = 0; i < mesh.instances.size(); ++i) {
+            INFO("Instance " << i);
+            float largestDifference = 0.0f;
+            for (int row = 0; row < 4; ++row) {
+                for (int column = 0; column < 4; ++column)
+                    largestDifference = std::max(largestDifference, std::abs(mesh.instances[i](row, column) - importedInstances[i][row][column]));
+            }
+            CHECK(largestDifference <= Tolerance);
+        }
+    }
+}
+} // namespace
+
+TEST_CASE("GltfReader reads a generated glTF file like assimp")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    compareWithAssimp(writeGltf(dir));
+}
+
+TEST_CASE("GltfReader reads a generated binary glTF file like assimp")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    compareWithAssimp(writeGlb(dir));
+}
+
+TEST_CASE("GltfReader reads the showroom like assimp")
+{
+    // Its buffer isn't in the repository
+    const QString path = AssetsDir + QStringLiteral("/gltf/showroom2303.gltf");
+    if (!QFile::exists(AssetsDir + QStringLiteral("/gltf/showroom2303.bin"))) {
+        MESSAGE("Skipped, the buffer of " << path.toStdString() << " doesn't exist");
+        return;
+    }
+    compareWithAssimp(path);
+}
@@ -0,0 +1,139 @@
+// Alignment of the allocations served by all::ImportArena, and the reuse of
+// its per thread blocks from one job to the next.
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include <shared/import_arena.h>
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace {
+// More than the block a thread starts from
+constexpr std::size_t LargeJobBytes = std::size_t(1) << 20;
+constexpr std::size_t ChunkBytes = 4096;
+
+bool isAligned(const void* p, std::size_t alignment)
+{
+    return reinterpret_cast<std::uintptr_t>(p) % alignment == 0;
+}
+
+// Allocates LargeJobBytes in chunks, returns the first one
+void* runLargeJob(all::ImportArena& arena)
+{
+    all::ImportArena::Job job(&arena);
+    void* first = job.resource()->allocate(ChunkBytes, alignof(std::max_align_t));
+    for (std::size_t bytes = ChunkBytes; bytes < LargeJobBytes; bytes += ChunkBytes)
+        std::memset(job.resource()->allocate(ChunkBytes, alignof(std::max_align_t)), 0xab, ChunkBytes);
+    return first;
+}
+} // namespace
+
+TEST_CASE("Allocations are aligned as asked and don't overlap")
+{
+    all::ImportArena arena;
+    all::ImportArena::Job job(&arena);
+
+    struct Allocation {
+        unsigned char* data;
+        std::size_t bytes;
+    };
+    std::vector<Allocation> allocations;
+    for (const std::size_t alignment : { 1, 2, 4, 8, 16, 64, 256, 4096 }) {
+        // Odd sizes leave the next allocation misaligned unless the arena pads it
+        for (const std::size_t bytes : { std::size_t(1), std::size_t(3), alignment + 1, std::size_t(1000) }) {
+            auto* data = static_cast<unsigned char*>(job.resource()->allocate(bytes, alignment));
+            INFO("Allocation of " << bytes << " bytes aligned to " << alignment);
+            REQUIRE(data != nullptr);
+            CHECK(isAligned(data, alignment));
+            std::memset(data, int(allocations.size() & 0xff), bytes);
+            allocations.push_back({ data, bytes });
+        }
+    }
+
+    // Each allocation still holds its own fill byte
+    for (std::size_t i = 0; i < allocations.size(); ++i) {
+        INFO("Allocation " << i);
+        bool intact = true;
+        for (std::size_t j = 0; j < allocations[i].bytes; ++j)
+            intact = intact && allocations[i].data[j] == (i & 0xff);
+        CHECK(intact);
+    }
+}
+
+TEST_CASE("A thread starts each job over from one block fitting the largest job")
+{
+    all::ImportArena arena;
+
+    runLargeJob(arena);
+    const all::ImportArena::Statistics afterFirstJob = arena.statistics();
+    CHECK(afterFirstJob.threadCount == 1);
+    CHECK(afterFirstJob.heapAllocationCount > 1); // Grown during the job, then one block for the next
+    CHECK(afterFirstJob.peakBytes >= LargeJobBytes);
+
+    // The same job again fits in that block, from its start each time
+    void* second = runLargeJob(arena);
+    const all::ImportArena::Statistics afterSecondJob = arena.statistics();
+    CHECK(afterSecondJob.heapAllocationCount == afterFirstJob.heapAllocationCount);
+    CHECK(afterSecondJob.peakBytes == afterFirstJob.peakBytes);
+    CHECK(afterSecondJob.allocationCount == 2 * afterFirstJob.allocationCount);
+
+    void* third = runLargeJob(arena);
+    CHECK(third == second);
+    CHECK(arena.statistics().heapAllocationCount == afterFirstJob.heapAllocationCount);
+
+    // Smaller jobs don't shrink it
+    {
+        all::ImportArena::Job job(&arena);
+        CHECK(job.resource()->allocate(ChunkBytes, alignof(std::max_align_t)) == second);
+    }
+    CHECK(arena.statistics().heapAllocationCount == afterFirstJob.heapAllocationCount);
+}
+
+TEST_CASE("Nested jobs only start over when the outermost one ends")
+{
+    all::ImportArena arena;
+    all::ImportArena::Job outer(&arena);
+    auto* before = static_cast<unsigned char*>(outer.resource()->allocate(64, 16));
+    std::memset(before, 1, 64);
+
+    unsigned char* inside = nullptr;
+    {
+        all::ImportArena::Job inner(&arena);
+        CHECK(inner.resource() == outer.resource());
+        inside = static_cast<unsigned char*>(inner.resource()->allocate(64, 16));
+        std::memset(inside, 2, 64);
+    }
+
+    // Both allocations are still valid, the next one comes after them
+    auto* after = static_cast<unsigned char*>(outer.resource()->allocate(64, 16));
+    CHECK(after != before);
+    CHECK(after != inside);
+    std::memset(after, 3, 64);
+    CHECK(before[0] == 1);
+    CHECK(before[63] == 1);
+    CHECK(inside[0] == 2);
+    CHECK(inside[63] == 2);
+}
+
+TEST_CASE("Each thread gets its own sub-arena")
+{
+    all::ImportArena arena;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; ++i)
+        threads.emplace_back([&arena] { runLargeJob(arena); });
+    for (std::thread& thread : threads)
+        thread.join();
+
+    const all::ImportArena::Statistics statistics = arena.statistics();
+    CHECK(statistics.threadCount == 3);
+    CHECK(statistics.peakBytes >= 3 * LargeJobBytes);
+}
+
+TEST_CASE("Jobs without an arena use the default memory resource")
+{
+    const all::ImportArena::Job job(nullptr);
+    CHECK(job.resource() == std::pmr::get_default_resource());
+}
@@ -0,0 +1,166 @@
+// Round trips of models through MeshCache, and the cache files and keys it
+// has to reject or change.
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include <mesh_cache.h>
+#include <mesh_loader.h>
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+
+namespace {
+void writeFile(const QString& path, const QByteArray& content)
+{
+    QFile file(path);
+    REQUIRE(file.open(QIODevice::WriteOnly));
+    file.write(content);
+}
+
+// A quad of float positions and normals, with one material
+all::qt3d::ModelData quadModel()
+{
+    all::qt3d::ModelData model;
+    all::qt3d::ModelMaterial& material = model.materials.emplace_back();
+    material.name = QStringLiteral("Quad");
+    material.diffuse = Qt::red;
+    material.shininess = 8.0f;
+
+    all::qt3d::ModelMesh& mesh = model.meshes.emplace_back();
+    mesh.name = QStringLiteral("quad");
+    SceneMeshData& data = mesh.data;
+    data.vertexCount = 4;
+    data.indexCount = 6;
+    data.indexType = SceneMesh::IndexType::UInt16;
+
+    const float vertices[4][6] = { { 0, 0, 0, 0, 0, 1 }, { 1, 0, 0, 0, 0, 1 }, { 1, 1, 0, 0, 0, 1 }, { 0, 1, 0, 0, 0, 1 } };
+    REQUIRE(sizeof(vertices) == data.vertexCount * SceneMesh::vertexByteStride(data.vertexFlags));
+    data.vertexBytes = QByteArray(reinterpret_cast<const char*>(vertices), sizeof(vertices));
+    const uint16_t indices[6] = { 0, 1, 2, 0, 2, 3 };
+    data.indexBytes = QByteArray(reinterpret_cast<const char*>(indices), sizeof(indices));
+    data.bounds.expand(glm::vec3(0.0f));
+    data.bounds.expand(glm::vec3(1.0f, 1.0f, 0.0f));
+
+    // As if each triangle had been a mesh of its own before batching
+    mesh.subMeshes.push_back({ QStringLiteral("lower"), 0, 3, 0, 4, data.bounds });
+    mesh.subMeshes.push_back({ QStringLiteral("upper"), 3, 3, 0, 4, data.bounds });
+    return model;
+}
+
+struct CacheFixture {
+    CacheFixture()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+        REQUIRE(dir.isValid());
+        modelPath = dir.filePath(QStringLiteral("quad.obj"));
+        mtlPath = dir.filePath(QStringLiteral("quad.mtl"));
+        writeFile(modelPath, "mtllib quad.mtl\nv 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nusemtl Quad\nf 1 2 3 4\n");
+        writeFile(mtlPath, "newmtl Quad\nKd 1 0 0\n");
+    }
+
+    QTemporaryDir dir;
+    QString modelPath;
+    QString mtlPath;
+};
+} // namespace
+
+TEST_CASE_FIXTURE(CacheFixture, "A model written to the cache reads back the same")
+{
+    const QString cacheFilePath = all::qt3d::MeshCache::cacheFilePath(modelPath, {});
+    REQUIRE(!cacheFilePath.isEmpty());
+    const all::qt3d::ModelData model = quadModel();
+    REQUIRE(all::qt3d::MeshCache::write(cacheFilePath, modelPath, model));
+
+    const auto cached = all::qt3d::MeshCache::read(cacheFilePath, modelPath);
+    REQUIRE(cached != nullptr);
+    REQUIRE(cached->materials.size() == 1);
+    CHECK(cached->materials[0].name == model.materials[0].name);
+    CHECK(cached->materials[0].diffuse == model.materials[0].diffuse);
+    CHECK(cached->materials[0].shininess == model.materials[0].shininess);
+
+    REQUIRE(cached->meshes.size() == 1);
+    const all::qt3d::ModelMesh& mesh = cached->meshes[0];
+    CHECK(mesh.name == model.meshes[0].name);
+    CHECK(mesh.data.vertexCount == 4);
+    CHECK(mesh.data.indexCount == 6);
+    CHECK(mesh.data.indexType == SceneMesh::IndexType::UInt16);
+    CHECK(mesh.data.vertexBytes == model.meshes[0].data.vertexBytes);
+    CHECK(mesh.data.indexBytes == model.meshes[0].data.indexBytes);
+    CHECK(mesh.data.bounds.min == model.meshes[0].data.bounds.min);
+    CHECK(mesh.data.bounds.max == model.meshes[0].data.bounds.max);
+
+    REQUIRE(mesh.subMeshes.size() == 2);
+    REQUIRE(mesh.subMeshAt(0) != nullptr);
+    CHECK(mesh.subMeshAt(0)->name == QStringLiteral("lower"));
+    REQUIRE(mesh.subMeshAt(1) != nullptr);
+    CHECK(mesh.subMeshAt(1)->name == QStringLiteral("upper"));
+    CHECK(mesh.subMeshAt(1)->firstIndex == 3);
+    CHECK(mesh.subMeshAt(2) == nullptr);
+}
+
+TEST_CASE_FIXTURE(CacheFixture, "Touching a referenced material library changes the key")
+{
+    const QString before = all::qt3d::MeshCache::cacheFilePath(modelPath, {});
+    CHECK(before == all::qt3d::MeshCache::cacheFilePath(modelPath, {}));
+
+    {
+        QFile mtl(mtlPath);
+        REQUIRE(mtl.open(QIODevice::ReadWrite));
+        REQUIRE(mtl.setFileTime(QFileInfo(mtl).lastModified().addSecs(10), QFileDevice::FileModificationTime));
+    }
+    const QString touched = all::qt3d::MeshCache::cacheFilePath(modelPath, {});
+    CHECK(touched != before);
+
+    writeFile(mtlPath, "newmtl Quad\nKd 0 1 0.5\n");
+    CHECK(all::qt3d::MeshCache::cacheFilePath(modelPath, {}) != touched);
+
+    // So does a missing one
+    REQUIRE(QFile::remove(mtlPath));
+    CHECK(all::qt3d::MeshCache::cacheFilePath(modelPath, {}) != touched);
+}
+
+TEST_CASE_FIXTURE(CacheFixture, "Truncated cache files are rejected")
+{
+    const QString cacheFilePath = all::qt3d::MeshCache::cacheFilePath(modelPath, {});
+    REQUIRE(all::qt3d::MeshCache::write(cacheFilePath, modelPath, quadModel()));
+    const qint64 size = QFileInfo(cacheFilePath).size();
+
+    for (const qint64 truncatedSize : { size - 1, size / 2, qint64(8), qint64(0) }) {
+        INFO("Truncated to " << truncatedSize << " of " << size << " bytes");
+        REQUIRE(all::qt3d::MeshCache::write(cacheFilePath, modelPath, quadModel()));
+        REQUIRE(QFile::resize(cacheFilePath, truncatedSize));
+        CHECK(all::qt3d::MeshCache::read(cacheFilePath, modelPath) == nullptr);
+    }
+}
+
+TEST_CASE_FIXTURE(CacheFixture, "Blobs not matching their mesh are rejected")
+{
+    const QString cacheFilePath = all::qt3d::MeshCache::cacheFilePath(modelPath, {});
+
+    SUBCASE("Vertex blob one vertex short")
+    {
+        all::qt3d::ModelData model = quadModel();
+        model.meshes[0].data.vertexBytes.chop(qsizetype(SceneMesh::vertexByteStride(model.meshes[0].data.vertexFlags)));
+        REQUIRE(all::qt3d::MeshCache::write(cacheFilePath, modelPath, model));
+        CHECK(all::qt3d::MeshCache::read(cacheFilePath, modelPath) == nullptr);
+    }
+
+    SUBCASE("Index blob one index short")
+    {
+        all::qt3d::ModelData model = quadModel();
+        model.meshes[0].data.indexBytes.chop(sizeof(uint16_t));
+        REQUIRE(all::qt3d::MeshCache::write(cacheFilePath, modelPath, model));
+        CHECK(all::qt3d::MeshCache::read(cacheFilePath, modelPath) == nullptr);
+    }
+
+    SUBCASE("Picking positions of the wrong vertex count")
+    {
+        all::qt3d::ModelData model = quadModel();
+        model.meshes[0].data.pickingPositions = QByteArray(3 * 3 * sizeof(float), '\0');
+        REQUIRE(all::qt3d::MeshCache::write(cacheFilePath, modelPath, model));
+        CHECK(all::qt3d::MeshCache::read(cacheFilePath, modelPath) == nullptr);
+    }
+}
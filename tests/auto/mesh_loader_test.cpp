@@ -0,0 +1,89 @@
+// Entities created by MeshLoader for imported models, and the diffuse
+// textures they share within a load and with the load before them.
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include <mesh_loader.h>
+
+#include <Qt3DCore/QEntity>
+#include <Qt3DRender/QTextureLoader>
+#include <QDir>
+#include <QUrl>
+
+#include <memory>
+
+namespace {
+const QString TexturePath = QDir::temp().absoluteFilePath(QStringLiteral("mesh_loader_test_wood.png"));
+
+// A quad drawn with material, texture coordinates included
+all::qt3d::ModelMesh quad(const QString& name, uint32_t material)
+{
+    all::qt3d::ModelMesh mesh;
+    mesh.name = name;
+    mesh.materialIndex = material;
+    SceneMeshData& data = mesh.data;
+    data.vertexFlags = SceneMesh::VertexFlag::HasTextureCoords;
+    data.vertexCount = 4;
+    data.indexCount = 6;
+    data.indexType = SceneMesh::IndexType::UInt16;
+    data.vertexBytes = QByteArray(qsizetype(data.vertexCount * SceneMesh::vertexByteStride(data.vertexFlags)), '\0');
+    const uint16_t indices[6] = { 0, 1, 2, 0, 2, 3 };
+    data.indexBytes = QByteArray(reinterpret_cast<const char*>(indices), sizeof(indices));
+    data.bounds.expand(glm::vec3(0.0f));
+    data.bounds.expand(glm::vec3(1.0f, 1.0f, 0.0f));
+    return mesh;
+}
+
+// Two meshes sharing a textured material, and a third one whose own material uses the same texture
+all::qt3d::ModelData texturedModel()
+{
+    all::qt3d::ModelData model;
+    for (const QString& name : { QStringLiteral("Wood"), QStringLiteral("Varnished wood") }) {
+        all::qt3d::ModelMaterial& material = model.materials.emplace_back();
+        material.name = name;
+        material.diffuse = Qt::white;
+        material.diffuseTexturePath = TexturePath;
+    }
+    model.meshes.push_back(quad(QStringLiteral("floor"), 0));
+    model.meshes.push_back(quad(QStringLiteral("wall"), 0));
+    model.meshes.push_back(quad(QStringLiteral("table"), 1));
+    return model;
+}
+
+qsizetype textureCount(const Qt3DCore::QEntity* root)
+{
+    return root->findChildren<Qt3DRender::QTextureLoader*>(Qt::FindDirectChildrenOnly).size();
+}
+} // namespace
+
+TEST_CASE("Meshes sharing a texture path share a texture")
+{
+    std::unique_ptr<Qt3DCore::QEntity> root(all::qt3d::MeshLoader::createEntities(texturedModel()));
+    REQUIRE(root != nullptr);
+    CHECK(textureCount(root.get()) == 1);
+}
+
+TEST_CASE("A load takes over the textures of the model it replaces")
+{
+    std::unique_ptr<Qt3DCore::QEntity> previous(all::qt3d::MeshLoader::createEntities(texturedModel()));
+    REQUIRE(textureCount(previous.get()) == 1);
+    const auto* texture = previous->findChild<Qt3DRender::QTextureLoader*>();
+
+    std::unique_ptr<Qt3DCore::QEntity> root(all::qt3d::MeshLoader::createEntities(texturedModel()));
+    CHECK(textureCount(previous.get()) == 0);
+    REQUIRE(textureCount(root.get()) == 1);
+    CHECK(root->findChild<Qt3DRender::QTextureLoader*>() == texture);
+}
+
+TEST_CASE("Textures destroyed with their model are created again")
+{
+    std::unique_ptr<Qt3DCore::QEntity> previous(all::qt3d::MeshLoader::createEntities(texturedModel()));
+    REQUIRE(textureCount(previous.get()) == 1);
+    previous.reset();
+
+    // The cache entry left behind is dropped, a new texture takes its place
+    std::unique_ptr<Qt3DCore::QEntity> root(all::qt3d::MeshLoader::createEntities(texturedModel()));
+    REQUIRE(textureCount(root.get()) == 1);
+    const auto* texture = root->findChild<Qt3DRender::QTextureLoader*>();
+    CHECK(texture->source() == QUrl::fromLocalFile(TexturePath));
+}
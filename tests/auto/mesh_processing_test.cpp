@@ -0,0 +1,215 @@
+// Normal generation and vertex joining of all::mesh_processing, on small
+// meshes with known results and against assimp's own steps on a bundled model.
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include "assimp_test_support.h"
+
+#include <shared/mesh_processing.h>
+
+#include <assimp/Importer.hpp>
+#include <assimp/config.h>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include <cmath>
+#include <memory>
+#include <numbers>
+#include <string>
+#include <vector>
+
+namespace mesh_processing = all::mesh_processing;
+
+namespace {
+using assimp_test_support::isNear;
+using assimp_test_support::meshesOf;
+
+constexpr float Tolerance = 1.0e-5f;
+
+// One vertex per corner, like the OBJ importer produces them
+std::unique_ptr<aiMesh> unindexedMesh(const std::vector<aiVector3D>& corners)
+{
+    auto mesh = std::make_unique<aiMesh>();
+    mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+    mesh->mNumVertices = unsigned(corners.size());
+    mesh->mVertices = new aiVector3D[corners.size()];
+    std::copy(corners.begin(), corners.end(), mesh->mVertices);
+    mesh->mNumFaces = unsigned(corners.size() / 3);
+    mesh->mFaces = new aiFace[mesh->mNumFaces];
+    for (unsigned i = 0; i < mesh->mNumFaces; ++i) {
+        mesh->mFaces[i].mNumIndices = 3;
+        mesh->mFaces[i].mIndices = new unsigned[3]{ 3 * i, 3 * i + 1, 3 * i + 2 };
+    }
+    return mesh;
+}
+
+// Two unit squares meeting along the y axis, both sides raised by half of
+// foldDegrees, each split into two triangles mirroring the other side's.
+// The angles at the shared edge are the same on both sides, so its smoothed
+// normal points straight up.
+std::unique_ptr<aiMesh> foldedStrip(float foldDegrees)
+{
+    const float halfFold = foldDegrees * 0.5f * std::numbers::pi_v<float> / 180.0f;
+    const float c = std::cos(halfFold);
+    const float s = std::sin(halfFold);
+    const aiVector3D a(-c, 0.0f, s), b(0.0f, 0.0f, 0.0f), d(0.0f, 1.0f, 0.0f), e(-c, 1.0f, s);
+    const aiVector3D f(c, 0.0f, s), g(c, 1.0f, s);
+    return unindexedMesh({ a, b, d, a, d, e, b, f, d, f, g, d });
+}
+
+aiVector3D leftNormal(float foldDegrees)
+{
+    const float halfFold = foldDegrees * 0.5f * std::numbers::pi_v<float> / 180.0f;
+    return { std::sin(halfFold), 0.0f, std::cos(halfFold) };
+}
+
+aiVector3D rightNormal(float foldDegrees)
+{
+    const float halfFold = foldDegrees * 0.5f * std::numbers::pi_v<float> / 180.0f;
+    return { -std::sin(halfFold), 0.0f, std::cos(halfFold) };
+}
+
+// Checks the normals of a folded strip after generating them and joining the vertices
+void checkFoldedStrip(float foldDegrees, float creaseAngle, bool smoothEdge)
+{
+    INFO("Fold of " << foldDegrees << " degrees, crease angle of " << creaseAngle);
+    const auto mesh = foldedStrip(foldDegrees);
+    REQUIRE(mesh_processing::generateNormals(*mesh, creaseAngle));
+    mesh_processing::joinIdenticalVertices(*mesh);
+
+    // The edge vertices are shared by both sides when smoothed, there are two of each otherwise
+    CHECK(mesh->mNumVertices == (smoothEdge ? 6u : 8u));
+    for (unsigned face = 0; face < mesh->mNumFaces; ++face) {
+        const bool left = face < 2;
+        for (unsigned corner = 0; corner < 3; ++corner) {
+            const unsigned vertex = mesh->mFaces[face].mIndices[corner];
+            REQUIRE(vertex < mesh->mNumVertices);
+            const bool onEdge = std::abs(mesh->mVertices[vertex].x) <= Tolerance;
+            const aiVector3D expected = onEdge && smoothEdge ? aiVector3D(0.0f, 0.0f, 1.0f) : left ? leftNormal(foldDegrees) : rightNormal(foldDegrees);
+            INFO("Face " << face << ", corner " << corner);
+            CHECK(isNear(mesh->mNormals[vertex], expected));
+        }
+    }
+}
+} // namespace
+
+TEST_CASE("Flat normals are the face normals")
+{
+    checkFoldedStrip(20.0f, 0.0f, false);
+}
+
+TEST_CASE("Normals are smoothed across edges below the crease angle")
+{
+    checkFoldedStrip(20.0f, 30.0f, true);
+    checkFoldedStrip(60.0f, 30.0f, false);
+}
+
+TEST_CASE("A crease angle of 180 degrees smooths every edge")
+{
+    checkFoldedStrip(120.0f, 180.0f, true);
+}
+
+TEST_CASE("Meshes with normals are left alone")
+{
+    const auto mesh = foldedStrip(20.0f);
+    mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+    CHECK_FALSE(mesh_processing::generateNormals(*mesh, 0.0f));
+    CHECK(mesh->mNumVertices == 12);
+}
+
+TEST_CASE("Identical vertices are joined in order of first occurrence")
+{
+    // Two triangles sharing an edge, a third one off to the side
+    const aiVector3D a(0.0f, 0.0f, 0.0f), b(1.0f, 0.0f, 0.0f), c(0.0f, 1.0f, 0.0f), d(1.0f, 1.0f, 0.0f);
+    const aiVector3D e(5.0f, 0.0f, 0.0f), f(6.0f, 0.0f, 0.0f), g(5.0f, 1.0f, 0.0f);
+    const std::vector<aiVector3D> corners = { a, b, c, c, b, d, e, f, g };
+    const auto mesh = unindexedMesh(corners);
+
+    CHECK(mesh_processing::joinIdenticalVertices(*mesh) == 2);
+    REQUIRE(mesh->mNumVertices == 7);
+    const std::vector<aiVector3D> expectedVertices = { a, b, c, d, e, f, g };
+    for (unsigned i = 0; i < mesh->mNumVertices; ++i)
+        CHECK(isNear(mesh->mVertices[i], expectedVertices[i], 0.0f));
+
+    // Faces still go through the same positions
+    for (unsigned face = 0; face < mesh->mNumFaces; ++face) {
+        for (unsigned corner = 0; corner < 3; ++corner)
+            CHECK(isNear(mesh->mVertices[mesh->mFaces[face].mIndices[corner]], corners[3 * face + corner], 0.0f));
+    }
+
+    // Nothing left to join
+    CHECK(mesh_processing::joinIdenticalVertices(*mesh) == 0);
+    CHECK(mesh->mNumVertices == 7);
+}
+
+TEST_CASE("Vertices a rounding error apart are joined, others aren't")
+{
+    const aiVector3D a(1.0f, 1.0f, 1.0f);
+    const aiVector3D almostA(std::nextafter(1.0f, 2.0f), 1.0f, 1.0f);
+    const aiVector3D nearA(1.001f, 1.0f, 1.0f);
+    const auto mesh = unindexedMesh({ a, almostA, nearA });
+
+    CHECK(mesh_processing::joinIdenticalVertices(*mesh) == 1);
+    CHECK(mesh->mNumVertices == 2);
+    CHECK(mesh->mFaces[0].mIndices[0] == mesh->mFaces[0].mIndices[1]);
+}
+
+TEST_CASE("Vertices differing in any attribute aren't joined")
+{
+    const aiVector3D a(0.0f, 0.0f, 0.0f);
+    const auto mesh = unindexedMesh({ a, a, a });
+    mesh->mTextureCoords[0] = new aiVector3D[3]{ { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, { 0.5f, 0.0f, 0.0f } };
+    mesh->mNumUVComponents[0] = 2;
+
+    CHECK(mesh_processing::joinIdenticalVertices(*mesh) == 1);
+    REQUIRE(mesh->mNumVertices == 2);
+    CHECK(mesh->mTextureCoords[0][mesh->mFaces[0].mIndices[2]].x == 0.5f);
+}
+
+TEST_CASE("The cottage is processed like assimp does")
+{
+    const std::string path = ASSETS_DIR "/cottage.obj";
+
+    // Normals are dropped on import, so that both generate them
+    Assimp::Importer importer;
+    importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, aiComponent_NORMALS);
+    aiScene* scene = const_cast<aiScene*>(importer.ReadFile(path, aiProcess_Triangulate | aiProcess_RemoveComponent));
+    REQUIRE(scene != nullptr);
+    REQUIRE(mesh_processing::canProcess(*scene));
+    const mesh_processing::SceneReport report = mesh_processing::processScene(*scene, { .generateNormals = true, .normalCreaseAngle = 0.0f, .joinIdenticalVertices = true });
+    CHECK(report.normalMeshCount == scene->mNumMeshes);
+
+    Assimp::Importer referenceImporter;
+    referenceImporter.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, aiComponent_NORMALS);
+    const aiScene* reference = referenceImporter.ReadFile(path, aiProcess_Triangulate | aiProcess_RemoveComponent | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices);
+    REQUIRE(reference != nullptr);
+
+    const std::vector<const aiMesh*> meshes = meshesOf(scene);
+    const std::vector<const aiMesh*> referenceMeshes = meshesOf(reference);
+    REQUIRE(meshes.size() == referenceMeshes.size());
+    for (std::size_t i = 0; i < meshes.size(); ++i) {
+        const aiMesh* mesh = meshes[i];
+        const aiMesh* referenceMesh = referenceMeshes[i];
+        INFO("Mesh " << i << " (" << mesh->mName.C_Str() << ")");
+        REQUIRE(mesh->mNumFaces == referenceMesh->mNumFaces);
+        CHECK(mesh->mNumVertices == referenceMesh->mNumVertices);
+        REQUIRE(mesh->HasNormals());
+        REQUIRE(mesh->HasTextureCoords(0) == referenceMesh->HasTextureCoords(0));
+
+        // Corners by value, both might number the vertices differently
+        std::size_t mismatches = 0;
+        std::string firstMismatch;
+        for (unsigned face = 0; face < mesh->mNumFaces; ++face) {
+            for (unsigned corner = 0; corner < mesh->mFaces[face].mNumIndices; ++corner) {
+                const unsigned v = mesh->mFaces[face].mIndices[corner];
+                const unsigned r = referenceMesh->mFaces[face].mIndices[corner];
+                const bool matches = isNear(mesh->mVertices[v], referenceMesh->mVertices[r]) && isNear(mesh->mNormals[v], referenceMesh->mNormals[r], 1.0e-4f) &&
+                        (!mesh->HasTextureCoords(0) || isNear(mesh->mTextureCoords[0][v], referenceMesh->mTextureCoords[0][r]));
+                if (!matches && mismatches++ == 0)
+                    firstMismatch = "face " + std::to_string(face) + ", corner " + std::to_string(corner);
+            }
+        }
+        INFO("First mismatch at " << firstMismatch);
+        CHECK(mismatches == 0);
+    }
+}
@@ -0,0 +1,104 @@
+// Reads the bundled OBJ models with ObjReader and with assimp, using the
+// post-processing MeshLoader asks assimp for, and checks that both scenes
+// hold the same meshes, materials and triangles.
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include "assimp_test_support.h"
+
+#include <obj_reader.h>
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <QFile>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+using assimp_test_support::isNear;
+using assimp_test_support::meshesOf;
+
+// Both parse decimals on their own, and generate normals in their own order
+constexpr float PositionTolerance = 1.0e-5f;
+constexpr float NormalTolerance = 1.0e-4f;
+
+const QString AssetsDir = QStringLiteral(ASSETS_DIR);
+
+// Vertices are numbered differently by both, the corners of each triangle have to match
+std::size_t mismatchingCorners(const aiMesh* read, const aiMesh* imported, std::string& firstMismatch)
+{
+    const bool texCoords = read->HasTextureCoords(0);
+    std::size_t mismatches = 0;
+    for (unsigned face = 0; face < read->mNumFaces; ++face) {
+        for (unsigned corner = 0; corner < 3; ++corner) {
+            const unsigned a = read->mFaces[face].mIndices[corner];
+            const unsigned b = imported->mFaces[face].mIndices[corner];
+            const bool matches = isNear(read->mVertices[a], imported->mVertices[b], PositionTolerance) &&
+                    isNear(read->mNormals[a], imported->mNormals[b], NormalTolerance) &&
+                    (!texCoords ||
+                     (std::abs(read->mTextureCoords[0][a].x - imported->mTextureCoords[0][b].x) <= PositionTolerance &&
+                      std::abs(read->mTextureCoords[0][a].y - imported->mTextureCoords[0][b].y) <= PositionTolerance));
+            if (!matches && mismatches++ == 0)
+                firstMismatch = "face " + std::to_string(face) + ", corner " + std::to_string(corner);
+        }
+    }
+    return mismatches;
+}
+
+void compareWithAssimp(const QString& path)
+{
+    const all::qt3d::ObjReader::Result result = all::qt3d::ObjReader::read(path);
+    REQUIRE(result.scene != nullptr);
+    const aiScene* read = result.scene.get();
+
+    Assimp::Importer importer;
+    const aiScene* imported = importer.ReadFile(path.toLocal8Bit().constData(), aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices);
+    REQUIRE(imported != nullptr);
+
+    const std::vector<const aiMesh*> readMeshes = meshesOf(read);
+    const std::vector<const aiMesh*> importedMeshes = meshesOf(imported);
+    REQUIRE(readMeshes.size() == importedMeshes.size());
+
+    for (std::size_t i = 0; i < readMeshes.size(); ++i) {
+        const aiMesh* readMesh = readMeshes[i];
+        const aiMesh* importedMesh = importedMeshes[i];
+        INFO("Mesh " << i << " (" << readMesh->mName.C_Str() << ")");
+
+        CHECK(std::string(read->mMaterials[readMesh->mMaterialIndex]->GetName().C_Str()) ==
+              std::string(imported->mMaterials[importedMesh->mMaterialIndex]->GetName().C_Str()));
+
+        REQUIRE(readMesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE);
+        REQUIRE(readMesh->mNumFaces == importedMesh->mNumFaces);
+        CHECK(readMesh->mNumVertices == importedMesh->mNumVertices);
+        REQUIRE(readMesh->HasNormals());
+        REQUIRE(importedMesh->HasNormals());
+        REQUIRE(readMesh->HasTextureCoords(0) == importedMesh->HasTextureCoords(0));
+        for (unsigned face = 0; face < importedMesh->mNumFaces; ++face)
+            REQUIRE(importedMesh->mFaces[face].mNumIndices == 3);
+
+        std::string firstMismatch;
+        const std::size_t mismatches = mismatchingCorners(readMesh, importedMesh, firstMismatch);
+        INFO("First mismatch at " << firstMismatch);
+        CHECK(mismatches == 0);
+    }
+}
+} // namespace
+
+TEST_CASE("ObjReader reads the cottage like assimp")
+{
+    compareWithAssimp(AssetsDir + QStringLiteral("/cottage.obj"));
+}
+
+TEST_CASE("ObjReader reads the motorbike like assimp")
+{
+    // The default model, only its material library is in the repository
+    const QString path = AssetsDir + QStringLiteral("/motorbike.obj");
+    if (!QFile::exists(path)) {
+        MESSAGE("Skipped, " << path.toStdString() << " doesn't exist");
+        return;
+    }
+    compareWithAssimp(path);
+}
@@ -0,0 +1,118 @@
+// Binary PLY files read by PlyReader, and the malformed ones it has to turn
+// down without reading past the end of the file or allocating for counts
+// the file can't hold.
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include <ply_reader.h>
+
+#include <assimp/scene.h>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <cstdint>
+#include <string>
+
+namespace {
+// A unit quad as a single polygon, fanned into two triangles
+const QByteArray QuadVertices = [] {
+    QByteArray bytes;
+    for (const float value : { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f })
+        bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    return bytes;
+}();
+
+QByteArray face(std::initializer_list<int32_t> indices)
+{
+    QByteArray bytes(1, char(indices.size()));
+    for (const int32_t index : indices)
+        bytes.append(reinterpret_cast<const char*>(&index), sizeof(index));
+    return bytes;
+}
+
+std::string header(const std::string& elements)
+{
+    return "ply\nformat binary_little_endian 1.0\n" + elements + "end_header\n";
+}
+
+const std::string VertexProperties = "property float x\nproperty float y\nproperty float z\n";
+const std::string VertexElement = "element vertex 4\n" + VertexProperties;
+const std::string FaceElement = "element face 1\nproperty list uchar int vertex_indices\n";
+const std::string QuadElements = VertexElement + FaceElement;
+
+struct PlyFixture {
+    PlyFixture() { REQUIRE(dir.isValid()); }
+
+    all::qt3d::PlyReader::Result read(const std::string& header, const QByteArray& body)
+    {
+        const QString path = dir.filePath(QStringLiteral("model.ply"));
+        QFile file(path);
+        REQUIRE(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        file.write(header.data(), qint64(header.size()));
+        file.write(body);
+        file.close();
+        return all::qt3d::PlyReader::read(path);
+    }
+
+    QTemporaryDir dir;
+};
+} // namespace
+
+TEST_CASE_FIXTURE(PlyFixture, "A polygon is read as a fan of triangles")
+{
+    const all::qt3d::PlyReader::Result result = read(header(QuadElements), QuadVertices + face({ 0, 1, 2, 3 }));
+    REQUIRE(result.scene != nullptr);
+    REQUIRE(result.scene->mNumMeshes == 1);
+    const aiMesh* mesh = result.scene->mMeshes[0];
+    CHECK(mesh->mNumFaces == 2);
+    CHECK(mesh->mNumVertices == 4);
+    REQUIRE(mesh->HasNormals());
+    CHECK(mesh->mNormals[0].z == doctest::Approx(1.0f));
+}
+
+TEST_CASE_FIXTURE(PlyFixture, "Malformed headers are turned down")
+{
+    const QByteArray triangle = QuadVertices + face({ 0, 1, 2 });
+
+    SUBCASE("ASCII format")
+    {
+        CHECK(read("ply\nformat ascii 1.0\n" + QuadElements + "end_header\n", {}).scene == nullptr);
+    }
+
+    SUBCASE("No end of header")
+    {
+        CHECK(read("ply\nformat binary_little_endian 1.0\n" + QuadElements, triangle).scene == nullptr);
+    }
+
+    SUBCASE("Count that isn't a number")
+    {
+        CHECK(read(header("element vertex many\n" + VertexProperties + FaceElement), triangle).scene == nullptr);
+    }
+
+    SUBCASE("Property of an unknown type")
+    {
+        CHECK(read(header("element vertex 4\nproperty float x\nproperty float y\nproperty quad z\n" + FaceElement), triangle).scene == nullptr);
+    }
+
+    SUBCASE("Element before the vertices whose byte size wraps around")
+    {
+        // 2^62 elements of 4 bytes each take 2^64 bytes, 0 once wrapped
+        CHECK(read(header("element padding 4611686018427387904\nproperty float value\n" + QuadElements), triangle).scene == nullptr);
+    }
+
+    SUBCASE("Face count whose byte size wraps around")
+    {
+        // Faces of a uchar count and three ints take 13 bytes, this many of them 10 bytes once wrapped
+        CHECK(read(header(VertexElement + "element face 1418980313362273202\nproperty list uchar int vertex_indices\n"), triangle).scene == nullptr);
+    }
+
+    SUBCASE("More faces than the file holds")
+    {
+        CHECK(read(header(VertexElement + "element face 1000\nproperty list uchar int vertex_indices\n"), triangle).scene == nullptr);
+    }
+
+    SUBCASE("Vertex index out of range")
+    {
+        CHECK(read(header(QuadElements), QuadVertices + face({ 0, 1, 4 })).scene == nullptr);
+    }
+}
@@ -0,0 +1,112 @@
+// Index type selection of SceneMesh, and the split of meshes too large for
+// 16-bit indices into chunks that aren't.
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include <scene_mesh.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+// Grid of width x height vertices with two triangles per cell, row by row.
+// The x coordinate of each vertex holds its index, so that vertices can be
+// followed through a split.
+SceneMeshData grid(uint32_t width, uint32_t height)
+{
+    SceneMeshData data;
+    data.vertexCount = width * height;
+    data.indexType = SceneMesh::indexTypeFor(data.vertexCount);
+
+    const std::size_t byteStride = SceneMesh::vertexByteStride(data.vertexFlags);
+    data.vertexBytes = QByteArray(qsizetype(data.vertexCount * byteStride), '\0');
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            const uint32_t vertex = y * width + x;
+            const float position[3] = { float(vertex), float(y), 0.0f };
+            std::memcpy(data.vertexBytes.data() + vertex * byteStride, position, sizeof(position));
+            data.bounds.expand(glm::vec3(position[0], position[1], position[2]));
+        }
+    }
+
+    std::vector<uint32_t> indices;
+    for (uint32_t y = 0; y + 1 < height; ++y) {
+        for (uint32_t x = 0; x + 1 < width; ++x) {
+            const uint32_t corner = y * width + x;
+            indices.insert(indices.end(), { corner, corner + width, corner + 1, corner + 1, corner + width, corner + width + 1 });
+        }
+    }
+    data.indexCount = uint32_t(indices.size());
+    data.indexBytes.resize(qsizetype(indices.size() * SceneMesh::indexByteSize(data.indexType)));
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+        if (data.indexType == SceneMesh::IndexType::UInt16)
+            reinterpret_cast<uint16_t*>(data.indexBytes.data())[i] = uint16_t(indices[i]);
+        else
+            reinterpret_cast<uint32_t*>(data.indexBytes.data())[i] = indices[i];
+    }
+    return data;
+}
+
+uint32_t indexAt(const SceneMeshData& data, std::size_t i)
+{
+    if (data.indexType == SceneMesh::IndexType::UInt16)
+        return reinterpret_cast<const uint16_t*>(data.indexBytes.constData())[i];
+    return reinterpret_cast<const uint32_t*>(data.indexBytes.constData())[i];
+}
+
+// Index of the vertex in the grid it came from
+uint32_t gridVertex(const SceneMeshData& data, uint32_t vertex)
+{
+    float x = 0.0f;
+    std::memcpy(&x, data.vertexBytes.constData() + vertex * SceneMesh::vertexByteStride(data.vertexFlags), sizeof(x));
+    return uint32_t(x);
+}
+} // namespace
+
+TEST_CASE("16-bit indices are used while they can address every vertex")
+{
+    CHECK(SceneMesh::indexTypeFor(0) == SceneMesh::IndexType::UInt16);
+    CHECK(SceneMesh::indexTypeFor(65535) == SceneMesh::IndexType::UInt16);
+    CHECK(SceneMesh::indexTypeFor(65536) == SceneMesh::IndexType::UInt16);
+    CHECK(SceneMesh::indexTypeFor(65537) == SceneMesh::IndexType::UInt32);
+}
+
+TEST_CASE("A mesh with 16-bit indices isn't split")
+{
+    const SceneMeshData data = grid(256, 256);
+    REQUIRE(data.indexType == SceneMesh::IndexType::UInt16);
+
+    const std::vector<SceneMeshData> chunks = SceneMesh::splitForShortIndices(data);
+    REQUIRE(chunks.size() == 1);
+    CHECK(chunks[0].vertexCount == data.vertexCount);
+    CHECK(chunks[0].indexBytes == data.indexBytes);
+    CHECK(chunks[0].vertexBytes == data.vertexBytes);
+}
+
+TEST_CASE("A mesh too large for 16-bit indices is split into chunks that aren't")
+{
+    const SceneMeshData data = grid(400, 400);
+    REQUIRE(data.indexType == SceneMesh::IndexType::UInt32);
+
+    const std::vector<SceneMeshData> chunks = SceneMesh::splitForShortIndices(data);
+    REQUIRE(chunks.size() > 1);
+
+    // Every triangle ends up in a chunk, in order, indexing the same vertices
+    std::size_t index = 0;
+    for (const SceneMeshData& chunk : chunks) {
+        CHECK(chunk.indexType == SceneMesh::IndexType::UInt16);
+        CHECK(chunk.vertexCount <= SceneMesh::MaxShortIndexedVertexCount);
+        CHECK(std::size_t(chunk.vertexBytes.size()) == chunk.vertexCount * SceneMesh::vertexByteStride(chunk.vertexFlags));
+        REQUIRE(std::size_t(chunk.indexBytes.size()) == chunk.indexCount * sizeof(uint16_t));
+        CHECK(chunk.indexCount % 3 == 0);
+
+        for (std::size_t i = 0; i < chunk.indexCount; ++i, ++index) {
+            const uint32_t vertex = indexAt(chunk, i);
+            REQUIRE(vertex < chunk.vertexCount);
+            REQUIRE(index < data.indexCount);
+            CHECK(gridVertex(chunk, vertex) == indexAt(data, index));
+        }
+    }
+    CHECK(index == data.indexCount);
+}
@@ -0,0 +1,271 @@
+// Compares cursor picking through all::Bvh against the picking Qt3D does with
+// QPickingSettings::TrianglePicking: every entity whose bounding volume the
+// ray crosses gets all of its triangles tested.
+//
+// The scene is a grid of height field meshes, like a model split into parts,
+// picked with rays from a camera above it through random pixels. Beam queries,
+// as used for the SpaceMouse pivot, are timed on the same rays. Ray packets,
+// as used for auto focus, are timed on the grid of an auto focus area.
+//
+// A second table covers construction: one hierarchy over every triangle,
+// against one per mesh under a top level hierarchy, rebuilding after a single
+// mesh changed, and loading a serialized hierarchy instead of building it.
+#include <shared/bvh.h>
+#include <shared/focus_sampling.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <optional>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr std::size_t MeshesPerSide = 8;
+constexpr std::size_t RayCount = 2000;
+constexpr float BeamSpread = 0.01f; // About the hit aperture navlib asks for
+constexpr uint32_t FocusGridSize = 32;
+constexpr std::size_t TriangleCounts[] = { 10'000, 100'000, 1'000'000, 4'000'000 };
+
+struct Mesh {
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    all::AABB bounds;
+};
+
+// size x size quads covering [x0, x0 + 1] x [y0, y0 + 1]
+Mesh createMesh(std::size_t size, float x0, float y0)
+{
+    Mesh mesh;
+    for (std::size_t y = 0; y <= size; ++y) {
+        for (std::size_t x = 0; x <= size; ++x) {
+            const float u = x0 + float(x) / float(size);
+            const float v = y0 + float(y) / float(size);
+            const glm::vec3 p(u, v, 0.2f * std::sin(u * 3.0f) * std::cos(v * 2.0f));
+            mesh.positions.insert(mesh.positions.end(), { p.x, p.y, p.z });
+            mesh.bounds.expand(p);
+        }
+    }
+    for (std::size_t y = 0; y < size; ++y) {
+        for (std::size_t x = 0; x < size; ++x) {
+            const uint32_t a = uint32_t(y * (size + 1) + x);
+            const uint32_t b = a + 1;
+            const uint32_t c = a + uint32_t(size) + 2;
+            const uint32_t d = a + uint32_t(size) + 1;
+            mesh.indices.insert(mesh.indices.end(), { a, b, c, a, c, d });
+        }
+    }
+    return mesh;
+}
+
+bool crossesBox(const all::Ray& ray, const all::AABB& bounds)
+{
+    float entry = 0.0f;
+    float exit = std::numeric_limits<float>::max();
+    for (int axis = 0; axis < 3; ++axis) {
+        const float inverse = 1.0f / ray.direction[axis];
+        float t0 = (bounds.min[axis] - ray.origin[axis]) * inverse;
+        float t1 = (bounds.max[axis] - ray.origin[axis]) * inverse;
+        if (t0 > t1)
+            std::swap(t0, t1);
+        entry = std::max(entry, t0);
+        exit = std::min(exit, t1);
+    }
+    return entry <= exit;
+}
+
+// What Qt3D's triangle picking amounts to, on the CPU side
+std::optional<float> pickLinear(const std::vector<Mesh>& meshes, const all::Ray& ray)
+{
+    std::optional<float> closest;
+    for (const Mesh& mesh : meshes) {
+        if (!crossesBox(ray, mesh.bounds))
+            continue;
+        const auto* p = reinterpret_cast<const glm::vec3*>(mesh.positions.data());
+        for (std::size_t i = 0; i < mesh.indices.size(); i += 3) {
+            const glm::vec3 a = p[mesh.indices[i]];
+            const glm::vec3 edge1 = p[mesh.indices[i + 1]] - a;
+            const glm::vec3 edge2 = p[mesh.indices[i + 2]] - a;
+            const glm::vec3 pv = glm::cross(ray.direction, edge2);
+            const float determinant = glm::dot(edge1, pv);
+            if (std::abs(determinant) < 1e-12f)
+                continue;
+            const float inverseDeterminant = 1.0f / determinant;
+            const glm::vec3 s = ray.origin - a;
+            const float u = glm::dot(s, pv) * inverseDeterminant;
+            if (u < 0.0f || u > 1.0f)
+                continue;
+            const glm::vec3 q = glm::cross(s, edge1);
+            const float v = glm::dot(ray.direction, q) * inverseDeterminant;
+            if (v < 0.0f || u + v > 1.0f)
+                continue;
+            const float distance = glm::dot(edge2, q) * inverseDeterminant;
+            if (distance >= 0.0f && (!closest || distance < *closest))
+                closest = distance;
+        }
+    }
+    return closest;
+}
+
+double elapsedUs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::shared_ptr<all::Bvh> buildMeshBvh(const Mesh& mesh)
+{
+    auto bvh = std::make_shared<all::Bvh>();
+    bvh->addMesh(mesh.positions.data(), 3 * sizeof(float), mesh.positions.size() / 3, mesh.indices.data(), mesh.indices.size());
+    bvh->build();
+    return bvh;
+}
+
+void benchmarkConstruction()
+{
+    std::printf("\n%u threads\n", std::max(1u, std::thread::hardware_concurrency()));
+    std::printf("%12s %10s %14s %15s %10s %10s %14s %14s\n", "triangles", "build ms", "scene build ms", "part rebuild ms", "cache MiB", "load ms", "bvh us/ray", "scene us/ray");
+    for (const std::size_t triangleCount : TriangleCounts) {
+        const std::size_t meshCount = MeshesPerSide * MeshesPerSide;
+        const auto size = std::max<std::size_t>(1, std::size_t(std::sqrt(double(triangleCount) / double(meshCount) / 2.0)));
+        std::vector<Mesh> meshes;
+        for (std::size_t i = 0; i < meshCount; ++i)
+            meshes.push_back(createMesh(size, float(i % MeshesPerSide), float(i / MeshesPerSide)));
+
+        all::Bvh bvh;
+        for (const Mesh& mesh : meshes)
+            bvh.addMesh(mesh.positions.data(), 3 * sizeof(float), mesh.positions.size() / 3, mesh.indices.data(), mesh.indices.size());
+        auto start = std::chrono::steady_clock::now();
+        bvh.build();
+        const double buildMs = elapsedUs(start) / 1000.0;
+
+        // Meshes are built one after the other here, each across threads
+        all::SceneBvh scene;
+        start = std::chrono::steady_clock::now();
+        for (const Mesh& mesh : meshes)
+            scene.addInstance(buildMeshBvh(mesh));
+        scene.build();
+        const double sceneBuildMs = elapsedUs(start) / 1000.0;
+
+        start = std::chrono::steady_clock::now();
+        scene.setInstance(0, buildMeshBvh(meshes[0]), glm::mat4(1.0f));
+        scene.build();
+        const double partRebuildMs = elapsedUs(start) / 1000.0;
+
+        const std::vector<uint8_t> serialized = bvh.serialize();
+        all::Bvh loaded;
+        start = std::chrono::steady_clock::now();
+        if (!loaded.deserialize(serialized.data(), serialized.size())) {
+            std::fprintf(stderr, "Failed to load the serialized hierarchy\n");
+            return;
+        }
+        const double loadMs = elapsedUs(start) / 1000.0;
+
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> pixel(-1.0f, 1.0f);
+        const glm::vec3 eye(MeshesPerSide * 0.5f, -2.0f, 6.0f);
+        std::vector<all::Ray> rays(RayCount);
+        for (all::Ray& ray : rays) {
+            ray.origin = eye;
+            ray.direction = glm::normalize(glm::vec3(pixel(rng) * 0.6f, 0.8f + pixel(rng) * 0.4f, -0.8f));
+        }
+        start = std::chrono::steady_clock::now();
+        for (const all::Ray& ray : rays)
+            loaded.closestHit(ray);
+        const double bvhUs = elapsedUs(start) / double(RayCount);
+        start = std::chrono::steady_clock::now();
+        for (const all::Ray& ray : rays)
+            scene.closestHit(ray);
+        const double sceneUs = elapsedUs(start) / double(RayCount);
+
+        std::printf("%12zu %10.1f %14.1f %15.1f %10.1f %10.1f %14.2f %14.2f\n", bvh.triangleCount(), buildMs, sceneBuildMs, partRebuildMs,
+                    double(serialized.size()) / (1024.0 * 1024.0), loadMs, bvhUs, sceneUs);
+    }
+}
+} // namespace
+
+int main()
+{
+    std::printf("%12s %10s %10s %12s %14s %14s %14s %16s %14s %9s %10s\n", "triangles", "build ms", "nodes", "memory MiB", "bvh us/ray", "beam us/ray", "grid us/ray",
+                "packet us/ray", "linear us/ray", "speedup", "mismatches");
+    for (const std::size_t triangleCount : TriangleCounts) {
+        const std::size_t meshCount = MeshesPerSide * MeshesPerSide;
+        const auto size = std::max<std::size_t>(1, std::size_t(std::sqrt(double(triangleCount) / double(meshCount) / 2.0)));
+
+        std::vector<Mesh> meshes;
+        all::Bvh bvh;
+        for (std::size_t i = 0; i < meshCount; ++i) {
+            meshes.push_back(createMesh(size, float(i % MeshesPerSide), float(i / MeshesPerSide)));
+            const Mesh& mesh = meshes.back();
+            bvh.addMesh(mesh.positions.data(), 3 * sizeof(float), mesh.positions.size() / 3, mesh.indices.data(), mesh.indices.size());
+        }
+        bvh.build();
+
+        // A camera above the middle of the grid, looking down at an angle
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> pixel(-1.0f, 1.0f);
+        const glm::vec3 eye(MeshesPerSide * 0.5f, -2.0f, 6.0f);
+        std::vector<all::Ray> rays(RayCount);
+        for (all::Ray& ray : rays) {
+            ray.origin = eye;
+            ray.direction = glm::normalize(glm::vec3(pixel(rng) * 0.6f, 0.8f + pixel(rng) * 0.4f, -0.8f));
+        }
+
+        std::vector<std::optional<float>> bvhHits(RayCount);
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < RayCount; ++i) {
+            if (const auto hit = bvh.closestHit(rays[i]))
+                bvhHits[i] = hit->distance;
+        }
+        const double bvhUs = elapsedUs(start) / double(RayCount);
+
+        start = std::chrono::steady_clock::now();
+        for (const all::Ray& ray : rays)
+            bvh.closestHit(all::Beam{ ray, 0.0f, BeamSpread });
+        const double beamUs = elapsedUs(start) / double(RayCount);
+
+        std::size_t mismatches = 0; // Against the linear picker, and between packets and single rays
+
+        // A focus area about a quarter of the view across, in the order auto focus traces it
+        all::FocusSampling sampling;
+        sampling.columns = FocusGridSize;
+        sampling.rows = FocusGridSize;
+        std::vector<all::Ray> gridRays;
+        for (const all::FocusSample& sample : all::focusSamples(sampling, glm::vec2(-0.15f, -0.1f), glm::vec2(0.15f, 0.1f)))
+            gridRays.push_back({ eye, glm::normalize(glm::vec3(sample.position.x, 0.8f + sample.position.y, -0.8f)) });
+        std::vector<std::optional<all::RayHit>> gridHits(gridRays.size());
+        start = std::chrono::steady_clock::now();
+        for (const all::Ray& ray : gridRays)
+            bvh.closestHit(ray);
+        const double gridUs = elapsedUs(start) / double(gridRays.size());
+        start = std::chrono::steady_clock::now();
+        bvh.closestHits(gridRays.data(), gridHits.data(), gridRays.size());
+        const double packetUs = elapsedUs(start) / double(gridRays.size());
+        for (std::size_t i = 0; i < gridRays.size(); ++i) {
+            const std::optional<all::RayHit> hit = bvh.closestHit(gridRays[i]);
+            if (hit.has_value() != gridHits[i].has_value() || (hit && hit->triangle != gridHits[i]->triangle))
+                ++mismatches;
+        }
+
+        // The linear picker gets fewer rays on large scenes, it would take minutes otherwise
+        const std::size_t linearRayCount = std::max<std::size_t>(20, RayCount * 10'000 / triangleCount);
+        start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < std::min(linearRayCount, RayCount); ++i) {
+            const std::optional<float> hit = pickLinear(meshes, rays[i]);
+            if (hit.has_value() != bvhHits[i].has_value() || (hit && std::abs(*hit - *bvhHits[i]) > 1e-4f * *hit))
+                ++mismatches;
+        }
+        const double linearUs = elapsedUs(start) / double(std::min(linearRayCount, RayCount));
+
+        const all::Bvh::Statistics& statistics = bvh.statistics();
+        std::printf("%12zu %10.1f %10zu %12.1f %14.2f %14.2f %14.2f %16.2f %14.1f %8.0fx %10zu\n", bvh.triangleCount(), statistics.buildMs, statistics.nodeCount,
+                    double(statistics.memoryBytes) / (1024.0 * 1024.0), bvhUs, beamUs, gridUs, packetUs, linearUs, linearUs / bvhUs, mismatches);
+    }
+
+    benchmarkConstruction();
+    return 0;
+}
@@ -0,0 +1,299 @@
+// Compares the import scratch allocations made from the heap, as the mesh
+// loaders used to, against a per-import ImportArena.
+//
+// A synthetic model of many unindexed meshes, like OBJ files give, goes
+// through the parallel vertex processing, then each mesh through the vertex
+// cache, fetch and simplification passes of the bake on a pool of threads.
+// Each mode runs in its own process so that their peak RSS can be compared.
+#include <shared/import_arena.h>
+#include <shared/mesh_optimizer.h>
+#include <shared/mesh_processing.h>
+
+#include <assimp/scene.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr std::size_t MeshCount = 1500;
+constexpr std::size_t MinGridSize = 4;
+constexpr std::size_t MaxGridSize = 64;
+
+std::atomic<std::size_t> allocationCount{ 0 };
+std::atomic<std::size_t> liveBytes{ 0 };
+std::atomic<std::size_t> peakLiveBytes{ 0 };
+
+// Every heap block remembers where it starts and how large it is, for the live byte count
+struct BlockHeader {
+    void* block;
+    std::size_t size;
+};
+
+void* countedAllocate(std::size_t size, std::size_t alignment)
+{
+    alignment = std::max(alignment, alignof(std::max_align_t));
+    void* block = std::malloc(size + sizeof(BlockHeader) + alignment);
+    if (!block)
+        throw std::bad_alloc();
+    const auto address = reinterpret_cast<std::uintptr_t>(block) + sizeof(BlockHeader);
+    void* p = reinterpret_cast<void*>((address + alignment - 1) / alignment * alignment);
+    static_cast<BlockHeader*>(p)[-1] = { block, size };
+
+    ++allocationCount;
+    const std::size_t live = liveBytes += size;
+    std::size_t peak = peakLiveBytes;
+    while (live > peak && !peakLiveBytes.compare_exchange_weak(peak, live)) {
+    }
+    return p;
+}
+
+void countedFree(void* p)
+{
+    if (!p)
+        return;
+    const BlockHeader header = static_cast<BlockHeader*>(p)[-1];
+    liveBytes -= header.size;
+    std::free(header.block);
+}
+
+std::size_t currentRssKiB()
+{
+#if defined(__linux__)
+    if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        unsigned long pages = 0;
+        unsigned long residentPages = 0;
+        const int read = std::fscanf(statm, "%lu %lu", &pages, &residentPages);
+        std::fclose(statm);
+        if (read == 2)
+            return residentPages * std::size_t(sysconf(_SC_PAGESIZE)) / 1024;
+    }
+#endif
+    return 0;
+}
+
+std::size_t peakRssKiB()
+{
+#if defined(__linux__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return std::size_t(usage.ru_maxrss);
+#else
+    return 0;
+#endif
+}
+
+// Height field of size x size quads, every triangle corner its own vertex
+aiMesh* createGrid(std::size_t size, float phase)
+{
+    auto* mesh = new aiMesh;
+    mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+    mesh->mNumFaces = unsigned(size * size * 2);
+    mesh->mNumVertices = mesh->mNumFaces * 3;
+    mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+    mesh->mFaces = new aiFace[mesh->mNumFaces];
+
+    auto point = [&](std::size_t x, std::size_t y) {
+        const float u = float(x) / float(size);
+        const float v = float(y) / float(size);
+        return aiVector3D(u, v, 0.1f * std::sin(u * 6.0f + phase) * std::cos(v * 5.0f));
+    };
+    unsigned vertex = 0;
+    unsigned face = 0;
+    for (std::size_t y = 0; y < size; ++y) {
+        for (std::size_t x = 0; x < size; ++x) {
+            const std::size_t corners[2][3][2] = { { { x, y }, { x + 1, y }, { x + 1, y + 1 } },
+                                                   { { x, y }, { x + 1, y + 1 }, { x, y + 1 } } };
+            for (const auto& triangle : corners) {
+                aiFace& f = mesh->mFaces[face++];
+                f.mNumIndices = 3;
+                f.mIndices = new unsigned[3];
+                for (std::size_t k = 0; k < 3; ++k) {
+                    mesh->mVertices[vertex] = point(triangle[k][0], triangle[k][1]);
+                    f.mIndices[k] = vertex++;
+                }
+            }
+        }
+    }
+    return mesh;
+}
+
+std::unique_ptr<aiScene> createScene()
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<std::size_t> gridSize(MinGridSize, MaxGridSize);
+
+    auto scene = std::make_unique<aiScene>();
+    scene->mNumMeshes = unsigned(MeshCount);
+    scene->mMeshes = new aiMesh*[MeshCount];
+    for (std::size_t i = 0; i < MeshCount; ++i)
+        scene->mMeshes[i] = createGrid(gridSize(rng), float(i));
+    return scene;
+}
+
+// What the bake keeps of each mesh
+struct BakedMesh {
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+};
+
+BakedMesh bake(const aiMesh& mesh, std::pmr::memory_resource* scratch)
+{
+    namespace mesh_optimizer = all::mesh_optimizer;
+
+    BakedMesh baked;
+    baked.indices.reserve(mesh.mNumFaces * 3);
+    for (std::size_t i = 0; i < mesh.mNumFaces; ++i)
+        baked.indices.insert(baked.indices.end(), mesh.mFaces[i].mIndices, mesh.mFaces[i].mIndices + 3);
+    baked.positions.resize(mesh.mNumVertices * 3);
+    std::memcpy(baked.positions.data(), mesh.mVertices, baked.positions.size() * sizeof(float));
+
+    mesh_optimizer::optimizeVertexCache(baked.indices.data(), baked.indices.size(), mesh.mNumVertices, scratch);
+    const std::pmr::vector<uint32_t> remap = mesh_optimizer::optimizeVertexFetch(baked.indices.data(), baked.indices.size(), mesh.mNumVertices, scratch);
+    mesh_optimizer::remapVertices(remap, baked.positions.data(), 3 * sizeof(float), scratch);
+
+    const std::vector<uint32_t> lod = mesh_optimizer::simplify(baked.indices.data(), baked.indices.size(), baked.positions.data(), 3 * sizeof(float),
+                                                               mesh.mNumVertices, baked.indices.size() / 2, 0.02f, nullptr, scratch);
+    baked.indices.insert(baked.indices.end(), lod.begin(), lod.end());
+    return baked;
+}
+
+int run(bool useArena)
+{
+    std::unique_ptr<aiScene> scene = createScene();
+    std::size_t triangleCount = 0;
+    for (std::size_t i = 0; i < scene->mNumMeshes; ++i)
+        triangleCount += scene->mMeshes[i]->mNumFaces;
+
+    const std::size_t allocationsBefore = allocationCount;
+    const std::size_t liveBytesBefore = liveBytes;
+    peakLiveBytes = liveBytesBefore;
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<BakedMesh> baked(scene->mNumMeshes);
+    all::ImportArena::Statistics arenaStatistics;
+    {
+        std::unique_ptr<all::ImportArena> arena;
+        if (useArena)
+            arena = std::make_unique<all::ImportArena>();
+
+        all::mesh_processing::processScene(*scene, { true, 30.0f, true }, arena.get());
+
+        std::atomic<std::size_t> nextMesh{ 0 };
+        auto worker = [&] {
+            for (std::size_t i = nextMesh++; i < scene->mNumMeshes; i = nextMesh++) {
+                all::ImportArena::Job job(arena.get());
+                baked[i] = bake(*scene->mMeshes[i], job.resource());
+            }
+        };
+        std::vector<std::thread> threads;
+        for (unsigned i = 1; i < std::max(1u, std::thread::hardware_concurrency()); ++i)
+            threads.emplace_back(worker);
+        worker();
+        for (std::thread& thread : threads)
+            thread.join();
+
+        if (arena)
+            arenaStatistics = arena->statistics();
+    }
+    scene.reset();
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%-6s %zu meshes, %zu triangles: %8.1f ms, %9zu heap allocations, peak heap %8.1f MiB, RSS after %8.1f MiB, peak RSS %8.1f MiB\n",
+                useArena ? "arena" : "heap", std::size_t(MeshCount), triangleCount, ms, allocationCount - allocationsBefore,
+                double(peakLiveBytes - liveBytesBefore) / (1024.0 * 1024.0), double(currentRssKiB()) / 1024.0, double(peakRssKiB()) / 1024.0);
+    if (useArena)
+        std::printf("       arena: %zu allocations served by %zu heap blocks over %zu threads, peak %.1f MiB\n",
+                    arenaStatistics.allocationCount, arenaStatistics.heapAllocationCount, arenaStatistics.threadCount,
+                    double(arenaStatistics.peakBytes) / (1024.0 * 1024.0));
+    return 0;
+}
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    return countedAllocate(size, alignof(std::max_align_t));
+}
+
+void* operator new[](std::size_t size)
+{
+    return countedAllocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return countedAllocate(size, std::size_t(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return countedAllocate(size, std::size_t(alignment));
+}
+
+void operator delete(void* p) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+    countedFree(p);
+}
+
+// Without arguments, runs each mode in a process of its own
+int main(int argc, char** argv)
+{
+    if (argc > 1)
+        return run(std::strcmp(argv[1], "arena") == 0);
+
+    const std::string self = std::string("\"") + argv[0] + "\"";
+    const int heapResult = std::system((self + " heap").c_str());
+    const int arenaResult = std::system((self + " arena").c_str());
+    return heapResult != 0 || arenaResult != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,592 @@
+// Import benchmark of the Qt3D mesh loader, runs without a GPU.
+//
+// Synthetic OBJ, binary STL and glTF height fields from 10k to 50M triangles
+// and the models bundled in assets/ go through MeshLoader::import and
+// MeshLoader::createEntities with each loader configuration. Every file and
+// configuration is measured in a process of its own, so that the peak RSS
+// and the allocation count only cover that import. Results are written as
+// JSON, for runs to be compared over time.
+//
+//   loader_benchmark [--max-triangles N] [--configurations a,b] [--output results.json]
+#include <mesh_loader.h>
+
+#include <Qt3DCore/QEntity>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace {
+using namespace all::qt3d;
+
+constexpr std::array<std::size_t, 5> SyntheticScales = { 10'000, 100'000, 1'000'000, 10'000'000, 50'000'000 };
+constexpr std::size_t DefaultMaxTriangles = 1'000'000;
+
+std::atomic<std::size_t> allocationCount{ 0 };
+
+std::size_t currentRssKiB()
+{
+#if defined(__linux__)
+    if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        unsigned long pages = 0;
+        unsigned long residentPages = 0;
+        const int read = std::fscanf(statm, "%lu %lu", &pages, &residentPages);
+        std::fclose(statm);
+        if (read == 2)
+            return residentPages * std::size_t(sysconf(_SC_PAGESIZE)) / 1024;
+    }
+#endif
+    return 0;
+}
+
+std::size_t peakRssKiB()
+{
+#if defined(__linux__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return std::size_t(usage.ru_maxrss);
+#else
+    return 0;
+#endif
+}
+
+struct Configuration {
+    const char* name;
+    ImportOptions options;
+    bool warmCache{ false }; // Measured on the second import, read from the mesh cache
+};
+
+const std::vector<Configuration>& configurations()
+{
+    static const std::vector<Configuration> known = [] {
+        auto uncached = [](ImportOptions options) {
+            options.useCache = false;
+            return options;
+        };
+        ImportOptions compact = ImportOptions::forProfile(all::ImportProfile::FullQuality);
+        compact.quantization = ImportOptions::compact().quantization;
+        ImportOptions lean = compact;
+        lean.memoryLean = true;
+
+        return std::vector<Configuration>{
+            { "full", uncached(ImportOptions::forProfile(all::ImportProfile::FullQuality)) },
+            { "full-compact", uncached(compact) },
+            { "full-lean", uncached(lean) },
+            { "fast-preview", uncached(ImportOptions::forProfile(all::ImportProfile::FastPreview)) },
+            { "picking-only", uncached(ImportOptions::forProfile(all::ImportProfile::PickingOnly)) },
+            { "cached", ImportOptions::forProfile(all::ImportProfile::FullQuality), true },
+        };
+    }();
+    return known;
+}
+
+const Configuration* findConfiguration(const QString& name)
+{
+    auto it = std::ranges::find_if(configurations(), [&name](const Configuration& configuration) {
+        return name == QLatin1String(configuration.name);
+    });
+    return it != configurations().end() ? &*it : nullptr;
+}
+
+// Buffered writes of large generated files
+class FileWriter
+{
+public:
+    explicit FileWriter(const QString& path)
+        : m_file(path)
+    {
+        m_ok = m_file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+        m_buffer.reserve(BufferSize + 256);
+    }
+
+    ~FileWriter() { flush(); }
+
+    bool isOk() const { return m_ok; }
+
+    void write(const void* data, std::size_t size)
+    {
+        m_buffer.append(static_cast<const char*>(data), size);
+        if (m_buffer.size() >= BufferSize)
+            flush();
+    }
+
+    void write(std::string_view text) { write(text.data(), text.size()); }
+
+    void write(float value)
+    {
+        char digits[32];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        write(digits, std::size_t(result.ptr - digits));
+    }
+
+    void write(std::size_t value)
+    {
+        char digits[32];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        write(digits, std::size_t(result.ptr - digits));
+    }
+
+    void flush()
+    {
+        if (m_ok && !m_buffer.empty())
+            m_ok = m_file.write(m_buffer.data(), qint64(m_buffer.size())) == qint64(m_buffer.size());
+        m_buffer.clear();
+    }
+
+private:
+    static constexpr std::size_t BufferSize = std::size_t(1) << 20;
+
+    QFile m_file;
+    std::string m_buffer;
+    bool m_ok{ false };
+};
+
+// Height field of size x size quads, rows of vertices shared by the triangles around them
+struct HeightField {
+    std::size_t size{ 0 };
+
+    explicit HeightField(std::size_t triangleCount)
+        : size(std::max<std::size_t>(1, std::size_t(std::sqrt(double(triangleCount) / 2.0))))
+    {
+    }
+
+    std::size_t vertexCount() const { return (size + 1) * (size + 1); }
+    std::size_t triangleCount() const { return size * size * 2; }
+
+    std::array<float, 3> position(std::size_t x, std::size_t y) const
+    {
+        const float u = float(x) / float(size);
+        const float v = float(y) / float(size);
+        return { u, v, 0.1f * std::sin(u * 6.0f) * std::cos(v * 5.0f) };
+    }
+
+    std::array<float, 3> normal(std::size_t x, std::size_t y) const
+    {
+        const float u = float(x) / float(size);
+        const float v = float(y) / float(size);
+        const float dx = 0.6f * std::cos(u * 6.0f) * std::cos(v * 5.0f);
+        const float dy = -0.5f * std::sin(u * 6.0f) * std::sin(v * 5.0f);
+        const float length = std::sqrt(dx * dx + dy * dy + 1.0f);
+        return { -dx / length, -dy / length, 1.0f / length };
+    }
+
+    // Corners of both triangles of a quad, as vertex indices
+    std::array<uint32_t, 6> quad(std::size_t x, std::size_t y) const
+    {
+        const auto index = [this](std::size_t x, std::size_t y) {
+            return uint32_t(y * (size + 1) + x);
+        };
+        return { index(x, y), index(x + 1, y), index(x + 1, y + 1), index(x, y), index(x + 1, y + 1), index(x, y + 1) };
+    }
+};
+
+bool writeObj(const QString& path, const HeightField& field)
+{
+    FileWriter writer(path);
+    for (std::size_t y = 0; y <= field.size; ++y) {
+        for (std::size_t x = 0; x <= field.size; ++x) {
+            const auto p = field.position(x, y);
+            writer.write("v ");
+            writer.write(p[0]);
+            writer.write(" ");
+            writer.write(p[1]);
+            writer.write(" ");
+            writer.write(p[2]);
+            const auto n = field.normal(x, y);
+            writer.write("\nvn ");
+            writer.write(n[0]);
+            writer.write(" ");
+            writer.write(n[1]);
+            writer.write(" ");
+            writer.write(n[2]);
+            writer.write("\n");
+        }
+    }
+    for (std::size_t y = 0; y < field.size; ++y) {
+        for (std::size_t x = 0; x < field.size; ++x) {
+            const auto corners = field.quad(x, y);
+            for (std::size_t triangle = 0; triangle < 2; ++triangle) {
+                writer.write("f");
+                for (std::size_t k = 0; k < 3; ++k) {
+                    // Indices are 1-based, each corner has the normal of its position
+                    const std::size_t vertex = std::size_t(corners[triangle * 3 + k]) + 1;
+                    writer.write(" ");
+                    writer.write(vertex);
+                    writer.write("//");
+                    writer.write(vertex);
+                }
+                writer.write("\n");
+            }
+        }
+    }
+    writer.flush();
+    return writer.isOk();
+}
+
+bool writeStl(const QString& path, const HeightField& field)
+{
+    FileWriter writer(path);
+    const char header[80] = "loader_benchmark height field";
+    writer.write(header, sizeof(header));
+    const uint32_t triangleCount = uint32_t(field.triangleCount());
+    writer.write(&triangleCount, sizeof(triangleCount));
+    for (std::size_t y = 0; y < field.size; ++y) {
+        for (std::size_t x = 0; x < field.size; ++x) {
+            const auto corners = field.quad(x, y);
+            for (std::size_t triangle = 0; triangle < 2; ++triangle) {
+                // Zero normals, left for the reader to compute
+                const float normal[3] = { 0.0f, 0.0f, 0.0f };
+                writer.write(normal, sizeof(normal));
+                for (std::size_t k = 0; k < 3; ++k) {
+                    const uint32_t vertex = corners[triangle * 3 + k];
+                    const auto p = field.position(vertex % (field.size + 1), vertex / (field.size + 1));
+                    writer.write(p.data(), sizeof(float) * 3);
+                }
+                const uint16_t attributes = 0;
+                writer.write(&attributes, sizeof(attributes));
+            }
+        }
+    }
+    writer.flush();
+    return writer.isOk();
+}
+
+// Interleaved float positions and normals and 32-bit indices in a .bin next to the .gltf
+bool writeGltf(const QString& path, const HeightField& field)
+{
+    const QString binPath = QFileInfo(path).completeBaseName() + QStringLiteral(".bin");
+    const std::size_t vertexBytes = field.vertexCount() * 6 * sizeof(float);
+    const std::size_t indexBytes = field.triangleCount() * 3 * sizeof(uint32_t);
+
+    {
+        FileWriter writer(QFileInfo(path).absolutePath() + QLatin1Char('/') + binPath);
+        for (std::size_t y = 0; y <= field.size; ++y) {
+            for (std::size_t x = 0; x <= field.size; ++x) {
+                writer.write(field.position(x, y).data(), 3 * sizeof(float));
+                writer.write(field.normal(x, y).data(), 3 * sizeof(float));
+            }
+        }
+        for (std::size_t y = 0; y < field.size; ++y) {
+            for (std::size_t x = 0; x < field.size; ++x)
+                writer.write(field.quad(x, y).data(), 6 * sizeof(uint32_t));
+        }
+        writer.flush();
+        if (!writer.isOk())
+            return false;
+    }
+
+    const auto count = [](std::size_t value) {
+        return double(value);
+    };
+    const QJsonObject gltf{
+        { "asset", QJsonObject{ { "version", "2.0" }, { "generator", "loader_benchmark" } } },
+        { "scene", 0 },
+        { "scenes", QJsonArray{ QJsonObject{ { "nodes", QJsonArray{ 0 } } } } },
+        { "nodes", QJsonArray{ QJsonObject{ { "mesh", 0 } } } },
+        { "materials", QJsonArray{ QJsonObject{ { "name", "HeightField" },
+                                                { "pbrMetallicRoughness", QJsonObject{ { "baseColorFactor", QJsonArray{ 0.8, 0.8, 0.8, 1.0 } } } } } } },
+        { "meshes", QJsonArray{ QJsonObject{ { "primitives", QJsonArray{ QJsonObject{ { "attributes", QJsonObject{ { "POSITION", 0 }, { "NORMAL", 1 } } },
+                                                                                     { "indices", 2 },
+                                                                                     { "material", 0 },
+                                                                                     { "mode", 4 } } } } } } },
+        { "buffers", QJsonArray{ QJsonObject{ { "uri", binPath }, { "byteLength", count(vertexBytes + indexBytes) } } } },
+        { "bufferViews", QJsonArray{ QJsonObject{ { "buffer", 0 }, { "byteOffset", 0 }, { "byteLength", count(vertexBytes) }, { "byteStride", 24 }, { "target", 34962 } },
+                                     QJsonObject{ { "buffer", 0 }, { "byteOffset", count(vertexBytes) }, { "byteLength", count(indexBytes) }, { "target", 34963 } } } },
+        { "accessors", QJsonArray{ QJsonObject{ { "bufferView", 0 }, { "byteOffset", 0 }, { "componentType", 5126 }, { "count", count(field.vertexCount()) }, { "type", "VEC3" }, { "min", QJsonArray{ 0.0, 0.0, -0.1 } }, { "max", QJsonArray{ 1.0, 1.0, 0.1 } } },
+                                   QJsonObject{ { "bufferView", 0 }, { "byteOffset", 12 }, { "componentType", 5126 }, { "count", count(field.vertexCount()) }, { "type", "VEC3" } },
+                                   QJsonObject{ { "bufferView", 1 }, { "byteOffset", 0 }, { "componentType", 5125 }, { "count", count(field.triangleCount() * 3) }, { "type", "SCALAR" } } } },
+    };
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    return file.write(QJsonDocument(gltf).toJson()) > 0;
+}
+
+struct BenchmarkFile {
+    QString path;
+    QString format;
+    std::size_t sourceTriangles{ 0 }; // 0 for the bundled models
+};
+
+std::vector<BenchmarkFile> generateSyntheticFiles(const QString& directory, std::size_t maxTriangles)
+{
+    using Writer = bool (*)(const QString&, const HeightField&);
+    const std::array<std::pair<const char*, Writer>, 3> formats = { { { "obj", writeObj }, { "stl", writeStl }, { "gltf", writeGltf } } };
+
+    std::vector<BenchmarkFile> files;
+    for (const std::size_t scale : SyntheticScales) {
+        if (scale > maxTriangles)
+            break;
+        const HeightField field(scale);
+        for (const auto& [format, write] : formats) {
+            const QString path = QStringLiteral("%1/heightfield_%2.%3").arg(directory).arg(scale).arg(QLatin1String(format));
+            QElapsedTimer timer;
+            timer.start();
+            if (!write(path, field)) {
+                std::fprintf(stderr, "Failed to write %s\n", qPrintable(path));
+                continue;
+            }
+            std::printf("Generated %s (%zu triangles) in %lld ms\n", qPrintable(QFileInfo(path).fileName()), field.triangleCount(), timer.elapsed());
+            files.push_back({ path, QLatin1String(format), field.triangleCount() });
+        }
+    }
+    return files;
+}
+
+std::vector<BenchmarkFile> bundledFiles()
+{
+    std::vector<BenchmarkFile> files;
+    QDirIterator it(QStringLiteral(ASSETS_DIR), { "*.obj", "*.stl", "*.ply", "*.gltf", "*.glb", "*.fbx" }, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QFileInfo info(it.next());
+        files.push_back({ info.absoluteFilePath(), info.suffix().toLower(), 0 });
+    }
+    std::sort(files.begin(), files.end(), [](const BenchmarkFile& a, const BenchmarkFile& b) {
+        return a.path < b.path;
+    });
+    return files;
+}
+
+// Child process: imports file with configuration and writes the measurements to resultPath
+int runImport(const Configuration& configuration, const QString& path, const QString& resultPath)
+{
+    // Keeps the mesh cache of the benchmark away from the one of the demo
+    QStandardPaths::setTestModeEnabled(true);
+    qInstallMessageHandler([](QtMsgType type, const QMessageLogContext&, const QString& message) {
+        if (type != QtDebugMsg && type != QtInfoMsg)
+            std::fprintf(stderr, "%s\n", qPrintable(message));
+    });
+
+    const std::size_t baselineRss = currentRssKiB();
+    const std::size_t allocationsBefore = allocationCount;
+    QElapsedTimer timer;
+    timer.start();
+
+    const std::shared_ptr<ModelData> model = MeshLoader::import(path, configuration.options);
+    if (!model)
+        return EXIT_FAILURE;
+
+    // Materials, textures and the entities drawing the meshes
+    QElapsedTimer materialTimer;
+    materialTimer.start();
+    std::unique_ptr<Qt3DCore::QEntity> root(MeshLoader::createEntities(*model));
+    const double materialSetupMs = double(materialTimer.nsecsElapsed()) / 1.0e6;
+    const double wallMs = double(timer.nsecsElapsed()) / 1.0e6;
+    const std::size_t allocations = allocationCount - allocationsBefore;
+
+    std::size_t triangles = 0;
+    for (const ModelMesh& mesh : model->meshes)
+        triangles += std::size_t(mesh.data.indexCount / 3) * std::max<std::size_t>(1, mesh.instances.size());
+    const ModelMemory memory = model->memory();
+
+    const QJsonObject result{
+        { "parse_ms", model->timings.parseMs },
+        { "post_process_ms", model->timings.postProcessMs },
+        { "bake_ms", model->timings.bakeMs },
+        { "import_ms", model->timings.totalMs },
+        { "material_setup_ms", materialSetupMs },
+        { "wall_ms", wallMs },
+        { "allocations", double(allocations) },
+        { "baseline_rss_kib", double(baselineRss) },
+        { "peak_rss_kib", double(peakRssKiB()) },
+        { "model_bytes", double(memory.totalBytes()) },
+        { "meshes", double(model->meshes.size()) },
+        { "triangles", double(triangles) },
+    };
+    QFile file(resultPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return EXIT_FAILURE;
+    file.write(QJsonDocument(result).toJson(QJsonDocument::Compact));
+    return EXIT_SUCCESS;
+}
+
+std::optional<QJsonObject> runImportProcess(const Configuration& configuration, const BenchmarkFile& file, const QString& resultPath)
+{
+    QProcess process;
+    process.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    process.start(QCoreApplication::applicationFilePath(),
+                  { QStringLiteral("--run"), QLatin1String(configuration.name), QStringLiteral("--file"), file.path, QStringLiteral("--result"), resultPath });
+    if (!process.waitForFinished(-1) || process.exitStatus() != QProcess::NormalExit || process.exitCode() != EXIT_SUCCESS)
+        return std::nullopt;
+
+    QFile result(resultPath);
+    if (!result.open(QIODevice::ReadOnly))
+        return std::nullopt;
+    return QJsonDocument::fromJson(result.readAll()).object();
+}
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    ++allocationCount;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+int main(int argc, char** argv)
+{
+    // Child processes create Qt3D nodes, which don't need a display
+    const bool child = std::any_of(argv + 1, argv + argc, [](const char* arg) {
+        return std::strcmp(arg, "--run") == 0;
+    });
+    std::unique_ptr<QCoreApplication> app;
+    if (child) {
+        if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        app = std::make_unique<QGuiApplication>(argc, argv);
+    } else {
+        app = std::make_unique<QCoreApplication>(argc, argv);
+    }
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption maxTrianglesOption("max-triangles", "Largest synthetic model, up to 50000000.", "count", QString::number(DefaultMaxTriangles));
+    const QCommandLineOption configurationsOption("configurations", "Comma separated loader configurations, all by default.", "names");
+    const QCommandLineOption outputOption("output", "JSON file the results are written to.", "path", "loader_benchmark.json");
+    const QCommandLineOption noAssetsOption("no-assets", "Skip the models bundled in assets/.");
+    QCommandLineOption runOption("run", "Configuration to import file with, in a child process.", "name");
+    QCommandLineOption fileOption("file", "Model to import.", "path");
+    QCommandLineOption resultOption("result", "File the child process writes its results to.", "path");
+    for (QCommandLineOption* option : { &runOption, &fileOption, &resultOption })
+        option->setFlags(QCommandLineOption::HiddenFromHelp);
+    parser.addOptions({ maxTrianglesOption, configurationsOption, outputOption, noAssetsOption, runOption, fileOption, resultOption });
+    parser.process(*app);
+
+    if (child) {
+        const Configuration* configuration = findConfiguration(parser.value(runOption));
+        if (!configuration)
+            return EXIT_FAILURE;
+        return runImport(*configuration, parser.value(fileOption), parser.value(resultOption));
+    }
+
+    std::vector<const Configuration*> selected;
+    const QStringList names = parser.isSet(configurationsOption) ? parser.value(configurationsOption).split(QLatin1Char(','), Qt::SkipEmptyParts) : QStringList();
+    for (const Configuration& configuration : configurations()) {
+        if (names.isEmpty() || names.contains(QLatin1String(configuration.name)))
+            selected.push_back(&configuration);
+    }
+    if (selected.empty()) {
+        std::fprintf(stderr, "No known configuration in %s\n", qPrintable(names.join(QLatin1Char(','))));
+        return EXIT_FAILURE;
+    }
+
+    QTemporaryDir workDirectory;
+    if (!workDirectory.isValid()) {
+        std::fprintf(stderr, "Failed to create a temporary directory\n");
+        return EXIT_FAILURE;
+    }
+    std::vector<BenchmarkFile> files = generateSyntheticFiles(workDirectory.path(), parser.value(maxTrianglesOption).toULongLong());
+    if (!parser.isSet(noAssetsOption)) {
+        const std::vector<BenchmarkFile> bundled = bundledFiles();
+        files.insert(files.end(), bundled.begin(), bundled.end());
+    }
+
+    std::printf("%-32s %-13s %10s %10s %10s %10s %10s %12s %12s\n", "file", "configuration", "parse ms", "post ms", "bake ms", "setup ms",
+                "total ms", "allocations", "peak RSS MiB");
+    QJsonArray results;
+    int failures = 0;
+    const QString resultPath = workDirectory.filePath(QStringLiteral("result.json"));
+    for (const BenchmarkFile& file : files) {
+        for (const Configuration* configuration : selected) {
+            // The first import fills the mesh cache the measured one reads from
+            if (configuration->warmCache)
+                runImportProcess(*configuration, file, resultPath);
+
+            std::optional<QJsonObject> result = runImportProcess(*configuration, file, resultPath);
+            QFile::remove(resultPath);
+            const QString fileName = QFileInfo(file.path).fileName();
+            if (!result) {
+                std::printf("%-32s %-13s failed\n", qPrintable(fileName), configuration->name);
+                ++failures;
+                continue;
+            }
+            std::printf("%-32s %-13s %10.1f %10.1f %10.1f %10.1f %10.1f %12.0f %12.1f\n", qPrintable(fileName), configuration->name,
+                        (*result)["parse_ms"].toDouble(), (*result)["post_process_ms"].toDouble(), (*result)["bake_ms"].toDouble(),
+                        (*result)["material_setup_ms"].toDouble(), (*result)["wall_ms"].toDouble(), (*result)["allocations"].toDouble(),
+                        (*result)["peak_rss_kib"].toDouble() / 1024.0);
+
+            result->insert("file", file.sourceTriangles > 0 ? fileName : QDir(QStringLiteral(ASSETS_DIR)).relativeFilePath(file.path));
+            result->insert("format", file.format);
+            result->insert("synthetic", file.sourceTriangles > 0);
+            if (file.sourceTriangles > 0)
+                result->insert("source_triangles", double(file.sourceTriangles));
+            result->insert("configuration", QLatin1String(configuration->name));
+            results.append(*result);
+        }
+    }
+
+    const QJsonObject report{
+        { "benchmark", "loader" },
+        { "version", ALLEGIANCE_PROJECT_VERSION },
+        { "timestamp", QDateTime::currentDateTimeUtc().toString(Qt::ISODate) },
+        { "threads", QThread::idealThreadCount() },
+        { "results", results },
+    };
+    QFile output(parser.value(outputOption));
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        std::fprintf(stderr, "Failed to write %s\n", qPrintable(output.fileName()));
+        return EXIT_FAILURE;
+    }
+    output.write(QJsonDocument(report).toJson());
+    std::printf("Results written to %s\n", qPrintable(QFileInfo(output).absoluteFilePath()));
+    return failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
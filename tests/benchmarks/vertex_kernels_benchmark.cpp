@@ -0,0 +1,97 @@
+// Compares the batched vertex kernels against the per-vertex glm path the
+// mesh loaders used before.
+#include <shared/vertex_kernels.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+constexpr std::size_t VertexCount = 1 << 20;
+constexpr int Iterations = 20;
+// Interleaved position, normal, texCoord like the Qt3D vertex buffer
+constexpr std::size_t DstStride = 8 * sizeof(float);
+
+double bestOf(const std::function<void()>& f)
+{
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < Iterations; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        const auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+    return best;
+}
+
+void report(const char* name, double seconds, double baseline)
+{
+    std::printf("%-28s %8.3f ms %8.1f Mvertices/s %6.2fx\n", name, seconds * 1e3, VertexCount / seconds * 1e-6, baseline / seconds);
+}
+} // namespace
+
+int main()
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+
+    std::vector<glm::vec3> positions(VertexCount);
+    std::vector<glm::vec3> normals(VertexCount);
+    for (std::size_t i = 0; i < VertexCount; ++i) {
+        positions[i] = glm::vec3(dist(rng), dist(rng), dist(rng));
+        normals[i] = glm::vec3(dist(rng), dist(rng), dist(rng));
+    }
+
+    glm::mat4 transform(1.0f);
+    transform[0] = glm::vec4(0.8f, 0.1f, 0.0f, 0.0f);
+    transform[1] = glm::vec4(-0.1f, 0.9f, 0.2f, 0.0f);
+    transform[2] = glm::vec4(0.0f, -0.2f, 1.1f, 0.0f);
+    transform[3] = glm::vec4(5.0f, -3.0f, 2.0f, 1.0f);
+    const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+
+    std::vector<float> dst(VertexCount * DstStride / sizeof(float));
+
+    std::printf("Instruction set: %s, %zu vertices\n", all::vertex_kernels::activeInstructionSet(), VertexCount);
+
+    const double perVertex = bestOf([&] {
+        all::AABB bounds;
+        float* out = dst.data();
+        for (std::size_t i = 0; i < VertexCount; ++i) {
+            const glm::vec3 p = glm::vec3(transform * glm::vec4(positions[i], 1.0f));
+            const glm::vec3 n = glm::normalize(normalMatrix * normals[i]);
+            out[0] = p.x, out[1] = p.y, out[2] = p.z;
+            out[3] = n.x, out[4] = n.y, out[5] = n.z;
+            bounds.expand(p);
+            out += DstStride / sizeof(float);
+        }
+    });
+    report("per-vertex glm (AoS)", perVertex, perVertex);
+
+    const double batchedAoS = bestOf([&] {
+        all::AABB bounds;
+        all::vertex_kernels::transformPositions(transform, &positions[0].x, sizeof(glm::vec3), dst.data(), DstStride, VertexCount, &bounds);
+        all::vertex_kernels::transformNormals(normalMatrix, &normals[0].x, sizeof(glm::vec3), dst.data() + 3, DstStride, VertexCount);
+    });
+    report("batched kernels (AoS)", batchedAoS, perVertex);
+
+    std::vector<float> px(VertexCount), py(VertexCount), pz(VertexCount);
+    std::vector<float> nx(VertexCount), ny(VertexCount), nz(VertexCount);
+    std::vector<float> ox(VertexCount), oy(VertexCount), oz(VertexCount);
+    for (std::size_t i = 0; i < VertexCount; ++i) {
+        px[i] = positions[i].x, py[i] = positions[i].y, pz[i] = positions[i].z;
+        nx[i] = normals[i].x, ny[i] = normals[i].y, nz[i] = normals[i].z;
+    }
+
+    const double batchedSoA = bestOf([&] {
+        all::AABB bounds;
+        all::vertex_kernels::transformPositions(transform, { px.data(), py.data(), pz.data() }, { ox.data(), oy.data(), oz.data() }, VertexCount, &bounds);
+        all::vertex_kernels::transformNormals(normalMatrix, { nx.data(), ny.data(), nz.data() }, { ox.data(), oy.data(), oz.data() }, VertexCount);
+    });
+    report("batched kernels (SoA)", batchedSoA, perVertex);
+
+    return 0;
+}